@@ -435,6 +435,8 @@ void usb_write_packet(otg_global_type *usbx, uint8_t *pusr_buf, uint16_t num, ui
 
 /**
   * @brief  read data from usb buffer to user buffer
+  *         only the nbytes valid bytes are stored, the last fifo word is split
+  *         into bytes when nbytes is not a multiple of 4.
   * @param  pusr_buf: point to user buffer
   * @param  offset_addr: endpoint rx offset address
   * @param  nbytes: number of bytes data write to usb buffer
@@ -442,17 +444,52 @@ void usb_write_packet(otg_global_type *usbx, uint8_t *pusr_buf, uint16_t num, ui
   */
 void usb_read_packet(otg_global_type *usbx, uint8_t *pusr_buf, uint16_t num, uint16_t nbytes)
 {
-  uint32_t n_index;
-  uint32_t nhbytes = (nbytes + 3) / 4;
-  uint32_t *pbuf = (uint32_t *)pusr_buf;
-  for(n_index = 0; n_index < nhbytes; n_index ++)
+  __IO uint32_t *pfifo = &USB_FIFO(usbx, 0);
+  uint32_t nwords = nbytes >> 2;
+  uint32_t ntail = nbytes & 0x3;
+  uint32_t data;
+
+  if(((uint32_t)pusr_buf & 0x3) == 0)
+  {
+    /* word aligned buffer, pop four words per loop so that the stores
+       can be merged into one multiple store */
+    uint32_t *pbuf = (uint32_t *)pusr_buf;
+    for(; nwords >= 4; nwords -= 4)
+    {
+      pbuf[0] = *pfifo;
+      pbuf[1] = *pfifo;
+      pbuf[2] = *pfifo;
+      pbuf[3] = *pfifo;
+      pbuf += 4;
+    }
+    for(; nwords > 0; nwords --)
+    {
+      *pbuf ++ = *pfifo;
+    }
+    pusr_buf = (uint8_t *)pbuf;
+  }
+  else
   {
+    for(; nwords > 0; nwords --)
+    {
 #if defined (__ICCARM__) && (__VER__ < 7000000)
-    *(__packed uint32_t *)pbuf = USB_FIFO(usbx, 0);
+      *(__packed uint32_t *)pusr_buf = *pfifo;
 #else
-    __UNALIGNED_UINT32_WRITE(pbuf, (USB_FIFO(usbx, 0)));
+      __UNALIGNED_UINT32_WRITE(pusr_buf, *pfifo);
 #endif
-    pbuf ++;
+      pusr_buf += 4;
+    }
+  }
+
+  /* last partial word, do not write past the end of the packet */
+  if(ntail > 0)
+  {
+    data = *pfifo;
+    do
+    {
+      *pusr_buf ++ = (uint8_t)data;
+      data >>= 8;
+    } while(-- ntail > 0);
   }
 }
 #endif
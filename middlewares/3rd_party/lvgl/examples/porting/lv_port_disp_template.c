@@ -27,9 +27,31 @@
     #define MY_DISP_VER_RES    240
 #endif
 
+/*An area flush is split into at most 4 bands around the video area*/
+#define DISP_BAND_MAX   4
+
+/*Draw buffers rotated through LVGL's two buffer pointers, one renders while the others are sent*/
+#define DISP_BUF_NUM        3
+#define DISP_BUF_ROWS       20
+
+/*Strip size limits and step of the adaptive strip sizing, in display rows*/
+#define DISP_STRIP_MIN_ROWS     4
+#define DISP_STRIP_STEP_ROWS    2
+
 /**********************
  *      TYPEDEFS
  **********************/
+/*Panel vertical scrolling of one scrollable object*/
+typedef struct {
+    lv_obj_t * obj;
+    lv_coord_t top;                 /*First row of the scrolling area*/
+    lv_coord_t bottom;              /*Last row of the scrolling area*/
+    lv_coord_t ofs;                 /*Memory row of `top` is top + ofs*/
+    lv_coord_t scroll_x;            /*Last seen scroll position of obj*/
+    lv_coord_t scroll_y;
+    lv_coord_t dy;                  /*Rows the content moved in the last scroll*/
+    bool pending;                   /*The invalidation of that scroll is still to come*/
+} disp_scroll_t;
 
 /**********************
  *  STATIC PROTOTYPES
@@ -37,12 +59,34 @@
 static void disp_init(void);
 
 static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p);
+static void disp_update(lv_disp_drv_t * disp_drv);
+static void disp_rounder(lv_disp_drv_t * disp_drv, lv_area_t * area);
+static void disp_scroll_event_cb(lv_event_t * e);
+static void disp_scroll_reset(void);
+static lv_coord_t disp_scroll_map(lv_coord_t y, lv_coord_t * last);
+static void disp_flush_done(void * user);
+static void disp_wait(lv_disp_drv_t * disp_drv);
+static void video_obj_event_cb(lv_event_t * e);
+static void disp_submit(const lv_area_t * win, const lv_color_t * buf, const lv_area_t * buf_area,
+                        lcd_dma_done_type done, void * user);
 //static void gpu_fill(lv_disp_drv_t * disp_drv, lv_color_t * dest_buf, lv_coord_t dest_width,
 //        const lv_area_t * fill_area, lv_color_t color);
 
 /**********************
  *  STATIC VARIABLES
  **********************/
+static lv_area_t video_area;
+static bool video_valid;
+static lv_obj_t * video_obj;    /*Opaque placeholder of the video area on the active screen*/
+
+static disp_scroll_t scroll;
+
+static lv_color_t disp_buf[DISP_BUF_NUM][MY_DISP_HOR_RES * DISP_BUF_ROWS];
+static volatile bool disp_buf_busy[DISP_BUF_NUM];   /*The dma still reads the buffer*/
+static uint32_t disp_buf_submit[DISP_BUF_NUM];      /*Cycle counter when the buffer was queued*/
+static uint32_t disp_render_start;                  /*Cycle counter when LVGL got the last buffer*/
+static lv_color_t * disp_buf_next;                  /*Buffer LVGL renders the next strip into*/
+static lv_port_disp_stats_t disp_stats;
 
 /**********************
  *      MACROS
@@ -52,16 +96,6 @@ static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
  *   GLOBAL FUNCTIONS
  **********************/
 static lv_disp_drv_t* lv_disp_drv_p = NULL;
-void DMA1_Channel3_IRQHandler()
-{
-
-    dma_flag_clear(DMA1_FDT3_FLAG);
-    dma_channel_enable(DMA1_CHANNEL3, FALSE);  
-    if(lv_disp_drv_p != NULL) 
-    {
-        lv_disp_flush_ready(lv_disp_drv_p); /* tell lvgl that flushing is done */
-    }
-}
 void lv_port_disp_init(void)
 {
     /*-------------------------
@@ -95,10 +129,10 @@ void lv_port_disp_init(void)
      */
 
 
-    static lv_disp_draw_buf_t draw_buf_dsc_2          ;                      /*An other buffer for 10 rows*/
-    static lv_color_t buf_2_1[MY_DISP_HOR_RES * 20];                        /*A buffer for 10 rows*/
-    static lv_color_t buf_2_2[MY_DISP_HOR_RES * 20];                        /*An other buffer for 10 rows*/
-    lv_disp_draw_buf_init(&draw_buf_dsc_2, buf_2_1, buf_2_2, MY_DISP_HOR_RES * 20);   /*Initialize the display buffer*/
+    /* 2. with DISP_BUF_NUM buffers: disp_flush gives LVGL a free buffer in place of the one
+     * being sent, so the next strips render while the dma sends the previous ones*/
+    static lv_disp_draw_buf_t draw_buf_dsc_2          ;
+    lv_disp_draw_buf_init(&draw_buf_dsc_2, disp_buf[0], disp_buf[1], MY_DISP_HOR_RES * DISP_BUF_ROWS);   /*Initialize the display buffer*/
 
     /*-----------------------------------
      * Register the display in LVGL
@@ -116,6 +150,22 @@ void lv_port_disp_init(void)
     /*Used to copy the buffer's content to the display*/
     disp_drv.flush_cb = disp_flush;
 
+    /*Sleep instead of spinning while the dma still sends the buffers*/
+    disp_drv.wait_cb = disp_wait;
+
+    /*Rotate with the panel scan direction, LVGL keeps drawing unrotated strips*/
+    disp_drv.sw_rotate = 0;
+    disp_drv.drv_update_cb = disp_update;
+
+    /*Turns the invalidation after a panel accelerated scroll into the exposed rows*/
+    disp_drv.rounder_cb = disp_rounder;
+
+    /* Join invalid areas by their refresh cost, in cpu cycles at 288 MHz: a byte takes 64 cycles
+     * on the 36 MHz spi, every flush pays the window commands, the dma setup and an object tree walk*/
+    disp_drv.merge_cost.render_px = 16;
+    disp_drv.merge_cost.transfer_byte = 64;
+    disp_drv.merge_cost.flush = 8000;
+
     /*Set a display buffer*/
     disp_drv.draw_buf = &draw_buf_dsc_2;
 
@@ -138,24 +188,13 @@ void lv_port_disp_init(void)
 /*Initialize your display and the required peripherals.*/
 static void disp_init(void)
 {
-    /*You code here*/
-  dma_init_type dma_init_struct;
-  crm_periph_clock_enable(CRM_DMA1_PERIPH_CLOCK, TRUE);
-  dma_reset(LCD_SPI_MASTER_Tx_DMA_Channel);
-  dma_init_struct.buffer_size = 0xFFFE;
-  dma_init_struct.direction = DMA_DIR_MEMORY_TO_PERIPHERAL;
-  dma_init_struct.memory_base_addr = (uint32_t)LCD_SPI_MASTER_DR_Base;
-  dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_BYTE;
-  dma_init_struct.memory_inc_enable = TRUE;
-  dma_init_struct.peripheral_base_addr = (uint32_t)LCD_SPI_MASTER_DR_Base;
-  dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_BYTE;
-  dma_init_struct.peripheral_inc_enable = FALSE;
-  dma_init_struct.priority = DMA_PRIORITY_HIGH;
-  dma_init_struct.loop_mode_enable = FALSE;
-  dma_init(LCD_SPI_MASTER_Tx_DMA_Channel, &dma_init_struct);
-  
-  nvic_irq_enable(LCD_SPI_MASTER_Tx_DMA_IRQn, 1, 0);
-  dma_interrupt_enable(LCD_SPI_MASTER_Tx_DMA_Channel,DMA_FDT_INT,TRUE); 
+    /*The lcd dma engine is set up by lcd_init, see lcd_dma_submit*/
+    nvic_irq_enable(LCD_SPI_MASTER_Tx_DMA_IRQn, 1, 0);
+
+    /*Cycle counter for the render and flush times*/
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 volatile bool disp_flush_enabled = true;
@@ -174,6 +213,314 @@ void disp_disable_update(void)
     disp_flush_enabled = false;
 }
 
+/**
+ * Reserve a panel area for the camera. LVGL output is clipped around it so only
+ * lv_port_disp_video_flush writes there, widgets inside the area are not shown.
+ * An opaque object on the active screen covers the area, so LVGL doesn't render the
+ * widgets under it either. Call it again after loading an other screen or creating
+ * widgets there, only the ones below the placeholder are skipped.
+ * @param area      area in display coordinates, NULL to give it back to LVGL
+ */
+void lv_port_disp_video_set_area(const lv_area_t * area)
+{
+    lv_obj_t * scr = lv_scr_act();
+    lv_coord_t ofs_x;
+    lv_coord_t ofs_y;
+
+    lcd_dma_wait();
+    if(area == NULL) {
+        video_valid = false;
+        /*Deleting the placeholder invalidates the area, LVGL redraws what the video gives back*/
+        if(video_obj != NULL) lv_obj_del(video_obj);
+        return;
+    }
+
+    video_area = *area;
+    video_valid = true;
+
+    if(video_obj == NULL) {
+        video_obj = lv_obj_create(scr);
+        lv_obj_remove_style_all(video_obj);
+        lv_obj_clear_flag(video_obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(video_obj, LV_OBJ_FLAG_FLOATING | LV_OBJ_FLAG_IGNORE_LAYOUT);
+        lv_obj_add_event_cb(video_obj, video_obj_event_cb, LV_EVENT_ALL, NULL);
+    }
+    else if(lv_obj_get_parent(video_obj) != scr) {
+        lv_obj_set_parent(video_obj, scr);
+    }
+
+    /*Floating objects are placed relative to the content area of the screen*/
+    ofs_x = scr->coords.x1 + lv_obj_get_style_pad_left(scr, LV_PART_MAIN) +
+            lv_obj_get_style_border_width(scr, LV_PART_MAIN);
+    ofs_y = scr->coords.y1 + lv_obj_get_style_pad_top(scr, LV_PART_MAIN) +
+            lv_obj_get_style_border_width(scr, LV_PART_MAIN);
+    lv_obj_set_pos(video_obj, area->x1 - ofs_x, area->y1 - ofs_y);
+    lv_obj_set_size(video_obj, lv_area_get_width(area), lv_area_get_height(area));
+
+    /*Only the objects drawn before it are hidden*/
+    lv_obj_move_foreground(video_obj);
+}
+
+/*The video placeholder draws nothing but covers what is below it*/
+static void video_obj_event_cb(lv_event_t * e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if(code == LV_EVENT_COVER_CHECK) {
+        lv_cover_check_info_t * info = lv_event_get_param(e);
+        if(info->res != LV_COVER_RES_MASKED && _lv_area_is_in(info->area, &video_obj->coords, 0)) {
+            info->res = LV_COVER_RES_COVER;
+        }
+    }
+    else if(code == LV_EVENT_DELETE) {
+        video_obj = NULL;
+    }
+}
+
+/**
+ * Send camera pixels straight to the panel, bypassing the LVGL renderer.
+ * Only the part inside the video area is written. The transfer runs in the background,
+ * `pixels` has to stay valid until lv_port_disp_video_wait returns.
+ * @param area      area of the pixels in display coordinates
+ * @param pixels    lv_area_get_size(area) pixels
+ */
+void lv_port_disp_video_flush(const lv_area_t * area, const lv_color_t * pixels)
+{
+    lv_area_t win;
+
+    if(!video_valid || !_lv_area_intersect(&win, area, &video_area)) return;
+
+    disp_submit(&win, pixels, area, NULL, NULL);
+}
+
+/**
+ * Wait for the background transfers of lv_port_disp_video_flush.
+ */
+void lv_port_disp_video_wait(void)
+{
+    lcd_dma_wait();
+}
+
+/**
+ * Scroll `obj` vertically with the panel instead of redrawing it. On a scroll the panel's
+ * scrolling area is shifted and only the exposed rows are rendered and sent.
+ * `obj` has to span the full display width and not be rotated. What the panel shifts has to move
+ * with the content: no border, radius or shadow on `obj`, no floating children and no other
+ * widgets or video area over it. Horizontal scrolls are redrawn as usual.
+ * @param obj       scrollable object, only one at a time
+ * @return          true if the panel scrolls `obj`
+ */
+bool lv_port_disp_scroll_enable(lv_obj_t * obj)
+{
+    lv_disp_t * disp = lv_obj_get_disp(obj);
+    lv_coord_t top = LV_MAX(obj->coords.y1, 0);
+    lv_coord_t bottom = LV_MIN(obj->coords.y2, lv_disp_get_ver_res(disp) - 1);
+
+    lv_port_disp_scroll_disable();
+
+    if(lv_disp_get_rotation(disp) != LV_DISP_ROT_NONE) return false;
+    if(obj->coords.x1 > 0 || obj->coords.x2 < lv_disp_get_hor_res(disp) - 1) return false;
+    if(bottom <= top) return false;
+
+    scroll.obj = obj;
+    scroll.top = top;
+    scroll.bottom = bottom;
+    scroll.ofs = 0;
+    scroll.scroll_x = lv_obj_get_scroll_x(obj);
+    scroll.scroll_y = lv_obj_get_scroll_y(obj);
+    scroll.pending = false;
+
+    lcd_scroll_area(top, bottom - top + 1, MY_DISP_VER_RES - 1 - bottom);
+    lcd_scroll_start(top);
+    lv_obj_add_event_cb(obj, disp_scroll_event_cb, LV_EVENT_ALL, NULL);
+    return true;
+}
+
+/**
+ * Stop the panel scrolling of lv_port_disp_scroll_enable, the object is redrawn.
+ */
+void lv_port_disp_scroll_disable(void)
+{
+    lv_obj_t * obj = scroll.obj;
+
+    if(obj == NULL) return;
+    lv_obj_remove_event_cb(obj, disp_scroll_event_cb);
+    disp_scroll_reset();
+}
+
+/*Leave the scrolling mode, the panel rows are shown unshifted again so LVGL redraws them*/
+static void disp_scroll_reset(void)
+{
+    lv_area_t area;
+    lv_disp_t * disp = lv_obj_get_disp(scroll.obj);
+
+    lv_area_set(&area, 0, scroll.top, lv_disp_get_hor_res(disp) - 1, scroll.bottom);
+    scroll.obj = NULL;
+    scroll.pending = false;
+    lcd_scroll_disable();
+    _lv_inv_area(disp, &area);
+}
+
+/*Shift the panel when the scrolled object moves its content vertically*/
+static void disp_scroll_event_cb(lv_event_t * e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_obj_t * obj = lv_event_get_target(e);
+    lv_coord_t x, y, dy;
+    lv_coord_t vsa = scroll.bottom - scroll.top + 1;
+    lv_area_t hor, ver;
+
+    if(code == LV_EVENT_DELETE) {
+        disp_scroll_reset();
+        return;
+    }
+    if(code != LV_EVENT_SCROLL) return;
+
+    x = lv_obj_get_scroll_x(obj);
+    y = lv_obj_get_scroll_y(obj);
+    dy = scroll.scroll_y - y;               /*The content moves down when the scroll position decreases*/
+    scroll.pending = false;
+
+    /*Anything else is redrawn as usual*/
+    if(dy == 0 || x != scroll.scroll_x || LV_ABS(dy) >= vsa ||
+       LV_MAX(obj->coords.y1, 0) != scroll.top ||
+       LV_MIN(obj->coords.y2, lv_disp_get_ver_res(lv_obj_get_disp(obj)) - 1) != scroll.bottom) {
+        scroll.scroll_x = x;
+        scroll.scroll_y = y;
+        return;
+    }
+    scroll.scroll_y = y;
+
+    /*The scrollbar stays in place, redraw its column*/
+    lv_obj_get_scrollbar_area(obj, &hor, &ver);
+    if(lv_area_get_size(&ver) > 0) {
+        ver.y1 = scroll.top;
+        ver.y2 = scroll.bottom;
+        lv_obj_invalidate_area(obj, &ver);
+    }
+
+    /*Row r now shows what row r - dy showed, queued flushes still use the old mapping*/
+    scroll.ofs = (scroll.ofs - dy + vsa) % vsa;
+    lcd_scroll_start(scroll.top + scroll.ofs);
+    scroll.dy = dy;
+    scroll.pending = true;
+}
+
+/*LVGL invalidates the whole object after LV_EVENT_SCROLL, keep only the exposed rows of it*/
+static void disp_rounder(lv_disp_drv_t * disp_drv, lv_area_t * area)
+{
+    LV_UNUSED(disp_drv);
+
+    if(!scroll.pending) return;
+    if(area->y1 > scroll.top || area->y2 < scroll.bottom) return;
+    scroll.pending = false;
+
+    if(scroll.dy > 0) {
+        area->y1 = scroll.top;
+        area->y2 = scroll.top + scroll.dy - 1;
+    }
+    else {
+        area->y1 = scroll.bottom + scroll.dy + 1;
+        area->y2 = scroll.bottom;
+    }
+}
+
+/*Panel memory row of display row y. `last` is the last display row stored after it without a wrap*/
+static lv_coord_t disp_scroll_map(lv_coord_t y, lv_coord_t * last)
+{
+    lv_coord_t mem;
+
+    if(scroll.obj == NULL || scroll.ofs == 0 || y > scroll.bottom) {
+        *last = LV_COORD_MAX;
+        return y;
+    }
+    if(y < scroll.top) {
+        *last = scroll.top - 1;
+        return y;
+    }
+    mem = scroll.top + (y - scroll.top + scroll.ofs) % (scroll.bottom - scroll.top + 1);
+    *last = y + scroll.bottom - mem;
+    return mem;
+}
+
+/*Called by lv_disp_set_rotation. The panel maps the windows, so a flush needs no rotation pass*/
+static void disp_update(lv_disp_drv_t * disp_drv)
+{
+    if(disp_drv->sw_rotate) return;
+
+    /*The panel scrolls along its own rows only*/
+    if(disp_drv->rotated != LV_DISP_ROT_NONE) lv_port_disp_scroll_disable();
+
+    /*LV_DISP_ROT_x matches the 0, 90, 180 and 270 degree scan directions of lcd_scan_dir*/
+    lcd_scan_dir(disp_drv->rotated);
+}
+
+/**
+ * Get the draw buffer pipeline statistics.
+ * @param stats     statistics output
+ */
+void lv_port_disp_get_stats(lv_port_disp_stats_t * stats)
+{
+    *stats = disp_stats;
+}
+
+/*The last band of a draw buffer is on the panel, the buffer is free again*/
+static void disp_flush_done(void * user)
+{
+    volatile bool * busy = user;
+
+    disp_stats.flush_cyc = DWT->CYCCNT - disp_buf_submit[busy - disp_buf_busy];
+    *busy = false;
+}
+
+/*Sleep until the next interrupt, a dma completion wakes the cpu*/
+static void disp_wait(lv_disp_drv_t * disp_drv)
+{
+    LV_UNUSED(disp_drv);
+    __WFI();
+}
+
+/*Pick a buffer for the next strip, sleeps while all of them are being sent*/
+static lv_color_t * disp_buf_get(lv_disp_drv_t * disp_drv, uint8_t flushed, bool * waited)
+{
+    uint8_t i;
+
+    *waited = false;
+    while(1) {
+        /*Checked with the interrupts masked: a completion after the check stays pending and ends the sleep*/
+        __disable_irq();
+        for(i = 0; i < DISP_BUF_NUM; i++) {
+            if(i != flushed && !disp_buf_busy[i]) {
+                __enable_irq();
+                return disp_buf[i];
+            }
+        }
+        *waited = true;
+        disp_drv->wait_cb(disp_drv);
+        __enable_irq();
+    }
+}
+
+/*Queue the window `win` of a buffer covering buf_area, split where the panel scrolling wraps*/
+static void disp_submit(const lv_area_t * win, const lv_color_t * buf, const lv_area_t * buf_area,
+                        lcd_dma_done_type done, void * user)
+{
+    uint32_t buf_w = lv_area_get_width(buf_area);
+    const lv_color_t * pixels;
+    lv_coord_t y = win->y1;
+    lv_coord_t mem_y;
+    lv_coord_t last;
+
+    while(y <= win->y2) {
+        mem_y = disp_scroll_map(y, &last);
+        last = LV_MIN(last, win->y2);
+        pixels = buf + (y - buf_area->y1) * buf_w + (win->x1 - buf_area->x1);
+        lcd_dma_submit(win->x1, mem_y, win->x2, mem_y + last - y, (const uint16_t *)pixels, buf_w,
+                       last == win->y2 ? done : NULL, user);
+        y = last + 1;
+    }
+}
+
 /*Flush the content of the internal buffer the specific area on the display
  *You can use DMA or any hardware acceleration to do this operation in the background but
  *'lv_disp_flush_ready()' has to be called when finished.*/
@@ -204,14 +551,80 @@ static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_colo
     lv_disp_flush_ready(disp_drv);
     /*The most simple case (but also the slowest) to put all pixels to the screen one-by-one*/
 #else 
+    lv_area_t vid;
+    lv_area_t band[DISP_BAND_MAX];
+    uint8_t num = 0;
+    uint8_t i;
+
+    lv_disp_draw_buf_t * draw_buf = disp_drv->draw_buf;
+    uint32_t now = DWT->CYCCNT;
+    uint8_t idx = (color_p - disp_buf[0]) / (MY_DISP_HOR_RES * DISP_BUF_ROWS);
+    uint32_t rows = draw_buf->size / MY_DISP_HOR_RES;
+    bool idle = !lcd_dma_busy();
+    bool waited;
+    lv_color_t * next;
+
     lv_disp_drv_p = disp_drv;  
-    LCD_DC_SET;
-    u32 size = (area->x2 - area->x1+1)*(area->y2 - area->y1+1) ;
-    lcd_set_window(area->x1,area->y1,area->x2,area->y2);  
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl    &= ~(uint16_t)1;
-    LCD_SPI_MASTER_Tx_DMA_Channel->maddr  = (uint32_t)color_p;
-    LCD_SPI_MASTER_Tx_DMA_Channel->dtcnt = size*2;
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl    |= (uint16_t)1;   
+    scroll.pending = false;
+    disp_stats.flush_cnt++;
+    disp_stats.render_cyc = now - disp_render_start;
+
+    if(!video_valid || !_lv_area_intersect(&vid, area, &video_area)) {
+        band[num++] = *area;
+    }
+    else {
+        /*Leave the video area alone, send what is above, left, right and below it*/
+        if(vid.y1 > area->y1) {
+            lv_area_set(&band[num++], area->x1, area->y1, area->x2, vid.y1 - 1);
+        }
+        if(vid.x1 > area->x1) {
+            lv_area_set(&band[num++], area->x1, vid.y1, vid.x1 - 1, vid.y2);
+        }
+        if(vid.x2 < area->x2) {
+            lv_area_set(&band[num++], vid.x2 + 1, vid.y1, area->x2, vid.y2);
+        }
+        if(vid.y2 < area->y2) {
+            lv_area_set(&band[num++], area->x1, vid.y2 + 1, area->x2, area->y2);
+        }
+    }
+
+    /*The buffer is free again with the last band*/
+    if(num != 0) {
+        disp_buf_busy[idx] = true;
+        disp_buf_submit[idx] = now;
+    }
+    for(i = 0; i < num; i++) {
+        disp_submit(&band[i], color_p, area, i == num - 1 ? disp_flush_done : NULL, (void *)&disp_buf_busy[idx]);
+    }
+
+    /* LVGL flushes buf_act, swaps buf_act to its other pointer after flush_cb returns and renders the
+     * next strip there, so that pointer is replaced by a free buffer. lv_disp_draw_buf_init can't do it
+     * here, it clears the last area flags of the running refresh. Check the swap still works so.*/
+    LV_ASSERT(color_p == draw_buf->buf_act);
+    LV_ASSERT(disp_buf_next == NULL || color_p == disp_buf_next);
+    next = disp_buf_get(disp_drv, idx, &waited);
+    if(draw_buf->buf_act == draw_buf->buf1) draw_buf->buf2 = next;
+    else draw_buf->buf1 = next;
+    disp_buf_next = next;
+
+    /* Adapt the strip size for the next areas, LVGL renders size / area width rows at once.
+     * It reads the size when it starts an area and every buffer holds DISP_BUF_ROWS rows,
+     * so the strips of the area being refreshed still fit.
+     * Rendering waited for the dma: bigger strips, less per strip overhead.
+     * The dma waited for rendering: smaller strips, the panel gets the first pixels sooner.*/
+    if(waited) {
+        disp_stats.buf_wait_cnt++;
+        rows = LV_MIN(rows + DISP_STRIP_STEP_ROWS, DISP_BUF_ROWS);
+    }
+    else if(idle) {
+        disp_stats.dma_idle_cnt++;
+        rows = LV_MAX(rows - DISP_STRIP_STEP_ROWS, DISP_STRIP_MIN_ROWS);
+    }
+    draw_buf->size = rows * MY_DISP_HOR_RES;
+    disp_stats.strip_rows = rows;
+
+    lv_disp_flush_ready(disp_drv);
+    disp_render_start = DWT->CYCCNT;
 #endif
 
 }
@@ -33,6 +33,15 @@ extern "C" {
 /**********************
  *      TYPEDEFS
  **********************/
+/*Draw buffer pipeline statistics, times in cpu cycles*/
+typedef struct {
+    uint32_t flush_cnt;         /*Strips flushed*/
+    uint32_t buf_wait_cnt;      /*Strips that waited for a free draw buffer*/
+    uint32_t dma_idle_cnt;      /*Strips that found the dma idle*/
+    uint32_t render_cyc;        /*Render time of the last strip*/
+    uint32_t flush_cyc;         /*Transfer time of the last strip, from queueing to the panel*/
+    uint32_t strip_rows;        /*Current strip size in full width rows*/
+} lv_port_disp_stats_t;
 
 /**********************
  * GLOBAL PROTOTYPES
@@ -48,6 +57,30 @@ void disp_enable_update(void);
  */
 void disp_disable_update(void);
 
+/* Reserve a panel area for camera frames written with lv_port_disp_video_flush(), NULL to release
+ */
+void lv_port_disp_video_set_area(const lv_area_t * area);
+
+/* Send camera pixels to the video area without the LVGL renderer
+ */
+void lv_port_disp_video_flush(const lv_area_t * area, const lv_color_t * pixels);
+
+/* Wait until the last lv_port_disp_video_flush() is on the panel
+ */
+void lv_port_disp_video_wait(void);
+
+/* Scroll a full width object with the panel's vertical scrolling, only exposed rows are redrawn
+ */
+bool lv_port_disp_scroll_enable(lv_obj_t * obj);
+
+/* Stop the panel scrolling of lv_port_disp_scroll_enable()
+ */
+void lv_port_disp_scroll_disable(void);
+
+/* Get the draw buffer pipeline statistics
+ */
+void lv_port_disp_get_stats(lv_port_disp_stats_t * stats);
+
 /**********************
  *      MACROS
  **********************/
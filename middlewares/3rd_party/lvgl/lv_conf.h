@@ -27,7 +27,7 @@
 #define LV_COLOR_DEPTH 16
 
 /*Swap the 2 bytes of RGB565 color. Useful if the display has an 8-bit interface (e.g. SPI)*/
-#define LV_COLOR_16_SWAP 1
+#define LV_COLOR_16_SWAP 0
 
 /*Enable features to draw on transparent background.
  *It's required if opa, and transform_* style properties are used.
@@ -180,6 +180,10 @@
 /*Use Arm's 2D acceleration library Arm-2D */
 #define LV_USE_GPU_ARM2D 0
 
+/*Blend RGB565 two pixels at once in the software renderer.
+ *Requires LV_COLOR_DEPTH 16 and LV_COLOR_16_SWAP 0*/
+#define LV_USE_DRAW_SW_BLEND_565 1
+
 /*Use STM32's DMA2D (aka Chrom Art) GPU*/
 #define LV_USE_GPU_STM32_DMA2D 0
 #if LV_USE_GPU_STM32_DMA2D
@@ -194,6 +198,14 @@
     #define LV_GPU_SWM341_DMA2D_INCLUDE "SWM341.h"
 #endif
 
+/*Use the EDMA of AT32F435/437 for large opaque fills and image copies*/
+#define LV_USE_GPU_AT32_EDMA 1
+#if LV_USE_GPU_AT32_EDMA
+    #define LV_GPU_AT32_EDMA_INCLUDE "at32f435_437.h"
+    /*Smaller areas are drawn by the CPU, starting a transfer is not worth it*/
+    #define LV_GPU_AT32_EDMA_MIN_PX 256
+#endif
+
 /*Use NXP's PXP GPU iMX RTxxx platforms*/
 #define LV_USE_GPU_NXP_PXP 0
 #if LV_USE_GPU_NXP_PXP
@@ -639,8 +651,9 @@
 #define LV_USE_BMP 0
 
 /* JPG + split JPG decoder library.
- * Split JPG is a custom format optimized for embedded systems. */
-#define LV_USE_SJPG 0
+ * Split JPG is a custom format optimized for embedded systems.
+ * Also provides tjpgd for the uvc mjpeg decode stage. */
+#define LV_USE_SJPG 1
 
 /*GIF decoder library*/
 #define LV_USE_GIF 0
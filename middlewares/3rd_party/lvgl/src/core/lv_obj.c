@@ -34,6 +34,10 @@
     #include "../draw/swm341_dma2d/lv_gpu_swm341_dma2d.h"
 #endif
 
+#if LV_USE_GPU_AT32_EDMA
+    #include "../draw/at32_edma/lv_gpu_at32_edma.h"
+#endif
+
 #if LV_USE_GPU_NXP_PXP && LV_USE_GPU_NXP_PXP_AUTO_INIT
     #include "../draw/nxp/pxp/lv_gpu_nxp_pxp.h"
 #endif
@@ -124,6 +128,11 @@ void lv_init(void)
     lv_draw_swm341_dma2d_init();
 #endif
 
+#if LV_USE_GPU_AT32_EDMA
+    /*Initialize the EDMA used for fills and image copies*/
+    lv_draw_at32_edma_init();
+#endif
+
 #if LV_USE_GPU_NXP_PXP && LV_USE_GPU_NXP_PXP_AUTO_INIT
     PXP_COND_STOP(!lv_gpu_nxp_pxp_init(), "PXP init failed.");
 #endif
@@ -26,6 +26,10 @@
 /*********************
  *      DEFINES
  *********************/
+/*Opaque objects per draw buffer part which hide the objects drawn before them. 0: disable*/
+#ifndef LV_REFR_OCCLUDER_MAX
+    #define LV_REFR_OCCLUDER_MAX 8
+#endif
 
 /**********************
  *      TYPEDEFS
@@ -48,16 +52,29 @@ typedef struct {
 #endif
 } mem_monitor_t;
 
+typedef struct {
+    lv_obj_t * obj;
+    lv_area_t area;     /*Part of the draw buffer area the object covers*/
+} refr_occluder_t;
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
 static void lv_refr_join_area(void);
+static uint32_t lv_refr_area_cost(lv_disp_drv_t * drv, const lv_area_t * area);
+static bool lv_refr_join_is_cheaper(lv_disp_drv_t * drv, const lv_area_t * a1, const lv_area_t * a2,
+                                    const lv_area_t * joined);
 static void refr_invalid_areas(void);
 static void refr_area(const lv_area_t * area_p);
 static void refr_area_part(lv_draw_ctx_t * draw_ctx);
 static lv_obj_t * lv_refr_get_top_obj(const lv_area_t * area_p, lv_obj_t * obj);
 static void refr_obj_and_children(lv_draw_ctx_t * draw_ctx, lv_obj_t * top_obj);
 static void refr_obj(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj);
+#if LV_REFR_OCCLUDER_MAX
+    static void refr_occluders_collect(lv_obj_t * obj, const lv_area_t * clip_area);
+    static bool refr_occlusion_clip(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj, lv_area_t * clip_area);
+    static bool refr_obj_drawn_before(lv_obj_t * obj, lv_obj_t * other);
+#endif
 static uint32_t get_max_row(lv_disp_t * disp, lv_coord_t area_w, lv_coord_t area_h);
 static void draw_buf_flush(lv_disp_t * disp);
 static void call_flush_cb(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_t * color_p);
@@ -75,6 +92,11 @@ static void call_flush_cb(lv_disp_drv_t * drv, const lv_area_t * area, lv_color_
 static uint32_t px_num;
 static lv_disp_t * disp_refr; /*Display being refreshed*/
 
+#if LV_REFR_OCCLUDER_MAX
+    static refr_occluder_t occluders[LV_REFR_OCCLUDER_MAX];
+    static uint32_t occluder_cnt;
+#endif
+
 #if LV_USE_PERF_MONITOR
     static perf_monitor_t   perf_monitor;
 #endif
@@ -250,12 +272,24 @@ void _lv_inv_area(lv_disp_t * disp, const lv_area_t * area_p)
     /*Save the area*/
     if(disp->inv_p < LV_INV_BUF_SIZE) {
         lv_area_copy(&disp->inv_areas[disp->inv_p], &com_area);
+        disp->inv_p++;
     }
-    else {   /*If no place for the area add the screen*/
-        disp->inv_p = 0;
-        lv_area_copy(&disp->inv_areas[disp->inv_p], &scr_area);
+    else {
+        /*If no place for the area join it into the saved area it grows the least*/
+        lv_area_t joined_area;
+        uint32_t cost;
+        uint32_t min_cost = UINT32_MAX;
+        uint16_t min_i = 0;
+        for(i = 0; i < disp->inv_p; i++) {
+            _lv_area_join(&joined_area, &com_area, &disp->inv_areas[i]);
+            cost = lv_refr_area_cost(disp->driver, &joined_area) - lv_refr_area_cost(disp->driver, &disp->inv_areas[i]);
+            if(cost < min_cost) {
+                min_cost = cost;
+                min_i = i;
+            }
+        }
+        _lv_area_join(&disp->inv_areas[min_i], &com_area, &disp->inv_areas[min_i]);
     }
-    disp->inv_p++;
     if(disp->refr_timer) lv_timer_resume(disp->refr_timer);
 }
 
@@ -459,13 +493,17 @@ uint32_t lv_refr_get_fps_avg(void)
  **********************/
 
 /**
- * Join the areas which has got common parts
+ * Join the areas which are cheaper to refresh together
  */
 static void lv_refr_join_area(void)
 {
     uint32_t join_from;
     uint32_t join_in;
     lv_area_t joined_area;
+    lv_disp_drv_t * drv = disp_refr->driver;
+    lv_disp_merge_cost_t * mc = &drv->merge_cost;
+    /*Separate areas can be worth joining only if every area has a cost of its own*/
+    bool join_apart = drv->merge_cb || mc->flush != 0;
     for(join_in = 0; join_in < disp_refr->inv_p; join_in++) {
         if(disp_refr->inv_area_joined[join_in] != 0) continue;
 
@@ -477,15 +515,16 @@ static void lv_refr_join_area(void)
             }
 
             /*Check if the areas are on each other*/
-            if(_lv_area_is_on(&disp_refr->inv_areas[join_in], &disp_refr->inv_areas[join_from]) == false) {
+            if(!join_apart &&
+               _lv_area_is_on(&disp_refr->inv_areas[join_in], &disp_refr->inv_areas[join_from]) == false) {
                 continue;
             }
 
             _lv_area_join(&joined_area, &disp_refr->inv_areas[join_in], &disp_refr->inv_areas[join_from]);
 
-            /*Join two area only if the joined area size is smaller*/
-            if(lv_area_get_size(&joined_area) < (lv_area_get_size(&disp_refr->inv_areas[join_in]) +
-                                                 lv_area_get_size(&disp_refr->inv_areas[join_from]))) {
+            /*Join two area only if the joined area is cheaper to refresh*/
+            if(lv_refr_join_is_cheaper(drv, &disp_refr->inv_areas[join_in], &disp_refr->inv_areas[join_from],
+                                       &joined_area)) {
                 lv_area_copy(&disp_refr->inv_areas[join_in], &joined_area);
 
                 /*Mark 'join_form' is joined into 'join_in'*/
@@ -495,6 +534,45 @@ static void lv_refr_join_area(void)
     }
 }
 
+/**
+ * Estimate the cost of refreshing an area with the driver's cost model
+ * @param drv pointer to the display driver
+ * @param area the area to refresh
+ * @return the cost, the size of the area if the driver has no cost model
+ */
+static uint32_t lv_refr_area_cost(lv_disp_drv_t * drv, const lv_area_t * area)
+{
+    lv_disp_merge_cost_t * mc = &drv->merge_cost;
+    uint32_t size = lv_area_get_size(area);
+
+    if(mc->render_px == 0 && mc->transfer_byte == 0 && mc->flush == 0) return size;
+
+    /*The area is flushed in parts of as many rows as the draw buffer holds*/
+    lv_coord_t w = lv_area_get_width(area);
+    lv_coord_t h = lv_area_get_height(area);
+    int32_t max_row = drv->draw_buf->size / w;
+    if(max_row < 1) max_row = 1;
+    uint32_t flush_cnt = (h + max_row - 1) / max_row;
+
+    return size * (mc->render_px + mc->transfer_byte * sizeof(lv_color_t)) + flush_cnt * mc->flush;
+}
+
+/**
+ * Decide if two areas should be refreshed together as their bounding area
+ * @param drv pointer to the display driver
+ * @param a1 first area
+ * @param a2 second area
+ * @param joined bounding area of `a1` and `a2`
+ * @return true: refresh `joined` instead of `a1` and `a2`
+ */
+static bool lv_refr_join_is_cheaper(lv_disp_drv_t * drv, const lv_area_t * a1, const lv_area_t * a2,
+                                    const lv_area_t * joined)
+{
+    if(drv->merge_cb) return drv->merge_cb(drv, a1, a2, joined);
+
+    return lv_refr_area_cost(drv, joined) < lv_refr_area_cost(drv, a1) + lv_refr_area_cost(drv, a2);
+}
+
 /**
  * Refresh the joined areas
  */
@@ -648,6 +726,19 @@ static void refr_area_part(lv_draw_ctx_t * draw_ctx)
         top_prev_scr = lv_refr_get_top_obj(draw_ctx->buf_area, disp_refr->prev_scr);
     }
 
+#if LV_REFR_OCCLUDER_MAX
+    /*Find the opaque objects on the active screen, the ones drawn below them can be skipped or clipped.
+     *During screen animations the two screens are mixed so don't bother*/
+    occluder_cnt = 0;
+    if(disp_refr->prev_scr == NULL && disp_refr->act_scr) {
+        uint32_t i;
+        uint32_t child_cnt = lv_obj_get_child_cnt(disp_refr->act_scr);
+        for(i = 0; i < child_cnt; i++) {
+            refr_occluders_collect(disp_refr->act_scr->spec_attr->children[i], draw_ctx->buf_area);
+        }
+    }
+#endif
+
     /*Draw a display background if there is no top object*/
     if(top_act_scr == NULL && top_prev_scr == NULL) {
         lv_area_t a;
@@ -709,6 +800,10 @@ static void refr_area_part(lv_draw_ctx_t * draw_ctx)
     refr_obj_and_children(draw_ctx, lv_disp_get_layer_top(disp_refr));
     refr_obj_and_children(draw_ctx, lv_disp_get_layer_sys(disp_refr));
 
+#if LV_REFR_OCCLUDER_MAX
+    occluder_cnt = 0;
+#endif
+
     draw_buf_flush(disp_refr);
 }
 
@@ -885,6 +980,18 @@ void refr_obj(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj)
     if(lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) return;
     lv_layer_type_t layer_type = _lv_obj_get_layer_type(obj);
     if(layer_type == LV_LAYER_TYPE_NONE) {
+#if LV_REFR_OCCLUDER_MAX
+        if(occluder_cnt) {
+            /*Draw only the part which is not covered by an opaque object drawn later*/
+            const lv_area_t * clip_area_ori = draw_ctx->clip_area;
+            lv_area_t clip_area;
+            if(refr_occlusion_clip(draw_ctx, obj, &clip_area) == false) return;
+            draw_ctx->clip_area = &clip_area;
+            lv_obj_redraw(draw_ctx, obj);
+            draw_ctx->clip_area = clip_area_ori;
+            return;
+        }
+#endif
         lv_obj_redraw(draw_ctx, obj);
     }
     else {
@@ -912,6 +1019,12 @@ void refr_obj(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj)
             LV_LOG_WARN("Couldn't create a new layer context");
             return;
         }
+
+#if LV_REFR_OCCLUDER_MAX
+        /*The layer is blended with opacity or transformed, its content is not hidden as drawn*/
+        uint32_t occluder_cnt_ori = occluder_cnt;
+        occluder_cnt = 0;
+#endif
         lv_point_t pivot = {
             .x = lv_obj_get_style_transform_pivot_x(obj, 0),
             .y = lv_obj_get_style_transform_pivot_y(obj, 0)
@@ -961,9 +1074,161 @@ void refr_obj(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj)
         }
 
         lv_draw_layer_destroy(draw_ctx, layer_ctx);
+#if LV_REFR_OCCLUDER_MAX
+        occluder_cnt = occluder_cnt_ori;
+#endif
     }
 }
 
+#if LV_REFR_OCCLUDER_MAX
+/**
+ * Collect the objects which fully cover a part of the draw buffer. Keep the largest ones.
+ * @param obj the object to check together with its children
+ * @param clip_area the area where the object is visible
+ */
+static void refr_occluders_collect(lv_obj_t * obj, const lv_area_t * clip_area)
+{
+    if(lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) return;
+    /*Opacity and transformations apply to the children too*/
+    if(_lv_obj_get_layer_type(obj) != LV_LAYER_TYPE_NONE) return;
+
+    lv_area_t vis_area;
+    bool vis = _lv_area_intersect(&vis_area, clip_area, &obj->coords);
+    bool overflow = lv_obj_has_flag(obj, LV_OBJ_FLAG_OVERFLOW_VISIBLE);
+    if(!vis && !overflow) return;
+
+    if(vis) {
+        lv_cover_check_info_t info;
+        info.res = LV_COVER_RES_COVER;
+        info.area = &vis_area;
+        lv_event_send(obj, LV_EVENT_COVER_CHECK, &info);
+        /*The children are masked, e.g. with rounded corners*/
+        if(info.res == LV_COVER_RES_MASKED) return;
+
+        if(info.res == LV_COVER_RES_COVER) {
+            uint32_t size = lv_area_get_size(&vis_area);
+            uint32_t i = occluder_cnt;
+            if(occluder_cnt == LV_REFR_OCCLUDER_MAX) {
+                /*Replace the smallest if this one is larger*/
+                uint32_t j;
+                for(j = 0; j < occluder_cnt; j++) {
+                    if(lv_area_get_size(&occluders[j].area) < size &&
+                       (i == occluder_cnt || lv_area_get_size(&occluders[j].area) < lv_area_get_size(&occluders[i].area))) {
+                        i = j;
+                    }
+                }
+            }
+            else {
+                occluder_cnt++;
+            }
+
+            if(i < occluder_cnt) {
+                occluders[i].obj = obj;
+                occluders[i].area = vis_area;
+            }
+        }
+    }
+
+    const lv_area_t * clip_area_children = overflow ? clip_area : &vis_area;
+    uint32_t i;
+    uint32_t child_cnt = lv_obj_get_child_cnt(obj);
+    for(i = 0; i < child_cnt; i++) {
+        refr_occluders_collect(obj->spec_attr->children[i], clip_area_children);
+    }
+}
+
+/**
+ * Clip the area where an object and its children draw to the part not covered by the occluders.
+ * Only rectangular remainders are cut, other overlaps are drawn.
+ * @param draw_ctx pointer to the draw context
+ * @param obj the object to draw
+ * @param clip_area store the remaining area here
+ * @return false: the object is fully covered, don't draw it
+ */
+static bool refr_occlusion_clip(lv_draw_ctx_t * draw_ctx, lv_obj_t * obj, lv_area_t * clip_area)
+{
+    lv_area_t obj_coords_ext;
+
+    *clip_area = *draw_ctx->clip_area;
+    if(!lv_obj_has_flag(obj, LV_OBJ_FLAG_OVERFLOW_VISIBLE)) {
+        /*The children are clipped to the object so only its extended area matters*/
+        lv_coord_t ext_draw_size = _lv_obj_get_ext_draw_size(obj);
+        lv_obj_get_coords(obj, &obj_coords_ext);
+        lv_area_increase(&obj_coords_ext, ext_draw_size, ext_draw_size);
+        if(!_lv_area_intersect(clip_area, clip_area, &obj_coords_ext)) {
+            *clip_area = *draw_ctx->clip_area;
+            return true;
+        }
+    }
+
+    /*Cutting an area can make an other occluder cover a full side, so try until nothing changes*/
+    bool cut = true;
+    uint32_t i;
+    while(cut) {
+        cut = false;
+        for(i = 0; i < occluder_cnt; i++) {
+            const lv_area_t * o = &occluders[i].area;
+            if(!_lv_area_is_on(clip_area, o)) continue;
+
+            bool full_w = o->x1 <= clip_area->x1 && o->x2 >= clip_area->x2;
+            bool full_h = o->y1 <= clip_area->y1 && o->y2 >= clip_area->y2;
+            if(!full_w && !full_h) continue;
+            if(!refr_obj_drawn_before(obj, occluders[i].obj)) continue;
+
+            if(full_w && full_h) return false;
+            if(full_w) {
+                if(o->y1 <= clip_area->y1) clip_area->y1 = o->y2 + 1;
+                else if(o->y2 >= clip_area->y2) clip_area->y2 = o->y1 - 1;
+                else continue;
+            }
+            else {
+                if(o->x1 <= clip_area->x1) clip_area->x1 = o->x2 + 1;
+                else if(o->x2 >= clip_area->x2) clip_area->x2 = o->x1 - 1;
+                else continue;
+            }
+            cut = true;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Tell if an object is drawn completely before an other object
+ * @param obj pointer to an object
+ * @param other pointer to an other object
+ * @return true: `obj` and its children are drawn before `other`, false: after, or `obj` is an ancestor of `other`
+ */
+static bool refr_obj_drawn_before(lv_obj_t * obj, lv_obj_t * other)
+{
+    uint32_t depth = 0;
+    uint32_t other_depth = 0;
+    lv_obj_t * p;
+
+    for(p = lv_obj_get_parent(obj); p; p = lv_obj_get_parent(p)) depth++;
+    for(p = lv_obj_get_parent(other); p; p = lv_obj_get_parent(p)) other_depth++;
+
+    /*Go up to the same level, then to the children of the common parent*/
+    while(depth > other_depth) {
+        obj = lv_obj_get_parent(obj);
+        depth--;
+    }
+    while(other_depth > depth) {
+        other = lv_obj_get_parent(other);
+        other_depth--;
+    }
+    if(obj == other) return false;
+
+    while(lv_obj_get_parent(obj) != lv_obj_get_parent(other)) {
+        obj = lv_obj_get_parent(obj);
+        other = lv_obj_get_parent(other);
+    }
+    if(lv_obj_get_parent(obj) == NULL) return false;    /*Different screens*/
+
+    return lv_obj_get_index(obj) < lv_obj_get_index(other);
+}
+#endif
+
 
 static uint32_t get_max_row(lv_disp_t * disp, lv_coord_t area_w, lv_coord_t area_h)
 {
@@ -0,0 +1,6 @@
+CSRCS += lv_gpu_at32_edma.c
+
+DEPPATH += --dep-path $(LVGL_DIR)/$(LVGL_DIR_NAME)/src/draw/at32_edma
+VPATH += :$(LVGL_DIR)/$(LVGL_DIR_NAME)/src/draw/at32_edma
+
+CFLAGS += "-I$(LVGL_DIR)/$(LVGL_DIR_NAME)/src/draw/at32_edma"
@@ -0,0 +1,215 @@
+/**
+ * @file lv_gpu_at32_edma.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_gpu_at32_edma.h"
+#include "../../core/lv_refr.h"
+
+#if LV_USE_GPU_AT32_EDMA
+
+#include LV_GPU_AT32_EDMA_INCLUDE
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#if LV_COLOR_DEPTH != 16
+    #error "Can't use the EDMA with LV_COLOR_DEPTH other than 16"
+#endif
+
+#define LV_EDMA_STREAM      EDMA_STREAM1
+#define LV_EDMA_STREAM_2D   EDMA_STREAM1_2D
+#define LV_EDMA_FLAGS       (EDMA_FERR1_FLAG | EDMA_DMERR1_FLAG | EDMA_DTERR1_FLAG | EDMA_HDT1_FLAG | EDMA_FDT1_FLAG)
+
+/*The data counter of a stream is 16 bit*/
+#define LV_EDMA_MAX_PX      0xFFFF
+
+/*Images are copied by the EDMA only from the internal flash. Images in RAM are mostly
+ *temporary buffers (e.g. converted or decoded images) which are rewritten or freed
+ *right after the blend while the transfer could still be reading them.*/
+#define LV_EDMA_SRC_IS_CONST(p) ((uint32_t)(p) >= FLASH_BASE && (uint32_t)(p) < SRAM_BASE)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+
+static void lv_draw_at32_edma_blend_fill(lv_color_t * dest_buf, lv_coord_t dest_stride, const lv_area_t * fill_area,
+                                         lv_color_t color);
+
+static void lv_draw_at32_edma_blend_map(lv_color_t * dest_buf, const lv_area_t * dest_area, lv_coord_t dest_stride,
+                                        const lv_color_t * src_buf, lv_coord_t src_stride);
+
+static void lv_draw_at32_edma_start(const void * src_buf, bool src_inc, lv_coord_t src_gap,
+                                    lv_color_t * dest_buf, lv_coord_t dest_gap, lv_coord_t w, lv_coord_t h);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/*Source of the fill transfers, it has to stay unchanged until the transfer finishes*/
+static lv_color_t fill_color;
+
+/**********************
+ *      MACROS
+ **********************/
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+/**
+ * Turn on the EDMA clock, this only needs to be done once
+ */
+void lv_draw_at32_edma_init(void)
+{
+    crm_periph_clock_enable(CRM_EDMA_PERIPH_CLOCK, TRUE);
+
+    edma_stream_enable(LV_EDMA_STREAM, FALSE);
+    edma_flag_clear(LV_EDMA_FLAGS);
+}
+
+void lv_draw_at32_edma_ctx_init(lv_disp_drv_t * drv, lv_draw_ctx_t * draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+
+    lv_draw_at32_edma_ctx_t * edma_draw_ctx = (lv_draw_sw_ctx_t *)draw_ctx;
+
+    edma_draw_ctx->blend = lv_draw_at32_edma_blend;
+    edma_draw_ctx->base_draw.wait_for_finish = lv_gpu_at32_edma_wait_cb;
+}
+
+void lv_draw_at32_edma_ctx_deinit(lv_disp_drv_t * drv, lv_draw_ctx_t * draw_ctx)
+{
+    LV_UNUSED(drv);
+    LV_UNUSED(draw_ctx);
+}
+
+void lv_draw_at32_edma_blend(lv_draw_ctx_t * draw_ctx, const lv_draw_sw_blend_dsc_t * dsc)
+{
+    lv_area_t blend_area;
+    if(!_lv_area_intersect(&blend_area, dsc->blend_area, draw_ctx->clip_area))
+        return;
+
+    bool done = false;
+    uint32_t px_cnt = lv_area_get_size(&blend_area);
+
+    if(dsc->mask_buf == NULL && dsc->blend_mode == LV_BLEND_MODE_NORMAL && dsc->opa >= LV_OPA_MAX &&
+       px_cnt >= LV_GPU_AT32_EDMA_MIN_PX && px_cnt <= LV_EDMA_MAX_PX) {
+        lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+
+        lv_color_t * dest_buf = draw_ctx->buf;
+        dest_buf += dest_stride * (blend_area.y1 - draw_ctx->buf_area->y1) + (blend_area.x1 - draw_ctx->buf_area->x1);
+
+        const lv_color_t * src_buf = dsc->src_buf;
+        if(src_buf == NULL) {
+            lv_area_move(&blend_area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+            lv_draw_at32_edma_blend_fill(dest_buf, dest_stride, &blend_area, dsc->color);
+            done = true;
+        }
+        else if(LV_EDMA_SRC_IS_CONST(src_buf)) {
+            lv_coord_t src_stride;
+            src_stride = lv_area_get_width(dsc->blend_area);
+            src_buf += src_stride * (blend_area.y1 - dsc->blend_area->y1) + (blend_area.x1 - dsc->blend_area->x1);
+            lv_area_move(&blend_area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+            lv_draw_at32_edma_blend_map(dest_buf, &blend_area, dest_stride, src_buf, src_stride);
+            done = true;
+        }
+    }
+
+    if(!done) lv_draw_sw_blend_basic(draw_ctx, dsc);
+}
+
+void lv_gpu_at32_edma_wait_cb(lv_draw_ctx_t * draw_ctx)
+{
+    lv_disp_t * disp = _lv_refr_get_disp_refreshing();
+    if(disp && disp->driver && disp->driver->wait_cb) {
+        while(edma_stream_status_get(LV_EDMA_STREAM) == SET) {
+            disp->driver->wait_cb(disp->driver);
+        }
+    }
+    else {
+        while(edma_stream_status_get(LV_EDMA_STREAM) == SET);
+    }
+    lv_draw_sw_wait_for_finish(draw_ctx);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void lv_draw_at32_edma_blend_fill(lv_color_t * dest_buf, lv_coord_t dest_stride, const lv_area_t * fill_area,
+                                         lv_color_t color)
+{
+    lv_coord_t area_w = lv_area_get_width(fill_area);
+    lv_coord_t area_h = lv_area_get_height(fill_area);
+
+    fill_color = color;
+    lv_draw_at32_edma_start(&fill_color, false, 0, dest_buf, dest_stride - area_w, area_w, area_h);
+}
+
+static void lv_draw_at32_edma_blend_map(lv_color_t * dest_buf, const lv_area_t * dest_area, lv_coord_t dest_stride,
+                                        const lv_color_t * src_buf, lv_coord_t src_stride)
+{
+    lv_coord_t dest_w = lv_area_get_width(dest_area);
+    lv_coord_t dest_h = lv_area_get_height(dest_area);
+
+    lv_draw_at32_edma_start(src_buf, true, src_stride - dest_w, dest_buf, dest_stride - dest_w, dest_w, dest_h);
+}
+
+/**
+ * Start a memory to memory transfer of `w` x `h` pixels and return without waiting for it.
+ * The source is the peripheral side of the stream, the draw buffer is the memory side.
+ * @param src_buf       first source pixel
+ * @param src_inc       true: step the source after each pixel; false: repeat the same pixel
+ * @param src_gap       pixels to skip in the source at the end of each line
+ * @param dest_buf      first destination pixel
+ * @param dest_gap      pixels to skip in the destination at the end of each line
+ * @param w             width of the area in pixels
+ * @param h             height of the area in pixels
+ */
+static void lv_draw_at32_edma_start(const void * src_buf, bool src_inc, lv_coord_t src_gap,
+                                    lv_color_t * dest_buf, lv_coord_t dest_gap, lv_coord_t w, lv_coord_t h)
+{
+    edma_init_type edma_init_struct;
+
+    /*Every blend waits for the previous transfer, so the stream is idle here*/
+    edma_stream_enable(LV_EDMA_STREAM, FALSE);
+    edma_flag_clear(LV_EDMA_FLAGS);
+
+    edma_default_para_init(&edma_init_struct);
+    edma_init_struct.direction = EDMA_DIR_MEMORY_TO_MEMORY;
+    edma_init_struct.peripheral_base_addr = (uint32_t)src_buf;
+    edma_init_struct.peripheral_inc_enable = src_inc ? TRUE : FALSE;
+    edma_init_struct.peripheral_data_width = EDMA_PERIPHERAL_DATA_WIDTH_HALFWORD;
+    edma_init_struct.memory0_base_addr = (uint32_t)dest_buf;
+    edma_init_struct.memory_inc_enable = TRUE;
+    edma_init_struct.memory_data_width = EDMA_MEMORY_DATA_WIDTH_HALFWORD;
+    edma_init_struct.buffer_size = (uint16_t)(w * h);
+    edma_init_struct.priority = EDMA_PRIORITY_LOW;
+    /*Memory to memory transfers have to go through the FIFO*/
+    edma_init_struct.fifo_mode_enable = TRUE;
+    edma_init_struct.fifo_threshold = EDMA_FIFO_THRESHOLD_FULL;
+    edma_init(LV_EDMA_STREAM, &edma_init_struct);
+
+    /*A line of `w` pixels, then the addresses jump over the gap (in bytes) to the next line*/
+    if(src_gap != 0 || dest_gap != 0) {
+        lv_coord_t src_stride = src_inc ? src_gap * (lv_coord_t)sizeof(lv_color_t) : 0;
+        edma_2d_init(LV_EDMA_STREAM_2D, src_stride, dest_gap * (lv_coord_t)sizeof(lv_color_t), w, h);
+        edma_2d_enable(LV_EDMA_STREAM_2D, TRUE);
+    }
+    else {
+        edma_2d_enable(LV_EDMA_STREAM_2D, FALSE);
+    }
+
+    edma_stream_enable(LV_EDMA_STREAM, TRUE);
+}
+
+#endif
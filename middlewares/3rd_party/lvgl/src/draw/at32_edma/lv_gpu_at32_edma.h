@@ -0,0 +1,70 @@
+/**
+ * @file lv_gpu_at32_edma.h
+ *
+ */
+
+#ifndef LV_GPU_AT32_EDMA_H
+#define LV_GPU_AT32_EDMA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../misc/lv_color.h"
+#include "../../hal/lv_hal_disp.h"
+#include "../sw/lv_draw_sw.h"
+
+#if LV_USE_GPU_AT32_EDMA
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef lv_draw_sw_ctx_t lv_draw_at32_edma_ctx_t;
+
+struct _lv_disp_drv_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Turn on the EDMA clock, this only needs to be done once
+ */
+void lv_draw_at32_edma_init(void);
+
+void lv_draw_at32_edma_ctx_init(struct _lv_disp_drv_t * drv, lv_draw_ctx_t * draw_ctx);
+
+void lv_draw_at32_edma_ctx_deinit(struct _lv_disp_drv_t * drv, lv_draw_ctx_t * draw_ctx);
+
+/**
+ * Blend an area. Opaque fills and opaque copies of images from the internal flash
+ * are started on the EDMA and not waited for, everything else is drawn by the CPU.
+ * @param draw_ctx      pointer to a draw context
+ * @param dsc           the blend descriptor
+ */
+void lv_draw_at32_edma_blend(lv_draw_ctx_t * draw_ctx, const lv_draw_sw_blend_dsc_t * dsc);
+
+/**
+ * Wait until the last EDMA transfer has finished
+ * @param draw_ctx      pointer to a draw context
+ */
+void lv_gpu_at32_edma_wait_cb(lv_draw_ctx_t * draw_ctx);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif  /*LV_USE_GPU_AT32_EDMA*/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*LV_GPU_AT32_EDMA_H*/
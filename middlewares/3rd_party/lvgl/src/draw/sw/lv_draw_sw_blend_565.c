@@ -0,0 +1,415 @@
+/**
+ * @file lv_draw_sw_blend_565.c
+ *
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lv_draw_sw_blend_565.h"
+#include "../../misc/lv_mem.h"
+
+#if LV_USE_DRAW_SW_BLEND_565
+
+#if defined(__ARM_FEATURE_DSP) || defined(__TARGET_FEATURE_DSPMUL)
+    #include "cmsis_compiler.h"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+/*A pixel spread to 0b00000GGGGGG00000RRRRR000000BBBBB, every channel has room to be multiplied by 32*/
+#define SPREAD_MASK     0x07E0F81FU
+
+/*A channel of two pixels, one pixel per halfword*/
+#define LANE_MASK_5     0x001F001FU
+#define LANE_MASK_6     0x003F003FU
+#define LANE_MASK_8     0x00FF00FFU
+#define LANE_ONE        0x00010001U
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+/*Premultiplied fill color, each channel in both halfwords*/
+typedef struct {
+    uint32_t r;
+    uint32_t g;
+    uint32_t b;
+    uint32_t inv;
+} premult_2px_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void fill_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride, lv_color_t color, lv_opa_t opa);
+static void fill_mask(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride, lv_color_t color,
+                      const lv_opa_t * mask, lv_coord_t mask_stride);
+static void fill_mask_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride, lv_color_t color,
+                          lv_opa_t opa, const lv_opa_t * mask, lv_coord_t mask_stride);
+static void map_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                    const uint16_t * src, lv_coord_t src_stride, lv_opa_t opa);
+static void map_mask(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                     const uint16_t * src, lv_coord_t src_stride, const lv_opa_t * mask, lv_coord_t mask_stride);
+static void map_mask_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                         const uint16_t * src, lv_coord_t src_stride, lv_opa_t opa,
+                         const lv_opa_t * mask, lv_coord_t mask_stride);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+
+/**********************
+ *      MACROS
+ **********************/
+#if defined(__PKHBT) && defined(__PKHTB)
+    #define PAIR(lo, hi)    __PKHBT(lo, hi, 16)     /*The low halfwords of `lo` and `hi`*/
+    #define DUP_LO(w)       __PKHBT(w, w, 16)       /*The first pixel of `w` in both halfwords*/
+    #define DUP_HI(w)       __PKHTB(w, w, 16)       /*The second pixel of `w` in both halfwords*/
+#else
+    #define PAIR(lo, hi)    (((uint32_t)(lo) & 0xFFFFU) | ((uint32_t)(hi) << 16))
+    #define DUP_LO(w)       (((uint32_t)(w) & 0xFFFFU) | ((uint32_t)(w) << 16))
+    #define DUP_HI(w)       (((uint32_t)(w) & 0xFFFF0000U) | ((uint32_t)(w) >> 16))
+#endif
+
+/*The mix ratio of `lv_color_mix` with 16 bit color depth, 0..32*/
+#define MIX_5(opa)          (((uint32_t)(opa) + 4) >> 3)
+
+/*True if the pixel is on a 4 byte boundary, two pixels can be read and written at once from there*/
+#define IS_ALIGNED_2PX(p)   (((lv_uintptr_t)(p) & 0x3) == 0)
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+LV_ATTRIBUTE_FAST_MEM void lv_draw_sw_blend_565_fill(lv_color_t * dest_buf, const lv_area_t * dest_area,
+                                                     lv_coord_t dest_stride, lv_color_t color, lv_opa_t opa,
+                                                     const lv_opa_t * mask, lv_coord_t mask_stride)
+{
+    int32_t w = lv_area_get_width(dest_area);
+    int32_t h = lv_area_get_height(dest_area);
+    uint16_t * dest = (uint16_t *)dest_buf;
+
+    if(mask == NULL) {
+        if(opa >= LV_OPA_MAX) {
+            int32_t y;
+            for(y = 0; y < h; y++) {
+                lv_color_fill(dest_buf, color, w);
+                dest_buf += dest_stride;
+            }
+        }
+        else {
+            fill_opa(dest, w, h, dest_stride, color, opa);
+        }
+    }
+    else if(opa >= LV_OPA_MAX) {
+        fill_mask(dest, w, h, dest_stride, color, mask, mask_stride);
+    }
+    else {
+        fill_mask_opa(dest, w, h, dest_stride, color, opa, mask, mask_stride);
+    }
+}
+
+LV_ATTRIBUTE_FAST_MEM void lv_draw_sw_blend_565_map(lv_color_t * dest_buf, const lv_area_t * dest_area,
+                                                    lv_coord_t dest_stride, const lv_color_t * src_buf,
+                                                    lv_coord_t src_stride, lv_opa_t opa,
+                                                    const lv_opa_t * mask, lv_coord_t mask_stride)
+{
+    int32_t w = lv_area_get_width(dest_area);
+    int32_t h = lv_area_get_height(dest_area);
+    uint16_t * dest = (uint16_t *)dest_buf;
+    const uint16_t * src = (const uint16_t *)src_buf;
+
+    if(mask == NULL) {
+        if(opa >= LV_OPA_MAX) {
+            int32_t y;
+            for(y = 0; y < h; y++) {
+                lv_memcpy(dest_buf, src_buf, w * sizeof(lv_color_t));
+                dest_buf += dest_stride;
+                src_buf += src_stride;
+            }
+        }
+        else {
+            map_opa(dest, w, h, dest_stride, src, src_stride, opa);
+        }
+    }
+    else if(opa > LV_OPA_MAX) {
+        map_mask(dest, w, h, dest_stride, src, src_stride, mask, mask_stride);
+    }
+    else {
+        map_mask_opa(dest, w, h, dest_stride, src, src_stride, opa, mask, mask_stride);
+    }
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Mix two pixels like `lv_color_mix`, each with its own ratio.
+ * The channels of a pixel are spread in a word and multiplied at once.
+ * @param fg2       two foreground pixels
+ * @param bg2       two background pixels
+ * @param mix_lo    ratio of the first pixel, 0..32
+ * @param mix_hi    ratio of the second pixel, 0..32
+ * @return          the two mixed pixels
+ */
+static inline uint32_t mix_2px(uint32_t fg2, uint32_t bg2, uint32_t mix_lo, uint32_t mix_hi)
+{
+    uint32_t fg = DUP_LO(fg2) & SPREAD_MASK;
+    uint32_t bg = DUP_LO(bg2) & SPREAD_MASK;
+    uint32_t lo = ((((fg - bg) * mix_lo) >> 5) + bg) & SPREAD_MASK;
+
+    fg = DUP_HI(fg2) & SPREAD_MASK;
+    bg = DUP_HI(bg2) & SPREAD_MASK;
+    uint32_t hi = ((((fg - bg) * mix_hi) >> 5) + bg) & SPREAD_MASK;
+
+    return PAIR(lo | (lo >> 16), hi | (hi >> 16));
+}
+
+/**
+ * Mix two pixels like `lv_color_mix` with the same ratio.
+ * A channel of both pixels is multiplied at once.
+ * @param fg2       two foreground pixels
+ * @param bg2       two background pixels
+ * @param mix       ratio of both pixels, 0..32
+ * @return          the two mixed pixels
+ */
+static inline uint32_t mix_2px_same(uint32_t fg2, uint32_t bg2, uint32_t mix)
+{
+    uint32_t inv = 32 - mix;
+    uint32_t r = ((((fg2 >> 11) & LANE_MASK_5) * mix + ((bg2 >> 11) & LANE_MASK_5) * inv) >> 5) & LANE_MASK_5;
+    uint32_t g = ((((fg2 >> 5) & LANE_MASK_6) * mix + ((bg2 >> 5) & LANE_MASK_6) * inv) >> 5) & LANE_MASK_6;
+    uint32_t b = (((fg2 & LANE_MASK_5) * mix + (bg2 & LANE_MASK_5) * inv) >> 5) & LANE_MASK_5;
+
+    return (r << 11) | (g << 5) | b;
+}
+
+/*`LV_UDIV255` of both halfwords, exact below 0xFFFF*/
+static inline uint32_t udiv255_2px(uint32_t x)
+{
+    x += ((x >> 8) & LANE_MASK_8) + LANE_ONE;
+    return (x >> 8) & LANE_MASK_8;
+}
+
+/**
+ * Mix the premultiplied fill color on two pixels like `lv_color_mix_premult`
+ * @param p         the premultiplied fill color
+ * @param bg2       two background pixels
+ * @return          the two mixed pixels
+ */
+static inline uint32_t premult_2px(const premult_2px_t * p, uint32_t bg2)
+{
+    uint32_t r = udiv255_2px(p->r + ((bg2 >> 11) & LANE_MASK_5) * p->inv);
+    uint32_t g = udiv255_2px(p->g + ((bg2 >> 5) & LANE_MASK_6) * p->inv);
+    uint32_t b = udiv255_2px(p->b + (bg2 & LANE_MASK_5) * p->inv);
+
+    return (r << 11) | (g << 5) | b;
+}
+
+LV_ATTRIBUTE_FAST_MEM static void fill_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                           lv_color_t color, lv_opa_t opa)
+{
+    /*The generic blender mixes the black pixels with `lv_color_mix` until it meets an other color*/
+    uint16_t black_res = lv_color_mix(color, lv_color_black(), opa).full;
+    bool lead = true;
+
+    /*Same rounding as the generic blender*/
+    opa = (uint32_t)((uint32_t)opa + 4) >> 3;
+    opa = opa << 3;
+
+    premult_2px_t p;
+    p.r = LV_COLOR_GET_R(color) * opa * LANE_ONE;
+    p.g = LV_COLOR_GET_G(color) * opa * LANE_ONE;
+    p.b = LV_COLOR_GET_B(color) * opa * LANE_ONE;
+    p.inv = 255 - opa;
+
+    /*Buffer the result to avoid recalculating the same colors*/
+    uint32_t last_bg = 0;
+    uint32_t last_res = premult_2px(&p, last_bg);
+
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        for(; lead && x < w; x++) {
+            if(dest[x] != 0) {
+                lead = false;
+                break;
+            }
+            dest[x] = black_res;
+        }
+
+        if(x < w && !IS_ALIGNED_2PX(&dest[x])) {
+            dest[x] = premult_2px(&p, dest[x]);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t * d32 = (uint32_t *)&dest[x];
+            if(*d32 != last_bg) {
+                last_bg = *d32;
+                last_res = premult_2px(&p, last_bg);
+            }
+            *d32 = last_res;
+        }
+
+        if(x < w) dest[x] = premult_2px(&p, dest[x]);
+
+        dest += dest_stride;
+    }
+}
+
+LV_ATTRIBUTE_FAST_MEM static void fill_mask(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                            lv_color_t color, const lv_opa_t * mask, lv_coord_t mask_stride)
+{
+    uint32_t c32 = PAIR(color.full, color.full);
+
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        if(w > 0 && !IS_ALIGNED_2PX(dest)) {
+            dest[0] = mix_2px(c32, dest[0], MIX_5(mask[0]), 0);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t m_lo = mask[x];
+            uint32_t m_hi = mask[x + 1];
+            uint32_t * d32 = (uint32_t *)&dest[x];
+            if((m_lo & m_hi) == LV_OPA_COVER) *d32 = c32;
+            else if(m_lo | m_hi) *d32 = mix_2px(c32, *d32, MIX_5(m_lo), MIX_5(m_hi));
+        }
+
+        if(x < w) dest[x] = mix_2px(c32, dest[x], MIX_5(mask[x]), 0);
+
+        dest += dest_stride;
+        mask += mask_stride;
+    }
+}
+
+LV_ATTRIBUTE_FAST_MEM static void fill_mask_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                                lv_color_t color, lv_opa_t opa, const lv_opa_t * mask,
+                                                lv_coord_t mask_stride)
+{
+    uint32_t c32 = PAIR(color.full, color.full);
+
+    /*The mix ratio of every mask value*/
+#define FILL_MASK_OPA_MIX(m) MIX_5((m) == LV_OPA_COVER ? opa : ((uint32_t)(m) * opa) >> 8)
+
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        if(w > 0 && !IS_ALIGNED_2PX(dest)) {
+            dest[0] = mix_2px(c32, dest[0], FILL_MASK_OPA_MIX(mask[0]), 0);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t m_lo = mask[x];
+            uint32_t m_hi = mask[x + 1];
+            if(m_lo | m_hi) {
+                uint32_t * d32 = (uint32_t *)&dest[x];
+                *d32 = mix_2px(c32, *d32, FILL_MASK_OPA_MIX(m_lo), FILL_MASK_OPA_MIX(m_hi));
+            }
+        }
+
+        if(x < w) dest[x] = mix_2px(c32, dest[x], FILL_MASK_OPA_MIX(mask[x]), 0);
+
+        dest += dest_stride;
+        mask += mask_stride;
+    }
+#undef FILL_MASK_OPA_MIX
+}
+
+LV_ATTRIBUTE_FAST_MEM static void map_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                          const uint16_t * src, lv_coord_t src_stride, lv_opa_t opa)
+{
+    uint32_t mix = MIX_5(opa);
+
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        if(w > 0 && !IS_ALIGNED_2PX(dest)) {
+            dest[0] = mix_2px_same(src[0], dest[0], mix);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t * d32 = (uint32_t *)&dest[x];
+            *d32 = mix_2px_same(PAIR(src[x], src[x + 1]), *d32, mix);
+        }
+
+        if(x < w) dest[x] = mix_2px_same(src[x], dest[x], mix);
+
+        dest += dest_stride;
+        src += src_stride;
+    }
+}
+
+LV_ATTRIBUTE_FAST_MEM static void map_mask(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                           const uint16_t * src, lv_coord_t src_stride,
+                                           const lv_opa_t * mask, lv_coord_t mask_stride)
+{
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        if(w > 0 && !IS_ALIGNED_2PX(dest)) {
+            dest[0] = mix_2px(src[0], dest[0], MIX_5(mask[0]), 0);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t m_lo = mask[x];
+            uint32_t m_hi = mask[x + 1];
+            uint32_t * d32 = (uint32_t *)&dest[x];
+            if((m_lo & m_hi) == LV_OPA_COVER) *d32 = PAIR(src[x], src[x + 1]);
+            else if(m_lo | m_hi) *d32 = mix_2px(PAIR(src[x], src[x + 1]), *d32, MIX_5(m_lo), MIX_5(m_hi));
+        }
+
+        if(x < w) dest[x] = mix_2px(src[x], dest[x], MIX_5(mask[x]), 0);
+
+        dest += dest_stride;
+        src += src_stride;
+        mask += mask_stride;
+    }
+}
+
+LV_ATTRIBUTE_FAST_MEM static void map_mask_opa(uint16_t * dest, int32_t w, int32_t h, lv_coord_t dest_stride,
+                                               const uint16_t * src, lv_coord_t src_stride, lv_opa_t opa,
+                                               const lv_opa_t * mask, lv_coord_t mask_stride)
+{
+    /*The mix ratio of every mask value*/
+#define MAP_MASK_OPA_MIX(m) MIX_5((m) >= LV_OPA_MAX ? opa : ((uint32_t)(m) * opa) >> 8)
+
+    int32_t x;
+    int32_t y;
+    for(y = 0; y < h; y++) {
+        x = 0;
+        if(w > 0 && !IS_ALIGNED_2PX(dest)) {
+            dest[0] = mix_2px(src[0], dest[0], MAP_MASK_OPA_MIX(mask[0]), 0);
+            x++;
+        }
+
+        for(; x < w - 1; x += 2) {
+            uint32_t m_lo = mask[x];
+            uint32_t m_hi = mask[x + 1];
+            if(m_lo | m_hi) {
+                uint32_t * d32 = (uint32_t *)&dest[x];
+                *d32 = mix_2px(PAIR(src[x], src[x + 1]), *d32, MAP_MASK_OPA_MIX(m_lo), MAP_MASK_OPA_MIX(m_hi));
+            }
+        }
+
+        if(x < w) dest[x] = mix_2px(src[x], dest[x], MAP_MASK_OPA_MIX(mask[x]), 0);
+
+        dest += dest_stride;
+        src += src_stride;
+        mask += mask_stride;
+    }
+#undef MAP_MASK_OPA_MIX
+}
+
+#endif /*LV_USE_DRAW_SW_BLEND_565*/
@@ -0,0 +1,79 @@
+/**
+ * @file lv_draw_sw_blend_565.h
+ *
+ */
+
+#ifndef LV_DRAW_SW_BLEND_565_H
+#define LV_DRAW_SW_BLEND_565_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "../../misc/lv_color.h"
+#include "../../misc/lv_area.h"
+
+#if LV_USE_DRAW_SW_BLEND_565
+
+#if LV_COLOR_DEPTH != 16 || LV_COLOR_16_SWAP != 0 || LV_COLOR_MIX_ROUND_OFS != 0
+#error "LV_USE_DRAW_SW_BLEND_565 requires LV_COLOR_DEPTH 16, LV_COLOR_16_SWAP 0 and LV_COLOR_MIX_ROUND_OFS 0"
+#endif
+
+/*********************
+ *      DEFINES
+ *********************/
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Fill an area with a color in normal blend mode, two pixels at once.
+ * Gives the same result as the generic software blender.
+ * @param dest_buf      pointer to the first pixel of the area in the draw buffer
+ * @param dest_area     the area to fill, only its size is used
+ * @param dest_stride   width of the draw buffer in pixels
+ * @param color         fill color
+ * @param opa           overall opacity
+ * @param mask          mask of the area or NULL
+ * @param mask_stride   width of the mask in pixels
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_draw_sw_blend_565_fill(lv_color_t * dest_buf, const lv_area_t * dest_area,
+                                                     lv_coord_t dest_stride, lv_color_t color, lv_opa_t opa,
+                                                     const lv_opa_t * mask, lv_coord_t mask_stride);
+
+/**
+ * Blend an image in normal blend mode, two pixels at once.
+ * Gives the same result as the generic software blender.
+ * @param dest_buf      pointer to the first pixel of the area in the draw buffer
+ * @param dest_area     the area to blend, only its size is used
+ * @param dest_stride   width of the draw buffer in pixels
+ * @param src_buf       pointer to the first pixel of the image
+ * @param src_stride    width of the image in pixels
+ * @param opa           overall opacity
+ * @param mask          mask of the area or NULL
+ * @param mask_stride   width of the mask in pixels
+ */
+LV_ATTRIBUTE_FAST_MEM void lv_draw_sw_blend_565_map(lv_color_t * dest_buf, const lv_area_t * dest_area,
+                                                    lv_coord_t dest_stride, const lv_color_t * src_buf,
+                                                    lv_coord_t src_stride, lv_opa_t opa,
+                                                    const lv_opa_t * mask, lv_coord_t mask_stride);
+
+/**********************
+ *      MACROS
+ **********************/
+
+#endif /*LV_USE_DRAW_SW_BLEND_565*/
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*LV_DRAW_SW_BLEND_565_H*/
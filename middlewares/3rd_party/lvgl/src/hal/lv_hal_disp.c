@@ -22,6 +22,7 @@
 #include "../draw/sdl/lv_draw_sdl.h"
 #include "../draw/stm32_dma2d/lv_gpu_stm32_dma2d.h"
 #include "../draw/swm341_dma2d/lv_gpu_swm341_dma2d.h"
+#include "../draw/at32_edma/lv_gpu_at32_edma.h"
 #include "../draw/arm2d/lv_gpu_arm2d.h"
 #include "../draw/nxp/vglite/lv_draw_vglite.h"
 #include "../draw/nxp/pxp/lv_draw_pxp.h"
@@ -104,6 +105,10 @@ void lv_disp_drv_init(lv_disp_drv_t * driver)
     driver->draw_ctx_init = lv_draw_swm341_dma2d_ctx_init;
     driver->draw_ctx_deinit = lv_draw_swm341_dma2d_ctx_init;
     driver->draw_ctx_size = sizeof(lv_draw_swm341_dma2d_ctx_t);
+#elif LV_USE_GPU_AT32_EDMA
+    driver->draw_ctx_init = lv_draw_at32_edma_ctx_init;
+    driver->draw_ctx_deinit = lv_draw_at32_edma_ctx_deinit;
+    driver->draw_ctx_size = sizeof(lv_draw_at32_edma_ctx_t);
 #elif LV_USE_GPU_NXP_VG_LITE
     driver->draw_ctx_init = lv_draw_vglite_ctx_init;
     driver->draw_ctx_deinit = lv_draw_vglite_ctx_deinit;
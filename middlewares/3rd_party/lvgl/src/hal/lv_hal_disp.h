@@ -62,6 +62,17 @@ typedef struct _lv_disp_draw_buf_t {
     volatile uint32_t last_part         : 1; /*1: the last part of the current area is being rendered*/
 } lv_disp_draw_buf_t;
 
+/**
+ * Cost of refreshing an area, used to decide which invalid areas to join.
+ * All fields use the same unit, e.g. CPU cycles.
+ * All 0: join only areas on each other and only if the joined area is smaller.
+ */
+typedef struct {
+    uint32_t render_px;         /**< Cost of rendering one pixel*/
+    uint32_t transfer_byte;     /**< Cost of sending one byte to the display*/
+    uint32_t flush;             /**< Fixed cost of one flush, e.g. window commands and DMA setup*/
+} lv_disp_merge_cost_t;
+
 typedef enum {
     LV_DISP_ROT_NONE = 0,
     LV_DISP_ROT_90,
@@ -109,6 +120,14 @@ typedef struct _lv_disp_drv_t {
      * E.g. round `y` to, 8, 16 ..) on a monochrome display*/
     void (*rounder_cb)(struct _lv_disp_drv_t * disp_drv, lv_area_t * area);
 
+    /** OPTIONAL: Cost model of the invalid area joining, see `lv_disp_merge_cost_t`*/
+    lv_disp_merge_cost_t merge_cost;
+
+    /** OPTIONAL: Decide if two invalid areas should be redrawn as their bounding area `joined`.
+     * Replaces the `merge_cost` based decision*/
+    bool (*merge_cb)(struct _lv_disp_drv_t * disp_drv, const lv_area_t * a1, const lv_area_t * a2,
+                     const lv_area_t * joined);
+
     /** OPTIONAL: Set a pixel in a buffer according to the special requirements of the display
      * Can be used for color format not supported in LittelvGL. E.g. 2 bit -> 4 gray scales
      * @note Much slower then drawing with supported color formats.*/
@@ -425,6 +425,16 @@
     #endif
 #endif
 
+/*Blend RGB565 two pixels at once in the software renderer.
+ *Requires LV_COLOR_DEPTH 16 and LV_COLOR_16_SWAP 0*/
+#ifndef LV_USE_DRAW_SW_BLEND_565
+    #ifdef CONFIG_LV_USE_DRAW_SW_BLEND_565
+        #define LV_USE_DRAW_SW_BLEND_565 CONFIG_LV_USE_DRAW_SW_BLEND_565
+    #else
+        #define LV_USE_DRAW_SW_BLEND_565 0
+    #endif
+#endif
+
 /*Use STM32's DMA2D (aka Chrom Art) GPU*/
 #ifndef LV_USE_GPU_STM32_DMA2D
     #ifdef CONFIG_LV_USE_GPU_STM32_DMA2D
@@ -463,6 +473,32 @@
     #endif
 #endif
 
+/*Use the EDMA of AT32F435/437 for large opaque fills and image copies*/
+#ifndef LV_USE_GPU_AT32_EDMA
+    #ifdef CONFIG_LV_USE_GPU_AT32_EDMA
+        #define LV_USE_GPU_AT32_EDMA CONFIG_LV_USE_GPU_AT32_EDMA
+    #else
+        #define LV_USE_GPU_AT32_EDMA 0
+    #endif
+#endif
+#if LV_USE_GPU_AT32_EDMA
+    #ifndef LV_GPU_AT32_EDMA_INCLUDE
+        #ifdef CONFIG_LV_GPU_AT32_EDMA_INCLUDE
+            #define LV_GPU_AT32_EDMA_INCLUDE CONFIG_LV_GPU_AT32_EDMA_INCLUDE
+        #else
+            #define LV_GPU_AT32_EDMA_INCLUDE "at32f435_437.h"
+        #endif
+    #endif
+    /*Smaller areas are drawn by the CPU, starting a transfer is not worth it*/
+    #ifndef LV_GPU_AT32_EDMA_MIN_PX
+        #ifdef CONFIG_LV_GPU_AT32_EDMA_MIN_PX
+            #define LV_GPU_AT32_EDMA_MIN_PX CONFIG_LV_GPU_AT32_EDMA_MIN_PX
+        #else
+            #define LV_GPU_AT32_EDMA_MIN_PX 256
+        #endif
+    #endif
+#endif
+
 /*Use NXP's PXP GPU iMX RTxxx platforms*/
 #ifndef LV_USE_GPU_NXP_PXP
     #ifdef CONFIG_LV_USE_GPU_NXP_PXP
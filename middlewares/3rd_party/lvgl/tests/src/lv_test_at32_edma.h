@@ -0,0 +1,187 @@
+/**
+ * @file lv_test_at32_edma.h
+ * Stand-in for the AT32F435/437 EDMA driver, used as LV_GPU_AT32_EDMA_INCLUDE by the tests.
+ * A started transfer stays busy for a few status polls and is then done in software,
+ * so a blend that does not wait for the stream leaves the buffer unchanged.
+ */
+
+#ifndef LV_TEST_AT32_EDMA_H
+#define LV_TEST_AT32_EDMA_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+typedef enum {FALSE = 0, TRUE = !FALSE} confirm_state;
+typedef enum {RESET = 0, SET = !RESET} flag_status;
+
+#define CRM_EDMA_PERIPH_CLOCK                   1
+
+#define EDMA_DIR_MEMORY_TO_MEMORY               2
+#define EDMA_PERIPHERAL_DATA_WIDTH_HALFWORD     1
+#define EDMA_MEMORY_DATA_WIDTH_HALFWORD         1
+#define EDMA_PRIORITY_LOW                       0
+#define EDMA_FIFO_THRESHOLD_FULL                3
+
+#define EDMA_FERR1_FLAG                         0x01
+#define EDMA_DMERR1_FLAG                        0x04
+#define EDMA_DTERR1_FLAG                        0x08
+#define EDMA_HDT1_FLAG                          0x10
+#define EDMA_FDT1_FLAG                          0x20
+
+#define EDMA_STREAM1                            (&lv_test_edma.stream)
+#define EDMA_STREAM1_2D                         (&lv_test_edma.stream_2d)
+
+/*Status polls a transfer stays busy for*/
+#define LV_TEST_EDMA_BUSY_POLLS                 3
+
+/*Images in this array count as being in the internal flash*/
+#define FLASH_BASE                              ((uint32_t)(uintptr_t)lv_test_edma_flash)
+#define SRAM_BASE                               ((uint32_t)(uintptr_t)(lv_test_edma_flash + LV_TEST_EDMA_FLASH_PX))
+#define LV_TEST_EDMA_FLASH_PX                   4096
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+
+typedef struct {
+    uint32_t peripheral_base_addr;
+    uint32_t memory0_base_addr;
+    uint32_t direction;
+    uint16_t buffer_size;
+    confirm_state peripheral_inc_enable;
+    confirm_state memory_inc_enable;
+    uint32_t peripheral_data_width;
+    uint32_t memory_data_width;
+    confirm_state loop_mode_enable;
+    uint32_t priority;
+    confirm_state fifo_mode_enable;
+    uint32_t fifo_threshold;
+} edma_init_type;
+
+typedef struct {
+    edma_init_type cfg;
+    uint32_t busy;
+} edma_stream_type;
+
+typedef struct {
+    confirm_state enabled;
+    int16_t src_stride;
+    int16_t dst_stride;
+    uint16_t xcnt;
+    uint16_t ycnt;
+} edma_stream_2d_type;
+
+typedef struct {
+    edma_stream_type stream;
+    edma_stream_2d_type stream_2d;
+    uint32_t clock_on;
+    uint32_t started;       /*Transfers started*/
+    uint32_t polls;         /*Status polls while a transfer was busy*/
+    uint32_t flags;         /*Flags cleared since the last reset*/
+    uint32_t aborted;       /*Transfers stopped before they were done*/
+} lv_test_edma_t;
+
+/**********************
+ *  GLOBAL VARIABLES
+ **********************/
+
+static lv_test_edma_t lv_test_edma;
+static uint16_t lv_test_edma_flash[LV_TEST_EDMA_FLASH_PX];
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/*The driver gets 32 bit addresses, all buffers of a test are in the same 4 GB of a 64 bit host*/
+static inline uint8_t * lv_test_edma_addr(uint32_t addr)
+{
+    return (uint8_t *)(((uintptr_t)&lv_test_edma & ~(uintptr_t)0xFFFFFFFF) | addr);
+}
+
+static inline void lv_test_edma_run(void)
+{
+    edma_init_type * cfg = &lv_test_edma.stream.cfg;
+    edma_stream_2d_type * s2d = &lv_test_edma.stream_2d;
+    uint8_t * src = lv_test_edma_addr(cfg->peripheral_base_addr);
+    uint8_t * dest = lv_test_edma_addr(cfg->memory0_base_addr);
+    uint32_t line = s2d->enabled ? s2d->xcnt : cfg->buffer_size;
+    uint32_t i;
+
+    for(i = 0; i < cfg->buffer_size; i++) {
+        memcpy(dest, src, 2);
+        if(cfg->peripheral_inc_enable) src += 2;
+        dest += 2;
+        if(s2d->enabled && (i + 1) % line == 0) {
+            src += s2d->src_stride;
+            dest += s2d->dst_stride;
+        }
+    }
+}
+
+static inline void lv_test_edma_reset(void)
+{
+    memset(&lv_test_edma, 0, sizeof(lv_test_edma));
+}
+
+static inline void crm_periph_clock_enable(uint32_t periph, confirm_state new_state)
+{
+    if(periph == CRM_EDMA_PERIPH_CLOCK) lv_test_edma.clock_on = new_state;
+}
+
+static inline void edma_default_para_init(edma_init_type * init)
+{
+    memset(init, 0, sizeof(edma_init_type));
+}
+
+static inline void edma_init(edma_stream_type * stream, edma_init_type * init)
+{
+    stream->cfg = *init;
+}
+
+static inline void edma_2d_init(edma_stream_2d_type * stream_2d, int16_t src_stride, int16_t dst_stride,
+                                uint16_t xcnt, uint16_t ycnt)
+{
+    stream_2d->src_stride = src_stride;
+    stream_2d->dst_stride = dst_stride;
+    stream_2d->xcnt = xcnt;
+    stream_2d->ycnt = ycnt;
+}
+
+static inline void edma_2d_enable(edma_stream_2d_type * stream_2d, confirm_state new_state)
+{
+    stream_2d->enabled = new_state;
+}
+
+static inline void edma_stream_enable(edma_stream_type * stream, confirm_state new_state)
+{
+    if(new_state == FALSE) {
+        /*Disabling a busy stream aborts the transfer*/
+        if(stream->busy) lv_test_edma.aborted++;
+        stream->busy = 0;
+        return;
+    }
+    lv_test_edma.started++;
+    stream->busy = LV_TEST_EDMA_BUSY_POLLS;
+}
+
+static inline flag_status edma_stream_status_get(edma_stream_type * stream)
+{
+    if(stream->busy == 0) return RESET;
+    lv_test_edma.polls++;
+    if(--stream->busy == 0) {
+        lv_test_edma_run();
+        return RESET;
+    }
+    return SET;
+}
+
+static inline void edma_flag_clear(uint32_t flags)
+{
+    lv_test_edma.flags |= flags;
+}
+
+#endif /*LV_TEST_AT32_EDMA_H*/
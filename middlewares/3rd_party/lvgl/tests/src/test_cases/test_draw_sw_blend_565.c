@@ -0,0 +1,172 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+#if LV_USE_DRAW_SW_BLEND_565
+#include "../src/draw/sw/lv_draw_sw_blend_565.h"
+
+#define TEST_BLEND_565 1
+
+/*Compile the generic blender here too, its normal mode fill and map are the reference*/
+#undef LV_USE_DRAW_SW_BLEND_565
+#define LV_USE_DRAW_SW_BLEND_565 0
+#define lv_draw_sw_blend        ref_draw_sw_blend
+#define lv_draw_sw_blend_basic  ref_draw_sw_blend_basic
+#include "../src/draw/sw/lv_draw_sw_blend.c"
+#undef lv_draw_sw_blend
+#undef lv_draw_sw_blend_basic
+
+#define BUF_W       24
+#define BUF_H       4
+#define GUARD       0x5A5A
+
+static lv_color_t dest_565[BUF_W * BUF_H];
+static lv_color_t dest_ref[BUF_W * BUF_H];
+static lv_color_t src[BUF_W * BUF_H];
+static lv_opa_t mask[BUF_W * BUF_H];
+static uint32_t seed;
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static lv_color_t rnd_color(void)
+{
+    lv_color_t c;
+    /*Black and white are special in the generic blender, use them often*/
+    switch(rnd() % 8) {
+        case 0:
+            c.full = 0x0000;
+            break;
+        case 1:
+            c.full = 0xFFFF;
+            break;
+        default:
+            c.full = (uint16_t)rnd();
+            break;
+    }
+    return c;
+}
+
+static lv_opa_t rnd_opa(void)
+{
+    /*Fully transparent and fully covered runs take their own paths*/
+    switch(rnd() % 4) {
+        case 0:
+            return LV_OPA_TRANSP;
+        case 1:
+            return LV_OPA_COVER;
+        default:
+            return (lv_opa_t)rnd();
+    }
+}
+
+static void prepare(lv_coord_t w, lv_coord_t h, bool with_mask)
+{
+    int32_t i;
+    for(i = 0; i < BUF_W * BUF_H; i++) {
+        dest_565[i].full = GUARD;
+        src[i] = rnd_color();
+        mask[i] = rnd_opa();
+    }
+
+    /*Random background in the area only, the rest is the guard*/
+    lv_coord_t y;
+    lv_coord_t x;
+    for(y = 0; y < h; y++) {
+        for(x = 0; x < w; x++) {
+            dest_565[y * BUF_W + x + 1] = rnd_color();
+        }
+    }
+
+    if(with_mask) {
+        /*Long runs of the same value too*/
+        for(i = 0; i < BUF_W * BUF_H; i += 4) {
+            if(rnd() % 2) lv_memset(&mask[i], rnd_opa(), 4);
+        }
+    }
+    lv_memcpy(dest_ref, dest_565, sizeof(dest_565));
+}
+
+static void check(lv_coord_t w, lv_coord_t h, lv_opa_t opa, bool with_mask, bool map)
+{
+    int32_t i;
+    for(i = 0; i < BUF_W * BUF_H; i++) {
+        if(dest_565[i].full != dest_ref[i].full) {
+            TEST_PRINTF("%s w:%d h:%d opa:%d mask:%d px:%d 565:%04X ref:%04X", map ? "map" : "fill", (int)w, (int)h,
+                        opa, with_mask, (int)i, dest_565[i].full, dest_ref[i].full);
+            TEST_FAIL();
+        }
+    }
+}
+
+static void blend(bool map)
+{
+    static const lv_opa_t opas[] = {LV_OPA_COVER, LV_OPA_COVER - 1, LV_OPA_50, LV_OPA_MAX, LV_OPA_MIN + 1, 17};
+    lv_coord_t w;
+    lv_coord_t h;
+    uint32_t o;
+    uint32_t m;
+    uint32_t rep;
+
+    seed = 1;
+    /*Odd and even widths; starting at x = 1 makes the first pixel the upper half of a word*/
+    for(w = 1; w < BUF_W - 2; w++) {
+        for(h = 1; h <= BUF_H; h++) {
+            for(o = 0; o < sizeof(opas) / sizeof(opas[0]); o++) {
+                for(m = 0; m < 2; m++) {
+                    for(rep = 0; rep < 4; rep++) {
+                        lv_area_t area;
+                        lv_area_set(&area, 0, 0, w - 1, h - 1);
+                        prepare(w, h, m);
+                        lv_opa_t * mask_p = m ? mask : NULL;
+                        lv_color_t color = rnd_color();
+                        if(map) {
+                            lv_draw_sw_blend_565_map(dest_565 + 1, &area, BUF_W, src, BUF_W, opas[o], mask_p, BUF_W);
+                            map_normal(dest_ref + 1, &area, BUF_W, src, BUF_W, opas[o], mask_p, BUF_W);
+                        }
+                        else {
+                            lv_draw_sw_blend_565_fill(dest_565 + 1, &area, BUF_W, color, opas[o], mask_p, BUF_W);
+                            fill_normal(dest_ref + 1, &area, BUF_W, color, opas[o], mask_p, BUF_W);
+                        }
+                        check(w, h, opas[o], m, map);
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
+
+void setUp(void)
+{
+    /* Function run before every test */
+}
+
+void tearDown(void)
+{
+    /* Function run after every test */
+}
+
+void test_blend_565_fill(void)
+{
+#ifdef TEST_BLEND_565
+    blend(false);
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_USE_DRAW_SW_BLEND_565");
+#endif
+}
+
+void test_blend_565_map(void)
+{
+#ifdef TEST_BLEND_565
+    blend(true);
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_USE_DRAW_SW_BLEND_565");
+#endif
+}
+
+#endif
@@ -0,0 +1,277 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+#if LV_COLOR_DEPTH == 16 && !LV_USE_GPU_AT32_EDMA
+/*Compile the EDMA backend here against the stand-in driver*/
+#define TEST_AT32_EDMA 1
+
+#undef LV_USE_GPU_AT32_EDMA
+#define LV_USE_GPU_AT32_EDMA 1
+#define LV_GPU_AT32_EDMA_INCLUDE "lv_test_at32_edma.h"
+#define LV_GPU_AT32_EDMA_MIN_PX 256
+/*The backend passes 32 bit addresses to the driver*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+#include "../src/draw/at32_edma/lv_gpu_at32_edma.c"
+#pragma GCC diagnostic pop
+
+#define BUF_W       64
+#define BUF_H       32
+#define BUF_X       100     /*Screen position of the draw buffer*/
+#define BUF_Y       50
+#define GUARD       0x5A5A
+
+static lv_color_t buf[BUF_W * BUF_H];
+static lv_color_t buf_ref[BUF_W * BUF_H];
+static lv_area_t buf_area;
+static lv_area_t clip_area;
+static lv_draw_at32_edma_ctx_t edma_ctx;
+static lv_draw_sw_ctx_t sw_ctx;
+static uint32_t wait_cb_cnt;
+
+static void count_wait_cb(lv_disp_drv_t * disp_drv)
+{
+    LV_UNUSED(disp_drv);
+    wait_cb_cnt++;
+}
+
+static void ctx_set_buf(lv_draw_ctx_t * draw_ctx, lv_color_t * dest)
+{
+    draw_ctx->buf = dest;
+    draw_ctx->buf_area = &buf_area;
+    draw_ctx->clip_area = &clip_area;
+}
+
+static void bufs_fill(void)
+{
+    uint32_t i;
+    for(i = 0; i < BUF_W * BUF_H; i++) {
+        buf[i].full = (uint16_t)(GUARD + i * 31);
+    }
+    lv_memcpy(buf_ref, buf, sizeof(buf));
+}
+
+/*Blend with the EDMA and with the CPU, return with the EDMA transfer finished*/
+static void blend_both(const lv_draw_sw_blend_dsc_t * dsc)
+{
+    lv_draw_sw_blend(&edma_ctx.base_draw, dsc);
+    edma_ctx.base_draw.wait_for_finish(&edma_ctx.base_draw);
+    lv_draw_sw_blend(&sw_ctx.base_draw, dsc);
+}
+
+static void assert_bufs_equal(void)
+{
+    TEST_ASSERT_EQUAL_HEX16_ARRAY(buf_ref, buf, BUF_W * BUF_H);
+    TEST_ASSERT_EQUAL(0, lv_test_edma.aborted);
+}
+
+static void blend_dsc_init(lv_draw_sw_blend_dsc_t * dsc, lv_area_t * area, lv_coord_t x1, lv_coord_t y1,
+                           lv_coord_t x2, lv_coord_t y2)
+{
+    lv_area_set(area, BUF_X + x1, BUF_Y + y1, BUF_X + x2, BUF_Y + y2);
+    lv_memset_00(dsc, sizeof(lv_draw_sw_blend_dsc_t));
+    dsc->blend_area = area;
+    dsc->color = lv_color_make(0x20, 0x80, 0xF0);
+    dsc->opa = LV_OPA_COVER;
+    dsc->blend_mode = LV_BLEND_MODE_NORMAL;
+}
+#endif
+
+void setUp(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_disp_t * disp = lv_disp_get_default();
+
+    lv_test_edma_reset();
+    lv_area_set(&buf_area, BUF_X, BUF_Y, BUF_X + BUF_W - 1, BUF_Y + BUF_H - 1);
+    clip_area = buf_area;
+
+    lv_memset_00(&edma_ctx, sizeof(edma_ctx));
+    lv_memset_00(&sw_ctx, sizeof(sw_ctx));
+    lv_draw_at32_edma_init();
+    lv_draw_at32_edma_ctx_init(disp->driver, &edma_ctx.base_draw);
+    lv_draw_sw_init_ctx(disp->driver, &sw_ctx.base_draw);
+    ctx_set_buf(&edma_ctx.base_draw, buf);
+    ctx_set_buf(&sw_ctx.base_draw, buf_ref);
+
+    /*The blenders look up the display being refreshed*/
+    _lv_refr_set_disp_refreshing(disp);
+    wait_cb_cnt = 0;
+    bufs_fill();
+#endif
+}
+
+void tearDown(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_disp_get_default()->driver->wait_cb = NULL;
+    _lv_refr_set_disp_refreshing(NULL);
+#endif
+}
+
+void test_at32_edma_fill_runs_on_the_edma(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_area_t area;
+
+    TEST_ASSERT_TRUE(lv_test_edma.clock_on);
+
+    /*Full lines and a window inside the buffer*/
+    blend_dsc_init(&dsc, &area, 0, 0, BUF_W - 1, 7);
+    blend_both(&dsc);
+    blend_dsc_init(&dsc, &area, 5, 10, 40, 30);
+    blend_both(&dsc);
+
+    TEST_ASSERT_EQUAL(2, lv_test_edma.started);
+    assert_bufs_equal();
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+void test_at32_edma_does_not_wait_for_the_transfer(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_area_t area;
+
+    blend_dsc_init(&dsc, &area, 0, 0, 31, 15);
+    lv_draw_sw_blend(&edma_ctx.base_draw, &dsc);
+    TEST_ASSERT_EQUAL(1, lv_test_edma.started);
+    TEST_ASSERT_EQUAL_HEX16(buf_ref[0].full, buf[0].full);
+
+    /*The next blend waits for the first one*/
+    blend_dsc_init(&dsc, &area, 16, 8, 63, 31);
+    dsc.color = lv_color_make(0xF0, 0x10, 0x10);
+    lv_draw_sw_blend(&edma_ctx.base_draw, &dsc);
+    TEST_ASSERT_EQUAL(2, lv_test_edma.started);
+    TEST_ASSERT_EQUAL(0, lv_test_edma.aborted);
+    edma_ctx.base_draw.wait_for_finish(&edma_ctx.base_draw);
+
+    blend_dsc_init(&dsc, &area, 0, 0, 31, 15);
+    lv_draw_sw_blend(&sw_ctx.base_draw, &dsc);
+    blend_dsc_init(&dsc, &area, 16, 8, 63, 31);
+    dsc.color = lv_color_make(0xF0, 0x10, 0x10);
+    lv_draw_sw_blend(&sw_ctx.base_draw, &dsc);
+    assert_bufs_equal();
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+void test_at32_edma_wait_calls_the_driver_wait_cb(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_area_t area;
+
+    lv_disp_get_default()->driver->wait_cb = count_wait_cb;
+    blend_dsc_init(&dsc, &area, 0, 0, BUF_W - 1, BUF_H - 1);
+    lv_draw_sw_blend(&edma_ctx.base_draw, &dsc);
+    edma_ctx.base_draw.wait_for_finish(&edma_ctx.base_draw);
+
+    TEST_ASSERT_EQUAL(LV_TEST_EDMA_BUSY_POLLS - 1, wait_cb_cnt);
+    TEST_ASSERT_EQUAL(RESET, edma_stream_status_get(EDMA_STREAM1));
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+void test_at32_edma_copies_flash_images(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_area_t area;
+    uint32_t i;
+
+    for(i = 0; i < LV_TEST_EDMA_FLASH_PX; i++) lv_test_edma_flash[i] = (uint16_t)(i * 7 + 3);
+
+    /*An image partly outside of the clip area*/
+    blend_dsc_init(&dsc, &area, -10, -4, 49, 19);
+    dsc.src_buf = (const lv_color_t *)lv_test_edma_flash;
+    lv_area_set(&clip_area, BUF_X + 2, BUF_Y + 1, BUF_X + 45, BUF_Y + 30);
+    blend_both(&dsc);
+
+    TEST_ASSERT_EQUAL(1, lv_test_edma.started);
+    assert_bufs_equal();
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+void test_at32_edma_leaves_the_rest_to_the_cpu(void)
+{
+#ifdef TEST_AT32_EDMA
+    static lv_color_t ram_img[BUF_W * BUF_H];
+    static lv_opa_t mask[BUF_W * BUF_H];
+    lv_draw_sw_blend_dsc_t dsc;
+    lv_area_t area;
+    uint32_t i;
+
+    for(i = 0; i < BUF_W * BUF_H; i++) {
+        ram_img[i].full = (uint16_t)(i * 13);
+        mask[i] = (lv_opa_t)(i * 5);
+    }
+
+    /*Below the pixel limit*/
+    blend_dsc_init(&dsc, &area, 0, 0, 15, 14);
+    blend_both(&dsc);
+
+    /*Translucent*/
+    blend_dsc_init(&dsc, &area, 0, 0, 40, 20);
+    dsc.opa = LV_OPA_50;
+    blend_both(&dsc);
+
+    /*Masked*/
+    blend_dsc_init(&dsc, &area, 0, 0, 40, 20);
+    dsc.mask_buf = mask;
+    dsc.mask_area = &area;
+    dsc.mask_res = LV_DRAW_MASK_RES_CHANGED;
+    blend_both(&dsc);
+
+    /*Other blend mode*/
+    blend_dsc_init(&dsc, &area, 0, 0, 40, 20);
+    dsc.blend_mode = LV_BLEND_MODE_ADDITIVE;
+    blend_both(&dsc);
+
+    /*An image in RAM may change right after the blend*/
+    blend_dsc_init(&dsc, &area, 0, 0, 40, 20);
+    dsc.src_buf = ram_img;
+    blend_both(&dsc);
+
+    TEST_ASSERT_EQUAL(0, lv_test_edma.started);
+    assert_bufs_equal();
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+void test_at32_edma_draws_rects_like_the_cpu(void)
+{
+#ifdef TEST_AT32_EDMA
+    lv_draw_rect_dsc_t dsc;
+    lv_area_t area;
+
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_color = lv_palette_main(LV_PALETTE_GREEN);
+    dsc.radius = 6;
+    dsc.border_width = 3;
+    dsc.border_color = lv_palette_main(LV_PALETTE_RED);
+    lv_area_set(&area, BUF_X + 2, BUF_Y + 2, BUF_X + 60, BUF_Y + 28);
+
+    lv_draw_rect(&edma_ctx.base_draw, &dsc, &area);
+    edma_ctx.base_draw.wait_for_finish(&edma_ctx.base_draw);
+    lv_draw_rect(&sw_ctx.base_draw, &dsc, &area);
+
+    /*The inside of the rectangle is large enough for the EDMA*/
+    TEST_ASSERT_GREATER_THAN(0, lv_test_edma.started);
+    assert_bufs_equal();
+#else
+    TEST_IGNORE_MESSAGE("Requires LV_COLOR_DEPTH 16");
+#endif
+}
+
+#endif
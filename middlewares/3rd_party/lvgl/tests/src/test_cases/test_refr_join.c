@@ -0,0 +1,157 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+#define FLUSH_MAX   (LV_INV_BUF_SIZE + 8)
+
+static lv_disp_drv_t * drv;
+static void (*flush_cb_ori)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+static lv_area_t flushed[FLUSH_MAX];
+static uint32_t flush_cnt;
+static bool merge_cb_res;
+
+static void count_flush_cb(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    LV_UNUSED(color_p);
+    if(flush_cnt < FLUSH_MAX) flushed[flush_cnt] = *area;
+    flush_cnt++;
+    lv_disp_flush_ready(disp_drv);
+}
+
+static bool fixed_merge_cb(lv_disp_drv_t * disp_drv, const lv_area_t * a1, const lv_area_t * a2,
+                           const lv_area_t * joined)
+{
+    LV_UNUSED(disp_drv);
+    LV_UNUSED(a1);
+    LV_UNUSED(a2);
+    LV_UNUSED(joined);
+    return merge_cb_res;
+}
+
+static void inv(lv_coord_t x1, lv_coord_t y1, lv_coord_t x2, lv_coord_t y2)
+{
+    lv_area_t a;
+    lv_area_set(&a, x1, y1, x2, y2);
+    _lv_inv_area(lv_disp_get_default(), &a);
+}
+
+static void refr(void)
+{
+    flush_cnt = 0;
+    lv_refr_now(NULL);
+}
+
+static void assert_flushed(uint32_t i, lv_coord_t x1, lv_coord_t y1, lv_coord_t x2, lv_coord_t y2)
+{
+    TEST_ASSERT_EQUAL(x1, flushed[i].x1);
+    TEST_ASSERT_EQUAL(y1, flushed[i].y1);
+    TEST_ASSERT_EQUAL(x2, flushed[i].x2);
+    TEST_ASSERT_EQUAL(y2, flushed[i].y2);
+}
+
+void setUp(void)
+{
+    drv = lv_disp_get_default()->driver;
+    flush_cb_ori = drv->flush_cb;
+    lv_obj_clean(lv_scr_act());
+    lv_refr_now(NULL);
+    drv->flush_cb = count_flush_cb;
+}
+
+void tearDown(void)
+{
+    lv_memset_00(&drv->merge_cost, sizeof(drv->merge_cost));
+    drv->merge_cb = NULL;
+    drv->flush_cb = flush_cb_ori;
+}
+
+void test_join_without_cost_joins_smaller_overlapping_areas(void)
+{
+    /*The bounding area is smaller than the two areas*/
+    inv(0, 0, 99, 99);
+    inv(20, 20, 119, 119);
+    refr();
+    TEST_ASSERT_EQUAL(1, flush_cnt);
+    assert_flushed(0, 0, 0, 119, 119);
+
+    /*The bounding area is larger than the two areas*/
+    inv(0, 0, 99, 99);
+    inv(60, 60, 159, 159);
+    refr();
+    TEST_ASSERT_EQUAL(2, flush_cnt);
+
+    /*Areas which are not on each other are never joined*/
+    inv(0, 0, 9, 9);
+    inv(20, 0, 29, 9);
+    refr();
+    TEST_ASSERT_EQUAL(2, flush_cnt);
+}
+
+void test_join_with_flush_cost_joins_separate_areas(void)
+{
+    drv->merge_cost.render_px = 1;
+    drv->merge_cost.flush = 100000;
+
+    inv(0, 0, 9, 9);
+    inv(20, 0, 29, 9);
+    refr();
+    TEST_ASSERT_EQUAL(1, flush_cnt);
+    assert_flushed(0, 0, 0, 29, 9);
+
+    /*Far apart the bounding area costs more than a flush*/
+    inv(0, 0, 9, 9);
+    inv(700, 400, 709, 409);
+    refr();
+    TEST_ASSERT_EQUAL(2, flush_cnt);
+}
+
+void test_join_merge_cb_decides(void)
+{
+    drv->merge_cb = fixed_merge_cb;
+
+    merge_cb_res = false;
+    inv(0, 0, 99, 99);
+    inv(20, 20, 119, 119);
+    refr();
+    TEST_ASSERT_EQUAL(2, flush_cnt);
+
+    merge_cb_res = true;
+    inv(0, 0, 9, 9);
+    inv(700, 400, 709, 409);
+    refr();
+    TEST_ASSERT_EQUAL(1, flush_cnt);
+    assert_flushed(0, 0, 0, 709, 409);
+}
+
+void test_join_full_buffer_does_not_redraw_the_screen(void)
+{
+    uint32_t i;
+    uint32_t px = 0;
+    lv_coord_t x;
+    lv_coord_t y;
+
+    /*One more area than fits, none of them can be joined by the default rule*/
+    for(i = 0; i <= LV_INV_BUF_SIZE; i++) {
+        x = (lv_coord_t)(i * 20);
+        y = (lv_coord_t)(i * 10);
+        inv(x, y, x + 9, y + 9);
+    }
+    refr();
+
+    TEST_ASSERT_EQUAL(LV_INV_BUF_SIZE, flush_cnt);
+    for(i = 0; i < flush_cnt; i++) {
+        px += lv_area_get_size(&flushed[i]);
+    }
+    TEST_ASSERT_LESS_THAN(lv_disp_get_hor_res(NULL) * lv_disp_get_ver_res(NULL) / 10, px);
+
+    /*The last area was joined into a flushed one*/
+    x = LV_INV_BUF_SIZE * 20;
+    y = LV_INV_BUF_SIZE * 10;
+    for(i = 0; i < flush_cnt; i++) {
+        if(flushed[i].x1 <= x && flushed[i].y1 <= y && flushed[i].x2 >= x + 9 && flushed[i].y2 >= y + 9) break;
+    }
+    TEST_ASSERT_LESS_THAN(flush_cnt, i);
+}
+
+#endif
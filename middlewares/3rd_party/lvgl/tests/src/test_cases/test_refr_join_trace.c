@@ -0,0 +1,292 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+/*Record the invalid areas of widget scenes frame by frame, then replay them with every join policy
+ *and compare the pixels, flushes and modeled cost of the refreshes*/
+
+#define TRACE_FRAMES        24
+#define TRACE_AREA_MAX      8192
+#define STRIP_ROWS          24
+
+/*Cost model of the uvc_lvgl port in cpu cycles: render, spi at 36 MHz, window commands and dma setup*/
+#define COST_RENDER_PX      16
+#define COST_TRANSFER_BYTE  64
+#define COST_FLUSH          8000
+
+typedef enum {
+    POLICY_NONE,        /*Refresh every area on its own*/
+    POLICY_SIZE,        /*Join areas on each other if the joined area is smaller*/
+    POLICY_COST,        /*Join by the cost model of the port*/
+    POLICY_NUM
+} policy_t;
+
+static const char * policy_name[POLICY_NUM] = {"no join", "size rule", "cost model"};
+
+typedef struct {
+    uint32_t flush_cnt;
+    uint32_t px;
+    uint32_t max_frame_px;
+} replay_stats_t;
+
+static lv_disp_drv_t * drv;
+static void (*flush_cb_ori)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+static lv_disp_draw_buf_t * draw_buf_ori;
+static lv_disp_draw_buf_t strip_buf;
+static lv_color_t strip_px[800 * STRIP_ROWS];
+
+static lv_area_t trace[TRACE_AREA_MAX];
+static uint32_t trace_cnt;
+static uint32_t frame_end[TRACE_FRAMES];
+static bool recording;
+
+static replay_stats_t stats;
+static uint32_t frame_px;
+
+static lv_obj_t * objs[64];
+
+static void record_rounder_cb(lv_disp_drv_t * disp_drv, lv_area_t * area)
+{
+    LV_UNUSED(disp_drv);
+    if(recording && trace_cnt < TRACE_AREA_MAX) trace[trace_cnt++] = *area;
+}
+
+static void count_flush_cb(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p)
+{
+    LV_UNUSED(color_p);
+    stats.flush_cnt++;
+    stats.px += lv_area_get_size(area);
+    frame_px += lv_area_get_size(area);
+    lv_disp_flush_ready(disp_drv);
+}
+
+static bool no_merge_cb(lv_disp_drv_t * disp_drv, const lv_area_t * a1, const lv_area_t * a2,
+                        const lv_area_t * joined)
+{
+    LV_UNUSED(disp_drv);
+    LV_UNUSED(a1);
+    LV_UNUSED(a2);
+    LV_UNUSED(joined);
+    return false;
+}
+
+static uint64_t modeled_cost(const replay_stats_t * s)
+{
+    return (uint64_t)s->px * (COST_RENDER_PX + COST_TRANSFER_BYTE * sizeof(lv_color_t)) +
+           (uint64_t)s->flush_cnt * COST_FLUSH;
+}
+
+static void policy_set(policy_t policy)
+{
+    lv_memset_00(&drv->merge_cost, sizeof(drv->merge_cost));
+    drv->merge_cb = NULL;
+    if(policy == POLICY_NONE) {
+        drv->merge_cb = no_merge_cb;
+    }
+    else if(policy == POLICY_COST) {
+        drv->merge_cost.render_px = COST_RENDER_PX;
+        drv->merge_cost.transfer_byte = COST_TRANSFER_BYTE;
+        drv->merge_cost.flush = COST_FLUSH;
+    }
+}
+
+/*Run the scene and save what it and its layout invalidate, every frame ends with a refresh.
+ *The refresh calls the rounder too, it is not recorded*/
+static void record(void (*step)(uint32_t frame))
+{
+    uint32_t f;
+
+    lv_refr_now(NULL);
+    trace_cnt = 0;
+    for(f = 0; f < TRACE_FRAMES; f++) {
+        recording = true;
+        step(f);
+        lv_obj_update_layout(lv_scr_act());
+        recording = false;
+        frame_end[f] = trace_cnt;
+        lv_refr_now(NULL);
+    }
+    TEST_ASSERT_LESS_THAN(TRACE_AREA_MAX, trace_cnt);
+}
+
+static void replay(policy_t policy, replay_stats_t * res)
+{
+    uint32_t f;
+    uint32_t i = 0;
+
+    policy_set(policy);
+    lv_memset_00(&stats, sizeof(stats));
+    for(f = 0; f < TRACE_FRAMES; f++) {
+        frame_px = 0;
+        for(; i < frame_end[f]; i++) _lv_inv_area(lv_disp_get_default(), &trace[i]);
+        lv_refr_now(NULL);
+        stats.max_frame_px = LV_MAX(stats.max_frame_px, frame_px);
+    }
+    *res = stats;
+}
+
+static void replay_all(const char * name, void (*step)(uint32_t frame))
+{
+    replay_stats_t res[POLICY_NUM];
+    uint32_t p;
+
+    record(step);
+    for(p = 0; p < POLICY_NUM; p++) replay(p, &res[p]);
+
+    printf("%s, %d areas in %d frames\n", name, (int)trace_cnt, TRACE_FRAMES);
+    for(p = 0; p < POLICY_NUM; p++) {
+        printf("    %-10s %5d flushes %8d px %7d px in the largest frame  %6.2f ms at 288 MHz\n",
+               policy_name[p], (int)res[p].flush_cnt, (int)res[p].px, (int)res[p].max_frame_px,
+               modeled_cost(&res[p]) / 288000.0);
+    }
+
+    /*The cost model is never worse than the other policies by its own measure*/
+    TEST_ASSERT_TRUE(modeled_cost(&res[POLICY_COST]) <= modeled_cost(&res[POLICY_SIZE]));
+    TEST_ASSERT_TRUE(modeled_cost(&res[POLICY_COST]) <= modeled_cost(&res[POLICY_NONE]));
+    /*No frame falls back to a full screen refresh*/
+    for(p = 0; p < POLICY_NUM; p++) {
+        TEST_ASSERT_LESS_THAN(lv_disp_get_hor_res(NULL) * lv_disp_get_ver_res(NULL), res[p].max_frame_px);
+    }
+}
+
+static lv_obj_t * label_create(lv_coord_t x, lv_coord_t y, const char * txt)
+{
+    lv_obj_t * label = lv_label_create(lv_scr_act());
+    lv_obj_set_pos(label, x, y);
+    lv_label_set_text(label, txt);
+    return label;
+}
+
+/*Scenes*/
+
+static void counters_step(uint32_t frame)
+{
+    uint32_t i;
+
+    /*A few of a grid of values change every frame*/
+    for(i = frame % 5; i < 40; i += 5) {
+        lv_label_set_text_fmt(objs[i], "%d", (int)((frame + 1) * 37 * (i + 3) % 100000));
+    }
+}
+
+static void bars_step(uint32_t frame)
+{
+    uint32_t i;
+
+    for(i = 0; i < 6; i++) {
+        lv_bar_set_value(objs[i], (int32_t)((frame * (i + 3) * 7) % 100), LV_ANIM_OFF);
+    }
+    lv_label_set_text_fmt(objs[6], "%d%%", (int)(frame * 4));
+}
+
+static void moving_step(uint32_t frame)
+{
+    /*A button crosses the screen while a status line changes on the other side*/
+    lv_obj_set_pos(objs[0], (lv_coord_t)(frame * 30), (lv_coord_t)(100 + frame * 8));
+    lv_label_set_text_fmt(objs[1], "frame %d", (int)frame);
+}
+
+static void status_step(uint32_t frame)
+{
+    uint32_t i;
+
+    /*Small values a few pixels apart, a clock and a frame counter*/
+    for(i = 0; i < 8; i++) {
+        if((frame + i) % 3) lv_label_set_text_fmt(objs[i], "%02d", (int)((frame * (i + 1)) % 60));
+    }
+}
+
+static void overflow_step(uint32_t frame)
+{
+    uint32_t i;
+
+    /*More changes a frame than invalid areas fit*/
+    for(i = 0; i < 48; i++) {
+        lv_label_set_text_fmt(objs[i], "%c%d", 'a' + (int)(i % 26), (int)((frame + i) % 10));
+    }
+}
+
+/*Setup*/
+
+void setUp(void)
+{
+    drv = lv_disp_get_default()->driver;
+    flush_cb_ori = drv->flush_cb;
+    draw_buf_ori = drv->draw_buf;
+    lv_obj_clean(lv_scr_act());
+    lv_refr_now(NULL);
+
+    /*Render in strips as a serial panel port does*/
+    lv_disp_draw_buf_init(&strip_buf, strip_px, NULL, 800 * STRIP_ROWS);
+    drv->draw_buf = &strip_buf;
+    drv->flush_cb = count_flush_cb;
+    drv->rounder_cb = record_rounder_cb;
+}
+
+void tearDown(void)
+{
+    lv_obj_clean(lv_scr_act());
+    lv_refr_now(NULL);
+    lv_memset_00(&drv->merge_cost, sizeof(drv->merge_cost));
+    drv->merge_cb = NULL;
+    drv->rounder_cb = NULL;
+    drv->flush_cb = flush_cb_ori;
+    drv->draw_buf = draw_buf_ori;
+}
+
+void test_join_trace_counters(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < 40; i++) {
+        objs[i] = label_create((lv_coord_t)(20 + (i % 8) * 95), (lv_coord_t)(20 + (i / 8) * 90), "0");
+    }
+    replay_all("counter grid", counters_step);
+}
+
+void test_join_trace_bars(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < 6; i++) {
+        objs[i] = lv_bar_create(lv_scr_act());
+        lv_obj_set_size(objs[i], 300, 20);
+        lv_obj_set_pos(objs[i], (lv_coord_t)(40 + (i % 2) * 380), (lv_coord_t)(60 + (i / 2) * 120));
+    }
+    objs[6] = label_create(700, 440, "0%");
+    replay_all("bars", bars_step);
+}
+
+void test_join_trace_moving(void)
+{
+    objs[0] = lv_btn_create(lv_scr_act());
+    lv_obj_set_size(objs[0], 120, 50);
+    objs[1] = label_create(600, 20, "frame");
+    replay_all("moving button", moving_step);
+}
+
+void test_join_trace_status_bar(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < 8; i++) {
+        objs[i] = label_create((lv_coord_t)(500 + i * 36), 4, "00");
+    }
+    replay_all("status bar", status_step);
+}
+
+void test_join_trace_overflow(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < 48; i++) {
+        objs[i] = label_create((lv_coord_t)(10 + (i % 12) * 66), (lv_coord_t)(10 + (i / 12) * 110), "a0");
+    }
+    replay_all("more areas than fit", overflow_step);
+    printf("    a full screen refresh of every frame was %d px\n",
+           (int)(lv_disp_get_hor_res(NULL) * lv_disp_get_ver_res(NULL) * TRACE_FRAMES));
+    TEST_ASSERT_GREATER_THAN(LV_INV_BUF_SIZE * TRACE_FRAMES, trace_cnt);
+}
+
+#endif
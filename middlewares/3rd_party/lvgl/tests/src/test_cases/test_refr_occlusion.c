@@ -0,0 +1,127 @@
+#if LV_BUILD_TEST
+#include "../lvgl.h"
+
+#include "unity/unity.h"
+
+typedef struct {
+    uint32_t cnt;
+    lv_area_t clip_area;
+} draw_info_t;
+
+static void draw_main_cb(lv_event_t * e)
+{
+    draw_info_t * info = lv_event_get_user_data(e);
+    lv_draw_ctx_t * draw_ctx = lv_event_get_draw_ctx(e);
+    info->cnt++;
+    info->clip_area = *draw_ctx->clip_area;
+}
+
+static lv_obj_t * rect_create(lv_obj_t * parent, lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h,
+                              lv_opa_t opa, draw_info_t * info)
+{
+    lv_obj_t * obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_pos(obj, x, y);
+    lv_obj_set_size(obj, w, h);
+    lv_obj_set_style_bg_color(obj, lv_palette_main(LV_PALETTE_BLUE), 0);
+    lv_obj_set_style_bg_opa(obj, opa, 0);
+    lv_memset_00(info, sizeof(draw_info_t));
+    lv_obj_add_event_cb(obj, draw_main_cb, LV_EVENT_DRAW_MAIN, info);
+    return obj;
+}
+
+static void refr(void)
+{
+    lv_obj_invalidate(lv_scr_act());
+    lv_refr_now(NULL);
+}
+
+static void assert_clip(const draw_info_t * info, lv_coord_t x1, lv_coord_t y1, lv_coord_t x2, lv_coord_t y2)
+{
+    TEST_ASSERT_EQUAL(x1, info->clip_area.x1);
+    TEST_ASSERT_EQUAL(y1, info->clip_area.y1);
+    TEST_ASSERT_EQUAL(x2, info->clip_area.x2);
+    TEST_ASSERT_EQUAL(y2, info->clip_area.y2);
+}
+
+void setUp(void)
+{
+    lv_obj_clean(lv_scr_act());
+    lv_refr_now(NULL);
+}
+
+void tearDown(void)
+{
+    lv_obj_clean(lv_scr_act());
+}
+
+void test_occlusion_covered_obj_is_skipped_with_children(void)
+{
+    draw_info_t below;
+    draw_info_t child;
+    draw_info_t above;
+
+    lv_obj_t * obj = rect_create(lv_scr_act(), 10, 10, 100, 100, LV_OPA_COVER, &below);
+    rect_create(obj, 10, 10, 20, 20, LV_OPA_COVER, &child);
+    rect_create(lv_scr_act(), 0, 0, 200, 200, LV_OPA_COVER, &above);
+    refr();
+
+    TEST_ASSERT_EQUAL(0, below.cnt);
+    TEST_ASSERT_EQUAL(0, child.cnt);
+    TEST_ASSERT_EQUAL(1, above.cnt);
+}
+
+void test_occlusion_obj_covered_across_a_side_is_clipped(void)
+{
+    draw_info_t below;
+    draw_info_t above;
+
+    rect_create(lv_scr_act(), 10, 10, 100, 100, LV_OPA_COVER, &below);
+    rect_create(lv_scr_act(), 0, 0, 60, 200, LV_OPA_COVER, &above);
+    refr();
+
+    TEST_ASSERT_EQUAL(1, below.cnt);
+    assert_clip(&below, 60, 10, 109, 109);
+}
+
+void test_occlusion_translucent_obj_does_not_cover(void)
+{
+    draw_info_t below;
+    draw_info_t above;
+
+    rect_create(lv_scr_act(), 10, 10, 100, 100, LV_OPA_COVER, &below);
+    rect_create(lv_scr_act(), 0, 0, 200, 200, LV_OPA_50, &above);
+    refr();
+
+    TEST_ASSERT_EQUAL(1, below.cnt);
+    assert_clip(&below, 10, 10, 109, 109);
+}
+
+void test_occlusion_obj_drawn_later_is_not_culled(void)
+{
+    draw_info_t below;
+    draw_info_t above;
+
+    rect_create(lv_scr_act(), 0, 0, 200, 200, LV_OPA_COVER, &below);
+    rect_create(lv_scr_act(), 10, 10, 100, 100, LV_OPA_COVER, &above);
+    refr();
+
+    TEST_ASSERT_EQUAL(1, below.cnt);
+    TEST_ASSERT_EQUAL(1, above.cnt);
+    assert_clip(&above, 10, 10, 109, 109);
+}
+
+void test_occlusion_ancestor_of_occluder_is_drawn(void)
+{
+    draw_info_t parent;
+    draw_info_t child;
+
+    lv_obj_t * obj = rect_create(lv_scr_act(), 10, 10, 100, 100, LV_OPA_COVER, &parent);
+    rect_create(obj, 0, 0, 100, 100, LV_OPA_COVER, &child);
+    refr();
+
+    TEST_ASSERT_EQUAL(1, parent.cnt);
+    TEST_ASSERT_EQUAL(1, child.cnt);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**
+  **************************************************************************
+  * @file     host_cmsis.h
+  * @brief    host versions of the cortex-m4 intrinsics and core registers
+  *           used by the usb host classes, included before every source
+  *           of a test that needs them
+  **************************************************************************
+  * cmsis_gcc.h implements the intrinsics with arm instructions and the
+  * core registers are fixed addresses, neither works on the host. the
+  * intrinsics are replaced by macros after the device header declared
+  * them, the scb and nvic by structs the tests can check.
+  */
+#ifndef __HOST_CMSIS_H
+#define __HOST_CMSIS_H
+
+#include <stdint.h>
+#include "at32f435_437.h"
+
+/* the tests run single threaded, exclusive access always succeeds */
+#define __LDREXB(ptr)                    (*(volatile uint8_t *)(ptr))
+#define __STREXB(value, ptr)             ((*(volatile uint8_t *)(ptr) = (value)), 0U)
+#define __CLREX()                        ((void)0)
+
+/* no interrupt can preempt the code under test */
+#define __get_PRIMASK()                  0U
+#define __set_PRIMASK(mask)              ((void)(mask))
+#define __disable_irq()                  ((void)0)
+#define __enable_irq()                   ((void)0)
+
+#define __DMB()                          __sync_synchronize()
+#define __DSB()                          __sync_synchronize()
+#define __ISB()                          __sync_synchronize()
+
+static inline uint32_t host_rev16(uint32_t value)
+{
+  return ((value & 0x00FF00FFU) << 8) | ((value >> 8) & 0x00FF00FFU);
+}
+
+static inline int32_t host_sat16(int32_t value)
+{
+  return value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+}
+
+/* dual 16-bit saturating add, as qadd16 */
+static inline uint32_t host_qadd16(uint32_t op1, uint32_t op2)
+{
+  int32_t lo = host_sat16((int16_t)op1 + (int16_t)op2);
+  int32_t hi = host_sat16((int16_t)(op1 >> 16) + (int16_t)(op2 >> 16));
+
+  return ((uint32_t)lo & 0xFFFFU) | ((uint32_t)hi << 16);
+}
+
+/* dual 16-bit unsigned saturate, as usat16 */
+static inline uint32_t host_usat16(uint32_t op, uint32_t bits)
+{
+  int32_t max = (1 << bits) - 1;
+  int32_t lo = (int16_t)op, hi = (int16_t)(op >> 16);
+
+  lo = lo < 0 ? 0 : (lo > max ? max : lo);
+  hi = hi < 0 ? 0 : (hi > max ? max : hi);
+  return (uint32_t)lo | ((uint32_t)hi << 16);
+}
+
+#define __REV16(value)                   host_rev16(value)
+#define __QADD16(op1, op2)               host_qadd16(op1, op2)
+#define __USAT16(op, bits)               host_usat16(op, bits)
+#ifndef __PKHBT
+#define __PKHBT(arg1, arg2, arg3)        ((((uint32_t)(arg1)) & 0x0000FFFFUL) | \
+                                          ((((uint32_t)(arg2)) << (arg3)) & 0xFFFF0000UL))
+#endif
+
+/* core registers the tests can check */
+extern SCB_Type host_scb;
+extern NVIC_Type host_nvic;
+
+#undef SCB
+#undef NVIC
+#define SCB                              (&host_scb)
+#define NVIC                             (&host_nvic)
+
+static inline void host_nvic_set_priority(IRQn_Type irqn, uint32_t priority)
+{
+  uint8_t value = (uint8_t)(priority << (8U - __NVIC_PRIO_BITS));
+
+  if((int32_t)irqn >= 0)
+    host_nvic.IP[(uint32_t)irqn] = value;
+  else
+    host_scb.SHP[((uint32_t)irqn & 0xFU) - 4U] = value;
+}
+
+#undef NVIC_SetPriority
+#define NVIC_SetPriority(irqn, priority) host_nvic_set_priority(irqn, priority)
+
+#endif
@@ -0,0 +1,59 @@
+/**
+  **************************************************************************
+  * @file     host_periph.h
+  * @brief    host versions of the peripherals used by the lcd driver,
+  *           included before every source of a test that needs them
+  **************************************************************************
+  * the peripheral macros of the driver headers are fixed addresses. they
+  * are replaced by structs the test owns, the spi and dma driver functions
+  * the lcd driver calls are implemented by the test. the peripheral
+  * interrupts are raised from SIGVTALRM, primask blocks the signal.
+  */
+#ifndef __HOST_PERIPH_H
+#define __HOST_PERIPH_H
+
+#include <signal.h>
+#include <stddef.h>
+#include "host_cmsis.h"
+
+static inline uint32_t host_get_primask(void)
+{
+  sigset_t set;
+
+  sigprocmask(SIG_BLOCK, NULL, &set);
+  return (uint32_t)sigismember(&set, SIGVTALRM);
+}
+
+static inline void host_set_primask(uint32_t mask)
+{
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGVTALRM);
+  sigprocmask(mask ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+
+#undef __get_PRIMASK
+#undef __set_PRIMASK
+#undef __disable_irq
+#undef __enable_irq
+#define __get_PRIMASK()                  host_get_primask()
+#define __set_PRIMASK(mask)              host_set_primask(mask)
+#define __disable_irq()                  host_set_primask(1)
+#define __enable_irq()                   host_set_primask(0)
+
+extern spi_type host_spi1;
+extern gpio_type host_gpioa;
+extern gpio_type host_gpioc;
+extern dma_channel_type host_dma1_channel3;
+
+#undef SPI1
+#undef GPIOA
+#undef GPIOC
+#undef DMA1_CHANNEL3
+#define SPI1                             (&host_spi1)
+#define GPIOA                            (&host_gpioa)
+#define GPIOC                            (&host_gpioc)
+#define DMA1_CHANNEL3                    (&host_dma1_channel3)
+
+#endif
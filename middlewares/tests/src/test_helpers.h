@@ -0,0 +1,36 @@
+/**
+  **************************************************************************
+  * @file     test_helpers.h
+  * @brief    minimal assertions for the host tests of the middlewares
+  **************************************************************************
+  */
+#ifndef __TEST_HELPERS_H
+#define __TEST_HELPERS_H
+
+#include <stdio.h>
+
+static int test_failed;
+static int test_case_failed;
+
+#define TEST_ASSERT(cond)                                                   \
+  do                                                                        \
+  {                                                                         \
+    if(!(cond))                                                             \
+    {                                                                       \
+      printf("%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #cond);   \
+      test_case_failed = 1;                                                 \
+    }                                                                       \
+  } while(0)
+
+#define TEST_RUN(func)                                                      \
+  do                                                                        \
+  {                                                                         \
+    test_case_failed = 0;                                                   \
+    func();                                                                 \
+    printf("%s: %s\n", #func, test_case_failed ? "FAIL" : "PASS");          \
+    test_failed |= test_case_failed;                                        \
+  } while(0)
+
+#define TEST_RESULT()   (test_failed ? 1 : 0)
+
+#endif
@@ -0,0 +1,651 @@
+/**
+  **************************************************************************
+  * @file     test_lcd_bus.c
+  * @brief    host test and benchmark of the lcd command shadow and the
+  *           lcd dma queue
+  **************************************************************************
+  * the lcd driver runs on the host peripherals of host_periph.h. the spi
+  * driver functions feed a model of the ili9341: it decodes the commands
+  * by the dc line, keeps the window and writes the pixels to its memory,
+  * and counts the bytes and the command/data transitions on the wire. the
+  * dma channel is run by the test, every chunk ends with the transfer done
+  * interrupt of the driver. the dma takes 32-bit memory addresses, so the
+  * test is linked without pie and its buffers are below 4 GB.
+  *
+  * the benchmark draws the usual lvgl flush patterns twice, once with the
+  * register shadow and once with the shadow forgotten before every window
+  * as the driver did before it, and prints what the shadow saves.
+  */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "at32_video_ev_lcd.h"
+#include "at32_video_ev_spi.h"
+#include "test_helpers.h"
+
+#define PANEL_SIZE                       320
+#define PANEL_BLANK                      0xDEAD
+#define SPI_SCK_HZ                       36000000  /* apb2 144 mhz, SPI_MCLK_DIV_4 */
+#define DMA_TICK_US                      200       /* cpu time between dma interrupts */
+#define TEST_TIMEOUT_S                   10        /* a pool or queue leak waits forever */
+
+SCB_Type host_scb;
+NVIC_Type host_nvic;
+spi_type host_spi1;
+gpio_type host_gpioa;
+gpio_type host_gpioc;
+dma_channel_type host_dma1_channel3;
+
+void DMA1_Channel3_IRQHandler(void);
+
+/**
+  * @brief what went over the spi wire
+  */
+typedef struct
+{
+  uint32_t cmd_bytes;
+  uint32_t param_bytes;
+  uint32_t pixel_bytes;
+  uint32_t dc_edges;        //command/data transitions
+  uint32_t frame_switches;  //8-bit and 16-bit frames
+  uint32_t dma_chunks;
+  uint32_t errors;          //the panel would not show what was meant
+} bus_stats_type;
+
+/**
+  * @brief ili9341 model
+  */
+static struct
+{
+  uint8_t spi_on;
+  uint8_t frame16;
+  uint8_t dc;
+  uint8_t cmd;
+  uint8_t param[4];
+  uint8_t param_cnt;
+  uint8_t writing;
+  uint8_t pixel_hi;
+  uint8_t pixel_half;
+  uint8_t madctl;
+  uint8_t pixfmt;
+  uint16_t xs, xe, ys, ye;
+  uint16_t x, y;
+} panel;
+
+static uint16_t gram[PANEL_SIZE][PANEL_SIZE];
+static bus_stats_type bus;
+
+static uint16_t pixels[64 * 64];
+static uint8_t done_order[8];
+static uint8_t done_cnt;
+
+/* panel model --------------------------------------------------------------*/
+
+static void panel_error(const char *what)
+{
+  if(bus.errors ++ < 4)
+    printf("  panel: %s\n", what);
+}
+
+/* the dc line is set and cleared by the set and reset registers of gpioc.
+   every command sets it again after its byte, so when both were written
+   since the last frame the clear of the next command came last */
+static void panel_dc_sample(void)
+{
+  uint8_t dc = panel.dc;
+
+  if(host_gpioc.scr & LCD_DC_MASK)
+    dc = 1;
+  if(host_gpioc.clr & LCD_DC_MASK)
+    dc = 0;
+  host_gpioc.clr = 0;
+  host_gpioc.scr = 0;
+  if(dc != panel.dc)
+    bus.dc_edges ++;
+  panel.dc = dc;
+}
+
+static void panel_pixel(uint16_t color)
+{
+  if(!panel.writing || panel.y > panel.ye)
+  {
+    panel_error("pixel outside of a memory write");
+    return;
+  }
+  if(panel.x < PANEL_SIZE && panel.y < PANEL_SIZE)
+    gram[panel.y][panel.x] = color;
+  if(++ panel.x > panel.xe)
+  {
+    panel.x = panel.xs;
+    panel.y ++;
+  }
+}
+
+static void panel_command(uint8_t cmd)
+{
+  bus.cmd_bytes ++;
+  panel.cmd = cmd;
+  panel.param_cnt = 0;
+  panel.writing = (cmd == 0x2C);
+  panel.pixel_half = 0;
+  panel.x = panel.xs;
+  panel.y = panel.ys;
+}
+
+static void panel_param(uint8_t data)
+{
+  bus.param_bytes ++;
+  if(panel.param_cnt < sizeof(panel.param))
+    panel.param[panel.param_cnt ++] = data;
+
+  if(panel.cmd == 0x2A && panel.param_cnt == 4)
+  {
+    panel.xs = (panel.param[0] << 8) | panel.param[1];
+    panel.xe = (panel.param[2] << 8) | panel.param[3];
+  }
+  else if(panel.cmd == 0x2B && panel.param_cnt == 4)
+  {
+    panel.ys = (panel.param[0] << 8) | panel.param[1];
+    panel.ye = (panel.param[2] << 8) | panel.param[3];
+  }
+  else if(panel.cmd == 0x36 && panel.param_cnt == 1)
+  {
+    panel.madctl = data;
+  }
+  else if(panel.cmd == 0x3A && panel.param_cnt == 1)
+  {
+    panel.pixfmt = data;
+  }
+}
+
+static void panel_frame(uint16_t data)
+{
+  if(!panel.spi_on)
+    panel_error("frame sent with the spi off");
+  panel_dc_sample();
+
+  if(panel.frame16)
+  {
+    /* 16-bit frames are only used for pixels */
+    if(panel.dc == 0)
+      panel_error("16-bit command");
+    bus.pixel_bytes += 2;
+    panel_pixel(data);
+  }
+  else if(panel.dc == 0)
+  {
+    panel_command((uint8_t)data);
+  }
+  else if(panel.writing)
+  {
+    bus.pixel_bytes ++;
+    if(panel.pixel_half)
+      panel_pixel((panel.pixel_hi << 8) | (uint8_t)data);
+    panel.pixel_hi = (uint8_t)data;
+    panel.pixel_half ^= 1;
+  }
+  else
+  {
+    panel_param((uint8_t)data);
+  }
+}
+
+/* spi and dma drivers ------------------------------------------------------*/
+
+flag_status spi_i2s_flag_get(spi_type *spi_x, uint32_t spi_i2s_flag)
+{
+  /* the frames leave at once, the spi is never busy */
+  return (spi_i2s_flag == SPI_I2S_BF_FLAG) ? RESET : SET;
+}
+
+void spi_i2s_data_transmit(spi_type *spi_x, uint16_t tx_data)
+{
+  panel_frame(tx_data);
+}
+
+void spi_enable(spi_type *spi_x, confirm_state new_state)
+{
+  panel.spi_on = (new_state == TRUE);
+}
+
+void spi_frame_bit_num_set(spi_type *spi_x, spi_frame_bit_num_type bit_num)
+{
+  uint8_t frame16 = (bit_num == SPI_FRAME_16BIT);
+
+  if(panel.spi_on)
+    panel_error("frame size changed with the spi on");
+  if(frame16 != panel.frame16)
+    bus.frame_switches ++;
+  panel.frame16 = frame16;
+}
+
+void dma_flag_clear(uint32_t dmax_flag)
+{
+}
+
+void lcd_spi1_write(uint8_t data)
+{
+  spi_i2s_data_transmit(LCD_SPI_SELECTED, data);
+}
+
+void lcd_hw_init(void)
+{
+  panel.spi_on = 1;
+}
+
+void delay_ms(uint16_t nms)
+{
+}
+
+/* send the queued windows, a chunk at a time as the spi requests them */
+static void dma_run(void)
+{
+  dma_channel_type *ch = &host_dma1_channel3;
+  const uint16_t *src;
+  uint32_t beat;
+
+  while(ch->ctrl_bit.chen)
+  {
+    src = (const uint16_t *)(uintptr_t)ch->maddr;
+    bus.dma_chunks ++;
+    if(!panel.frame16)
+      panel_error("dma in 8-bit frames");
+    for(beat = 0; beat < ch->dtcnt; beat ++)
+      panel_frame(ch->ctrl_bit.mincm ? src[beat] : src[0]);
+    ch->dtcnt = 0;
+    DMA1_Channel3_IRQHandler();
+  }
+}
+
+/* the transfer done interrupt on its own, for the driver waiting for a
+   queue slot or pool pixels. a chunk started outside of the interrupt
+   ends a tick after it was seen, when the driver is done starting it */
+static void dma_irq(int sig)
+{
+  static uint8_t seen;
+
+  if(!host_dma1_channel3.ctrl_bit.chen)
+  {
+    seen = 0;
+  }
+  else if(!seen)
+  {
+    seen = 1;
+  }
+  else
+  {
+    seen = 0;
+    dma_run();
+  }
+}
+
+/* while enabled only the interrupt may run the dma */
+static void dma_irq_enable(uint8_t on)
+{
+  struct itimerval tick;
+
+  memset(&tick, 0, sizeof(tick));
+  if(on)
+  {
+    tick.it_interval.tv_usec = DMA_TICK_US;
+    tick.it_value.tv_usec = DMA_TICK_US;
+  }
+  signal(SIGVTALRM, dma_irq);
+  setitimer(ITIMER_VIRTUAL, &tick, NULL);
+}
+
+static void bus_reset(void)
+{
+  uint16_t x, y;
+
+  dma_run();
+  for(y = 0; y < PANEL_SIZE; y ++)
+    for(x = 0; x < PANEL_SIZE; x ++)
+      gram[y][x] = PANEL_BLANK;
+  memset(&bus, 0, sizeof(bus));
+  lcd_reset_bus_stats();
+}
+
+/* checks -------------------------------------------------------------------*/
+
+static uint32_t gram_count(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye, uint16_t color)
+{
+  uint32_t cnt = 0;
+  uint16_t x, y;
+
+  for(y = ys; y <= ye; y ++)
+    for(x = xs; x <= xe; x ++)
+      cnt += (gram[y][x] == color);
+  return cnt;
+}
+
+static uint32_t gram_count_all(uint16_t color)
+{
+  return gram_count(0, 0, PANEL_SIZE - 1, PANEL_SIZE - 1, color);
+}
+
+static uint8_t glyph_bit(uint8_t ch, uint8_t size, uint8_t col, uint8_t row)
+{
+  uint8_t col_bytes = size / 8 + ((size % 8) ? 1 : 0);
+  uint8_t idx = col * col_bytes + row / 8;
+  uint8_t bits;
+
+  if(size == 16)
+    bits = asc2_1608[ch - ' '][idx];
+  else
+    bits = asc2_2412[ch - ' '][idx];
+  return (bits & (0x80 >> (row % 8))) != 0;
+}
+
+static void done_record(void *user)
+{
+  if(done_cnt < sizeof(done_order))
+    done_order[done_cnt] = (uint8_t)(uintptr_t)user;
+  done_cnt ++;
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static void test_init_sequence(void)
+{
+  TEST_ASSERT(bus.errors == 0);
+  TEST_ASSERT(panel.madctl == 0x08);
+  TEST_ASSERT(panel.pixfmt == 0x55);
+  TEST_ASSERT(lcddev.width == 240 && lcddev.height == 320);
+  TEST_ASSERT(!panel.frame16 && panel.spi_on);
+}
+
+static void test_window_lands_on_the_panel(void)
+{
+  uint16_t x, y;
+  uint32_t bad = 0;
+
+  bus_reset();
+  for(x = 0; x < 8 * 4; x ++)
+    pixels[x] = 0x1000 + x;
+
+  /* 5 x 3 window out of rows of 8 pixels */
+  lcd_dma_submit(10, 20, 14, 22, pixels, 8, NULL, NULL);
+  dma_run();
+  for(y = 0; y < 3; y ++)
+    for(x = 0; x < 5; x ++)
+      bad += (gram[20 + y][10 + x] != 0x1000 + y * 8 + x);
+  TEST_ASSERT(bad == 0);
+  TEST_ASSERT(gram_count_all(PANEL_BLANK) == PANEL_SIZE * PANEL_SIZE - 15);
+  TEST_ASSERT(bus.dma_chunks == 3);
+
+  /* packed rows go as one chunk */
+  lcd_dma_submit(100, 200, 103, 201, pixels, 0, NULL, NULL);
+  dma_run();
+  for(y = 0; y < 2; y ++)
+    for(x = 0; x < 4; x ++)
+      bad += (gram[200 + y][100 + x] != 0x1000 + y * 4 + x);
+  TEST_ASSERT(bad == 0);
+  TEST_ASSERT(bus.dma_chunks == 4);
+  TEST_ASSERT(!panel.frame16);
+  TEST_ASSERT(bus.errors == 0);
+}
+
+static void test_big_fill_is_chained(void)
+{
+  bus_reset();
+  lcd_clear(RED);
+  dma_run();
+  TEST_ASSERT(gram_count(0, 0, LCD_WIDTH - 1, LCD_HEIGHT - 1, RED) == LCD_WIDTH * LCD_HEIGHT);
+  TEST_ASSERT(bus.dma_chunks == (LCD_WIDTH * LCD_HEIGHT + LCD_DMA_MAX_BEATS - 1) / LCD_DMA_MAX_BEATS);
+  TEST_ASSERT(bus.pixel_bytes == LCD_WIDTH * LCD_HEIGHT * 2);
+  TEST_ASSERT(bus.errors == 0);
+}
+
+static void test_shadow_skips_unchanged_commands(void)
+{
+  lcd_bus_stats_struct stats;
+
+  lcd_shadow_reset();
+  lcd_scan_dir(0);
+  lcd_set_pixel_format(0x55);
+  bus_reset();
+  lcd_dma_fill(0, 0, 239, 31, BLUE, NULL, NULL);
+  dma_run();
+  TEST_ASSERT(bus.cmd_bytes == 3 && bus.param_bytes == 8);
+
+  /* the next strip only moves the rows */
+  lcd_dma_fill(0, 32, 239, 63, GREEN, NULL, NULL);
+  dma_run();
+  TEST_ASSERT(bus.cmd_bytes == 5 && bus.param_bytes == 12);
+  TEST_ASSERT(gram_count(0, 32, 239, 63, GREEN) == 240 * 32);
+
+  /* the same window again only restarts the memory write */
+  lcd_dma_fill(0, 32, 239, 63, BLUE, NULL, NULL);
+  dma_run();
+  TEST_ASSERT(bus.cmd_bytes == 6 && bus.param_bytes == 12);
+  TEST_ASSERT(gram_count(0, 32, 239, 63, BLUE) == 240 * 32);
+  lcd_get_bus_stats(&stats);
+  TEST_ASSERT(stats.skip_cnt == 3);
+  TEST_ASSERT(stats.cmd_cnt == bus.cmd_bytes && stats.param_cnt == bus.param_bytes);
+
+  /* the scan direction and the pixel format stay */
+  lcd_scan_dir(0);
+  lcd_set_pixel_format(0x55);
+  TEST_ASSERT(bus.cmd_bytes == 6);
+
+  /* the cursor leaves the window end unknown */
+  lcd_set_cursor(5, 5);
+  lcd_dma_fill(0, 32, 239, 63, GREEN, NULL, NULL);
+  dma_run();
+  TEST_ASSERT(bus.cmd_bytes == 6 + 3 + 3);
+  TEST_ASSERT(gram_count(0, 32, 239, 63, GREEN) == 240 * 32);
+
+  /* a forgotten shadow sends everything */
+  lcd_shadow_reset();
+  lcd_scan_dir(0);
+  TEST_ASSERT(bus.cmd_bytes == 13 && panel.madctl == 0x08);
+  TEST_ASSERT(bus.errors == 0);
+}
+
+static void test_glyphs_use_the_pool(void)
+{
+  uint16_t col, row, n;
+  uint32_t bad = 0;
+
+  bus_reset();
+  point_color = BLACK;
+  back_color = WHITE;
+
+  /* an opaque glyph is one window of the pool */
+  lcd_show_char(30, 40, 'A', 16, 0);
+  dma_run();
+  for(row = 0; row < 16; row ++)
+    for(col = 0; col < 8; col ++)
+      bad += (gram[40 + row][30 + col] != (glyph_bit('A', 16, col, row) ? BLACK : WHITE));
+  TEST_ASSERT(bad == 0);
+  TEST_ASSERT(bus.cmd_bytes == 3 && gram_count_all(PANEL_BLANK) == PANEL_SIZE * PANEL_SIZE - 16 * 8);
+
+  /* a transparent glyph only sets its strokes, its runs are more than the
+     queue holds and the driver waits for the interrupt to free slots */
+  dma_irq_enable(1);
+  lcd_show_char(60, 40, '#', 24, 1);
+  lcd_dma_wait();
+  for(row = 0; row < 24; row ++)
+    for(col = 0; col < 12; col ++)
+      bad += (gram[40 + row][60 + col] != (glyph_bit('#', 24, col, row) ? BLACK : PANEL_BLANK));
+  TEST_ASSERT(bad == 0);
+
+  /* glyphs queued back to back go round the pool many times, the driver
+     waits for the interrupt to give pixels back */
+  for(n = 0; n < 60; n ++)
+    lcd_show_char((n % 20) * 12, 100 + n / 20 * 24, '0' + n % 10, 24, 0);
+  lcd_dma_wait();
+  dma_irq_enable(0);
+  for(n = 0; n < 60; n ++)
+  {
+    for(row = 0; row < 24; row ++)
+      for(col = 0; col < 12; col ++)
+        bad += (gram[100 + n / 20 * 24 + row][(n % 20) * 12 + col] !=
+                (glyph_bit('0' + n % 10, 24, col, row) ? BLACK : WHITE));
+  }
+  TEST_ASSERT(bad == 0);
+
+  /* a glyph clipped by the right edge keeps its stride */
+  lcd_show_char(236, 0, 'W', 16, 0);
+  dma_run();
+  for(row = 0; row < 16; row ++)
+    for(col = 0; col < 4; col ++)
+      bad += (gram[row][236 + col] != (glyph_bit('W', 16, col, row) ? BLACK : WHITE));
+  TEST_ASSERT(bad == 0);
+  TEST_ASSERT(gram_count(240, 0, PANEL_SIZE - 1, 15, PANEL_BLANK) == (PANEL_SIZE - 240) * 16);
+  TEST_ASSERT(bus.errors == 0);
+}
+
+static void test_done_in_queue_order(void)
+{
+  bus_reset();
+  done_cnt = 0;
+
+  lcd_dma_fill(0, 0, 9, 9, RED, done_record, (void *)1);
+  lcd_dma_fill(0, 0, 9, 9, GREEN, NULL, NULL);
+  lcd_dma_submit(20, 0, 27, 3, pixels, 0, done_record, (void *)2);
+  lcd_dma_fill(0, 10, 9, 10, BLUE, done_record, (void *)3);
+  TEST_ASSERT(done_cnt == 0);
+  TEST_ASSERT(lcd_dma_busy());
+  dma_run();
+  TEST_ASSERT(!lcd_dma_busy());
+  TEST_ASSERT(done_cnt == 3);
+  TEST_ASSERT(done_order[0] == 1 && done_order[1] == 2 && done_order[2] == 3);
+  TEST_ASSERT(gram_count(0, 0, 9, 9, GREEN) == 100);
+
+  /* an empty window is done at once and sends nothing */
+  lcd_dma_submit(5, 5, 4, 5, pixels, 0, done_record, (void *)4);
+  TEST_ASSERT(done_cnt == 4 && done_order[3] == 4);
+  TEST_ASSERT(!lcd_dma_busy());
+  TEST_ASSERT(bus.errors == 0);
+}
+
+/* benchmark ----------------------------------------------------------------*/
+
+static uint8_t bench_no_shadow;
+
+/* a window as disp_flush sends it, the driver before the shadow sent the
+   whole window every time */
+static void bench_window(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye)
+{
+  if(bench_no_shadow)
+    lcd_shadow_reset();
+  lcd_dma_submit(xs, ys, xe, ye, pixels, 0, NULL, NULL);
+  dma_run();
+}
+
+/* full screen refresh in strips of 240 x 16 */
+static void bench_full_refresh(void)
+{
+  uint16_t y;
+
+  for(y = 0; y < LCD_HEIGHT; y += 16)
+    bench_window(0, y, LCD_WIDTH - 1, y + 15);
+}
+
+/* two labels that change in turn */
+static void bench_labels(void)
+{
+  uint16_t n;
+
+  for(n = 0; n < 10; n ++)
+  {
+    bench_window(20, 100, 115, 115);
+    bench_window(150, 200, 213, 223);
+  }
+}
+
+/* full screen refresh around a 160 x 120 video, the strips are split in
+   the bands left and right of the video */
+static void bench_video_bands(void)
+{
+  uint16_t y;
+
+  for(y = 0; y < LCD_HEIGHT; y += 16)
+  {
+    if((y + 15 < 100) || (y >= 220))
+    {
+      bench_window(0, y, LCD_WIDTH - 1, y + 15);
+    }
+    else
+    {
+      bench_window(0, y, 39, y + 15);
+      bench_window(200, y, LCD_WIDTH - 1, y + 15);
+    }
+  }
+}
+
+/* a line of 20 glyphs of 16 points */
+static void bench_text(void)
+{
+  uint16_t n;
+
+  for(n = 0; n < 20; n ++)
+  {
+    if(bench_no_shadow)
+      lcd_shadow_reset();
+    lcd_show_char(n * 8, 60, 'a' + n, 16, 0);
+    dma_run();
+  }
+}
+
+static void bench_run(const char *name, void (*draw)(void))
+{
+  bus_stats_type with[2];
+  uint32_t cmd_bytes[2], total[2];
+  uint8_t idx;
+
+  for(idx = 0; idx < 2; idx ++)
+  {
+    bench_no_shadow = (idx == 0);
+    bus_reset();
+    lcd_shadow_reset();
+    draw();
+    with[idx] = bus;
+    cmd_bytes[idx] = bus.cmd_bytes + bus.param_bytes;
+    total[idx] = cmd_bytes[idx] + bus.pixel_bytes;
+    TEST_ASSERT(bus.errors == 0);
+  }
+
+  printf("  %-26s %6d pixel bytes\n", name, with[0].pixel_bytes);
+  for(idx = 0; idx < 2; idx ++)
+  {
+    printf("    %-14s %4d commands %5d command bytes %4d dc edges %4d frame switches  %7.1f us\n",
+           idx ? "shadow" : "no shadow", with[idx].cmd_bytes, cmd_bytes[idx], with[idx].dc_edges,
+           with[idx].frame_switches, total[idx] * 8 * 1e6 / SPI_SCK_HZ);
+  }
+  printf("    saves %d command bytes, %.1f%% of the command bytes, %.2f%% of the bus time\n",
+         cmd_bytes[0] - cmd_bytes[1], 100.0 * (cmd_bytes[0] - cmd_bytes[1]) / cmd_bytes[0],
+         100.0 * (total[0] - total[1]) / total[0]);
+  TEST_ASSERT(with[0].pixel_bytes == with[1].pixel_bytes);
+  TEST_ASSERT(cmd_bytes[1] <= cmd_bytes[0]);
+}
+
+int main(void)
+{
+  alarm(TEST_TIMEOUT_S);
+  if((uint64_t)(uintptr_t)pixels >> 32)
+  {
+    printf("the test buffers are above 4 GB, link the test without pie\n");
+    return 1;
+  }
+
+  lcd_init();
+  TEST_RUN(test_init_sequence);
+  TEST_RUN(test_window_lands_on_the_panel);
+  TEST_RUN(test_big_fill_is_chained);
+  TEST_RUN(test_shadow_skips_unchanged_commands);
+  TEST_RUN(test_glyphs_use_the_pool);
+  TEST_RUN(test_done_in_queue_order);
+
+  printf("lcd command bus, spi at %d mhz\n", SPI_SCK_HZ / 1000000);
+  test_case_failed = 0;
+  bench_run("full refresh, 16 rows", bench_full_refresh);
+  bench_run("two labels, 10 times", bench_labels);
+  bench_run("bands around a video", bench_video_bands);
+  bench_run("20 glyphs in a line", bench_text);
+  test_failed |= test_case_failed;
+  return TEST_RESULT();
+}
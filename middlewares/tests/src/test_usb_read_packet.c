@@ -0,0 +1,188 @@
+/**
+  **************************************************************************
+  * @file     test_usb_read_packet.c
+  * @brief    host test of usb_read_packet against an emulated rx fifo
+  **************************************************************************
+  * the driver reads the fifo through a 32-bit register address, so the
+  * register block is mapped below 4 GB (MAP_32BIT, x86-64 linux). every
+  * load from the fifo page faults, the handler puts the next fifo word
+  * there and single steps the load, the trap handler closes the page
+  * again. this gives the pop-on-read behaviour of the hardware and counts
+  * the pops.
+  *
+  * the benchmark opens the fifo page and times the current read against
+  * the word loop it replaced, in host cycles. every fifo load is a cache
+  * hit here while on the mcu it is a bus access, so the numbers compare
+  * the loop and store overhead of the two reads, not the mcu cycles.
+  */
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "at32f435_437.h"
+#include "test_helpers.h"
+
+#define PAGE_SIZE                        0x1000
+#define MAX_PACKET                       256
+#define MAX_BENCH_PACKET                 1024
+#define GUARD_BYTE                       0xEE
+#define X86_EFLAGS_TF                    0x100
+#define BENCH_RUNS                       2000
+
+static uint8_t *regs;
+static volatile uint32_t *fifo_word;
+static uint8_t stream[MAX_PACKET + 4];
+static volatile uint32_t fifo_pops;
+
+static void fifo_segv(int sig, siginfo_t *info, void *ctx)
+{
+  ucontext_t *uc = (ucontext_t *)ctx;
+  uint32_t word;
+
+  if((uint8_t *)info->si_addr < regs + PAGE_SIZE || (uint8_t *)info->si_addr >= regs + 2 * PAGE_SIZE)
+  {
+    signal(SIGSEGV, SIG_DFL);
+    return;
+  }
+  memcpy(&word, &stream[fifo_pops * 4], 4);
+  fifo_pops ++;
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_READ | PROT_WRITE);
+  *fifo_word = word;
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_READ);
+  uc->uc_mcontext.gregs[REG_EFL] |= X86_EFLAGS_TF;
+}
+
+static void fifo_trap(int sig, siginfo_t *info, void *ctx)
+{
+  ucontext_t *uc = (ucontext_t *)ctx;
+
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_NONE);
+  uc->uc_mcontext.gregs[REG_EFL] &= ~X86_EFLAGS_TF;
+}
+
+static int fifo_setup(void)
+{
+  struct sigaction sa;
+
+  regs = mmap(NULL, 2 * PAGE_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  if(regs == MAP_FAILED)
+    return -1;
+  fifo_word = &USB_FIFO((otg_global_type *)regs, 0);
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_NONE);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_flags = SA_SIGINFO;
+  sa.sa_sigaction = fifo_segv;
+  sigaction(SIGSEGV, &sa, NULL);
+  sa.sa_sigaction = fifo_trap;
+  sigaction(SIGTRAP, &sa, NULL);
+  return 0;
+}
+
+static void test_every_length_and_offset(void)
+{
+  static uint8_t buf[MAX_PACKET + 16];
+  uint32_t len, ofs, i;
+  int bad = 0;
+
+  for(i = 0; i < sizeof(stream); i ++)
+    stream[i] = (uint8_t)(i * 7 + 3);
+
+  for(ofs = 0; ofs < 4; ofs ++)
+  {
+    for(len = 0; len <= MAX_PACKET; len ++)
+    {
+      memset(buf, GUARD_BYTE, sizeof(buf));
+      fifo_pops = 0;
+      usb_read_packet((otg_global_type *)regs, buf + 4 + ofs, 0, len);
+
+      /* same bytes, one pop per started word, nothing written around the packet */
+      if(memcmp(buf + 4 + ofs, stream, len) != 0 || fifo_pops != (len + 3) / 4)
+        bad = 1;
+      for(i = 0; i < 4 + ofs; i ++)
+        if(buf[i] != GUARD_BYTE)
+          bad = 1;
+      for(i = 4 + ofs + len; i < sizeof(buf); i ++)
+        if(buf[i] != GUARD_BYTE)
+          bad = 1;
+      if(bad)
+      {
+        printf("  len %u offset %u: %u pops\n", len, ofs, fifo_pops);
+        TEST_ASSERT(!bad);
+        return;
+      }
+    }
+  }
+}
+
+/* usb_read_packet before the aligned and tail paths, every word with an
+   unaligned store and the last one written whole */
+static void usb_read_packet_old(otg_global_type *usbx, uint8_t *pusr_buf, uint16_t num, uint16_t nbytes)
+{
+  uint32_t n_index;
+  uint32_t nhbytes = (nbytes + 3) / 4;
+  uint32_t *pbuf = (uint32_t *)pusr_buf;
+  for(n_index = 0; n_index < nhbytes; n_index ++)
+  {
+    __UNALIGNED_UINT32_WRITE(pbuf, (USB_FIFO(usbx, 0)));
+    pbuf ++;
+  }
+}
+
+/* fewest cycles of a read out of BENCH_RUNS */
+static uint64_t bench_read(void (*read)(otg_global_type *, uint8_t *, uint16_t, uint16_t),
+                           uint8_t *buf, uint16_t len)
+{
+  uint64_t best = ~0ULL, start, cycles;
+  uint32_t run;
+
+  for(run = 0; run < BENCH_RUNS; run ++)
+  {
+    start = __rdtsc();
+    read((otg_global_type *)regs, buf, 0, len);
+    cycles = __rdtsc() - start;
+    if(cycles < best)
+      best = cycles;
+  }
+  return best;
+}
+
+static void bench_read_packet(void)
+{
+  static const uint16_t lens[] = {8, 64, 188, 512, 1020, 1023};
+  static uint32_t buf[MAX_BENCH_PACKET / 4 + 2];
+  uint64_t old_cyc, new_cyc;
+  uint32_t idx, ofs;
+
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_READ | PROT_WRITE);
+  *fifo_word = 0x5A5AA5A5;
+  printf("rx fifo read, fewest host cycles of %d reads\n", BENCH_RUNS);
+  for(ofs = 0; ofs < 2; ofs ++)
+  {
+    for(idx = 0; idx < sizeof(lens) / sizeof(lens[0]); idx ++)
+    {
+      old_cyc = bench_read(usb_read_packet_old, (uint8_t *)buf + ofs, lens[idx]);
+      new_cyc = bench_read(usb_read_packet, (uint8_t *)buf + ofs, lens[idx]);
+      printf("  %4d bytes %-9s  old %5d  new %5d  %.2fx\n", lens[idx], ofs ? "unaligned" : "aligned",
+             (int)old_cyc, (int)new_cyc, (double)old_cyc / new_cyc);
+    }
+  }
+  mprotect(regs + PAGE_SIZE, PAGE_SIZE, PROT_NONE);
+}
+
+int main(void)
+{
+  if(fifo_setup() != 0)
+  {
+    printf("no low mapping for the registers, skipped\n");
+    return 0;
+  }
+  TEST_RUN(test_every_length_and_offset);
+  bench_read_packet();
+  return TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+/**
+  **************************************************************************
+  * @file     test_usbh_cfg_parse.c
+  * @brief    host test of the configuration descriptor parser and the
+  *           interface alternate setting index
+  **************************************************************************
+  * the configurations are built like the ones of a video camera, with a
+  * streaming interface of many alternate settings that runs past the
+  * 512 bytes of a control buffer. the parser gets the buffer at the end of
+  * a page followed by a closed page, so reading behind it faults.
+  */
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "usbh_core.h"
+#include "usbh_ctrl.h"
+#include "test_helpers.h"
+
+#define VS_ALT_NUM                       60    /* alternate settings of the streaming interface */
+
+uint8_t usbh_cfg_buffer[USBH_MAX_CFG_DESC_LEN];
+
+static usbh_core_type host;
+static uint8_t *guard_page;
+static long page_size;
+
+/* usb host core stubs ------------------------------------------------------*/
+
+usb_sts_type usbh_in_out_request(usbh_core_type *uhost, uint8_t hc_num)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_ctrl_result_check(usbh_core_type *uhost, ctrl_ept0_sts_type next_ctrl_state, uint8_t next_enum_state)
+{
+  return USB_OK;
+}
+
+/* descriptor builder -------------------------------------------------------*/
+
+static uint16_t put_interface(uint8_t *buf, uint16_t len, uint8_t itf, uint8_t alt,
+                              uint8_t ept_num, uint8_t sub_class)
+{
+  uint8_t *p = buf + len;
+
+  p[0] = USB_DEVICE_IF_DESC_LEN;
+  p[1] = USB_DESCIPTOR_TYPE_INTERFACE;
+  p[2] = itf;
+  p[3] = alt;
+  p[4] = ept_num;
+  p[5] = 0x0E;
+  p[6] = sub_class;
+  p[7] = 0;
+  p[8] = 0;
+  return len + USB_DEVICE_IF_DESC_LEN;
+}
+
+static uint16_t put_endpoint(uint8_t *buf, uint16_t len, uint8_t addr, uint16_t wmax)
+{
+  uint8_t *p = buf + len;
+
+  p[0] = USB_DEVICE_EPT_LEN;
+  p[1] = USB_DESCIPTOR_TYPE_ENDPOINT;
+  p[2] = addr;
+  p[3] = 0x05;
+  p[4] = (uint8_t)wmax;
+  p[5] = (uint8_t)(wmax >> 8);
+  p[6] = 1;
+  return len + USB_DEVICE_EPT_LEN;
+}
+
+static void put_config(uint8_t *buf, uint16_t total)
+{
+  buf[0] = USB_DEVICE_CFG_DESC_LEN;
+  buf[1] = USB_DESCIPTOR_TYPE_CONFIGURATION;
+  buf[2] = (uint8_t)total;
+  buf[3] = (uint8_t)(total >> 8);
+  buf[4] = 2;
+  buf[5] = 1;
+  buf[6] = 0;
+  buf[7] = 0x80;
+  buf[8] = 50;
+}
+
+/* a video control interface and a streaming interface of VS_ALT_NUM
+   alternate settings, the ones above 0 with an iso endpoint */
+static uint16_t build_camera(uint8_t *buf)
+{
+  uint16_t len = USB_DEVICE_CFG_DESC_LEN;
+  uint8_t alt;
+
+  len = put_interface(buf, len, 0, 0, 0, 1);
+  len = put_interface(buf, len, 1, 0, 0, 2);
+  for(alt = 1; alt < VS_ALT_NUM; alt ++)
+  {
+    len = put_interface(buf, len, 1, alt, 1, 2);
+    len = put_endpoint(buf, len, 0x81, alt * 16);
+  }
+  put_config(buf, len);
+  return len;
+}
+
+/* copy a descriptor to the end of the page before the closed one */
+static uint8_t *at_page_end(const uint8_t *desc, uint16_t len)
+{
+  uint8_t *buf = guard_page - len;
+
+  memcpy(buf, desc, len);
+  return buf;
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static void test_long_config_indexes_every_alt(void)
+{
+  usb_itf_index_type *index = &host.dev.cfg_desc.index;
+  uint16_t len, alt_idx, alt_len;
+  uint8_t *alt_desc;
+
+  len = build_camera(usbh_cfg_buffer);
+  TEST_ASSERT(len > USB_MAX_DATA_LENGTH);
+
+  usbh_parse_configure_desc(&host, usbh_cfg_buffer, USBH_MAX_CFG_DESC_LEN);
+  TEST_ASSERT(index->alt_num == VS_ALT_NUM + 1);
+  TEST_ASSERT(index->itf_alt_num[1] == VS_ALT_NUM);
+
+  /* the last alternate setting lies behind the first 512 bytes */
+  alt_idx = usbh_find_interface_alt(&host, 1, VS_ALT_NUM - 1);
+  TEST_ASSERT(alt_idx == VS_ALT_NUM);
+  TEST_ASSERT(index->alt[alt_idx].offset > USB_MAX_DATA_LENGTH);
+  alt_desc = usbh_get_interface_alt_desc(&host, alt_idx, &alt_len);
+  TEST_ASSERT(alt_len == USB_DEVICE_IF_DESC_LEN + USB_DEVICE_EPT_LEN);
+  TEST_ASSERT(alt_desc[9 + 4] == (uint8_t)((VS_ALT_NUM - 1) * 16));
+  TEST_ASSERT(usbh_find_interface_alt(&host, 1, VS_ALT_NUM) == USBH_ITF_ALT_NONE);
+}
+
+static void test_zero_length_descriptor_stops(void)
+{
+  static uint8_t desc[256];
+  usb_itf_index_type *index = &host.dev.cfg_desc.index;
+  uint16_t len = USB_DEVICE_CFG_DESC_LEN;
+
+  len = put_interface(desc, len, 0, 0, 0, 1);
+  len = put_interface(desc, len, 1, 0, 0, 2);
+  /* a broken descriptor of length 0, then one that is never reached */
+  desc[len] = 0;
+  desc[len + 1] = 0x24;
+  len += 2;
+  len = put_interface(desc, len, 1, 1, 0, 2);
+  put_config(desc, len);
+
+  usbh_parse_configure_desc(&host, at_page_end(desc, len), len);
+  TEST_ASSERT(index->alt_num == 2);
+}
+
+static void test_no_read_behind_buffer(void)
+{
+  static uint8_t desc[256];
+  usb_itf_index_type *index = &host.dev.cfg_desc.index;
+  uint16_t len = USB_DEVICE_CFG_DESC_LEN;
+
+  /* wTotalLength ends exactly on the last descriptor */
+  len = put_interface(desc, len, 0, 0, 0, 1);
+  len = put_interface(desc, len, 1, 1, 1, 2);
+  len = put_endpoint(desc, len, 0x81, 512);
+  put_config(desc, len);
+  usbh_parse_configure_desc(&host, at_page_end(desc, len), len);
+  TEST_ASSERT(index->alt_num == 2);
+  TEST_ASSERT(host.dev.cfg_desc.interface[1].endpoint[0].wMaxPacketSize == 512);
+
+  /* a single byte of a header is left at the end */
+  desc[len] = USB_DEVICE_IF_DESC_LEN;
+  len ++;
+  put_config(desc, len);
+  usbh_parse_configure_desc(&host, at_page_end(desc, len), len);
+  TEST_ASSERT(index->alt_num == 2);
+
+  /* a descriptor that claims more than the configuration holds */
+  len = put_interface(desc, len - 1, 2, 0, 0, 2) - 3;
+  put_config(desc, len);
+  usbh_parse_configure_desc(&host, at_page_end(desc, len), len);
+  TEST_ASSERT(index->alt_num == 2);
+}
+
+int main(void)
+{
+  uint8_t *pages;
+
+  page_size = sysconf(_SC_PAGESIZE);
+  pages = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(pages == MAP_FAILED)
+  {
+    printf("no memory for the guard page\n");
+    return 1;
+  }
+  guard_page = pages + page_size;
+  mprotect(guard_page, page_size, PROT_NONE);
+
+  TEST_RUN(test_long_config_indexes_every_alt);
+  TEST_RUN(test_zero_length_descriptor_stops);
+  TEST_RUN(test_no_read_behind_buffer);
+  return TEST_RESULT();
+}
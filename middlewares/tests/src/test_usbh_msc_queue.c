@@ -0,0 +1,384 @@
+/**
+  **************************************************************************
+  * @file     test_usbh_msc_queue.c
+  * @brief    host test of the usb msc request queue against a ram disk
+  **************************************************************************
+  * the bulk-only layer is replaced by a test double that runs every
+  * read10/write10 on a ram disk after a few process steps, so the queue,
+  * the merging, the write-behind buffer and the read-ahead window of
+  * usbh_msc_class.c run unchanged. besides checking the data, the test
+  * prints the commands it took and the throughput they would give on a
+  * full speed bus.
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usbh_msc_class.h"
+#include "test_helpers.h"
+
+#define DISK_BLOCKS                      1024
+#define FAKE_BOT_STEPS                   3     /* process steps per command */
+
+/* full speed bulk: about 19 packets of 64 bytes per 1 ms frame, and one
+   frame each for the cbw and the csw */
+#define FS_BULK_BYTES_PER_MS             1216
+#define FS_CMD_OVERHEAD_MS               2
+
+static uint8_t disk[DISK_BLOCKS * USBH_MSC_BLOCK_SIZE];
+static uint8_t src[256 * USBH_MSC_BLOCK_SIZE];
+static uint8_t dst[256 * USBH_MSC_BLOCK_SIZE];
+
+static struct
+{
+  uint32_t busy;
+  uint32_t cmds;
+  uint32_t rd_cmds;
+  uint32_t wr_cmds;
+  uint32_t blocks;
+  uint32_t max_blocks;
+} bot;
+
+static uint32_t done_cnt;
+static uint32_t fail_cnt;
+
+static usbh_core_type host;
+static usbh_class_handler_type class_handler;
+static usbh_user_handler_type user_handler;
+
+/* bulk-only test double ----------------------------------------------------*/
+
+static usb_sts_type fake_rw(uint32_t lba, uint8_t *data, uint32_t count, uint8_t write)
+{
+  if(bot.busy == 0)
+  {
+    bot.busy = FAKE_BOT_STEPS;
+    bot.cmds ++;
+    bot.blocks += count;
+    if(count > bot.max_blocks)
+      bot.max_blocks = count;
+    if(write)
+      bot.wr_cmds ++;
+    else
+      bot.rd_cmds ++;
+    return USB_WAIT;
+  }
+  if(-- bot.busy)
+    return USB_WAIT;
+
+  if(lba + count > DISK_BLOCKS)
+    return USB_FAIL;
+  if(write)
+    memcpy(&disk[lba * USBH_MSC_BLOCK_SIZE], data, count * USBH_MSC_BLOCK_SIZE);
+  else
+    memcpy(data, &disk[lba * USBH_MSC_BLOCK_SIZE], count * USBH_MSC_BLOCK_SIZE);
+  return USB_OK;
+}
+
+usb_sts_type usbh_msc_bot_scsi_write(void *uhost, msc_bot_trans_type *bot_trans,
+                                     uint32_t address, uint8_t *write_data,
+                                     uint32_t write_len, uint8_t lun)
+{
+  return fake_rw(address, write_data, write_len, 1);
+}
+
+usb_sts_type usbh_msc_bot_scsi_read(void *uhost, msc_bot_trans_type *bot_trans,
+                                    uint32_t address, uint8_t *read_data,
+                                    uint32_t read_len, uint8_t lun)
+{
+  return fake_rw(address, read_data, read_len, 0);
+}
+
+usb_sts_type usbh_msc_bot_scsi_get_inquiry(void *uhost, msc_bot_trans_type *bot_trans,
+                                           uint8_t lun, msc_scsi_data_inquiry *inquiry)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_msc_bot_scsi_capacity(void *uhost, msc_bot_trans_type *bot_trans,
+                                        uint8_t lun, msc_scsi_data_capacity *capacity)
+{
+  capacity->blk_nbr = DISK_BLOCKS - 1;
+  capacity->blk_size = USBH_MSC_BLOCK_SIZE;
+  return USB_OK;
+}
+
+usb_sts_type usbh_msc_bot_scsi_test_unit_ready(void *uhost, msc_bot_trans_type *bot_trans,
+                                               uint8_t lun)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_msc_bot_scsi_request_sense(void *uhost, msc_bot_trans_type *bot_trans,
+                                             uint8_t lun)
+{
+  return USB_OK;
+}
+
+usb_sts_type msc_bot_scsi_init(usbh_msc_type *msc_struct)
+{
+  msc_struct->state = USBH_MSC_INIT;
+  msc_struct->cur_lun = 0;
+  msc_struct->error = MSC_OK;
+  return USB_OK;
+}
+
+/* usb host core stubs ------------------------------------------------------*/
+
+usb_sts_type usbh_ctrl_request(usbh_core_type *uhost, uint8_t *buffer, uint16_t length)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_ctrl_result_check(usbh_core_type *uhost, ctrl_ept0_sts_type next_ctrl_state,
+                                    uint8_t next_enum_state)
+{
+  return USB_OK;
+}
+
+uint8_t usbh_find_interface(usbh_core_type *uhost, uint8_t class_code, uint8_t sub_class,
+                            uint8_t protocol)
+{
+  return 0;
+}
+
+uint16_t usbh_alloc_channel(usbh_core_type *uhost, uint8_t ept_addr)
+{
+  return 1;
+}
+
+void usbh_hc_open(usbh_core_type *uhost, uint8_t chn, uint8_t ept_num, uint8_t dev_address,
+                  uint8_t type, uint16_t maxpacket, uint8_t speed)
+{
+}
+
+usb_sts_type usbh_set_toggle(usbh_core_type *uhost, uint8_t hc_num, uint8_t toggle)
+{
+  return USB_OK;
+}
+
+void usbh_free_channel(usbh_core_type *uhost, uint8_t index)
+{
+}
+
+void usbh_ch_disable(usbh_core_type *uhost, uint8_t chn)
+{
+}
+
+/* test helpers -------------------------------------------------------------*/
+
+static void done_cb(void *uhost, uint8_t lun, uint32_t lba, uint32_t count, usb_sts_type status)
+{
+  done_cnt ++;
+  if(status != USB_OK)
+    fail_cnt ++;
+}
+
+static usb_sts_type user_application(void)
+{
+  return USB_OK;
+}
+
+static void step(void)
+{
+  class_handler.process_handler(&host);
+  /* one sof per step */
+  host.timer ++;
+}
+
+static void submit(uint8_t dir, uint32_t lba, uint32_t count, uint8_t *buffer)
+{
+  usb_sts_type status;
+
+  while((status = usbh_msc_submit(&host, 0, lba, count, buffer, dir, done_cb)) == USB_WAIT)
+    step();
+  TEST_ASSERT(status == USB_OK);
+}
+
+static void sync(void)
+{
+  uint32_t guard = 0;
+
+  while(usbh_msc_flush(&host) == USB_WAIT)
+  {
+    step();
+    TEST_ASSERT(++ guard < 1000000);
+  }
+}
+
+static void reset_counters(void)
+{
+  memset(&bot, 0, sizeof(bot));
+  done_cnt = 0;
+  fail_cnt = 0;
+}
+
+static void report(const char *name, uint32_t bytes)
+{
+  double ms = (double)bot.cmds * FS_CMD_OVERHEAD_MS + (double)bytes / FS_BULK_BYTES_PER_MS;
+
+  printf("  %-28s %4u requests  %3u commands  %3u blocks max  %.2f MB/s at full speed\n",
+         name, done_cnt, bot.cmds, bot.max_blocks, bytes / ms / 1000.0);
+}
+
+static void setup(void)
+{
+  user_handler.user_application = user_application;
+  host.user_handler = &user_handler;
+  class_handler = uhost_msc_class_handler;
+  class_handler.pdata = &usbh_msc;
+  host.class_handler = &class_handler;
+  host.conn_sts = 1;
+  host.global_state = USBH_CLASS;
+
+  class_handler.init_handler(&host);
+  usbh_msc.max_lun = 1;
+  usbh_msc.l_unit_n[0].state = USBH_MSC_INIT;
+  while(usbh_msc.state != USBH_MSC_IDLE)
+    step();
+
+  srand(1);
+  for(uint32_t i = 0; i < sizeof(src); i ++)
+    src[i] = (uint8_t)rand();
+}
+
+/* test cases ---------------------------------------------------------------*/
+
+static void test_small_writes_are_merged(void)
+{
+  reset_counters();
+  for(uint32_t lba = 0; lba < 256; lba ++)
+    submit(USBH_MSC_DIR_WRITE, lba, 1, &src[lba * USBH_MSC_BLOCK_SIZE]);
+  sync();
+  report("256 x 1 block write", sizeof(src));
+
+  TEST_ASSERT(done_cnt == 256 && fail_cnt == 0);
+  TEST_ASSERT(memcmp(disk, src, sizeof(src)) == 0);
+#if USBH_MSC_WB_BLOCKS
+  TEST_ASSERT(bot.cmds == 256 / USBH_MSC_WB_BLOCKS);
+#endif
+}
+
+static void test_small_reads_use_read_ahead(void)
+{
+  reset_counters();
+  memset(dst, 0, sizeof(dst));
+  for(uint32_t lba = 0; lba < 256; lba ++)
+    submit(USBH_MSC_DIR_READ, lba, 1, &dst[lba * USBH_MSC_BLOCK_SIZE]);
+  sync();
+  report("256 x 1 block read", sizeof(dst));
+
+  TEST_ASSERT(done_cnt == 256 && fail_cnt == 0);
+  TEST_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+#if USBH_MSC_RA_BLOCKS
+  TEST_ASSERT(bot.cmds == 256 / USBH_MSC_RA_BLOCKS);
+#endif
+}
+
+static void test_contiguous_reads_are_merged(void)
+{
+  reset_counters();
+  memset(dst, 0, sizeof(dst));
+  for(uint32_t lba = 0; lba < 256; lba += 16)
+    submit(USBH_MSC_DIR_READ, lba, 16, &dst[lba * USBH_MSC_BLOCK_SIZE]);
+  sync();
+  report("16 x 16 block read", sizeof(dst));
+
+  TEST_ASSERT(done_cnt == 16 && fail_cnt == 0);
+  TEST_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+  TEST_ASSERT(bot.cmds < 16);
+  TEST_ASSERT(bot.max_blocks <= USBH_MSC_MAX_XFER_BLOCKS);
+}
+
+static void test_read_after_write(void)
+{
+  uint8_t wr[USBH_MSC_BLOCK_SIZE], rd[USBH_MSC_BLOCK_SIZE];
+
+  reset_counters();
+  memset(wr, 0xA5, sizeof(wr));
+  submit(USBH_MSC_DIR_WRITE, 5, 1, wr);
+  submit(USBH_MSC_DIR_READ, 5, 1, rd);
+  sync();
+  TEST_ASSERT(fail_cnt == 0);
+  TEST_ASSERT(memcmp(rd, wr, sizeof(wr)) == 0);
+}
+
+static void test_merged_read_sees_buffered_write(void)
+{
+  uint8_t wr[USBH_MSC_BLOCK_SIZE];
+
+  /* the head read does not touch the buffered block, the one merged after it does */
+  reset_counters();
+  memset(wr, 0x3C, sizeof(wr));
+  memset(dst, 0, sizeof(dst));
+  submit(USBH_MSC_DIR_WRITE, 40, 1, wr);
+  submit(USBH_MSC_DIR_READ, 32, 8, &dst[0]);
+  submit(USBH_MSC_DIR_READ, 40, 8, &dst[8 * USBH_MSC_BLOCK_SIZE]);
+  sync();
+  TEST_ASSERT(fail_cnt == 0);
+  TEST_ASSERT(memcmp(&dst[8 * USBH_MSC_BLOCK_SIZE], wr, sizeof(wr)) == 0);
+  TEST_ASSERT(memcmp(&dst[0], &src[32 * USBH_MSC_BLOCK_SIZE], 8 * USBH_MSC_BLOCK_SIZE) == 0);
+}
+
+static void test_merged_write_drops_read_ahead(void)
+{
+  static uint8_t wr[18 * USBH_MSC_BLOCK_SIZE];
+  uint8_t rd[USBH_MSC_BLOCK_SIZE];
+
+  /* fill the window at 100, then write 90..107 as two merged requests whose
+     first one ends before the window */
+  reset_counters();
+  submit(USBH_MSC_DIR_READ, 100, 1, rd);
+  sync();
+  memset(wr, 0x77, sizeof(wr));
+  submit(USBH_MSC_DIR_WRITE, 90, 9, &wr[0]);
+  submit(USBH_MSC_DIR_WRITE, 99, 9, &wr[9 * USBH_MSC_BLOCK_SIZE]);
+  submit(USBH_MSC_DIR_READ, 102, 1, rd);
+  sync();
+  TEST_ASSERT(fail_cnt == 0);
+  TEST_ASSERT(memcmp(rd, wr, sizeof(rd)) == 0);
+}
+
+static void test_blocking_read_keeps_order(void)
+{
+  uint8_t wr[USBH_MSC_BLOCK_SIZE], rd[USBH_MSC_BLOCK_SIZE];
+
+  reset_counters();
+  memset(wr, 0x5A, sizeof(wr));
+  submit(USBH_MSC_DIR_WRITE, 7, 1, wr);
+  TEST_ASSERT(usbh_msc_read(&host, 7, 1, rd, 0) == USB_OK);
+  TEST_ASSERT(fail_cnt == 0);
+  TEST_ASSERT(memcmp(rd, wr, sizeof(wr)) == 0);
+}
+
+static void test_reset_fails_pending(void)
+{
+  reset_counters();
+  submit(USBH_MSC_DIR_READ, 0, 64, dst);
+  submit(USBH_MSC_DIR_READ, 200, 64, dst);
+  step();
+  class_handler.reset_handler(&host);
+  TEST_ASSERT(done_cnt == 2 && fail_cnt == 2);
+  TEST_ASSERT(usbh_msc_flush(&host) == USB_OK);
+
+  /* the next device starts from scratch */
+  class_handler.init_handler(&host);
+  usbh_msc.max_lun = 1;
+  usbh_msc.l_unit_n[0].state = USBH_MSC_INIT;
+  bot.busy = 0;
+  while(usbh_msc.state != USBH_MSC_IDLE)
+    step();
+}
+
+int main(void)
+{
+  setup();
+  TEST_RUN(test_small_writes_are_merged);
+  TEST_RUN(test_small_reads_use_read_ahead);
+  TEST_RUN(test_contiguous_reads_are_merged);
+  TEST_RUN(test_read_after_write);
+  TEST_RUN(test_merged_read_sees_buffered_write);
+  TEST_RUN(test_merged_write_drops_read_ahead);
+  TEST_RUN(test_blocking_read_keeps_order);
+  TEST_RUN(test_reset_fails_pending);
+  return TEST_RESULT();
+}
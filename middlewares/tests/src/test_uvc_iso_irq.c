@@ -0,0 +1,362 @@
+/**
+  **************************************************************************
+  * @file     test_uvc_iso_irq.c
+  * @brief    host test of the interrupt driven isochronous receive of the
+  *           uvc class
+  **************************************************************************
+  * the otg channel is replaced by a test double that records every
+  * usbh_isoc_recv and the channel complete callback. the test completes
+  * the channel the way the otg interrupt does, with the transfer count in
+  * hch and URB_DONE or URB_ERROR, checks that pendsv is pended and the
+  * channel re-armed, and runs usbh_uvc_deferred_handler as PendSV_Handler
+  * does. the packets carry a real payload stream so the parser output
+  * shows the handoff kept the packet order.
+  */
+#include <stdio.h>
+#include <string.h>
+#include "usbh_video_class.h"
+#include "usbh_video_stream_parsing.h"
+#include "test_helpers.h"
+
+#define MAX_PACKET                       256
+#define STREAM_CHANNEL                   3
+#define HDR_LEN                          2
+#define HDR_FID                          0x01
+#define HDR_EOF                          0x02
+#define HDR_EOH                          0x80
+
+SCB_Type host_scb;
+NVIC_Type host_nvic;
+uint8_t usbh_cfg_buffer[USBH_MAX_CFG_DESC_LEN];
+
+/* class state of usbh_video_class.c and usbh_video_desc_parsing.c */
+extern usbh_uvc_type usbh_uvc;
+extern uvc_format_type g_uvc_format;
+
+static usbh_core_type host;
+static usbh_hch_callback_type iso_complete;
+static uint8_t buffer0[UVC_FRAME_BUFFER_SIZE];
+static uint8_t buffer1[UVC_FRAME_BUFFER_SIZE];
+
+/* otg channel test double --------------------------------------------------*/
+
+static struct
+{
+  uint32_t armed;                        /* receives started */
+  uint8_t  *buf;                         /* buffer of the last receive */
+  uint16_t len;
+  uint32_t disabled;
+} otg;
+
+usb_sts_type usbh_isoc_recv(usbh_core_type *uhost, uint8_t hc_num,
+                            uint8_t *buffer, uint16_t length)
+{
+  TEST_ASSERT(hc_num == STREAM_CHANNEL);
+  otg.armed ++;
+  otg.buf = buffer;
+  otg.len = length;
+  return USB_OK;
+}
+
+void usbh_set_hch_callback(usbh_core_type *uhost, uint8_t hc_num,
+                           usbh_hch_callback_type callback)
+{
+  uhost->hch_callback[hc_num] = callback;
+}
+
+void usbh_ch_disable(usbh_core_type *uhost, uint8_t chn)
+{
+  otg.disabled ++;
+}
+
+/* not reached while streaming */
+void usbh_free_channel(usbh_core_type *uhost, uint8_t index)
+{
+}
+
+uint16_t usbh_alloc_channel(usbh_core_type *uhost, uint8_t ept_addr)
+{
+  return 0;
+}
+
+usb_sts_type usbh_set_toggle(usbh_core_type *uhost, uint8_t hc_num, uint8_t toggle)
+{
+  return USB_OK;
+}
+
+void usbh_hc_open(usbh_core_type *uhost, uint8_t chn, uint8_t ept_num, uint8_t dev_address,
+                  uint8_t type, uint16_t maxpacket, uint8_t speed)
+{
+}
+
+usb_sts_type usbh_ctrl_request(usbh_core_type *uhost, uint8_t *buffer, uint16_t length)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_ctrl_result_check(usbh_core_type *uhost, ctrl_ept0_sts_type next_ctrl_state,
+                                    uint8_t next_enum_state)
+{
+  return USB_OK;
+}
+
+usb_sts_type usbh_set_interface(usbh_core_type *uhost, uint8_t ept_num, uint8_t altsetting)
+{
+  return USB_OK;
+}
+
+usb_header_desc_type *usbh_get_next_header(uint8_t *buf, uint16_t *index_len)
+{
+  return (usb_header_desc_type *)buf;
+}
+
+uint8_t *usbh_get_interface_alt_desc(usbh_core_type *uhost, uint16_t alt_idx, uint16_t *length)
+{
+  return NULL;
+}
+
+/* channel and pendsv -------------------------------------------------------*/
+
+/* complete the armed receive as the otg interrupt does */
+static void channel_complete(urb_sts_type urb_state, uint16_t len)
+{
+  host.hch[STREAM_CHANNEL].trans_count = len;
+  host.hch_callback[STREAM_CHANNEL](&host, STREAM_CHANNEL, urb_state);
+}
+
+/* receive one payload packet of len data bytes into the armed buffer */
+static void channel_receive(uint8_t bfh, uint8_t fid, uint8_t seed, uint16_t len)
+{
+  uint16_t i;
+
+  otg.buf[0] = HDR_LEN;
+  otg.buf[1] = HDR_EOH | bfh | fid;
+  for(i = 0; i < len; i ++)
+    otg.buf[HDR_LEN + i] = (uint8_t)(seed + i);
+  channel_complete(URB_DONE, HDR_LEN + len);
+}
+
+static uint8_t pendsv_pending(void)
+{
+  return (host_scb.ICSR & SCB_ICSR_PENDSVSET_Msk) != 0;
+}
+
+/* PendSV_Handler */
+static void pendsv_run(void)
+{
+  host_scb.ICSR = 0;
+  usbh_uvc_deferred_handler(&host);
+}
+
+static void process(void)
+{
+  uhost_video_class_handler.process_handler(&host);
+}
+
+static void stream_start(void)
+{
+  memset(&host, 0, sizeof(host));
+  memset(&usbh_uvc, 0, sizeof(usbh_uvc));
+  memset(&otg, 0, sizeof(otg));
+  memset(&host_scb, 0, sizeof(host_scb));
+
+  host.class_handler = &uhost_video_class_handler;
+  g_uvc_format = UVC_FORMAT_MJPEG;
+  uvc_stream_init(buffer0, buffer1);
+  usbh_uvc.intf_stream.supported = 1;
+  usbh_uvc.intf_stream.channel = STREAM_CHANNEL;
+  usbh_uvc.intf_stream.max_size = MAX_PACKET;
+  usbh_uvc.intf_stream.bandwidth = MAX_PACKET;
+  usbh_uvc.req_state = UVC_REQ_IDLE;
+  usbh_uvc.steam_in_state = UVC_STATE_START_IN;
+  process();
+  iso_complete = host.hch_callback[STREAM_CHANNEL];
+}
+
+/* end a frame with frame id 0, the parser starts on the next packet */
+static void stream_sync(void)
+{
+  uvc_frame_type *frame;
+
+  channel_receive(HDR_EOF, 0, 0, 10);
+  pendsv_run();
+  while((frame = uvc_stream_acquire_filled()) != NULL)
+    uvc_stream_release(frame);
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static void test_start_arms_the_channel(void)
+{
+  stream_start();
+
+  TEST_ASSERT(usbh_uvc.steam_in_state == UVC_STATE_DATA_IN);
+  TEST_ASSERT(host.hch_callback[STREAM_CHANNEL] != NULL);
+  TEST_ASSERT(otg.armed == 1);
+  TEST_ASSERT(otg.len == MAX_PACKET);
+  /* the parser runs below the otg interrupt */
+  TEST_ASSERT(host_scb.SHP[((uint32_t)PendSV_IRQn & 0xF) - 4] ==
+              (uint8_t)(((1 << __NVIC_PRIO_BITS) - 1) << (8 - __NVIC_PRIO_BITS)));
+  TEST_ASSERT(!pendsv_pending());
+}
+
+static void test_done_rearms_and_pends_the_parser(void)
+{
+  uvc_stream_stats_type stats;
+  uint8_t *first;
+
+  stream_start();
+  first = otg.buf;
+  channel_receive(0, 0, 1, 100);
+
+  /* the next packet goes to the other buffer before the parser ran */
+  TEST_ASSERT(otg.armed == 2);
+  TEST_ASSERT(otg.buf != first);
+  TEST_ASSERT(pendsv_pending());
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.packet_cnt == 0);
+
+  pendsv_run();
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.packet_cnt == 1);
+
+  /* and back to the first one */
+  channel_receive(0, 0, 2, 100);
+  TEST_ASSERT(otg.armed == 3);
+  TEST_ASSERT(otg.buf == first);
+  pendsv_run();
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.packet_cnt == 2);
+}
+
+static void test_parser_behind_leaves_channel_idle(void)
+{
+  uvc_stream_stats_type stats;
+
+  stream_start();
+
+  /* pendsv held off by a higher priority interrupt for two packets */
+  channel_receive(0, 0, 1, 100);
+  channel_receive(0, 0, 2, 100);
+  TEST_ASSERT(otg.armed == 2);
+  TEST_ASSERT(usbh_uvc.iso_rearm == 1);
+
+  /* pendsv parses both and arms the idle channel */
+  pendsv_run();
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.packet_cnt == 2);
+  TEST_ASSERT(usbh_uvc.iso_rearm == 0);
+  TEST_ASSERT(otg.armed == 3);
+
+  channel_receive(0, 0, 3, 100);
+  TEST_ASSERT(otg.armed == 4);
+  pendsv_run();
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.packet_cnt == 3);
+}
+
+static void test_frame_is_parsed_in_order(void)
+{
+  uvc_frame_type *frame;
+  uint16_t i;
+  uint8_t ok = 1;
+
+  stream_start();
+
+  /* a frame of three packets, two of them received before pendsv runs */
+  stream_sync();
+  channel_receive(0, HDR_FID, 0, 200);
+  channel_receive(0, HDR_FID, 200, 200);
+  pendsv_run();
+  channel_receive(HDR_EOF, HDR_FID, 400 & 0xFF, 50);
+  pendsv_run();
+
+  frame = uvc_stream_acquire_filled();
+  TEST_ASSERT(frame != NULL);
+  if(frame == NULL)
+    return;
+  TEST_ASSERT(frame->len == 450);
+  TEST_ASSERT(frame->error == 0);
+  for(i = 0; i < frame->len; i ++)
+    ok &= frame->data[i] == (uint8_t)i;
+  TEST_ASSERT(ok);
+  uvc_stream_release(frame);
+}
+
+static void test_error_rearms_the_same_buffer(void)
+{
+  uvc_stream_stats_type stats;
+  uvc_frame_type *frame;
+  uint8_t *armed;
+
+  stream_start();
+  stream_sync();
+  channel_receive(0, HDR_FID, 0, 200);
+
+  /* babble on the next packet: no pendsv, receive again into the same
+     buffer */
+  armed = otg.buf;
+  host_scb.ICSR = 0;
+  channel_complete(URB_ERROR, 0);
+  TEST_ASSERT(otg.armed == 4);
+  TEST_ASSERT(otg.buf == armed);
+  TEST_ASSERT(usbh_uvc.iso_err == 1);
+
+  /* the parser hears of the lost packet before the packet after it */
+  channel_receive(HDR_EOF, HDR_FID, 200, 50);
+  pendsv_run();
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.rx_error_cnt == 1);
+  TEST_ASSERT(stats.packet_cnt == 3);
+  frame = uvc_stream_acquire_filled();
+  TEST_ASSERT(frame != NULL);
+  if(frame != NULL)
+  {
+    TEST_ASSERT(frame->error != 0);
+    uvc_stream_release(frame);
+  }
+
+  /* the process handler counts the error once */
+  process();
+  TEST_ASSERT(usbh_uvc.iso_err_done == 1);
+  TEST_ASSERT(usbh_uvc.intf_stream.err_cnt == 1);
+  process();
+  TEST_ASSERT(usbh_uvc.intf_stream.err_cnt == 1);
+}
+
+static void test_errors_fall_back_to_lower_bandwidth(void)
+{
+  uint32_t i;
+
+  stream_start();
+  host_scb.ICSR = 0;
+  usbh_uvc.stream_in[0].valid = 1;
+  usbh_uvc.stream_in[0].bandwidth = MAX_PACKET / 2;
+
+  for(i = 0; i < UVC_ALT_FALLBACK_ERR_NUM; i ++)
+    channel_complete(URB_ERROR, 0);
+  process();
+
+  TEST_ASSERT(usbh_uvc.max_bandwidth == MAX_PACKET / 2);
+  TEST_ASSERT(usbh_uvc.steam_in_state == UVC_STATE_IDLE);
+  TEST_ASSERT(host.hch_callback[STREAM_CHANNEL] == NULL);
+  TEST_ASSERT(otg.disabled == 1);
+  TEST_ASSERT(host.global_state == USBH_CLASS_REQUEST);
+
+  /* a completion already on its way does not arm the channel again */
+  i = otg.armed;
+  iso_complete(&host, STREAM_CHANNEL, URB_DONE);
+  TEST_ASSERT(otg.armed == i);
+  TEST_ASSERT(!pendsv_pending());
+}
+
+int main(void)
+{
+  TEST_RUN(test_start_arms_the_channel);
+  TEST_RUN(test_done_rearms_and_pends_the_parser);
+  TEST_RUN(test_parser_behind_leaves_channel_idle);
+  TEST_RUN(test_frame_is_parsed_in_order);
+  TEST_RUN(test_error_rearms_the_same_buffer);
+  TEST_RUN(test_errors_fall_back_to_lower_bandwidth);
+  return TEST_RESULT();
+}
@@ -0,0 +1,659 @@
+/**
+  **************************************************************************
+  * @file     test_uvc_mjpeg.c
+  * @brief    host test and benchmark of the uvc mjpeg decode stage
+  **************************************************************************
+  * the frames are made like a uvc camera makes them: baseline 4:2:2
+  * jpeg without huffman tables, so every frame goes through the default
+  * table insertion. a small encoder builds a moving test scene at the
+  * usual camera sizes, the decoded pixels of flat color areas are checked
+  * against the colors that were encoded, then every size and scale is
+  * decoded in a loop and the frame rate and the memory the decoder needs
+  * are printed. frames dumped from a camera are decoded as well with
+  *   test_uvc_mjpeg [frames per run] [frame.jpg ...]
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "usbh_video_mjpeg.h"
+#include "test_helpers.h"
+
+#define BENCH_FRAMES                     20    /* decodes per size and scale */
+#define SCENE_FRAMES                     4     /* different frames per size */
+#define JPEG_QUALITY                     80
+#define JPEG_MAX_SIZE                    (640 * 480)
+#define OUT_MAX_W                        640
+#define OUT_MAX_H                        480
+
+/* standard tables of itu-t t.81 annex k, as the camera uses them ----------*/
+
+static const uint8_t quant_luma[64] =
+{
+  16, 11, 10, 16,  24,  40,  51,  61,
+  12, 12, 14, 19,  26,  58,  60,  55,
+  14, 13, 16, 24,  40,  57,  69,  56,
+  14, 17, 22, 29,  51,  87,  80,  62,
+  18, 22, 37, 56,  68, 109, 103,  77,
+  24, 35, 55, 64,  81, 104, 113,  92,
+  49, 64, 78, 87, 103, 121, 120, 101,
+  72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t quant_chroma[64] =
+{
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+static const uint8_t zigzag[64] =
+{
+   0,  1,  8, 16,  9,  2,  3, 10,
+  17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34,
+  27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36,
+  29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46,
+  53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const uint8_t dc_luma_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dc_chroma_bits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t dc_vals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t ac_luma_bits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+static const uint8_t ac_luma_vals[162] =
+{
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+  0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+  0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+  0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA,
+};
+
+static const uint8_t ac_chroma_bits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t ac_chroma_vals[162] =
+{
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+  0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+  0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+  0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+  0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+  0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA,
+};
+
+/* camera encoder -----------------------------------------------------------*/
+
+/**
+  * @brief huffman code of every symbol
+  */
+typedef struct
+{
+  uint16_t code[256];
+  uint8_t  size[256];
+} huff_type;
+
+/**
+  * @brief one 4:2:2 frame, ycbcr planes in full resolution
+  */
+typedef struct
+{
+  uint16_t width;
+  uint16_t height;
+  uint8_t  *y;
+  uint8_t  *cb;
+  uint8_t  *cr;
+} scene_type;
+
+static huff_type huff_dc[2], huff_ac[2];
+static uint8_t quant[2][64];
+static float dct_cos[8][8];
+
+static uint8_t *jpeg_out;
+static uint32_t jpeg_len;
+static uint32_t bit_buf;
+static uint8_t bit_cnt;
+
+static void huff_build(huff_type *huff, const uint8_t *bits, const uint8_t *vals)
+{
+  uint16_t code = 0;
+  uint8_t len, idx, k = 0;
+
+  for(len = 1; len <= 16; len ++)
+  {
+    for(idx = 0; idx < bits[len - 1]; idx ++)
+    {
+      huff->code[vals[k]] = code ++;
+      huff->size[vals[k ++]] = len;
+    }
+    code <<= 1;
+  }
+}
+
+static void encoder_init(uint8_t quality)
+{
+  uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  uint32_t idx, u, q;
+
+  for(idx = 0; idx < 64; idx ++)
+  {
+    q = (quant_luma[idx] * scale + 50) / 100;
+    quant[0][idx] = (uint8_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+    q = (quant_chroma[idx] * scale + 50) / 100;
+    quant[1][idx] = (uint8_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+  }
+  huff_build(&huff_dc[0], dc_luma_bits, dc_vals);
+  huff_build(&huff_dc[1], dc_chroma_bits, dc_vals);
+  huff_build(&huff_ac[0], ac_luma_bits, ac_luma_vals);
+  huff_build(&huff_ac[1], ac_chroma_bits, ac_chroma_vals);
+  for(idx = 0; idx < 8; idx ++)
+    for(u = 0; u < 8; u ++)
+      dct_cos[idx][u] = (float)cos((2 * idx + 1) * u * M_PI / 16) * (u == 0 ? (float)M_SQRT1_2 : 1.0f) / 2;
+}
+
+static void put_byte(uint8_t value)
+{
+  jpeg_out[jpeg_len ++] = value;
+}
+
+static void put_word(uint16_t value)
+{
+  put_byte((uint8_t)(value >> 8));
+  put_byte((uint8_t)value);
+}
+
+static void put_bits(uint16_t code, uint8_t size)
+{
+  uint8_t byte;
+
+  bit_buf = (bit_buf << size) | (code & ((1U << size) - 1));
+  bit_cnt += size;
+  while(bit_cnt >= 8)
+  {
+    byte = (uint8_t)(bit_buf >> (bit_cnt - 8));
+    put_byte(byte);
+    if(byte == 0xFF)
+      put_byte(0);
+    bit_cnt -= 8;
+  }
+}
+
+static uint8_t coef_size(int32_t value)
+{
+  uint8_t size = 0;
+
+  if(value < 0)
+    value = -value;
+  while(value)
+  {
+    size ++;
+    value >>= 1;
+  }
+  return size;
+}
+
+static void put_coef(int32_t value, uint8_t size)
+{
+  put_bits((uint16_t)(value < 0 ? value - 1 : value), size);
+}
+
+/* forward dct, quantize and huffman code one 8x8 block */
+static void encode_block(const uint8_t *plane, uint16_t stride, uint8_t step, uint8_t table, int32_t *dc)
+{
+  float in[64], sum;
+  int32_t coef[64], value;
+  uint8_t x, y, u, v, idx, run = 0, size;
+
+  for(y = 0; y < 8; y ++)
+    for(x = 0; x < 8; x ++)
+      in[y * 8 + x] = (float)plane[y * stride + x * step] - 128;
+
+  for(v = 0; v < 8; v ++)
+  {
+    for(u = 0; u < 8; u ++)
+    {
+      sum = 0;
+      for(y = 0; y < 8; y ++)
+        for(x = 0; x < 8; x ++)
+          sum += in[y * 8 + x] * dct_cos[x][u] * dct_cos[y][v];
+      coef[v * 8 + u] = (int32_t)lroundf(sum / quant[table][v * 8 + u]);
+    }
+  }
+
+  value = coef[0] - *dc;
+  *dc = coef[0];
+  size = coef_size(value);
+  put_bits(huff_dc[table].code[size], huff_dc[table].size[size]);
+  put_coef(value, size);
+
+  for(idx = 1; idx < 64; idx ++)
+  {
+    value = coef[zigzag[idx]];
+    if(value == 0)
+    {
+      run ++;
+      continue;
+    }
+    while(run >= 16)
+    {
+      put_bits(huff_ac[table].code[0xF0], huff_ac[table].size[0xF0]);
+      run -= 16;
+    }
+    size = coef_size(value);
+    put_bits(huff_ac[table].code[(run << 4) | size], huff_ac[table].size[(run << 4) | size]);
+    put_coef(value, size);
+    run = 0;
+  }
+  if(run)
+    put_bits(huff_ac[table].code[0], huff_ac[table].size[0]);
+}
+
+/* baseline 4:2:2 without dht, the way uvc cameras send mjpeg */
+static uint32_t encode_frame(const scene_type *scene, uint8_t *out)
+{
+  int32_t dc[3] = {0, 0, 0};
+  uint16_t x, y, idx;
+  uint8_t table, k;
+
+  jpeg_out = out;
+  jpeg_len = 0;
+  bit_buf = 0;
+  bit_cnt = 0;
+
+  put_word(0xFFD8);
+  for(table = 0; table < 2; table ++)
+  {
+    put_word(0xFFDB);
+    put_word(67);
+    put_byte(table);
+    for(idx = 0; idx < 64; idx ++)
+      put_byte(quant[table][zigzag[idx]]);
+  }
+  put_word(0xFFC0);
+  put_word(17);
+  put_byte(8);
+  put_word(scene->height);
+  put_word(scene->width);
+  put_byte(3);
+  put_byte(1); put_byte(0x21); put_byte(0);
+  put_byte(2); put_byte(0x11); put_byte(1);
+  put_byte(3); put_byte(0x11); put_byte(1);
+  put_word(0xFFDA);
+  put_word(12);
+  put_byte(3);
+  for(k = 1; k <= 3; k ++)
+  {
+    put_byte(k);
+    put_byte(k == 1 ? 0x00 : 0x11);
+  }
+  put_byte(0);
+  put_byte(63);
+  put_byte(0);
+
+  for(y = 0; y < scene->height; y += 8)
+  {
+    for(x = 0; x < scene->width; x += 16)
+    {
+      encode_block(&scene->y[y * scene->width + x], scene->width, 1, 0, &dc[0]);
+      encode_block(&scene->y[y * scene->width + x + 8], scene->width, 1, 0, &dc[0]);
+      /* chroma of every second column */
+      encode_block(&scene->cb[y * scene->width + x], scene->width, 2, 1, &dc[1]);
+      encode_block(&scene->cr[y * scene->width + x], scene->width, 2, 1, &dc[2]);
+    }
+  }
+  put_bits(0x7F, 7);
+  put_word(0xFFD9);
+  return jpeg_len;
+}
+
+static void scene_alloc(scene_type *scene, uint16_t width, uint16_t height)
+{
+  scene->width = width;
+  scene->height = height;
+  scene->y = malloc((size_t)width * height);
+  scene->cb = malloc((size_t)width * height);
+  scene->cr = malloc((size_t)width * height);
+}
+
+static void scene_free(scene_type *scene)
+{
+  free(scene->y);
+  free(scene->cb);
+  free(scene->cr);
+}
+
+/* gradients, a moving disc and sensor noise */
+static void scene_draw(scene_type *scene, uint32_t frame)
+{
+  uint32_t seed = frame * 2654435761U + 1;
+  int32_t cx = (int32_t)(scene->width / 4 + frame * scene->width / 8);
+  int32_t cy = scene->height / 2, r = scene->height / 4, dx, dy;
+  uint16_t x, y;
+  uint32_t idx;
+
+  for(y = 0; y < scene->height; y ++)
+  {
+    for(x = 0; x < scene->width; x ++)
+    {
+      idx = (uint32_t)y * scene->width + x;
+      seed = seed * 1103515245U + 12345U;
+      dx = x - cx;
+      dy = y - cy;
+      if(dx * dx + dy * dy < r * r)
+      {
+        scene->y[idx] = (uint8_t)(200 + ((seed >> 16) & 7));
+        scene->cb[idx] = 90;
+        scene->cr[idx] = 200;
+      }
+      else
+      {
+        scene->y[idx] = (uint8_t)(40 + x * 150 / scene->width + ((seed >> 16) & 15));
+        scene->cb[idx] = (uint8_t)(100 + y * 60 / scene->height);
+        scene->cr[idx] = (uint8_t)(140 - x * 40 / scene->width);
+      }
+    }
+  }
+}
+
+/* lvgl tick ----------------------------------------------------------------*/
+
+static double now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+uint32_t lv_tick_get(void)
+{
+  return (uint32_t)now_ms();
+}
+
+uint32_t lv_tick_elaps(uint32_t prev_tick)
+{
+  return lv_tick_get() - prev_tick;
+}
+
+/* output -------------------------------------------------------------------*/
+
+static lv_color_t out_buf[OUT_MAX_W * OUT_MAX_H];
+static uint8_t jpeg_buf[JPEG_MAX_SIZE];
+
+/**
+  * @brief what the strip callback saw
+  */
+typedef struct
+{
+  uint16_t width;
+  uint16_t height;
+  uint32_t strips;
+  uint32_t pixels;
+  uint8_t  bad_strip;
+  uint8_t  copy;
+} out_info_type;
+
+static int strip_output(const lv_area_t *area, lv_color_t *pixels, void *user)
+{
+  out_info_type *info = (out_info_type *)user;
+  lv_coord_t w = lv_area_get_width(area), h = lv_area_get_height(area), y;
+
+  info->strips ++;
+  info->pixels += (uint32_t)(w * h);
+  if((w > UVC_MJPEG_STRIP_WIDTH) || (h > UVC_MJPEG_STRIP_HEIGHT) || (area->x1 < 0) ||
+     (area->y1 < 0) || (area->x2 >= info->width) || (area->y2 >= info->height))
+  {
+    info->bad_strip = 1;
+    return 1;
+  }
+  if(info->copy)
+  {
+    for(y = 0; y < h; y ++)
+      memcpy(&out_buf[(area->y1 + y) * info->width + area->x1], &pixels[y * w], w * sizeof(lv_color_t));
+  }
+  return 1;
+}
+
+/* jfif full range ycbcr to rgb, as the decoder does it */
+static lv_color_t ycc_to_color(uint8_t y, uint8_t cb, uint8_t cr)
+{
+  double r = y + 1.402 * (cr - 128);
+  double g = y - 0.344136 * (cb - 128) - 0.714136 * (cr - 128);
+  double b = y + 1.772 * (cb - 128);
+
+  r = r < 0 ? 0 : (r > 255 ? 255 : r);
+  g = g < 0 ? 0 : (g > 255 ? 255 : g);
+  b = b < 0 ? 0 : (b > 255 ? 255 : b);
+  return lv_color_make((uint8_t)lround(r), (uint8_t)lround(g), (uint8_t)lround(b));
+}
+
+static uint8_t color_close(lv_color_t a, lv_color_t b)
+{
+  return abs((int)LV_COLOR_GET_R(a) - (int)LV_COLOR_GET_R(b)) <= 1 &&
+         abs((int)LV_COLOR_GET_G(a) - (int)LV_COLOR_GET_G(b)) <= 1 &&
+         abs((int)LV_COLOR_GET_B(a) - (int)LV_COLOR_GET_B(b)) <= 1;
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static const uint8_t patch_ycc[4][3] =
+{
+  {235, 128, 128},
+  { 82,  90, 240},
+  {145,  54,  34},
+  { 60, 200, 110},
+};
+
+/* four flat 64 x 48 patches, the decoded center of each has its color */
+static void test_decodes_camera_frames(void)
+{
+  scene_type scene;
+  out_info_type info;
+  uvc_mjpeg_stats_type stats;
+  uint16_t x, y, p, px, py;
+  uint32_t len, bad = 0;
+
+  scene_alloc(&scene, 128, 96);
+  for(y = 0; y < 96; y ++)
+  {
+    for(x = 0; x < 128; x ++)
+    {
+      p = (y / 48) * 2 + x / 64;
+      scene.y[y * 128 + x] = patch_ycc[p][0];
+      scene.cb[y * 128 + x] = patch_ycc[p][1];
+      scene.cr[y * 128 + x] = patch_ycc[p][2];
+    }
+  }
+  len = encode_frame(&scene, jpeg_buf);
+  scene_free(&scene);
+
+  uvc_mjpeg_reset_stats();
+  memset(&info, 0, sizeof(info));
+  info.width = 128;
+  info.height = 96;
+  info.copy = 1;
+  TEST_ASSERT(uvc_mjpeg_decode(jpeg_buf, len, UVC_MJPEG_SCALE_1, strip_output, &info) == JDR_OK);
+  TEST_ASSERT(info.bad_strip == 0);
+  TEST_ASSERT(info.pixels == 128 * 96);
+
+  uvc_mjpeg_get_stats(&stats);
+  TEST_ASSERT(stats.frame_cnt == 1);
+  TEST_ASSERT(stats.dht_insert_cnt == 1);
+  TEST_ASSERT(stats.width == 128 && stats.height == 96);
+
+  for(p = 0; p < 4; p ++)
+  {
+    px = (p & 1) * 64 + 32;
+    py = (p >> 1) * 48 + 24;
+    for(y = py - 8; y < py + 8; y ++)
+      for(x = px - 8; x < px + 8; x ++)
+        bad += !color_close(out_buf[y * 128 + x], ycc_to_color(patch_ycc[p][0], patch_ycc[p][1], patch_ycc[p][2]));
+  }
+  TEST_ASSERT(bad == 0);
+}
+
+static void test_scales_fit_the_panel(void)
+{
+  scene_type scene;
+  out_info_type info;
+  uvc_mjpeg_stats_type stats;
+  uint32_t len;
+
+  scene_alloc(&scene, 640, 480);
+  scene_draw(&scene, 0);
+  len = encode_frame(&scene, jpeg_buf);
+  scene_free(&scene);
+
+  /* 640 x 480 fits 240 x 320 at 1/4 */
+  memset(&info, 0, sizeof(info));
+  info.width = 160;
+  info.height = 120;
+  TEST_ASSERT(uvc_mjpeg_decode(jpeg_buf, len, UVC_MJPEG_SCALE_FIT, strip_output, &info) == JDR_OK);
+  uvc_mjpeg_get_stats(&stats);
+  TEST_ASSERT(stats.width == 160 && stats.height == 120);
+  TEST_ASSERT(info.pixels == 160 * 120);
+  TEST_ASSERT(info.bad_strip == 0);
+
+  /* a truncated frame fails and is counted */
+  uvc_mjpeg_reset_stats();
+  TEST_ASSERT(uvc_mjpeg_decode(jpeg_buf, len / 2, UVC_MJPEG_SCALE_1, strip_output, &info) != JDR_OK);
+  uvc_mjpeg_get_stats(&stats);
+  TEST_ASSERT(stats.error_cnt == 1);
+}
+
+/* benchmark ----------------------------------------------------------------*/
+
+static const char *scale_name[] = {"1", "1/2", "1/4", "1/8"};
+
+static void bench(const char *name, uint8_t **frames, uint32_t *lens, uint32_t num,
+                  uint16_t width, uint16_t height, uint32_t runs)
+{
+  out_info_type info;
+  uvc_mjpeg_stats_type stats;
+  uint32_t idx, bytes = 0, fail;
+  uint8_t scale;
+  double start, ms;
+
+  for(idx = 0; idx < num; idx ++)
+    bytes += lens[idx];
+  printf("  %s %dx%d, %d bytes a frame\n", name, width, height, bytes / num);
+
+  for(scale = UVC_MJPEG_SCALE_1; scale <= UVC_MJPEG_SCALE_8; scale ++)
+  {
+    memset(&info, 0, sizeof(info));
+    info.width = width >> scale;
+    info.height = height >> scale;
+    uvc_mjpeg_reset_stats();
+    fail = 0;
+    start = now_ms();
+    for(idx = 0; idx < runs; idx ++)
+      fail += uvc_mjpeg_decode(frames[idx % num], lens[idx % num], (uvc_mjpeg_scale_type)scale,
+                               strip_output, &info) != JDR_OK;
+    ms = now_ms() - start;
+    uvc_mjpeg_get_stats(&stats);
+    printf("    scale %-3s %8.1f frames/s  %6.2f ms a frame  %3d strips  work pool peak %d of %d bytes\n",
+           scale_name[scale], runs * 1000.0 / ms, ms / runs, stats.strip_cnt, stats.pool_peak,
+           UVC_MJPEG_POOL_SIZE);
+    TEST_ASSERT(fail == 0);
+    TEST_ASSERT(info.bad_strip == 0);
+  }
+}
+
+static void bench_scenes(uint32_t runs)
+{
+  static const uint16_t sizes[][2] = {{320, 240}, {640, 480}};
+  uint8_t *frames[SCENE_FRAMES];
+  uint32_t lens[SCENE_FRAMES];
+  scene_type scene;
+  uint32_t s, f;
+
+  for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s ++)
+  {
+    scene_alloc(&scene, sizes[s][0], sizes[s][1]);
+    for(f = 0; f < SCENE_FRAMES; f ++)
+    {
+      scene_draw(&scene, f);
+      lens[f] = encode_frame(&scene, jpeg_buf);
+      frames[f] = malloc(lens[f]);
+      memcpy(frames[f], jpeg_buf, lens[f]);
+    }
+    bench("test scene", frames, lens, SCENE_FRAMES, sizes[s][0], sizes[s][1], runs);
+    for(f = 0; f < SCENE_FRAMES; f ++)
+      free(frames[f]);
+    scene_free(&scene);
+  }
+}
+
+/* a camera frame dumped to a file, the size is taken from the header */
+static void bench_file(const char *name, uint32_t runs)
+{
+  FILE *f = fopen(name, "rb");
+  uint8_t *frame = jpeg_buf;
+  uint32_t len, pos;
+  uint16_t width = 0, height = 0;
+
+  TEST_ASSERT(f != NULL);
+  if(f == NULL)
+    return;
+  len = (uint32_t)fread(jpeg_buf, 1, sizeof(jpeg_buf), f);
+  fclose(f);
+
+  for(pos = 2; pos + 9 < len && jpeg_buf[pos] == 0xFF; pos += 2 + ((jpeg_buf[pos + 2] << 8) | jpeg_buf[pos + 3]))
+  {
+    if(jpeg_buf[pos + 1] == 0xC0)
+    {
+      height = (uint16_t)((jpeg_buf[pos + 5] << 8) | jpeg_buf[pos + 6]);
+      width = (uint16_t)((jpeg_buf[pos + 7] << 8) | jpeg_buf[pos + 8]);
+      break;
+    }
+  }
+  if(width == 0)
+  {
+    printf("  %s: no baseline frame header\n", name);
+    TEST_ASSERT(0);
+    return;
+  }
+  bench(name, &frame, &len, 1, width, height, runs);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t runs = BENCH_FRAMES;
+  int idx;
+
+  encoder_init(JPEG_QUALITY);
+  TEST_RUN(test_decodes_camera_frames);
+  TEST_RUN(test_scales_fit_the_panel);
+
+  if(argc > 1)
+    runs = (uint32_t)strtoul(argv[1], NULL, 0);
+  printf("mjpeg decode, %d frames a run\n", runs);
+  printf("  static buffers: work pool %d bytes, strips %d bytes, decoder state on the stack %d bytes\n",
+         UVC_MJPEG_POOL_SIZE, (int)(2 * UVC_MJPEG_STRIP_WIDTH * UVC_MJPEG_STRIP_HEIGHT * sizeof(lv_color_t)),
+         (int)sizeof(JDEC));
+  test_case_failed = 0;
+  bench_scenes(runs);
+  for(idx = 2; idx < argc; idx ++)
+    bench_file(argv[idx], runs);
+  test_failed |= test_case_failed;
+  return TEST_RESULT();
+}
@@ -0,0 +1,403 @@
+/**
+  **************************************************************************
+  * @file     test_uvc_stream_parsing.c
+  * @brief    host test of the uvc payload parser
+  **************************************************************************
+  * payload streams are built like a camera sends them, a payload header
+  * with the frame id, end of frame, pts and scr bits in front of every
+  * packet, and fed through uvc_stream_rx_buffer and uvc_stream_data_process
+  * as the polled receive does. the published frames are checked against
+  * the data that was sent.
+  *
+  * built once with the copying receive and once with UVC_ZERO_COPY_ENABLE.
+  * captured packet streams are replayed with
+  *   test_uvc_stream_parsing <capture> [yuy2 <frame size>]
+  * a capture is the list of received packets, each a 16-bit little endian
+  * length and the packet with its payload header, CAP_LOST in place of
+  * the length is a receive lost to a frame overrun or babble.
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usbh_video_stream_parsing.h"
+#include "test_helpers.h"
+
+#define MAX_PACKET                       256
+#define HDR_LEN                          12    /* header with pts and scr */
+#define HDR_FID                          0x01
+#define HDR_EOF                          0x02
+#define HDR_PTS                          0x04
+#define HDR_SCR                          0x08
+#define HDR_ERR                          0x40
+#define HDR_EOH                          0x80
+
+#define CAP_LOST                         0xFFFF
+#define CAP_MAX_SIZE                     0x100000
+#define REPLAY_MAX_FRAMES                16
+
+__IO uint8_t tmp_frame_buffer[UVC_RX_BUFFER_SIZE];
+uvc_format_type g_uvc_format;
+
+static uint8_t buffer0[UVC_FRAME_BUFFER_SIZE];
+static uint8_t buffer1[UVC_FRAME_BUFFER_SIZE];
+static uint8_t image[UVC_MAX_FRAME_SIZE];
+static uint8_t fid;
+static uint32_t sof;
+
+static uint8_t cap[CAP_MAX_SIZE];
+static uint32_t cap_len;
+
+/**
+  * @brief frame published during a replay
+  */
+typedef struct
+{
+  uint32_t len;
+  uint8_t  error;
+  uint32_t sum;
+} replay_frame_type;
+
+static replay_frame_type replay_frames[REPLAY_MAX_FRAMES];
+static uint32_t replay_frame_num;
+
+/* stream builder -----------------------------------------------------------*/
+
+static void stream_start(uvc_format_type format, uint32_t frame_size)
+{
+  g_uvc_format = format;
+  uvc_stream_init(buffer0, buffer1);
+  uvc_stream_set_max_packet(MAX_PACKET);
+  uvc_stream_set_frame_size(frame_size);
+  fid = 0;
+  sof = 0;
+}
+
+static void image_fill(uint32_t len, uint8_t seed)
+{
+  uint32_t i;
+
+  for(i = 0; i < len; i ++)
+    image[i] = (uint8_t)(i * 7 + (i >> 8) + seed);
+}
+
+/* receive one packet the way the polled class handler does */
+static void send_packet(uint8_t bfh, const uint8_t *data, uint16_t len)
+{
+  uint8_t *buf = uvc_stream_rx_buffer(MAX_PACKET);
+
+  buf[0] = HDR_LEN;
+  buf[1] = HDR_EOH | HDR_PTS | HDR_SCR | bfh | fid;
+  memset(&buf[2], 0x11, HDR_LEN - 2);
+  memcpy(&buf[HDR_LEN], data, len);
+  uvc_stream_data_process(buf, HDR_LEN + len, sof ++);
+}
+
+/* send len bytes of the image as one frame, eof on the last packet when
+   set_eof */
+static void send_frame(uint32_t len, uint8_t set_eof)
+{
+  uint32_t pos = 0;
+  uint16_t chunk;
+  uint8_t bfh;
+
+  while(pos < len)
+  {
+    chunk = (len - pos > MAX_PACKET - HDR_LEN) ? MAX_PACKET - HDR_LEN : (uint16_t)(len - pos);
+    bfh = ((pos + chunk == len) && set_eof) ? HDR_EOF : 0;
+    send_packet(bfh, &image[pos], chunk);
+    pos += chunk;
+  }
+  fid ^= HDR_FID;
+}
+
+/* check the next published frame against the first len bytes of the image */
+static void expect_frame(uint32_t len, uint8_t error)
+{
+  uvc_frame_type *frame = uvc_stream_acquire_filled();
+
+  TEST_ASSERT(frame != NULL);
+  if(frame == NULL)
+    return;
+  TEST_ASSERT(frame->len == len);
+  TEST_ASSERT(frame->error == error);
+  TEST_ASSERT(memcmp(frame->data, image, len) == 0);
+  uvc_stream_release(frame);
+}
+
+/* capture replay ----------------------------------------------------------*/
+
+static uint32_t data_sum(const uint8_t *data, uint32_t len)
+{
+  uint32_t sum = 2166136261U;
+
+  while(len --)
+    sum = (sum ^ *data ++) * 16777619U;
+  return sum;
+}
+
+/* receive buffers are sized for the largest packet of the capture as for
+   the max packet size of the streaming endpoint */
+static uint16_t replay_max_packet(const uint8_t *data, uint32_t len)
+{
+  uint32_t pos = 0;
+  uint16_t n, max = 0;
+
+  while(pos + 2 <= len)
+  {
+    n = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+    pos += 2;
+    if(n == CAP_LOST)
+      continue;
+    if(n > max)
+      max = n;
+    pos += n;
+  }
+  return max;
+}
+
+/* feed a capture through the parser the way the polled class handler
+   does, the consumer takes every frame as soon as it is published */
+static int replay(const uint8_t *data, uint32_t len)
+{
+  uint16_t max = replay_max_packet(data, len);
+  uint32_t pos = 0;
+  uint16_t n;
+  uint8_t *buf;
+  uvc_frame_type *frame;
+
+  if(max > UVC_RX_FIFO_SIZE)
+  {
+    printf("  packets of %d bytes, the receive fifo takes %d\n", max, UVC_RX_FIFO_SIZE);
+    return -1;
+  }
+  replay_frame_num = 0;
+  while(pos + 2 <= len)
+  {
+    n = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+    pos += 2;
+    buf = uvc_stream_rx_buffer(max);
+    if(n == CAP_LOST)
+    {
+      uvc_stream_rx_cancel();
+    }
+    else
+    {
+      if(pos + n > len)
+      {
+        printf("  capture ends inside a packet\n");
+        return -1;
+      }
+      memcpy(buf, &data[pos], n);
+      pos += n;
+      uvc_stream_data_process(buf, n, sof ++);
+    }
+
+    while((frame = uvc_stream_acquire_filled()) != NULL)
+    {
+      if(replay_frame_num < REPLAY_MAX_FRAMES)
+      {
+        replay_frames[replay_frame_num].len = frame->len;
+        replay_frames[replay_frame_num].error = frame->error;
+        replay_frames[replay_frame_num].sum = data_sum(frame->data, frame->len);
+      }
+      replay_frame_num ++;
+      uvc_stream_release(frame);
+    }
+  }
+  return 0;
+}
+
+/* record one packet of len image bytes from *pos, hlen 2 or 12 */
+static void cap_packet(uint8_t bfh, uint8_t hlen, uint32_t *pos, uint16_t len)
+{
+  uint8_t *p = &cap[cap_len];
+
+  p[0] = (uint8_t)(hlen + len);
+  p[1] = (uint8_t)((hlen + len) >> 8);
+  p[2] = hlen;
+  p[3] = HDR_EOH | bfh | fid | ((hlen == HDR_LEN) ? HDR_PTS | HDR_SCR : 0);
+  memset(&p[4], 0x22, hlen - 2);
+  memcpy(&p[2 + hlen], &image[*pos], len);
+  cap_len += 2 + hlen + len;
+  *pos += len;
+}
+
+static void cap_lost(void)
+{
+  cap[cap_len ++] = (uint8_t)CAP_LOST;
+  cap[cap_len ++] = (uint8_t)(CAP_LOST >> 8);
+}
+
+static void expect_replay_frame(uint32_t idx, uint32_t start, uint32_t len, uint8_t error)
+{
+  TEST_ASSERT(idx < replay_frame_num);
+  if(idx >= replay_frame_num)
+    return;
+  TEST_ASSERT(replay_frames[idx].len == len);
+  TEST_ASSERT(replay_frames[idx].error == error);
+  TEST_ASSERT(replay_frames[idx].sum == data_sum(&image[start], len));
+}
+
+/* replay a capture file, print what the parser made of it */
+static int replay_file(const char *name, uvc_format_type format, uint32_t frame_size)
+{
+  FILE *f = fopen(name, "rb");
+  uvc_stream_stats_type stats;
+  uint32_t idx;
+
+  if(f == NULL)
+  {
+    printf("cannot open %s\n", name);
+    return 1;
+  }
+  cap_len = (uint32_t)fread(cap, 1, sizeof(cap), f);
+  fclose(f);
+
+  stream_start(format, frame_size);
+  if(replay(cap, cap_len) != 0)
+    return 1;
+  for(idx = 0; idx < replay_frame_num && idx < REPLAY_MAX_FRAMES; idx ++)
+    printf("frame %d: %d bytes, error %02x\n", idx, replay_frames[idx].len, replay_frames[idx].error);
+  uvc_stream_get_stats(&stats);
+  printf("packets %d, data %d, header only %d, zero length %d, short %d, invalid %d, lost %d\n",
+         stats.packet_cnt, stats.data_cnt, stats.header_cnt, stats.zero_len_cnt,
+         stats.short_cnt, stats.invalid_cnt, stats.rx_error_cnt);
+  printf("frames %d, with errors %d, dropped %d\n",
+         stats.frame_cnt, stats.error_frame_cnt, stats.dropped_cnt);
+  return 0;
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static void test_yuy2_frame_is_published(void)
+{
+  uvc_stream_stats_type stats;
+  const uint32_t size = UVC_TARGET_WIDTH * UVC_TARGET_HEIGHT * UVC_YUY2_BYTES_PER_PIXEL;
+
+  TEST_ASSERT(size <= UVC_MAX_FRAME_SIZE);
+  stream_start(UVC_FORMAT_YUY2, size);
+  image_fill(size, 1);
+
+  /* the first frame only syncs to the frame id */
+  send_frame(size, 1);
+  TEST_ASSERT(uvc_stream_acquire_filled() == NULL);
+  send_frame(size, 1);
+  expect_frame(size, 0);
+  image_fill(size, 2);
+  send_frame(size, 1);
+  expect_frame(size, 0);
+
+  uvc_stream_get_stats(&stats);
+  TEST_ASSERT(stats.frame_cnt == 2);
+  TEST_ASSERT(stats.error_frame_cnt == 0);
+}
+
+static void test_yuy2_completes_at_committed_size_without_eof(void)
+{
+  const uint32_t size = UVC_TARGET_WIDTH * UVC_TARGET_HEIGHT;
+
+  /* a camera that committed a smaller frame and never sets eof */
+  stream_start(UVC_FORMAT_YUY2, size);
+  image_fill(size, 3);
+  send_frame(size, 1);
+  send_frame(size, 0);
+  expect_frame(size, 0);
+  send_frame(size, 0);
+  expect_frame(size, 0);
+  TEST_ASSERT(uvc_stream_acquire_filled() == NULL);
+}
+
+static void test_yuy2_short_frame_is_marked(void)
+{
+  const uint32_t size = UVC_TARGET_WIDTH * UVC_TARGET_HEIGHT * UVC_YUY2_BYTES_PER_PIXEL;
+
+  stream_start(UVC_FORMAT_YUY2, size);
+  image_fill(size, 4);
+  send_frame(size, 1);
+  send_frame(size / 2, 1);
+  expect_frame(size / 2, UVC_FRAME_ERR_LOST);
+}
+
+static void test_mjpeg_completes_at_eof(void)
+{
+  const uint32_t size = 5000;
+
+  stream_start(UVC_FORMAT_MJPEG, 0);
+  image_fill(size, 5);
+  send_frame(size, 1);
+  send_frame(size, 1);
+  expect_frame(size, 0);
+  send_frame(size - 100, 1);
+  expect_frame(size - 100, 0);
+}
+
+static void test_capture_replay(void)
+{
+  uvc_frame_type *frame;
+  uint32_t pos = 0, a, b, c, d;
+
+  stream_start(UVC_FORMAT_MJPEG, 0);
+  image_fill(sizeof(image), 6);
+  /* two frames sync the parser to the frame id, fid is back at 0 */
+  send_frame(100, 1);
+  send_frame(100, 1);
+  while((frame = uvc_stream_acquire_filled()) != NULL)
+    uvc_stream_release(frame);
+  cap_len = 0;
+
+  /* header lengths change inside a frame, zero length and header only
+     packets carry no data */
+  a = pos;
+  cap_packet(0, HDR_LEN, &pos, 200);
+  cap_packet(0, 2, &pos, 100);
+  cap_packet(0, 2, &pos, 0);
+  cap[cap_len ++] = 0;
+  cap[cap_len ++] = 0;
+  cap_packet(0, HDR_LEN, &pos, 244);
+  cap_packet(HDR_EOF, 2, &pos, 50);
+  fid ^= HDR_FID;
+
+  /* a receive lost inside the frame */
+  b = pos;
+  cap_packet(0, 2, &pos, 200);
+  cap_lost();
+  cap_packet(HDR_EOF, HDR_LEN, &pos, 200);
+  fid ^= HDR_FID;
+
+  /* the camera flags a payload error */
+  c = pos;
+  cap_packet(HDR_ERR, 2, &pos, 100);
+  cap_packet(HDR_EOF, 2, &pos, 100);
+  fid ^= HDR_FID;
+
+  /* an end of frame in a header only packet */
+  d = pos;
+  cap_packet(0, HDR_LEN, &pos, 244);
+  cap_packet(0, HDR_LEN, &pos, 244);
+  cap_packet(HDR_EOF, HDR_LEN, &pos, 0);
+  fid ^= HDR_FID;
+
+  TEST_ASSERT(replay(cap, cap_len) == 0);
+  TEST_ASSERT(replay_frame_num == 4);
+  expect_replay_frame(0, a, b - a, 0);
+  expect_replay_frame(1, b, c - b, UVC_FRAME_ERR_LOST);
+  expect_replay_frame(2, c, d - c, UVC_FRAME_ERR_PAYLOAD);
+  expect_replay_frame(3, d, pos - d, 0);
+}
+
+int main(int argc, char **argv)
+{
+  if(argc > 1)
+  {
+    if((argc > 3) && (strcmp(argv[2], "yuy2") == 0))
+      return replay_file(argv[1], UVC_FORMAT_YUY2, (uint32_t)strtoul(argv[3], NULL, 0));
+    return replay_file(argv[1], UVC_FORMAT_MJPEG, 0);
+  }
+
+  TEST_RUN(test_yuy2_frame_is_published);
+  TEST_RUN(test_yuy2_completes_at_committed_size_without_eof);
+  TEST_RUN(test_yuy2_short_frame_is_marked);
+  TEST_RUN(test_mjpeg_completes_at_eof);
+  TEST_RUN(test_capture_replay);
+  return TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+/**
+  **************************************************************************
+  * @file     test_uvc_yuv.c
+  * @brief    host test of the yuy2 to rgb565 conversion
+  **************************************************************************
+  * built twice, with the portable pixel code and with UVC_YUV_SIMD on the
+  * host versions of the cortex-m4 intrinsics, both have to give the same
+  * pixels. the golden vectors are bt.601 limited range color bars and
+  * saturating inputs, the sweep checks every luma and chroma against the
+  * fixed point formula, the frame tests check the pixel positions of the
+  * scaling and the rotations.
+  */
+#include <stdio.h>
+#include <string.h>
+#include "usbh_video_yuv.h"
+#include "test_helpers.h"
+
+#if LV_COLOR_DEPTH != 16
+#error "the yuy2 conversion outputs rgb565"
+#endif
+
+#define FRAME_MAX_W                      256
+#define FRAME_MAX_H                      8
+
+#ifdef UVC_YUV_SIMD
+SCB_Type host_scb;
+NVIC_Type host_nvic;
+#endif
+
+static uint8_t frame[FRAME_MAX_W * FRAME_MAX_H * 2];
+static lv_color_t out[FRAME_MAX_W * FRAME_MAX_H];
+static lv_color_t strip[FRAME_MAX_W * FRAME_MAX_H];
+
+/**
+  * @brief two pixels of one yuyv macropixel and their rgb565
+  */
+typedef struct
+{
+  uint8_t  y0, y1, u, v;
+  uint16_t rgb0, rgb1;
+} golden_type;
+
+static const golden_type golden[] =
+{
+  { 16,  16, 128, 128, 0x0000, 0x0000},   /* black */
+  {235, 235, 128, 128, 0xFFFF, 0xFFFF},   /* white */
+  {180, 180, 128, 128, 0xBDF7, 0xBDF7},   /* 75% white */
+  {162, 162,  44, 142, 0xC5E0, 0xC5E0},   /* 75% yellow */
+  {131, 131, 156,  44, 0x05F7, 0x05F7},   /* 75% cyan */
+  {112, 112,  72,  58, 0x05E0, 0x05E0},   /* 75% green */
+  { 84,  84, 184, 198, 0xB818, 0xB818},   /* 75% magenta */
+  { 65,  65, 100, 212, 0xB800, 0xB800},   /* 75% red */
+  { 35,  35, 212, 114, 0x0017, 0x0017},   /* 75% blue */
+  { 81,  81,  90, 240, 0xF800, 0xF800},   /* red */
+  {145, 145,  54,  34, 0x07E0, 0x07E0},   /* green */
+  { 41,  41, 240, 110, 0x001F, 0x001F},   /* blue */
+  { 16, 235, 128, 128, 0x0000, 0xFFFF},   /* black, white */
+  {  0, 255, 128, 128, 0x0000, 0xFFFF},   /* luma out of range */
+  {255, 255, 255, 255, 0xFBFF, 0xFBFF},   /* saturates high */
+  {  0,   0,   0,   0, 0x0420, 0x0420},   /* saturates low */
+  {128, 200,   0, 255, 0xFA60, 0xFD00},   /* chroma extremes */
+  {128,  60, 255,   0, 0x05DF, 0x035F},   /* chroma extremes */
+  {100, 101, 127, 129, 0x630C, 0x630C},   /* near gray */
+};
+
+/* reference ----------------------------------------------------------------*/
+
+static int32_t clamp255(int32_t value)
+{
+  return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/* rgb565 in lv_color_t byte order */
+static uint16_t color_full(uint16_t rgb565)
+{
+#if LV_COLOR_16_SWAP
+  return (uint16_t)((rgb565 << 8) | (rgb565 >> 8));
+#else
+  return rgb565;
+#endif
+}
+
+/* bt.601 limited range, luma and chroma terms rounded on their own as the
+   conversion documents */
+static uint16_t ref_rgb565(uint8_t y, uint8_t u, uint8_t v)
+{
+  int32_t cu = (int32_t)u - 128, cv = (int32_t)v - 128;
+  int32_t l = (298 * ((int32_t)y - 16) + 128) >> 8;
+  int32_t r = clamp255(l + ((409 * cv + 128) >> 8));
+  int32_t g = clamp255(l + ((-100 * cu - 208 * cv + 128) >> 8));
+  int32_t b = clamp255(l + ((516 * cu + 128) >> 8));
+
+  return color_full((uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)));
+}
+
+/* frame builder ------------------------------------------------------------*/
+
+static void frame_put(uint16_t width, uint16_t x, uint16_t y, uint8_t luma, uint8_t u, uint8_t v)
+{
+  uint8_t *p = &frame[(y * width + (x & ~1)) * 2];
+
+  p[(x & 1) * 2] = luma;
+  p[1] = u;
+  p[3] = v;
+}
+
+/* gray frame with a different luma in every pixel, the rgb565 of the gray
+   tells which source pixel an output pixel came from */
+static uint8_t ramp_luma(uint16_t x, uint16_t y)
+{
+  return (uint8_t)(16 + x * 8 + y * 32);
+}
+
+static void frame_ramp(uint16_t width, uint16_t height)
+{
+  uint16_t x, y;
+
+  for(y = 0; y < height; y ++)
+    for(x = 0; x < width; x ++)
+      frame_put(width, x, y, ramp_luma(x, y), 128, 128);
+}
+
+static void convert(uint16_t src_w, uint16_t src_h, uint16_t dst_w, uint16_t dst_h,
+                    uvc_yuv_rotate_type rotate, uvc_yuv_filter_type filter)
+{
+  uvc_yuv_conv_type conv;
+
+  memset(out, 0, sizeof(out));
+  uvc_yuv_init(&conv, frame, src_w, src_h, dst_w, dst_h, rotate, filter);
+  uvc_yuv_convert(&conv, out);
+}
+
+/* tests --------------------------------------------------------------------*/
+
+static void test_golden_vectors(void)
+{
+  uint32_t idx;
+
+  for(idx = 0; idx < sizeof(golden) / sizeof(golden[0]); idx ++)
+  {
+    const golden_type *g = &golden[idx];
+
+    /* the reference follows the table */
+    TEST_ASSERT(ref_rgb565(g->y0, g->u, g->v) == color_full(g->rgb0));
+    TEST_ASSERT(ref_rgb565(g->y1, g->u, g->v) == color_full(g->rgb1));
+    frame_put(4, 0, 0, g->y0, g->u, g->v);
+    frame_put(4, 1, 0, g->y1, g->u, g->v);
+    frame_put(4, 2, 0, g->y1, g->u, g->v);
+    frame_put(4, 3, 0, g->y0, g->u, g->v);
+    convert(4, 1, 4, 1, UVC_YUV_ROTATE_0, UVC_YUV_NEAREST);
+    if(out[0].full != color_full(g->rgb0) || out[1].full != color_full(g->rgb1) ||
+       out[2].full != color_full(g->rgb1) || out[3].full != color_full(g->rgb0))
+    {
+      printf("  yuyv %d %d %d %d: %04X %04X, expected %04X %04X\n", g->y0, g->u, g->y1, g->v,
+             out[0].full, out[1].full, color_full(g->rgb0), color_full(g->rgb1));
+      TEST_ASSERT(0);
+    }
+  }
+}
+
+static void test_every_input_matches_the_formula(void)
+{
+  uint32_t u, v, x, bad = 0;
+
+  /* one row of every luma per chroma pair, the unscaled fast path for the
+     first pixels and the generic one for the tail */
+  for(u = 0; u < 256; u ++)
+  {
+    for(v = 0; v < 256; v ++)
+    {
+      for(x = 0; x < 256; x ++)
+        frame_put(256, (uint16_t)x, 0, (uint8_t)x, (uint8_t)u, (uint8_t)v);
+      convert(256, 1, 256, 1, UVC_YUV_ROTATE_0, UVC_YUV_NEAREST);
+      for(x = 0; x < 256; x ++)
+      {
+        if(out[x].full != ref_rgb565((uint8_t)x, (uint8_t)u, (uint8_t)v) && bad ++ < 4)
+          printf("  y %d u %d v %d: %04X\n", (int)x, (int)u, (int)v, out[x].full);
+      }
+    }
+  }
+  TEST_ASSERT(bad == 0);
+}
+
+static void check_positions(uint16_t dst_w, uint16_t dst_h, uint16_t (*src_x)(uint16_t, uint16_t),
+                            uint16_t (*src_y)(uint16_t, uint16_t))
+{
+  uint16_t x, y;
+  uint32_t bad = 0;
+
+  for(y = 0; y < dst_h; y ++)
+  {
+    for(x = 0; x < dst_w; x ++)
+    {
+      if(out[y * dst_w + x].full != ref_rgb565(ramp_luma(src_x(x, y), src_y(x, y)), 128, 128) &&
+         bad ++ < 4)
+        printf("  output %d,%d: %04X\n", x, y, out[y * dst_w + x].full);
+    }
+  }
+  TEST_ASSERT(bad == 0);
+}
+
+/* 6 x 4 source */
+static uint16_t rot0_x(uint16_t x, uint16_t y)   { return x; }
+static uint16_t rot0_y(uint16_t x, uint16_t y)   { return y; }
+static uint16_t rot90_x(uint16_t x, uint16_t y)  { return y; }
+static uint16_t rot90_y(uint16_t x, uint16_t y)  { return 3 - x; }
+static uint16_t rot180_x(uint16_t x, uint16_t y) { return 5 - x; }
+static uint16_t rot180_y(uint16_t x, uint16_t y) { return 3 - y; }
+static uint16_t rot270_x(uint16_t x, uint16_t y) { return 5 - y; }
+static uint16_t rot270_y(uint16_t x, uint16_t y) { return x; }
+static uint16_t half_x(uint16_t x, uint16_t y)   { return x * 2 + 1; }
+static uint16_t half_y(uint16_t x, uint16_t y)   { return y * 2 + 1; }
+
+static void test_rotations(void)
+{
+  frame_ramp(6, 4);
+  convert(6, 4, 6, 4, UVC_YUV_ROTATE_0, UVC_YUV_NEAREST);
+  check_positions(6, 4, rot0_x, rot0_y);
+  convert(6, 4, 4, 6, UVC_YUV_ROTATE_90, UVC_YUV_NEAREST);
+  check_positions(4, 6, rot90_x, rot90_y);
+  convert(6, 4, 6, 4, UVC_YUV_ROTATE_180, UVC_YUV_NEAREST);
+  check_positions(6, 4, rot180_x, rot180_y);
+  convert(6, 4, 4, 6, UVC_YUV_ROTATE_270, UVC_YUV_NEAREST);
+  check_positions(4, 6, rot270_x, rot270_y);
+}
+
+static void test_scaling(void)
+{
+  uint16_t x, y;
+  uint32_t bad = 0;
+
+  /* nearest takes the center pixel of every 2 x 2 block */
+  frame_ramp(8, 4);
+  convert(8, 4, 4, 2, UVC_YUV_ROTATE_0, UVC_YUV_NEAREST);
+  check_positions(4, 2, half_x, half_y);
+
+  /* bilinear averages the block, the luma ramp is linear so the average
+     is the luma at the block center */
+  convert(8, 4, 4, 2, UVC_YUV_ROTATE_0, UVC_YUV_BILINEAR);
+  for(y = 0; y < 2; y ++)
+  {
+    for(x = 0; x < 4; x ++)
+    {
+      if(out[y * 4 + x].full != ref_rgb565((uint8_t)(16 + 4 + x * 16 + 16 + y * 64), 128, 128))
+        bad ++;
+    }
+  }
+  TEST_ASSERT(bad == 0);
+}
+
+static void test_strips_match_the_frame(void)
+{
+  uvc_yuv_conv_type conv;
+  uint16_t rows, done = 0;
+
+  /* odd output width converts a single pixel at the end of every row */
+  frame_ramp(6, 4);
+  convert(6, 4, 5, 7, UVC_YUV_ROTATE_90, UVC_YUV_NEAREST);
+
+  memset(strip, 0, sizeof(strip));
+  uvc_yuv_init(&conv, frame, 6, 4, 5, 7, UVC_YUV_ROTATE_90, UVC_YUV_NEAREST);
+  while((rows = uvc_yuv_convert_rows(&conv, &strip[done * 5], 3)) != 0)
+  {
+    TEST_ASSERT(rows <= 3);
+    done += rows;
+  }
+  TEST_ASSERT(done == 7);
+  TEST_ASSERT(memcmp(strip, out, 5 * 7 * sizeof(lv_color_t)) == 0);
+}
+
+int main(void)
+{
+  TEST_RUN(test_golden_vectors);
+  TEST_RUN(test_every_input_matches_the_formula);
+  TEST_RUN(test_rotations);
+  TEST_RUN(test_scaling);
+  TEST_RUN(test_strips_match_the_frame);
+  return TEST_RESULT();
+}
@@ -63,7 +63,8 @@ typedef enum
   HCH_STALL,          /*!< usb host channel stall */
   HCH_XACTERR,        /*!< usb host channel transaction error */
   HCH_BBLERR,         /*!< usb host channel babble error */
-  HCH_DATATGLERR      /*!< usb host channel data toggle error */
+  HCH_DATATGLERR,     /*!< usb host channel data toggle error */
+  HCH_FRMOVRRUN       /*!< usb host channel frame overrun */
 } hch_sts_type;
 
 /**
@@ -140,6 +141,8 @@ typedef enum
 typedef enum
 {
   USBH_IDLE,                            /*!< usb host global state idle */
+  USBH_PORT_DEBOUNCE,                   /*!< usb host global state wait connect stable */
+  USBH_PORT_RESET,                      /*!< usb host global state port reset */
   USBH_PORT_EN,                         /*!< usb host global state port enable */
   USBH_ATTACHED,                        /*!< usb host global state attached */
   USBH_DISCONNECT,                      /*!< usb host global state disconnect */
@@ -156,6 +159,20 @@ typedef enum
   USBH_ERROR_STATE,                     /*!< usb host global state error */
 } usbh_gstate_type;
 
+/**
+  * @brief usb host attach phases
+  */
+typedef enum
+{
+  USBH_PHASE_DEBOUNCE,                  /*!< connect to port reset */
+  USBH_PHASE_RESET,                     /*!< port reset to port enabled */
+  USBH_PHASE_RECOVERY,                  /*!< port enabled to attached */
+  USBH_PHASE_ENUMERATION,               /*!< standard requests to set configuration */
+  USBH_PHASE_CLASS_INIT,                /*!< class init handler */
+  USBH_PHASE_CLASS_REQUEST,             /*!< class requests until the class runs */
+  USBH_PHASE_NUM,
+} usbh_phase_type;
+
 /**
   * @brief usb host transfer state
   */
@@ -202,6 +219,24 @@ typedef enum
 #define USBH_MAX_INTERFACE               5   /*!< usb support maximum interface */
 #define USBH_MAX_ENDPOINT                5   /*!< usb support maximum endpoint */
 
+/**
+  * @brief configuration descriptor buffer
+  */
+#ifndef USBH_MAX_CFG_DESC_LEN
+/* video and audio devices have configuration descriptors of some kilobytes,
+   a longer configuration is truncated to the buffer */
+#define USBH_MAX_CFG_DESC_LEN            0x1000 /*!< usb host configuration descriptor buffer size */
+#endif
+
+/**
+  * @brief interface alternate setting index
+  */
+#define USBH_MAX_ITF_NUM                 16  /*!< usb support maximum interface number in the index */
+/* every alternate setting takes one interface descriptor of the configuration
+   descriptor, so the index can not hold more than fit in the buffer */
+#define USBH_MAX_ITF_ALT                 (USBH_MAX_CFG_DESC_LEN / USB_DEVICE_IF_DESC_LEN)
+#define USBH_ITF_ALT_NONE                0xFFFF /*!< no alternate setting index */
+
 /**
   * @brief interface descriptor
   */
@@ -211,6 +246,31 @@ typedef struct
   usb_endpoint_desc_type                 endpoint[USBH_MAX_ENDPOINT];    /*!< usb device endpoint descriptor structure array */
 } usb_itf_desc_type;
 
+/**
+  * @brief interface alternate setting index entry
+  */
+typedef struct
+{
+  uint16_t                               offset;                         /*!< interface descriptor offset in the configuration descriptor */
+  uint8_t                                bInterfaceNumber;               /*!< number of the interface */
+  uint8_t                                bAlternateSetting;              /*!< alternate setting of the interface */
+  uint8_t                                bNumEndpoints;                  /*!< number of endpoints of the alternate setting */
+  uint8_t                                bInterfaceClass;                /*!< class code */
+  uint8_t                                bInterfaceSubClass;             /*!< subclass code */
+  uint8_t                                bInterfaceProtocol;             /*!< protocol code */
+} usb_itf_alt_type;
+
+/**
+  * @brief interface alternate setting index of the configuration descriptor
+  */
+typedef struct
+{
+  usb_itf_alt_type                       alt[USBH_MAX_ITF_ALT];          /*!< alternate settings in descriptor order */
+  uint16_t                               alt_num;                        /*!< number of alternate settings */
+  uint16_t                               itf_first[USBH_MAX_ITF_NUM];    /*!< first alternate setting index of each interface number */
+  uint16_t                               itf_alt_num[USBH_MAX_ITF_NUM];  /*!< number of alternate settings of each interface number */
+} usb_itf_index_type;
+
 /**
   * @brief configure descriptor
   */
@@ -218,6 +278,7 @@ typedef struct
 {
   usb_configuration_desc_type            cfg;                            /*!< usb device configuration descriptor structure */
   usb_itf_desc_type                      interface[USBH_MAX_INTERFACE];  /*!< usb device interface descriptor structure array*/
+  usb_itf_index_type                     index;                          /*!< index of every interface alternate setting */
 } usb_cfg_desc_type;
 
 /**
@@ -279,6 +340,11 @@ typedef struct
   usb_sts_type (*user_not_support)(void);                                /*!< usb host user not support handler */
 } usbh_user_handler_type;
 
+/**
+  * @brief host channel complete callback type, called from the otg interrupt
+  */
+typedef void (*usbh_hch_callback_type)(void *uhost, uint8_t chn, urb_sts_type urb_state);
+
 /**
   * @brief host host core handler type
   */
@@ -302,12 +368,19 @@ typedef struct
   uint32_t                               conn_sts;                       /*!< connect status */
   uint32_t                               port_enable;                    /*!< port enable status */
   uint32_t                               timer;                          /*!< sof timer */
+  uint32_t                               state_tick;                     /*!< start of a timed global state */
+#ifdef USBH_ENUM_TIMING_ENABLE
+  uint32_t                               phase_tick;                     /*!< start of the current attach phase */
+  uint32_t                               phase_time[USBH_PHASE_NUM];     /*!< attach phase durations in ms */
+  uint8_t                                phase;                          /*!< current attach phase */
+#endif
 
   uint32_t                               err_cnt[USB_HOST_CHANNEL_NUM];  /*!< error counter */
   uint32_t                               xfer_cnt[USB_HOST_CHANNEL_NUM]; /*!< xfer counter */
   hch_sts_type                           hch_state[USB_HOST_CHANNEL_NUM];/*!< channel state */
   urb_sts_type                           urb_state[USB_HOST_CHANNEL_NUM];/*!< usb request state */
   uint16_t                               channel[USB_HOST_CHANNEL_NUM];  /*!< channel array */
+  usbh_hch_callback_type                 hch_callback[USB_HOST_CHANNEL_NUM]; /*!< channel complete callback */
 } usbh_core_type;
 
 
@@ -327,6 +400,8 @@ usb_sts_type usbh_isoc_send(usbh_core_type *uhost, uint8_t hc_num,
                             uint8_t *buffer, uint16_t length);
 usb_sts_type usbh_isoc_recv(usbh_core_type *uhost, uint8_t hc_num,
                             uint8_t *buffer, uint16_t length);
+void usbh_set_hch_callback(usbh_core_type *uhost, uint8_t hc_num,
+                            usbh_hch_callback_type callback);
 usb_sts_type usbh_cfg_default_init(usbh_core_type *uhost);
 void usbh_enter_suspend(usbh_core_type *uhost);
 void usbh_resume(usbh_core_type *uhost);
@@ -338,6 +413,7 @@ usb_sts_type usbh_ctrl_result_check(usbh_core_type *uhost,
                                     uint8_t next_enum_state);
 uint8_t usbh_alloc_address(void);
 void usbh_reset_port(usbh_core_type *uhost);
+void usbh_set_port_reset(usbh_core_type *uhost, confirm_state state);
 usb_sts_type usbh_loop_handler(usbh_core_type *uhost);
 void usbh_ch_disable(usbh_core_type *uhost, uint8_t chn);
 void usbh_hc_open(usbh_core_type *uhost,
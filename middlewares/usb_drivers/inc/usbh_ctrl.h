@@ -79,6 +79,9 @@ void usbh_parse_endpoint_desc(usb_endpoint_desc_type *ept_desc, uint8_t *buf);
 usb_sts_type usbh_parse_configure_desc(usbh_core_type *uhost,
                                   uint8_t *buffer, uint16_t length);
 uint8_t usbh_find_interface(usbh_core_type *uhost, uint8_t class_code, uint8_t sub_class, uint8_t protocol);
+uint16_t usbh_find_interface_alt(usbh_core_type *uhost, uint8_t itf_number, uint8_t alt_setting);
+uint16_t usbh_find_class_alt(usbh_core_type *uhost, uint8_t class_code, uint8_t sub_class, uint8_t alt_setting);
+uint8_t *usbh_get_interface_alt_desc(usbh_core_type *uhost, uint16_t alt_idx, uint16_t *length);
 void usbh_parse_string_desc(uint8_t *src, uint8_t *dest, uint16_t length);
 usb_sts_type usbh_get_device_descriptor(usbh_core_type *uhost, uint16_t length);
 usb_sts_type usbh_get_configure_descriptor(usbh_core_type *uhost, uint16_t length);
@@ -56,6 +56,9 @@ void usbh_hch_out_handler(usbh_core_type *uhost, uint8_t chn);
 void usbh_rx_qlvl_handler(usbh_core_type *uhost);
 void usbh_wakeup_handler(usbh_core_type *uhost);
 void usbh_sof_handler(usbh_core_type *uhost);
+#ifdef USBH_RX_DMA_ENABLE
+void usbh_rx_dma_irq_handler(void);
+#endif
 
 /**
   * @}
@@ -48,7 +48,12 @@ static void usbh_class(usbh_core_type *uhost);
 static void usbh_suspend(usbh_core_type *uhost);
 static void usbh_wakeup(usbh_core_type *uhost);
 static void usbh_disconnect(usbh_core_type *uhost);
-uint8_t usbh_cfg_buffer[USB_MAX_DATA_LENGTH]; /*!< usb host cfg buffer */
+#ifdef USBH_ENUM_TIMING_ENABLE
+static void usbh_phase_done(usbh_core_type *uhost, usbh_phase_type phase);
+#else
+#define usbh_phase_done(uhost, phase)
+#endif
+uint8_t usbh_cfg_buffer[USBH_MAX_CFG_DESC_LEN]; /*!< usb host cfg buffer */
 /**
   * @brief  usb host free channel
   * @param  uhost: to the structure of usbh_core_type
@@ -61,6 +66,7 @@ void usbh_free_channel(usbh_core_type *uhost, uint8_t index)
   {
     /* free host channel */
     uhost->channel[index] = 0x0;
+    uhost->hch_callback[index] = NULL;
   }
 }
 
@@ -398,6 +404,23 @@ usb_sts_type usbh_isoc_recv(usbh_core_type *uhost, uint8_t hc_num,
   return usbh_in_out_request(uhost, hc_num);
 }
 
+/**
+  * @brief  usb host set channel complete callback, the callback runs in
+  *         the otg interrupt when an iso transfer completes or fails
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  hc_num: channel number
+  * @param  callback: complete callback, NULL to disable
+  * @retval none
+  */
+void usbh_set_hch_callback(usbh_core_type *uhost, uint8_t hc_num,
+                            usbh_hch_callback_type callback)
+{
+  if(hc_num < USB_HOST_CHANNEL_NUM)
+  {
+    uhost->hch_callback[hc_num] = callback;
+  }
+}
+
 /**
   * @brief  usb host cfg default init
   * @param  uhost: to the structure of usbh_core_type
@@ -849,12 +872,13 @@ usb_sts_type usbh_enum_handler(usbh_core_type *uhost)
 
       if(usbh_ctrl_result_check(uhost, CONTROL_IDLE, ENUM_GET_FULL_CFG) == USB_OK)
       {
-        usbh_parse_configure_desc(uhost, uhost->rx_buffer, 9);
+        usbh_parse_configure_desc(uhost, usbh_cfg_buffer, 9);
       }
       break;
 
     case ENUM_GET_FULL_CFG:
-      /* get device confiuration */
+      /* get device confiuration, a longer configuration is truncated
+         to the buffer */
       if(uhost->ctrl.state == CONTROL_IDLE)
       {
         usbh_get_configure_descriptor(uhost, uhost->dev.cfg_desc.cfg.wTotalLength);
@@ -862,12 +886,7 @@ usb_sts_type usbh_enum_handler(usbh_core_type *uhost)
 
       if(usbh_ctrl_result_check(uhost, CONTROL_IDLE, ENUM_GET_MFC_STRING) == USB_OK)
       {
-        uint32_t i = 0;
-        for(i = 0; i < uhost->dev.cfg_desc.cfg.wTotalLength; i ++)
-        {
-          usbh_cfg_buffer[i] = uhost->rx_buffer[i];
-        }
-        usbh_parse_configure_desc(uhost, uhost->rx_buffer, uhost->dev.cfg_desc.cfg.wTotalLength);
+        usbh_parse_configure_desc(uhost, usbh_cfg_buffer, USBH_MAX_CFG_DESC_LEN);
       }
       break;
 
@@ -953,24 +972,75 @@ void usbh_active_vbus(usbh_core_type *uhost, confirm_state state)
   * @retval none
   */
 void usbh_reset_port(usbh_core_type *uhost)
+{
+  /* set port reset */
+  usbh_set_port_reset(uhost, TRUE);
+
+  usb_delay_ms(100);
+
+  /* clear port reset */
+  usbh_set_port_reset(uhost, FALSE);
+
+  usb_delay_ms(20);
+
+}
+
+/**
+  * @brief  set or clear usb port reset
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  state: TRUE to drive the reset, FALSE to release it
+  * @retval none
+  */
+void usbh_set_port_reset(usbh_core_type *uhost, confirm_state state)
 {
   otg_host_type *usb_host = OTG_HOST(uhost->usb_reg);
   uint32_t hprt_val = usb_host->hprt;
 
   hprt_val &= ~(USB_OTG_HPRT_PRTENA | USB_OTG_HPRT_PRTENCHNG |
-               USB_OTG_HPRT_PRTOVRCACT | USB_OTG_HPRT_PRTCONDET);
+               USB_OTG_HPRT_PRTOVRCACT | USB_OTG_HPRT_PRTCONDET |
+               USB_OTG_HPRT_PRTRST);
 
-  /* set port reset */
-  usb_host->hprt = hprt_val | USB_OTG_HPRT_PRTRST;
+  if(state == TRUE)
+  {
+    hprt_val |= USB_OTG_HPRT_PRTRST;
+  }
+  usb_host->hprt = hprt_val;
+}
 
-  usb_delay_ms(100);
+#ifdef USBH_ENUM_TIMING_ENABLE
+/**
+  * @brief  end an attach phase and start the next one
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  phase: phase that ended, ignored if it is not the current one
+  * @retval none
+  */
+static void usbh_phase_done(usbh_core_type *uhost, usbh_phase_type phase)
+{
+  static const char *phase_name[USBH_PHASE_NUM] =
+  {
+    "debounce", "reset", "recovery", "enumeration", "class init", "class request"
+  };
+  uint32_t now = usb_get_tick_ms(), total = 0;
+  uint8_t i_index;
 
-  /* clear port reset */
-  usb_host->hprt = hprt_val & (~USB_OTG_HPRT_PRTRST);
+  if(uhost->phase != phase)
+    return;
 
-  usb_delay_ms(20);
+  uhost->phase_time[phase] = now - uhost->phase_tick;
+  uhost->phase_tick = now;
+  uhost->phase ++;
+  USBH_DEBUG("%s: %d ms", phase_name[phase], uhost->phase_time[phase]);
 
+  if(uhost->phase == USBH_PHASE_NUM)
+  {
+    for(i_index = 0; i_index < USBH_PHASE_NUM; i_index ++)
+    {
+      total += uhost->phase_time[i_index];
+    }
+    USBH_DEBUG("attach: %d ms", total);
+  }
 }
+#endif
 
 /**
   * @brief  usb host attached
@@ -1021,6 +1091,8 @@ static void usbh_enumeration(usbh_core_type *uhost)
   /* enumeration process */
   if(usbh_enum_handler(uhost) == USB_OK)
   {
+    usbh_phase_done(uhost, USBH_PHASE_ENUMERATION);
+
     /* user enumeration done callback */
     uhost->user_handler->user_enumeration_done();
     uhost->global_state  = USBH_USER_HANDLER;
@@ -1040,6 +1112,7 @@ static void usbh_class_request(usbh_core_type *uhost)
   status = uhost->class_handler->request_handler((void *)uhost);
   if(status == USB_OK)
   {
+    usbh_phase_done(uhost, USBH_PHASE_CLASS_REQUEST);
     uhost->global_state = USBH_CLASS;
   }
   else if(status == USB_ERROR || status == USB_FAIL)
@@ -1153,6 +1226,10 @@ usb_sts_type usbh_loop_handler(usbh_core_type *uhost)
       uhost->global_state != USBH_IDLE &&
       uhost->global_state != USBH_DISCONNECT)
   {
+    if(uhost->global_state == USBH_PORT_RESET)
+    {
+      usbh_set_port_reset(uhost, FALSE);
+    }
     uhost->global_state  = USBH_IDLE;
   }
   switch(uhost->global_state)
@@ -1160,28 +1237,78 @@ usb_sts_type usbh_loop_handler(usbh_core_type *uhost)
     case USBH_IDLE:
       if(uhost->conn_sts == 1)
       {
+#ifdef USBH_ENUM_TIMING_ENABLE
+        uhost->phase = USBH_PHASE_DEBOUNCE;
+        uhost->phase_tick = usb_get_tick_ms();
+#endif
+#ifdef USBH_FAST_ATTACH_ENABLE
+        uhost->state_tick = usb_get_tick_ms();
+        uhost->global_state  = USBH_PORT_DEBOUNCE;
+#else
         uhost->global_state  = USBH_PORT_EN;
 
         /* wait stable */
         usb_delay_ms(200);
+        usbh_phase_done(uhost, USBH_PHASE_DEBOUNCE);
 
         /* port reset */
         usbh_reset_port(uhost);
 
+        /* user reset */
+        uhost->user_handler->user_reset();
+#endif
+      }
+      break;
+
+#ifdef USBH_FAST_ATTACH_ENABLE
+    case USBH_PORT_DEBOUNCE:
+      /* wait stable */
+      if(usb_get_tick_ms() - uhost->state_tick >= USBH_ATTACH_DEBOUNCE_TIME)
+      {
+        usbh_phase_done(uhost, USBH_PHASE_DEBOUNCE);
+
+        /* port reset, port_enable is set again when the reset ends */
+        uhost->port_enable = 0;
+        usbh_set_port_reset(uhost, TRUE);
+        uhost->state_tick = usb_get_tick_ms();
+        uhost->global_state  = USBH_PORT_RESET;
+      }
+      break;
+
+    case USBH_PORT_RESET:
+      if(usb_get_tick_ms() - uhost->state_tick >= USBH_PORT_RESET_TIME)
+      {
+        usbh_set_port_reset(uhost, FALSE);
+        uhost->global_state  = USBH_PORT_EN;
+
         /* user reset */
         uhost->user_handler->user_reset();
       }
       break;
+#endif
 
     case USBH_PORT_EN:
       if(uhost->port_enable)
       {
+        usbh_phase_done(uhost, USBH_PHASE_RESET);
         uhost->global_state  = USBH_ATTACHED;
+#ifdef USBH_FAST_ATTACH_ENABLE
+        uhost->state_tick = usb_get_tick_ms();
+#else
         usb_delay_ms(50);
+#endif
       }
       break;
 
     case USBH_ATTACHED:
+#ifdef USBH_FAST_ATTACH_ENABLE
+      /* reset recovery */
+      if(usb_get_tick_ms() - uhost->state_tick < USBH_RESET_RECOVERY_TIME)
+      {
+        break;
+      }
+#endif
+      usbh_phase_done(uhost, USBH_PHASE_RECOVERY);
       usbh_attached(uhost);
       break;
 
@@ -1195,6 +1322,7 @@ usb_sts_type usbh_loop_handler(usbh_core_type *uhost)
       {
         uhost->global_state = USBH_UNSUPPORT;
       }
+      usbh_phase_done(uhost, USBH_PHASE_CLASS_INIT);
       break;
 
     case USBH_CLASS_REQUEST:
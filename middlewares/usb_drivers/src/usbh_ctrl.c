@@ -43,6 +43,8 @@
 /* control timeout 5s */
 #define CTRL_TIMEOUT          5000
 
+extern uint8_t usbh_cfg_buffer[USBH_MAX_CFG_DESC_LEN]; /*!< usb host cfg buffer */
+
 /**
   * @brief  usb host control send setup packet
   * @param  uhost: to the structure of usbh_core_type
@@ -652,7 +654,43 @@ void usbh_parse_endpoint_desc(usb_endpoint_desc_type *ept_desc, uint8_t *buf)
 }
 
 /**
-  * @brief  usb host parse configure descriptor
+  * @brief  usb host add an interface alternate setting to the index
+  * @param  index: to the structure of usb_itf_index_type
+  * @param  buf: interface description data buffer
+  * @param  offset: offset of the interface descriptor in the configuration descriptor
+  * @retval none
+  */
+static void usbh_index_interface_alt(usb_itf_index_type *index, uint8_t *buf, uint16_t offset)
+{
+  usb_itf_alt_type *alt;
+  uint8_t itf_number = *(uint8_t *)(buf + 2);
+
+  if(index->alt_num >= USBH_MAX_ITF_ALT || itf_number >= USBH_MAX_ITF_NUM)
+  {
+    return;
+  }
+
+  alt = &index->alt[index->alt_num];
+  alt->offset                            = offset;
+  alt->bInterfaceNumber                  = itf_number;
+  alt->bAlternateSetting                 = *(uint8_t *)(buf + 3);
+  alt->bNumEndpoints                     = *(uint8_t *)(buf + 4);
+  alt->bInterfaceClass                   = *(uint8_t *)(buf + 5);
+  alt->bInterfaceSubClass                = *(uint8_t *)(buf + 6);
+  alt->bInterfaceProtocol                = *(uint8_t *)(buf + 7);
+
+  if(index->itf_first[itf_number] == USBH_ITF_ALT_NONE)
+  {
+    index->itf_first[itf_number] = index->alt_num;
+  }
+  index->itf_alt_num[itf_number] ++;
+  index->alt_num ++;
+}
+
+/**
+  * @brief  usb host parse configure descriptor, fills the first interfaces
+  *         and their endpoints, and indexes every interface alternate setting
+  *         in one pass over the descriptor
   * @param  uhost: to the structure of usbh_core_type
   * @param  buffer: configure buffer
   * @param  length: configure length
@@ -662,7 +700,8 @@ usb_sts_type usbh_parse_configure_desc(usbh_core_type *uhost,
                                   uint8_t *buffer, uint16_t length)
 {
   usb_cfg_desc_type *cfg_desc = &(uhost->dev.cfg_desc);
-  usb_interface_desc_type *intf_desc;
+  usb_itf_index_type *index = &(cfg_desc->index);
+  usb_interface_desc_type *intf_desc = 0;
   usb_endpoint_desc_type *ept_desc;
   usb_header_desc_type *desc;
   uint16_t index_len;
@@ -679,30 +718,56 @@ usb_sts_type usbh_parse_configure_desc(usbh_core_type *uhost,
   cfg_desc->cfg.bmAttributes                 = *(uint8_t *)(buffer + 7);
   cfg_desc->cfg.bMaxPower                    = *(uint8_t *)(buffer + 8);
 
+  index->alt_num = 0;
+  for(index_len = 0; index_len < USBH_MAX_ITF_NUM; index_len ++)
+  {
+    index->itf_first[index_len] = USBH_ITF_ALT_NONE;
+    index->itf_alt_num[index_len] = 0;
+  }
+
+  if(length > cfg_desc->cfg.wTotalLength)
+  {
+    length = cfg_desc->cfg.wTotalLength;
+  }
+
   if(length > USB_DEVICE_CFG_DESC_LEN)
   {
-    index_len = USB_DEVICE_CFG_DESC_LEN;
+    /* offset of desc, the first usbh_get_next_header steps over the
+       configuration descriptor */
+    index_len = 0;
 
-    while((index_intf < USBH_MAX_INTERFACE) && index_len < cfg_desc->cfg.wTotalLength)
+    while(1)
     {
       desc = usbh_get_next_header((uint8_t *)desc, &index_len);
+
+      /* check the header is in the buffer before reading it, a zero or
+         one byte length would never move on */
+      if(index_len + 2 > length || desc->bLength < 2 ||
+         index_len + desc->bLength > length)
+      {
+        /* end of the configuration, truncated or broken descriptor */
+        break;
+      }
+
       if(desc->bDescriptorType == USB_DESCIPTOR_TYPE_INTERFACE)
       {
-        index_ept = 0;
-        intf_desc = &cfg_desc->interface[index_intf].interface;
-        usbh_parse_interface_desc(intf_desc, (uint8_t *)desc);
+        usbh_index_interface_alt(index, (uint8_t *)desc, index_len);
 
-        while(index_ept < intf_desc->bNumEndpoints && index_len < cfg_desc->cfg.wTotalLength)
+        intf_desc = 0;
+        if(index_intf < USBH_MAX_INTERFACE)
         {
-          desc = usbh_get_next_header((uint8_t *)desc, &index_len);
-          if(desc->bDescriptorType == USB_DESCIPTOR_TYPE_ENDPOINT)
-          {
-            ept_desc = &(cfg_desc->interface[index_intf].endpoint[index_ept]);
-            usbh_parse_endpoint_desc(ept_desc, (uint8_t *)desc);
-            index_ept ++;
-          }
+          index_ept = 0;
+          intf_desc = &cfg_desc->interface[index_intf].interface;
+          usbh_parse_interface_desc(intf_desc, (uint8_t *)desc);
+          index_intf ++;
         }
-        index_intf ++;
+      }
+      else if(desc->bDescriptorType == USB_DESCIPTOR_TYPE_ENDPOINT && intf_desc != 0 &&
+              index_ept < intf_desc->bNumEndpoints && index_ept < USBH_MAX_ENDPOINT)
+      {
+        ept_desc = &(cfg_desc->interface[index_intf - 1].endpoint[index_ept]);
+        usbh_parse_endpoint_desc(ept_desc, (uint8_t *)desc);
+        index_ept ++;
       }
     }
   }
@@ -735,6 +800,100 @@ uint8_t usbh_find_interface(usbh_core_type *uhost, uint8_t class_code, uint8_t s
   return 0xFF;
 }
 
+/**
+  * @brief  usb host find an interface alternate setting in the index
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  itf_number: interface number
+  * @param  alt_setting: alternate setting
+  * @retval alt_idx: index of the alternate setting, USBH_ITF_ALT_NONE if not found
+  */
+uint16_t usbh_find_interface_alt(usbh_core_type *uhost, uint8_t itf_number, uint8_t alt_setting)
+{
+  usb_itf_index_type *index = &uhost->dev.cfg_desc.index;
+  uint16_t first, idx;
+
+  if(itf_number >= USBH_MAX_ITF_NUM || index->itf_first[itf_number] == USBH_ITF_ALT_NONE)
+  {
+    return USBH_ITF_ALT_NONE;
+  }
+  first = index->itf_first[itf_number];
+
+  /* alternate settings are numbered from 0 and follow each other */
+  idx = first + alt_setting;
+  if(alt_setting < index->itf_alt_num[itf_number] && idx < index->alt_num &&
+     index->alt[idx].bInterfaceNumber == itf_number &&
+     index->alt[idx].bAlternateSetting == alt_setting)
+  {
+    return idx;
+  }
+
+  for(idx = first; idx < index->alt_num; idx ++)
+  {
+    if(index->alt[idx].bInterfaceNumber == itf_number &&
+       index->alt[idx].bAlternateSetting == alt_setting)
+    {
+      return idx;
+    }
+  }
+  return USBH_ITF_ALT_NONE;
+}
+
+/**
+  * @brief  usb host find the alternate setting of the first interface of a class
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  class_code: class code
+  * @param  sub_class: subclass code, 0xFF matches any
+  * @param  alt_setting: alternate setting
+  * @retval alt_idx: index of the alternate setting, USBH_ITF_ALT_NONE if not found
+  */
+uint16_t usbh_find_class_alt(usbh_core_type *uhost, uint8_t class_code, uint8_t sub_class, uint8_t alt_setting)
+{
+  usb_itf_index_type *index = &uhost->dev.cfg_desc.index;
+  usb_itf_alt_type *alt;
+  uint8_t itf_number;
+
+  for(itf_number = 0; itf_number < USBH_MAX_ITF_NUM; itf_number ++)
+  {
+    if(index->itf_first[itf_number] == USBH_ITF_ALT_NONE)
+    {
+      continue;
+    }
+    alt = &index->alt[index->itf_first[itf_number]];
+    if((alt->bInterfaceClass == class_code) &&
+       ((alt->bInterfaceSubClass == sub_class) || (sub_class == 0xFF)))
+    {
+      return usbh_find_interface_alt(uhost, itf_number, alt_setting);
+    }
+  }
+  return USBH_ITF_ALT_NONE;
+}
+
+/**
+  * @brief  usb host get the descriptors of an interface alternate setting,
+  *         from its interface descriptor up to the next interface descriptor
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  alt_idx: index of the alternate setting
+  * @param  length: returns the length of the descriptors
+  * @retval pointer to the interface descriptor in the configuration buffer
+  */
+uint8_t *usbh_get_interface_alt_desc(usbh_core_type *uhost, uint16_t alt_idx, uint16_t *length)
+{
+  usb_itf_index_type *index = &uhost->dev.cfg_desc.index;
+  uint16_t end = uhost->dev.cfg_desc.cfg.wTotalLength;
+
+  if(end > USBH_MAX_CFG_DESC_LEN)
+  {
+    end = USBH_MAX_CFG_DESC_LEN;
+  }
+  if(alt_idx + 1 < index->alt_num)
+  {
+    end = index->alt[alt_idx + 1].offset;
+  }
+
+  *length = end - index->alt[alt_idx].offset;
+  return &usbh_cfg_buffer[index->alt[alt_idx].offset];
+}
+
 /**
   * @brief  usbh parse string descriptor
   * @param  src: string source pointer
@@ -795,8 +954,14 @@ usb_sts_type usbh_get_configure_descriptor(usbh_core_type *uhost, uint16_t lengt
   bm_req = USB_REQ_RECIPIENT_DEVICE | USB_REQ_TYPE_STANDARD;
   wvalue = (USB_DESCIPTOR_TYPE_CONFIGURATION << 8) & 0xFF00;
 
+  /* the whole configuration does not fit in rx_buffer, it is received
+     in the configuration buffer the class drivers parse */
+  if(length > USBH_MAX_CFG_DESC_LEN)
+  {
+    length = USBH_MAX_CFG_DESC_LEN;
+  }
   status = usbh_get_descriptor(uhost, length, bm_req,
-                               wvalue, uhost->rx_buffer);
+                               wvalue, usbh_cfg_buffer);
 
   return status;
 }
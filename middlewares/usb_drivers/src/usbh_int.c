@@ -39,6 +39,80 @@
   * @{
   */
 
+#ifdef USBH_RX_DMA_ENABLE
+/* packet being drained by the edma, the cpu reads its last partial word */
+static struct
+{
+  otg_global_type *usbx;
+  uint8_t *tail_buf;
+  uint16_t tail_bytes;
+} usbh_rx_dma;
+
+/**
+  * @brief  start draining a received packet from the rx fifo by the edma.
+  *         the rx fifo level interrupt stays masked until the transfer
+  *         finished, see usbh_rx_dma_irq_handler.
+  * @param  usbx: to select the otgfs peripheral.
+  * @param  pusr_buf: point to user buffer
+  * @param  nbytes: number of bytes of the packet
+  * @retval none
+  */
+static void usbh_rx_dma_start(otg_global_type *usbx, uint8_t *pusr_buf, uint16_t nbytes)
+{
+  edma_init_type edma_init_struct;
+
+  edma_stream_enable(USBH_RX_DMA_STREAM, FALSE);
+  edma_flag_clear(USBH_RX_DMA_FLAGS);
+
+  /* the usb fifo is the fixed source, the edma fifo unpacks its words
+     into bytes when the user buffer is not word aligned */
+  edma_default_para_init(&edma_init_struct);
+  edma_init_struct.direction = EDMA_DIR_MEMORY_TO_MEMORY;
+  edma_init_struct.peripheral_base_addr = (uint32_t)&USB_FIFO(usbx, 0);
+  edma_init_struct.peripheral_inc_enable = FALSE;
+  edma_init_struct.peripheral_data_width = EDMA_PERIPHERAL_DATA_WIDTH_WORD;
+  edma_init_struct.memory0_base_addr = (uint32_t)pusr_buf;
+  edma_init_struct.memory_inc_enable = TRUE;
+  if(((uint32_t)pusr_buf & 0x3) == 0)
+    edma_init_struct.memory_data_width = EDMA_MEMORY_DATA_WIDTH_WORD;
+  else
+    edma_init_struct.memory_data_width = EDMA_MEMORY_DATA_WIDTH_BYTE;
+  /* counted in source words, the partial last word is left to the cpu */
+  edma_init_struct.buffer_size = nbytes >> 2;
+  edma_init_struct.priority = EDMA_PRIORITY_HIGH;
+  edma_init_struct.fifo_mode_enable = TRUE;
+  edma_init_struct.fifo_threshold = EDMA_FIFO_THRESHOLD_FULL;
+  edma_init(USBH_RX_DMA_STREAM, &edma_init_struct);
+  edma_interrupt_enable(USBH_RX_DMA_STREAM, EDMA_FDT_INT, TRUE);
+
+  usbh_rx_dma.usbx = usbx;
+  usbh_rx_dma.tail_buf = pusr_buf + (nbytes & ~0x3);
+  usbh_rx_dma.tail_bytes = nbytes & 0x3;
+
+  edma_stream_enable(USBH_RX_DMA_STREAM, TRUE);
+}
+
+/**
+  * @brief  usb host rx fifo edma interrupt handler, reads the rest of
+  *         the packet and unmasks the rx fifo level interrupt
+  * @param  none
+  * @retval none
+  */
+void usbh_rx_dma_irq_handler(void)
+{
+  if(edma_flag_get(USBH_RX_DMA_FDT_FLAG) != RESET)
+  {
+    edma_flag_clear(USBH_RX_DMA_FLAGS);
+
+    if(usbh_rx_dma.tail_bytes > 0)
+    {
+      usb_read_packet(usbh_rx_dma.usbx, usbh_rx_dma.tail_buf, 0, usbh_rx_dma.tail_bytes);
+    }
+    usbh_rx_dma.usbx->gintmsk_bit.rxflvlmsk = 1;
+  }
+}
+#endif
+
 /**
   * @brief  usb host interrupt handler
   * @param  otgdev: to the structure of otg_core_type
@@ -183,6 +257,7 @@ void usbh_hch_in_handler(usbh_core_type *uhost, uint8_t chn)
   else if(hcint_value & USB_OTG_HC_FRMOVRRUN_FLAG)
   {
     usb_chh->hcintmsk_bit.chhltdmsk = TRUE;
+    uhost->hch[chn].state = HCH_FRMOVRRUN;
     usb_hch_halt(usbx, chn);
     usb_chh->hcint = USB_OTG_HC_FRMOVRRUN_FLAG;
   }
@@ -205,6 +280,10 @@ void usbh_hch_in_handler(usbh_core_type *uhost, uint8_t chn)
     else if(usb_chh->hcchar_bit.eptype == EPT_ISO_TYPE)
     {
       uhost->urb_state[chn] = URB_DONE;
+      if(uhost->hch_callback[chn] != NULL)
+      {
+        uhost->hch_callback[chn](uhost, chn, URB_DONE);
+      }
     }
     uhost->hch[chn].toggle_in ^= 1;
   }
@@ -241,6 +320,16 @@ void usbh_hch_in_handler(usbh_core_type *uhost, uint8_t chn)
       usb_chh->hcchar_bit.chena = TRUE;
       uhost->urb_state[chn] = URB_NOTREADY;
     }
+    else if(uhost->hch[chn].state == HCH_FRMOVRRUN ||
+            uhost->hch[chn].state == HCH_BBLERR)
+    {
+      /* the class decides how to recover from periodic overruns */
+      uhost->urb_state[chn] = URB_ERROR;
+      if(uhost->hch_callback[chn] != NULL)
+      {
+        uhost->hch_callback[chn](uhost, chn, URB_ERROR);
+      }
+    }
     usb_chh->hcint = USB_OTG_HC_CHHLTD_FLAG;
   }
   else if(hcint_value & USB_OTG_HC_XACTERR_FLAG)
@@ -272,6 +361,9 @@ void usbh_hch_in_handler(usbh_core_type *uhost, uint8_t chn)
   }
   else if(hcint_value & USB_OTG_HC_BBLERR_FLAG)
   {
+    usb_chh->hcintmsk_bit.chhltdmsk = TRUE;
+    uhost->hch[chn].state = HCH_BBLERR;
+    usb_hch_halt(usbx, chn);
     usb_chh->hcint = USB_OTG_HC_BBLERR_FLAG;
   }
 }
@@ -419,6 +511,9 @@ void usbh_rx_qlvl_handler(usbh_core_type *uhost)
   uint32_t tmp;
   otg_hchannel_type *ch;
   otg_global_type *usbx = uhost->usb_reg;
+#ifdef USBH_RX_DMA_ENABLE
+  confirm_state rx_dma = FALSE;
+#endif
 
   usbx->gintmsk_bit.rxflvlmsk = 0;
 
@@ -432,7 +527,17 @@ void usbh_rx_qlvl_handler(usbh_core_type *uhost)
     case PKTSTS_IN_DATA_PACKET_RECV:
       if(pktcnt > 0 && (uhost->hch[chn].trans_buf) != 0)
       {
-        usb_read_packet(usbx, uhost->hch[chn].trans_buf, chn, pktcnt);
+#ifdef USBH_RX_DMA_ENABLE
+        if(pktcnt >= USBH_RX_DMA_MIN_SIZE)
+        {
+          usbh_rx_dma_start(usbx, uhost->hch[chn].trans_buf, pktcnt);
+          rx_dma = TRUE;
+        }
+        else
+#endif
+        {
+          usb_read_packet(usbx, uhost->hch[chn].trans_buf, chn, pktcnt);
+        }
         uhost->hch[chn].trans_buf += pktcnt;
         uhost->hch[chn].trans_count += pktcnt;
 
@@ -454,6 +559,13 @@ void usbh_rx_qlvl_handler(usbh_core_type *uhost)
       break;
 
   }
+#ifdef USBH_RX_DMA_ENABLE
+  /* the packet is still in the fifo, unmasked when the edma finished */
+  if(rx_dma == TRUE)
+  {
+    return;
+  }
+#endif
   usbx->gintmsk_bit.rxflvlmsk = 1;
 }
 
@@ -43,6 +43,7 @@
   */
 
 static usb_sts_type usbh_bot_cbw(msc_bot_cbw_type *cbw, uint32_t data_length, uint8_t cmd_len, uint8_t flag);
+static void usbh_bot_data_in(usbh_core_type *puhost, msc_bot_trans_type *bot_trans);
 static usb_sts_type usbh_cmd_inquiry(msc_bot_trans_type *bot_trans, uint8_t *cmd, uint8_t lun);
 static usb_sts_type usbh_cmd_capacity10(msc_bot_trans_type *bot_trans, uint8_t *cmd, uint8_t lun);
 static usb_sts_type usbh_cmd_test_unit_ready(msc_bot_trans_type *bot_trans, uint8_t *cmd, uint8_t lun);
@@ -218,6 +219,26 @@ usb_sts_type usbh_check_csw(void *uhost, msc_bot_cbw_type *cbw, msc_bot_csw_type
   return status;
 }
 
+/**
+  * @brief  usb host bulk-only receive the next part of the data stage,
+  *         the core chains the packets of one urb without the class
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  bot_trans: to the structure of msc_bot_trans_type
+  * @retval none
+  */
+static void usbh_bot_data_in(usbh_core_type *puhost, msc_bot_trans_type *bot_trans)
+{
+  usbh_msc_type *msc_struct = (usbh_msc_type *)bot_trans->msc_struct;
+
+  bot_trans->data_len = bot_trans->cbw.dCBWDataTransferLength;
+  if(bot_trans->data_len > MSC_BOT_MAX_IN_LEN)
+  {
+    bot_trans->data_len = MSC_BOT_MAX_IN_LEN;
+  }
+  usbh_bulk_recv(puhost, msc_struct->chin, bot_trans->data,
+                 (uint16_t)bot_trans->data_len);
+}
+
 /**
   * @brief  usb host msc bulk-only request
   * @param  uhost: to the structure of usbh_core_type
@@ -229,6 +250,7 @@ usb_sts_type usb_bot_request(void *uhost, msc_bot_trans_type *bot_trans)
   usb_sts_type status = USB_WAIT;
   urb_sts_type urb_status;
   usb_sts_type clr_status;
+  uint32_t recv_len;
   usbh_core_type *puhost = (usbh_core_type *)uhost;
   usbh_msc_type *msc_struct = (usbh_msc_type *)bot_trans->msc_struct;
   switch(bot_trans->bot_state)
@@ -269,8 +291,7 @@ usb_sts_type usb_bot_request(void *uhost, msc_bot_trans_type *bot_trans)
       break;
 
     case BOT_STATE_DATA_IN:
-      usbh_bulk_recv(puhost, msc_struct->chin, bot_trans->data,
-                     msc_struct->in_maxpacket);
+      usbh_bot_data_in(puhost, bot_trans);
       bot_trans->bot_state = BOT_STATE_DATA_IN_WAIT;
       break;
 
@@ -278,22 +299,17 @@ usb_sts_type usb_bot_request(void *uhost, msc_bot_trans_type *bot_trans)
       urb_status = usbh_get_urb_status(puhost, msc_struct->chin);
       if(urb_status == URB_DONE)
       {
-        if(bot_trans->cbw.dCBWDataTransferLength > msc_struct->in_maxpacket)
+        recv_len = puhost->hch[msc_struct->chin].trans_count;
+        if(recv_len < bot_trans->cbw.dCBWDataTransferLength && recv_len >= bot_trans->data_len)
         {
-          bot_trans->data += msc_struct->in_maxpacket;
-          bot_trans->cbw.dCBWDataTransferLength -= msc_struct->in_maxpacket;
+          bot_trans->data += recv_len;
+          bot_trans->cbw.dCBWDataTransferLength -= recv_len;
+          usbh_bot_data_in(puhost, bot_trans);
         }
         else
         {
+          /* all data received or the device ended the stage with a short packet */
           bot_trans->cbw.dCBWDataTransferLength = 0;
-        }
-        if(bot_trans->cbw.dCBWDataTransferLength > 0)
-        {
-          usbh_bulk_recv(puhost, msc_struct->chin, bot_trans->data,
-                     msc_struct->in_maxpacket);
-        }
-        else
-        {
           bot_trans->bot_state = BOT_STATE_RECV_CSW;
         }
       }
@@ -566,7 +582,7 @@ usb_sts_type usbh_msc_bot_scsi_write(void *uhost, msc_bot_trans_type *bot_trans,
   switch(bot_trans->cmd_state)
   {
     case CMD_STATE_SEND:
-      usbh_bot_cbw(&bot_trans->cbw, write_len * 512,
+      usbh_bot_cbw(&bot_trans->cbw, write_len * USBH_MSC_BLOCK_SIZE,
                    MSC_WRITE_CMD_LEN, MSC_CBW_FLAG_OUT);
       bot_trans->cbw.bCBWLUN = lun;
       usbh_cmd_write(bot_trans, bot_trans->cbw.CBWCB, lun, write_len, address, write_data);
@@ -609,7 +625,7 @@ usb_sts_type usbh_msc_bot_scsi_read(void *uhost, msc_bot_trans_type *bot_trans,
   switch(bot_trans->cmd_state)
   {
     case CMD_STATE_SEND:
-      usbh_bot_cbw(&bot_trans->cbw, read_len * 512,
+      usbh_bot_cbw(&bot_trans->cbw, read_len * USBH_MSC_BLOCK_SIZE,
                    MSC_READ_CMD_LEN, MSC_CBW_FLAG_IN);
       bot_trans->cbw.bCBWLUN = lun;
       usbh_cmd_read(bot_trans, bot_trans->cbw.CBWCB, lun, read_len, address, read_data);
@@ -65,6 +65,7 @@ extern "C" {
 #define MSC_REQUEST_SENSE_DATA_LEN       18
 #define MSC_WRITE_CMD_LEN                12
 #define MSC_READ_CMD_LEN                 10
+#define MSC_BOT_MAX_IN_LEN               8192  /*!< data-in bytes per bulk urb, multiple of max packet */
 
 #define MSC_OPCODE_INQUIRY               0x12
 #define MSC_OPCODE_CAPACITY              0x25
@@ -182,6 +183,7 @@ typedef struct
   msc_cmd_state_type cmd_state;
   msc_bot_state_type bot_state;
   uint8_t *data;
+  uint32_t data_len;
   void *msc_struct;
 }msc_bot_trans_type;
 
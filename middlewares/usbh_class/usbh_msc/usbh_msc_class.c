@@ -27,6 +27,7 @@
 #include "usb_conf.h"
 #include "usbh_core.h"
 #include "usbh_ctrl.h"
+#include "string.h"
 
 /** @addtogroup AT32F435_437_middlewares_usbh_class
   * @{
@@ -49,6 +50,17 @@ static usb_sts_type uhost_process_handler(void *uhost);
 static usb_sts_type usbh_msc_get_max_lun(void *uhost, uint8_t *lun);
 static usb_sts_type usbh_msc_clear_feature(void *uhost, uint8_t ept_num);
 
+static uint8_t usbh_msc_queue_busy(usbh_msc_type *pmsc);
+static uint8_t usbh_msc_overlap(uint8_t lun_a, uint32_t lba_a, uint32_t count_a,
+                                uint8_t lun_b, uint32_t lba_b, uint32_t count_b);
+static void usbh_msc_queue_handle(usbh_core_type *puhost);
+static void usbh_msc_queue_start(usbh_core_type *puhost, usbh_msc_type *pmsc);
+static void usbh_msc_queue_abort(usbh_core_type *puhost, usbh_msc_type *pmsc);
+static void usbh_msc_req_done(usbh_core_type *puhost, usbh_msc_type *pmsc, usb_sts_type status);
+static void usbh_msc_xfer_start(usbh_msc_type *pmsc, usbh_msc_xfer_state_type state, uint8_t lun,
+                                uint32_t lba, uint32_t count, uint8_t *buffer, uint8_t n_req);
+static usb_sts_type usbh_msc_drain(usbh_core_type *puhost, usbh_msc_type *pmsc);
+
 
 usbh_msc_type usbh_msc;
 
@@ -115,6 +127,16 @@ static usb_sts_type uhost_init_handler(void *uhost)
   }
 
   msc_bot_scsi_init(pmsc);
+  pmsc->req_head = 0;
+  pmsc->req_tail = 0;
+  pmsc->xfer.state = USBH_MSC_XFER_IDLE;
+#if USBH_MSC_WB_BLOCKS
+  pmsc->wb_count = 0;
+  pmsc->wb_flush = 0;
+#endif
+#if USBH_MSC_RA_BLOCKS
+  pmsc->ra_count = 0;
+#endif
   usbh_set_toggle(puhost, pmsc->chout, 0);
   usbh_set_toggle(puhost, pmsc->chin, 0);
   return status;
@@ -132,6 +154,12 @@ static usb_sts_type uhost_reset_handler(void *uhost)
   usb_sts_type status = USB_OK;
   uint8_t i_index = 0;
 
+  if(pmsc != NULL)
+  {
+    /* the device is gone, fail whatever is still queued */
+    usbh_msc_queue_abort(puhost, pmsc);
+  }
+
   if(puhost->class_handler->pdata)
   {
     return status;
@@ -296,6 +324,7 @@ static usb_sts_type uhost_process_handler(void *uhost)
       }
       break;
     case USBH_MSC_IDLE:
+    usbh_msc_queue_handle(puhost);
     if(puhost->user_handler->user_application != NULL)
     {
       puhost->user_handler->user_application();
@@ -380,6 +409,459 @@ msc_error_type usbh_msc_is_ready(void *uhost, uint8_t lun)
 }
 
 
+/**
+  * @brief  usb host msc check if a queued request, a transfer or buffered
+  *         write data is still pending
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @retval 1: pending, 0: idle
+  */
+static uint8_t usbh_msc_queue_busy(usbh_msc_type *pmsc)
+{
+  if(pmsc->req_head != pmsc->req_tail || pmsc->xfer.state != USBH_MSC_XFER_IDLE)
+  {
+    return 1;
+  }
+#if USBH_MSC_WB_BLOCKS
+  if(pmsc->wb_count != 0)
+  {
+    return 1;
+  }
+#endif
+  return 0;
+}
+
+/**
+  * @brief  usb host msc check if two block ranges share a block
+  * @param  lun_a: logical unit of the first range
+  * @param  lba_a: first block of the first range
+  * @param  count_a: blocks of the first range, 0 for an empty range
+  * @param  lun_b: logical unit of the second range
+  * @param  lba_b: first block of the second range
+  * @param  count_b: blocks of the second range, 0 for an empty range
+  * @retval 1: overlap, 0: disjoint
+  */
+static uint8_t usbh_msc_overlap(uint8_t lun_a, uint32_t lba_a, uint32_t count_a,
+                                uint8_t lun_b, uint32_t lba_b, uint32_t count_b)
+{
+  if(count_a == 0 || count_b == 0 || lun_a != lun_b)
+  {
+    return 0;
+  }
+  return (lba_a < lba_b + count_b && lba_b < lba_a + count_a);
+}
+
+/**
+  * @brief  usb host msc start a read10 or write10 on the bulk pipes
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @param  state: what the transfer is for
+  * @param  lun: logical unit number
+  * @param  lba: first logical block
+  * @param  count: number of blocks
+  * @param  buffer: transfer data buffer
+  * @param  n_req: queued requests the transfer completes
+  * @retval none
+  */
+static void usbh_msc_xfer_start(usbh_msc_type *pmsc, usbh_msc_xfer_state_type state, uint8_t lun,
+                                uint32_t lba, uint32_t count, uint8_t *buffer, uint8_t n_req)
+{
+  uint8_t dir_out = (state == USBH_MSC_XFER_FLUSH);
+
+  if(state == USBH_MSC_XFER_REQUEST)
+  {
+    dir_out = (pmsc->req_queue[pmsc->req_head].dir == USBH_MSC_DIR_WRITE);
+  }
+
+  pmsc->xfer.state = state;
+  pmsc->xfer.lun = lun;
+  pmsc->xfer.lba = lba;
+  pmsc->xfer.count = count;
+  pmsc->xfer.buffer = buffer;
+  pmsc->xfer.n_req = n_req;
+
+  pmsc->bot_trans.msc_struct = pmsc;
+  pmsc->l_unit_n[lun].state = dir_out ? USBH_MSC_WRITE : USBH_MSC_READ10;
+  pmsc->use_lun = lun;
+}
+
+/**
+  * @brief  usb host msc remove the oldest queued request and report it
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @param  status: USB_OK or USB_FAIL
+  * @retval none
+  */
+static void usbh_msc_req_done(usbh_core_type *puhost, usbh_msc_type *pmsc, usb_sts_type status)
+{
+  /* the slot may be reused by a submit from the callback */
+  usbh_msc_req_type req = pmsc->req_queue[pmsc->req_head];
+
+  pmsc->req_head = (pmsc->req_head + 1) & (USBH_MSC_QUEUE_SIZE - 1);
+  if(req.cb != NULL)
+  {
+    req.cb(puhost, req.lun, req.lba, req.count, status);
+  }
+}
+
+/**
+  * @brief  usb host msc pick the next thing to do for the queue while the
+  *         bulk pipes are free. small writes are copied to the write-behind
+  *         buffer and completed at once, small reads are served from the
+  *         read-ahead window, everything else becomes one read10/write10
+  *         together with the requests that continue it
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @retval none
+  */
+static void usbh_msc_queue_start(usbh_core_type *puhost, usbh_msc_type *pmsc)
+{
+  usbh_msc_req_type *req, *next;
+  uint32_t count;
+  uint8_t n_req, n_queue;
+#if USBH_MSC_RA_BLOCKS
+  uint32_t last_lba;
+#endif
+
+  if(pmsc->req_head == pmsc->req_tail)
+  {
+#if USBH_MSC_WB_BLOCKS
+    /* nothing more to append for a while, write the buffer back */
+    if(pmsc->wb_count != 0 &&
+       (pmsc->wb_flush || (puhost->timer - pmsc->wb_timer) > USBH_MSC_WB_FLUSH_TIME))
+    {
+      usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_FLUSH, pmsc->wb_lun, pmsc->wb_lba,
+                          pmsc->wb_count, pmsc->wb_buf, 0);
+    }
+#endif
+    return;
+  }
+
+  req = &pmsc->req_queue[pmsc->req_head];
+
+  if(req->dir == USBH_MSC_DIR_WRITE)
+  {
+#if USBH_MSC_RA_BLOCKS
+    if(usbh_msc_overlap(pmsc->ra_lun, pmsc->ra_lba, pmsc->ra_count,
+                        req->lun, req->lba, req->count))
+    {
+      pmsc->ra_count = 0;
+    }
+#endif
+#if USBH_MSC_WB_BLOCKS
+    if(pmsc->wb_count != 0 &&
+       (pmsc->wb_lun != req->lun || pmsc->wb_lba + pmsc->wb_count != req->lba ||
+        pmsc->wb_count + req->count > USBH_MSC_WB_BLOCKS))
+    {
+      /* the write does not continue the buffer, keep the order on the device */
+      usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_FLUSH, pmsc->wb_lun, pmsc->wb_lba,
+                          pmsc->wb_count, pmsc->wb_buf, 0);
+      return;
+    }
+    if(req->count <= USBH_MSC_WB_BLOCKS)
+    {
+      if(pmsc->wb_count == 0)
+      {
+        pmsc->wb_lun = req->lun;
+        pmsc->wb_lba = req->lba;
+      }
+      memcpy(&pmsc->wb_buf[pmsc->wb_count * USBH_MSC_BLOCK_SIZE], req->buffer,
+             req->count * USBH_MSC_BLOCK_SIZE);
+      pmsc->wb_count += req->count;
+      pmsc->wb_timer = puhost->timer;
+      usbh_msc_req_done(puhost, pmsc, USB_OK);
+
+      if(pmsc->wb_count == USBH_MSC_WB_BLOCKS)
+      {
+        usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_FLUSH, pmsc->wb_lun, pmsc->wb_lba,
+                            pmsc->wb_count, pmsc->wb_buf, 0);
+      }
+      return;
+    }
+#endif
+  }
+  else
+  {
+#if USBH_MSC_WB_BLOCKS
+    if(usbh_msc_overlap(pmsc->wb_lun, pmsc->wb_lba, pmsc->wb_count,
+                        req->lun, req->lba, req->count))
+    {
+      /* the device has to see the buffered blocks first */
+      usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_FLUSH, pmsc->wb_lun, pmsc->wb_lba,
+                          pmsc->wb_count, pmsc->wb_buf, 0);
+      return;
+    }
+#endif
+#if USBH_MSC_RA_BLOCKS
+    if(pmsc->ra_count != 0 && pmsc->ra_lun == req->lun &&
+       req->lba >= pmsc->ra_lba && req->lba + req->count <= pmsc->ra_lba + pmsc->ra_count)
+    {
+      memcpy(req->buffer, &pmsc->ra_buf[(req->lba - pmsc->ra_lba) * USBH_MSC_BLOCK_SIZE],
+             req->count * USBH_MSC_BLOCK_SIZE);
+      usbh_msc_req_done(puhost, pmsc, USB_OK);
+      return;
+    }
+    if(req->count < USBH_MSC_RA_BLOCKS)
+    {
+      /* read capacity reports the last block, do not read past it */
+      last_lba = pmsc->l_unit_n[req->lun].capacity.blk_nbr;
+      count = USBH_MSC_RA_BLOCKS;
+      if(req->lba <= last_lba && last_lba - req->lba + 1 < count)
+      {
+        count = last_lba - req->lba + 1;
+      }
+      if(count > req->count)
+      {
+        pmsc->ra_count = 0;
+        usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_READ_AHEAD, req->lun, req->lba,
+                            count, pmsc->ra_buf, 0);
+        return;
+      }
+    }
+#endif
+  }
+
+  /* merge the requests that go on where this one ends, on the device and in memory */
+  n_queue = (pmsc->req_tail - pmsc->req_head) & (USBH_MSC_QUEUE_SIZE - 1);
+  count = req->count;
+  for(n_req = 1; n_req < n_queue; n_req ++)
+  {
+    next = &pmsc->req_queue[(pmsc->req_head + n_req) & (USBH_MSC_QUEUE_SIZE - 1)];
+    if(next->lun != req->lun || next->dir != req->dir ||
+       next->lba != req->lba + count ||
+       next->buffer != req->buffer + count * USBH_MSC_BLOCK_SIZE ||
+       count + next->count > USBH_MSC_MAX_XFER_BLOCKS)
+    {
+      break;
+    }
+#if USBH_MSC_WB_BLOCKS
+    /* a read of buffered blocks has to wait for the flush, the next start does it */
+    if(req->dir == USBH_MSC_DIR_READ &&
+       usbh_msc_overlap(pmsc->wb_lun, pmsc->wb_lba, pmsc->wb_count,
+                        next->lun, next->lba, next->count))
+    {
+      break;
+    }
+#endif
+    count += next->count;
+  }
+
+#if USBH_MSC_RA_BLOCKS
+  /* the merged write may reach into the window past the first request */
+  if(req->dir == USBH_MSC_DIR_WRITE &&
+     usbh_msc_overlap(pmsc->ra_lun, pmsc->ra_lba, pmsc->ra_count,
+                      req->lun, req->lba, count))
+  {
+    pmsc->ra_count = 0;
+  }
+#endif
+
+  usbh_msc_xfer_start(pmsc, USBH_MSC_XFER_REQUEST, req->lun, req->lba, count, req->buffer, n_req);
+}
+
+/**
+  * @brief  usb host msc run one step of the request queue, called from the
+  *         class process handler
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void usbh_msc_queue_handle(usbh_core_type *puhost)
+{
+  usbh_msc_type *pmsc = (usbh_msc_type *)puhost->class_handler->pdata;
+  usbh_msc_req_type done[USBH_MSC_QUEUE_SIZE];
+  usbh_msc_xfer_state_type state;
+  usb_sts_type status;
+  uint8_t i_index, n_req;
+
+  if(pmsc->xfer.state == USBH_MSC_XFER_IDLE)
+  {
+    usbh_msc_queue_start(puhost, pmsc);
+    return;
+  }
+
+  status = usbh_msc_rw_handle(puhost, pmsc->xfer.lba, pmsc->xfer.count,
+                              pmsc->xfer.buffer, pmsc->xfer.lun);
+  if(status == USB_WAIT)
+  {
+    return;
+  }
+
+  state = pmsc->xfer.state;
+  pmsc->xfer.state = USBH_MSC_XFER_IDLE;
+  pmsc->l_unit_n[pmsc->xfer.lun].state = USBH_MSC_IDLE;
+
+  switch(state)
+  {
+    case USBH_MSC_XFER_REQUEST:
+      /* take them all off the queue first, a callback may submit again */
+      n_req = pmsc->xfer.n_req;
+      for(i_index = 0; i_index < n_req; i_index ++)
+      {
+        done[i_index] = pmsc->req_queue[pmsc->req_head];
+        pmsc->req_head = (pmsc->req_head + 1) & (USBH_MSC_QUEUE_SIZE - 1);
+      }
+      for(i_index = 0; i_index < n_req; i_index ++)
+      {
+        if(done[i_index].cb != NULL)
+        {
+          done[i_index].cb(puhost, done[i_index].lun, done[i_index].lba, done[i_index].count, status);
+        }
+      }
+      break;
+#if USBH_MSC_WB_BLOCKS
+    case USBH_MSC_XFER_FLUSH:
+      if(status != USB_OK)
+      {
+        /* the writes were already reported, usbh_msc_flush tells about the loss */
+        USBH_DEBUG("msc write-behind of %d blocks failed", pmsc->wb_count);
+        pmsc->error = MSC_ERROR;
+      }
+      pmsc->wb_count = 0;
+      pmsc->wb_flush = 0;
+      break;
+#endif
+#if USBH_MSC_RA_BLOCKS
+    case USBH_MSC_XFER_READ_AHEAD:
+      if(status == USB_OK)
+      {
+        /* the next step serves the request from the window */
+        pmsc->ra_lun = pmsc->xfer.lun;
+        pmsc->ra_lba = pmsc->xfer.lba;
+        pmsc->ra_count = pmsc->xfer.count;
+      }
+      else
+      {
+        usbh_msc_req_done(puhost, pmsc, USB_FAIL);
+      }
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  usb host msc fail every queued request and drop the buffers
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @retval none
+  */
+static void usbh_msc_queue_abort(usbh_core_type *puhost, usbh_msc_type *pmsc)
+{
+  pmsc->xfer.state = USBH_MSC_XFER_IDLE;
+#if USBH_MSC_WB_BLOCKS
+  pmsc->wb_count = 0;
+  pmsc->wb_flush = 0;
+#endif
+#if USBH_MSC_RA_BLOCKS
+  pmsc->ra_count = 0;
+#endif
+  while(pmsc->req_head != pmsc->req_tail)
+  {
+    usbh_msc_req_done(puhost, pmsc, USB_FAIL);
+  }
+}
+
+/**
+  * @brief  usb host msc run the queue until nothing is pending, the blocking
+  *         read and write keep their order with queued requests this way
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  pmsc: to the structure of usbh_msc_type
+  * @retval status: usb_sts_type status
+  */
+static usb_sts_type usbh_msc_drain(usbh_core_type *puhost, usbh_msc_type *pmsc)
+{
+  while(usbh_msc_queue_busy(pmsc))
+  {
+    if(puhost->conn_sts == 0)
+    {
+      return USB_FAIL;
+    }
+#if USBH_MSC_WB_BLOCKS
+    if(pmsc->wb_count != 0)
+    {
+      pmsc->wb_flush = 1;
+    }
+#endif
+    usbh_msc_queue_handle(puhost);
+  }
+  return USB_OK;
+}
+
+/**
+  * @brief  usb host msc queue a read or write of whole blocks, the request runs
+  *         from the class process handler and cb reports the result. a small
+  *         write may be reported before it reached the device, usbh_msc_flush
+  *         tells when the device has it
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  lun: logical unit number
+  * @param  lba: first logical block
+  * @param  count: number of blocks
+  * @param  buffer: data buffer, it has to stay valid until cb is called
+  * @param  dir: USBH_MSC_DIR_READ or USBH_MSC_DIR_WRITE
+  * @param  cb: done callback or NULL
+  * @retval status: USB_OK, USB_WAIT if the queue is full or USB_FAIL
+  */
+usb_sts_type usbh_msc_submit(void *uhost, uint8_t lun, uint32_t lba, uint32_t count,
+                             uint8_t *buffer, usbh_msc_dir_type dir, usbh_msc_callback_type cb)
+{
+  usbh_core_type *puhost = (usbh_core_type *)uhost;
+  usbh_msc_type *pmsc = (usbh_msc_type *)puhost->class_handler->pdata;
+  usbh_msc_req_type *req;
+  uint8_t next;
+
+  if(puhost->conn_sts == 0 || puhost->global_state != USBH_CLASS ||
+     pmsc->state != USBH_MSC_IDLE || lun >= pmsc->max_lun ||
+     count == 0 || count > 0xFFFF)
+  {
+    return USB_FAIL;
+  }
+
+  next = (pmsc->req_tail + 1) & (USBH_MSC_QUEUE_SIZE - 1);
+  if(next == pmsc->req_head)
+  {
+    return USB_WAIT;
+  }
+
+  req = &pmsc->req_queue[pmsc->req_tail];
+  req->buffer = buffer;
+  req->lba = lba;
+  req->count = count;
+  req->cb = cb;
+  req->lun = lun;
+  req->dir = dir;
+  pmsc->req_tail = next;
+  return USB_OK;
+}
+
+/**
+  * @brief  usb host msc ask for the write-behind buffer to go to the device now
+  *         and check if every queued request and buffered write is done
+  * @param  uhost: to the structure of usbh_core_type
+  * @retval status: USB_WAIT while pending, USB_FAIL if a buffered write was lost
+  *         since the last check, otherwise USB_OK
+  */
+usb_sts_type usbh_msc_flush(void *uhost)
+{
+  usbh_core_type *puhost = (usbh_core_type *)uhost;
+  usbh_msc_type *pmsc = (usbh_msc_type *)puhost->class_handler->pdata;
+
+#if USBH_MSC_WB_BLOCKS
+  if(pmsc->wb_count != 0)
+  {
+    pmsc->wb_flush = 1;
+  }
+#endif
+  if(usbh_msc_queue_busy(pmsc))
+  {
+    return USB_WAIT;
+  }
+  if(pmsc->error != MSC_OK)
+  {
+    pmsc->error = MSC_OK;
+    return USB_FAIL;
+  }
+  return USB_OK;
+}
+
 /**
   * @brief  usb host msc read and write handle
   * @param  uhost: to the structure of usbh_core_type
@@ -453,6 +935,7 @@ usb_sts_type usbh_msc_read(void *uhost, uint32_t address, uint32_t len, uint8_t
   usbh_msc_type *pmsc = (usbh_msc_type *)puhost->class_handler->pdata;
   uint32_t timeout = 0;
   if(puhost->conn_sts == 0 || puhost->global_state != USBH_CLASS
+    || usbh_msc_drain(puhost, pmsc) != USB_OK
     || pmsc->l_unit_n[lun].state != USBH_MSC_IDLE)
   {
     return USB_FAIL;
@@ -489,10 +972,17 @@ usb_sts_type usbh_msc_write(void *uhost, uint32_t address, uint32_t len, uint8_t
   usbh_msc_type *pmsc = (usbh_msc_type *)puhost->class_handler->pdata;
   uint32_t timeout = 0;
   if(puhost->conn_sts == 0 || puhost->global_state != USBH_CLASS
+    || usbh_msc_drain(puhost, pmsc) != USB_OK
     || pmsc->l_unit_n[lun].state != USBH_MSC_IDLE)
   {
     return USB_FAIL;
   }
+#if USBH_MSC_RA_BLOCKS
+  if(usbh_msc_overlap(pmsc->ra_lun, pmsc->ra_lba, pmsc->ra_count, lun, address, len))
+  {
+    pmsc->ra_count = 0;
+  }
+#endif
 
   pmsc->bot_trans.msc_struct = &usbh_msc;
   pmsc->l_unit_n[lun].state = USBH_MSC_WRITE;
@@ -76,6 +76,16 @@ extern "C" {
 
 #define USBH_SUPPORT_MAX_LUN             0x2
 
+/**
+  * @brief  usb msc asynchronous request queue
+  */
+#define USBH_MSC_BLOCK_SIZE              512
+#define USBH_MSC_QUEUE_SIZE              8     /*!< pending requests, power of two */
+#define USBH_MSC_MAX_XFER_BLOCKS         64    /*!< largest coalesced read10/write10 */
+#define USBH_MSC_WB_BLOCKS               8     /*!< write-behind buffer, 0: disabled */
+#define USBH_MSC_WB_FLUSH_TIME           20    /*!< idle frames before a partial write-behind flush */
+#define USBH_MSC_RA_BLOCKS               8     /*!< read-ahead window, 0: disabled */
+
 /**
   * @brief  usb msc request state
   */
@@ -87,6 +97,55 @@ typedef enum
   USBH_MSC_STATE_COMPLETE,
 }usbh_msc_ctrl_state_type;
 
+/**
+  * @brief  usb msc request direction
+  */
+typedef enum
+{
+  USBH_MSC_DIR_READ,
+  USBH_MSC_DIR_WRITE,
+}usbh_msc_dir_type;
+
+/**
+  * @brief  usb msc request done callback, status is USB_OK or USB_FAIL
+  */
+typedef void (*usbh_msc_callback_type)(void *uhost, uint8_t lun, uint32_t lba,
+                                       uint32_t count, usb_sts_type status);
+
+/**
+  * @brief  usb msc queued request
+  */
+typedef struct
+{
+  uint8_t                                *buffer;
+  uint32_t                               lba;
+  uint32_t                               count;
+  usbh_msc_callback_type                 cb;
+  uint8_t                                lun;
+  usbh_msc_dir_type                      dir;
+}usbh_msc_req_type;
+
+/**
+  * @brief  usb msc transfer running on the bulk pipes
+  */
+typedef enum
+{
+  USBH_MSC_XFER_IDLE,
+  USBH_MSC_XFER_REQUEST,                 /*!< straight to/from the queued buffers */
+  USBH_MSC_XFER_FLUSH,                   /*!< write-behind buffer to the device */
+  USBH_MSC_XFER_READ_AHEAD,              /*!< device to the read-ahead window */
+}usbh_msc_xfer_state_type;
+
+typedef struct
+{
+  usbh_msc_xfer_state_type               state;
+  uint8_t                                *buffer;
+  uint32_t                               lba;
+  uint32_t                               count;
+  uint8_t                                lun;
+  uint8_t                                n_req;   /*!< queued requests covered by the transfer */
+}usbh_msc_xfer_type;
+
 /**
   * @brief  usb msc struct
   */
@@ -115,6 +174,26 @@ typedef struct
   usbh_msc_unit_type                     l_unit_n[USBH_SUPPORT_MAX_LUN];
   uint16_t                               poll_timer;
   uint8_t buffer[64];
+
+  usbh_msc_req_type                      req_queue[USBH_MSC_QUEUE_SIZE];
+  uint8_t                                req_head;
+  uint8_t                                req_tail;
+  usbh_msc_xfer_type                     xfer;
+
+#if USBH_MSC_WB_BLOCKS
+  uint32_t                               wb_lba;
+  uint32_t                               wb_count;
+  uint32_t                               wb_timer;
+  uint8_t                                wb_lun;
+  uint8_t                                wb_flush;
+  uint8_t                                wb_buf[USBH_MSC_WB_BLOCKS * USBH_MSC_BLOCK_SIZE];
+#endif
+#if USBH_MSC_RA_BLOCKS
+  uint32_t                               ra_lba;
+  uint32_t                               ra_count;
+  uint8_t                                ra_lun;
+  uint8_t                                ra_buf[USBH_MSC_RA_BLOCKS * USBH_MSC_BLOCK_SIZE];
+#endif
 }usbh_msc_type;
 
 extern usbh_class_handler_type uhost_msc_class_handler;
@@ -123,6 +202,9 @@ msc_error_type usbh_msc_is_ready(void *uhost, uint8_t lun);
 usb_sts_type usbh_msc_write(void *uhost, uint32_t address, uint32_t len, uint8_t *buffer, uint8_t lun);
 usb_sts_type usbh_msc_read(void *uhost, uint32_t address, uint32_t len, uint8_t *buffer, uint8_t lun);
 usb_sts_type usbh_msc_rw_handle(void *uhost, uint32_t address, uint32_t len, uint8_t *buffer, uint8_t lun);
+usb_sts_type usbh_msc_submit(void *uhost, uint8_t lun, uint32_t lba, uint32_t count,
+                             uint8_t *buffer, usbh_msc_dir_type dir, usbh_msc_callback_type cb);
+usb_sts_type usbh_msc_flush(void *uhost);
 usb_sts_type msc_bot_scsi_init(usbh_msc_type *msc_struct);
 
 /**
@@ -38,14 +38,121 @@ static usb_sts_type uhost_process_handler(void *uhost);
 
 static usb_sts_type uhost_find_video_stream_in(usbh_core_type *puhost);
 static usb_sts_type uvc_cs_request_handle(usbh_core_type *phost);
-static usb_sts_type uvc_cs_request(usbh_core_type *puhost , uint8_t feature, uint8_t channel);
+static usb_sts_type uvc_cs_request(usbh_core_type *puhost, uvc_ctrl_req_type *preq);
+static void uvc_ctrl_setup(usbh_core_type *puhost);
+static usb_sts_type uvc_ctrl_push(usbh_core_type *puhost, uint8_t ctrl, uint8_t request, int32_t value);
+static usb_sts_type uvc_class_request(usbh_core_type *puhost, uint8_t request, uint16_t value,
+                                      uint16_t index, uint8_t *data, uint16_t len);
+static void uvc_ctrl_read_all(usbh_core_type *puhost);
+#ifdef UVC_DESC_CACHE_NUM
+static usb_sts_type uvc_cache_load(usbh_core_type *puhost);
+static void uvc_cache_save_desc(usbh_core_type *puhost);
+static void uvc_cache_save_commit(usbh_core_type *puhost);
+#endif
 
 usb_sts_type uvc_vs_set_cur(usbh_core_type *puhost, uint16_t request_type);
 usb_sts_type uvc_vs_get_cur(usbh_core_type *puhost, uint16_t request_type);
+static usb_sts_type uvc_vs_request(usbh_core_type *puhost, uint8_t request,
+                                   uint16_t request_type, uvc_video_info_type *params);
+static void uvc_probe_setup(usbh_core_type *puhost);
+static uint8_t uvc_probe_validate(usbh_core_type *puhost);
+static usb_sts_type uvc_probe_step_down(usbh_core_type *puhost, uint8_t reason);
+static usb_sts_type uvc_select_alt(usbh_core_type *puhost, uint32_t payload);
+static void uvc_stream_restart(usbh_core_type *puhost);
+static void uvc_stream_error(usbh_core_type *puhost);
+#ifdef UVC_ISO_IRQ_ENABLE
+static void uvc_iso_start(usbh_core_type *puhost);
+static void uvc_iso_arm(usbh_core_type *puhost);
+static void uvc_iso_complete(void *uhost, uint8_t chn, urb_sts_type urb_state);
+#endif
 
-extern uint8_t usbh_cfg_buffer[USB_MAX_DATA_LENGTH]; /*!< usb host cfg buffer */
-__IO uint8_t tmp_frame_buffer[UVC_RX_FIFO_SIZE];
+/* uvc_probe_validate results */
+#define UVC_PROBE_OK                     0
+#define UVC_PROBE_BANDWIDTH              1
+#define UVC_PROBE_FRAME_SIZE             2
+
+/* uvc_iso_desc_type state */
+#define UVC_ISO_FREE                     0
+#define UVC_ISO_ARMED                    1
+#define UVC_ISO_DONE                     2
+
+/* uvc_ctrl_map_type flags */
+#define UVC_CTRL_SIGNED                  0x01
+#define UVC_CTRL_RANGE                   0x02
+
+/**
+  * @brief where a control lives and how its value is coded
+  */
+typedef struct
+{
+  uint8_t  entity;                       /* UVC_VC_INPUT_TERMINAL or UVC_VC_PROCESSING_UNIT */
+  uint8_t  selector;
+  uint8_t  bit;                          /* bmControls bit */
+  uint8_t  size;
+  uint8_t  flags;
+}uvc_ctrl_map_type;
+
+/* indexed by uvc_ctrl_id_type */
+static const uvc_ctrl_map_type uvc_ctrl_map[UVC_CTRL_NUM] =
+{
+  {UVC_VC_PROCESSING_UNIT, PU_BRIGHTNESS_CONTROL,                     0, 2, UVC_CTRL_SIGNED | UVC_CTRL_RANGE},
+  {UVC_VC_INPUT_TERMINAL,  CT_AE_MODE_CONTROL,                        1, 1, 0},
+  {UVC_VC_INPUT_TERMINAL,  CT_AE_PRIORITY_CONTROL,                    2, 1, 0},
+  {UVC_VC_INPUT_TERMINAL,  CT_EXPOSURE_TIME_ABSOLUTE_CONTROL,         3, 4, UVC_CTRL_RANGE},
+  {UVC_VC_PROCESSING_UNIT, PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL, 12, 1, 0},
+  {UVC_VC_PROCESSING_UNIT, PU_WHITE_BALANCE_TEMPERATURE_CONTROL,      6, 2, UVC_CTRL_RANGE},
+  {UVC_VC_PROCESSING_UNIT, PU_POWER_LINE_FREQUENCY_CONTROL,           10, 1, 0},
+  {UVC_VC_INPUT_TERMINAL,  CT_FOCUS_AUTO_CONTROL,                     17, 1, 0},
+  {UVC_VC_INPUT_TERMINAL,  CT_FOCUS_ABSOLUTE_CONTROL,                 5, 2, UVC_CTRL_RANGE},
+};
+
+ALIGNED_HEAD __IO uint8_t tmp_frame_buffer[UVC_RX_BUFFER_SIZE] ALIGNED_TAIL;
+#ifdef UVC_ISO_IRQ_ENABLE
+ALIGNED_HEAD static uint8_t uvc_iso_buffer[UVC_ISO_DESC_NUM][UVC_RX_BUFFER_SIZE] ALIGNED_TAIL;
+#endif
 uvc_video_info_type video_params;
+uvc_video_info_type video_limits;
+
+#ifdef UVC_DESC_CACHE_NUM
+extern uint8_t usbh_cfg_buffer[USBH_MAX_CFG_DESC_LEN];
+
+/**
+  * @brief parsed descriptors and last commit of a known camera
+  */
+typedef struct
+{
+  /* device descriptor key, the configuration descriptor checksum makes
+     sure the cached pointers into usbh_cfg_buffer are still right */
+  uint16_t                    vid;
+  uint16_t                    pid;
+  uint16_t                    bcd;
+  uint16_t                    cfg_len;
+  uint32_t                    cfg_sum;
+  uint8_t                     valid;
+  
+  /* parsed descriptors */
+  uvc_class_spec_desc_type    class_desc;
+  uvc_streaming_in_type       stream_in[USBH_MAX_VIDEO_STREAM_IN];
+  uvc_intf_stream_type        intf_stream;
+  uint16_t                    max_bandwidth;
+  
+  /* last commit and the target it was negotiated for */
+  uint8_t                     committed;
+  uvc_format_type             format;
+  uint32_t                    width;
+  uint32_t                    height;
+  uint32_t                    interval;
+  int32_t                     format_index;
+  int32_t                     frame_index;
+  uint16_t                    frame_width;
+  uint16_t                    frame_height;
+  uint16_t                    commit_bandwidth;
+  uvc_video_info_type         commit;
+}uvc_cache_type;
+
+static uvc_cache_type uvc_cache[UVC_DESC_CACHE_NUM];
+static uint8_t uvc_cache_next = 0;
+#endif
 
 
 usbh_uvc_type usbh_uvc;
@@ -64,25 +171,39 @@ static usb_sts_type uhost_init_handler(void *uhost)
   usb_sts_type status = USB_OK;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;;
   
-  status = uhost_find_video_stream_in(puhost);
-  if(status != USB_OK)
+  puvc->cache_idx = 0xFF;
+  puvc->cache_commit = 0;
+#ifdef UVC_DESC_CACHE_NUM
+  if(uvc_cache_load(puhost) != USB_OK)
+#endif
   {
-    USBH_DEBUG("Unsupport Device!");
-    return USB_NOT_SUPPORT;
-  }
-  
-  uvc_parse_descriptor(puhost);
-  uvc_parse_format_descriptor(&puvc->class_desc);
-  
-  if (uvc_format_index == -1)
-  {
-    return USB_FAIL;
+    status = uhost_find_video_stream_in(puhost);
+    if(status != USB_OK)
+    {
+      USBH_DEBUG("Unsupport Device!");
+      return USB_NOT_SUPPORT;
+    }
+    
+    uvc_parse_descriptor(puhost);
+#ifdef UVC_DESC_CACHE_NUM
+    uvc_cache_save_desc(puhost);
+#endif
   }
   
-  uvc_parse_frame_descriptor(&puvc->class_desc);
-  if (uvc_frame_index == -1)
+  /* a cached commit brings its own format and frame */
+  if(puvc->cache_commit == 0)
   {
-    return USB_FAIL;
+    uvc_parse_format_descriptor(&puvc->class_desc);
+    if (uvc_format_index == -1)
+    {
+      return USB_FAIL;
+    }
+    
+    uvc_parse_frame_descriptor(&puvc->class_desc);
+    if (uvc_frame_index == -1)
+    {
+      return USB_FAIL;
+    }
   }
   
   if(puvc->intf_stream.supported == 1)
@@ -101,6 +222,8 @@ static usb_sts_type uhost_init_handler(void *uhost)
     usbh_set_toggle(puhost, puvc->intf_stream.channel, 0);
   }
     
+  uvc_ctrl_setup(puhost);
+  
   puvc->req_state     = UVC_REQ_INIT;
   puvc->control_state = UVC_CONTROL_INIT;
   
@@ -131,10 +254,25 @@ static usb_sts_type uhost_request_handler(void *uhost)
   usb_sts_type req_status = USB_OK;
   usbh_core_type *puhost = (usbh_core_type *)uhost;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;;
+  uint8_t result;
+
+  /* a control request may still be on the pipe when the stream restarts */
+  if(puvc->ctrl_busy)
+  {
+    uvc_cs_request_handle(puhost);
+    return status;
+  }
 
   switch (puvc->req_state)
   {
   case UVC_REQ_INIT:
+    /* a known camera commits its last parameters without probing */
+    if(puvc->cache_commit == 1)
+    {
+      puvc->req_state = UVC_REQ_SET_CUR_COM;
+      break;
+    }
+    /* fall through */
   case UVC_REQ_SET_DEFAULT_IN_INTERFACE:
     if(puvc->intf_stream.supported == 1)
     {
@@ -146,7 +284,7 @@ static usb_sts_type uhost_request_handler(void *uhost)
       {
         if(usbh_ctrl_result_check(puhost, CONTROL_IDLE, ENUM_IDLE) == USB_OK)
         {
-          puvc->req_state = UVC_REQ_SET_CUR;
+          puvc->req_state = UVC_REQ_GET_DEF;
         }
       }
     }
@@ -176,6 +314,8 @@ static usb_sts_type uhost_request_handler(void *uhost)
         {
           puvc->req_state = UVC_REQ_IDLE;
           puvc->steam_in_state = UVC_STATE_START_IN;
+          /* control values are read while the stream runs */
+          uvc_ctrl_read_all(puhost);
         }
       }
     }
@@ -184,29 +324,139 @@ static usb_sts_type uhost_request_handler(void *uhost)
       puvc->req_state = UVC_REQ_SET_IN_INTERFACE;     
     }
     break;
+    
+  case UVC_REQ_GET_DEF:
+    /* start from the device defaults, the request is optional */
+    req_status = uvc_vs_request(puhost, UVC_GET_DEF, VS_PROBE_CONTROL << 8, &video_params);
+    if(req_status == USB_WAIT)
+      break;
+    if(req_status != USB_OK)
+    {
+      memset(&video_params, 0, sizeof(video_params));
+    }
+    uvc_probe_setup(puhost);
+    puvc->req_state = UVC_REQ_SET_CUR;
+    break;
+    
+  case UVC_REQ_GET_MIN:
+    req_status = uvc_vs_request(puhost, UVC_GET_MIN, VS_PROBE_CONTROL << 8, &video_limits);
+    if(req_status == USB_WAIT)
+      break;
+    puvc->interval_min = (req_status == USB_OK) ? video_limits.dwFrameInterval : 0;
+    puvc->req_state = UVC_REQ_GET_MAX;
+    break;
+    
+  case UVC_REQ_GET_MAX:
+    req_status = uvc_vs_request(puhost, UVC_GET_MAX, VS_PROBE_CONTROL << 8, &video_limits);
+    if(req_status == USB_WAIT)
+      break;
+    puvc->interval_max = (req_status == USB_OK) ? video_limits.dwFrameInterval : 0;
+    puvc->probe_clamped = 1;
+    
+    /* probe again when the selected interval is outside the device range */
+    puvc->req_state = UVC_REQ_GET_CUR;
+    if((puvc->interval_min != 0) && (puvc->frame_interval < puvc->interval_min))
+    {
+      puvc->frame_interval = puvc->interval_min;
+      puvc->req_state = UVC_REQ_SET_CUR;
+    }
+    if((puvc->interval_max != 0) && (puvc->frame_interval > puvc->interval_max))
+    {
+      puvc->frame_interval = puvc->interval_max;
+      puvc->req_state = UVC_REQ_SET_CUR;
+    }
+    break;
+    
   case UVC_REQ_GET_CUR:
     req_status = uvc_vs_get_cur(puhost, VS_PROBE_CONTROL << 8);
     if(req_status == USB_OK)
     {
+      result = uvc_probe_validate(puhost);
+      if(result == UVC_PROBE_OK)
+      {
         puvc->req_state = UVC_REQ_SET_CUR_COM;
+      }
+      else if(uvc_probe_step_down(puhost, result) == USB_OK)
+      {
+        puvc->req_state = UVC_REQ_SET_CUR;
+      }
+      else
+      {
+        USBH_DEBUG("no streaming parameters fit the host");
+        status = USB_NOT_SUPPORT;
+      }
+    }
+    else if(req_status != USB_WAIT)
+    {
+      status = USB_FAIL;
     }
     break;
-    case UVC_REQ_SET_CUR:
+    
+  case UVC_REQ_SET_CUR:
+    if(puhost->ctrl.state == CONTROL_IDLE)
+    {
+      video_params.bmHint = 1;
+      video_params.bFormatIndex = uvc_format_index;             
+      video_params.bFrameIndex = uvc_frame_index;
+      video_params.dwFrameInterval = puvc->frame_interval;
+    }
     req_status = uvc_vs_set_cur(puhost, VS_PROBE_CONTROL << 8);
     if(req_status == USB_OK)
     {
-
-       puvc->req_state = UVC_REQ_GET_CUR;
+      puvc->req_state = (puvc->probe_clamped == 1) ? UVC_REQ_GET_CUR : UVC_REQ_GET_MIN;
+    }
+    else if((req_status != USB_WAIT) &&
+            ((req_status != USB_NOT_SUPPORT) ||
+             (uvc_probe_step_down(puhost, UVC_PROBE_FRAME_SIZE) != USB_OK)))
+    {
+      /* a stalled probe is retried with a smaller frame */
+      status = USB_FAIL;
     }
     break;
-    case UVC_REQ_SET_CUR_COM:
-      req_status = uvc_vs_set_cur(puhost, VS_COMMIT_CONTROL << 8);
-      if(req_status == USB_OK)
+    
+  case UVC_REQ_SET_CUR_COM:
+    /* commit what the device returned for the probe */
+    req_status = uvc_vs_set_cur(puhost, VS_COMMIT_CONTROL << 8);
+    if(req_status == USB_OK)
+    {
+      puvc->frame_interval = video_params.dwFrameInterval;
+      uvc_stream_set_frame_size(video_params.dwMaxVideoFrameSize);
+      USBH_DEBUG("commit %d x %d, interval %d, payload %d", puvc->frame_width, 
+                 puvc->frame_height, puvc->frame_interval, 
+                 video_params.dwMaxPayloadTransferSize);
+      if(uvc_select_alt(puhost, video_params.dwMaxPayloadTransferSize) == USB_OK)
       {
-
-         puvc->req_state = UVC_REQ_SET_IN_INTERFACE;
+        /* controls queued so far are applied before the first frame */
+        puvc->req_state = UVC_REQ_CS_REQUEST;
+#ifdef UVC_DESC_CACHE_NUM
+        uvc_cache_save_commit(puhost);
+#endif
       }
-      break;
+      else
+      {
+        status = USB_NOT_SUPPORT;
+      }
+      puvc->cache_commit = 0;
+    }
+    else if((req_status != USB_WAIT) && (puvc->cache_commit == 1))
+    {
+      /* the camera did not take the cached commit, negotiate again */
+      USBH_DEBUG("cached commit failed, probe");
+      puvc->cache_commit = 0;
+      uvc_parse_format_descriptor(&puvc->class_desc);
+      uvc_parse_frame_descriptor(&puvc->class_desc);
+      if((uvc_format_index == -1) || (uvc_frame_index == -1))
+      {
+        status = USB_FAIL;
+      }
+      puvc->req_state = UVC_REQ_SET_DEFAULT_IN_INTERFACE;
+    }
+    else if(req_status != USB_WAIT)
+    {
+      status = USB_FAIL;
+    }
+    break;
+    
   case UVC_REQ_IDLE:
     status = USB_OK;    
   default:
@@ -220,15 +470,35 @@ static usb_sts_type uhost_process_handler(void *uhost)
   usb_sts_type status = USB_OK;
   usbh_core_type *puhost = (usbh_core_type *)uhost;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+#ifndef UVC_ISO_IRQ_ENABLE
   volatile uint32_t rxlen = 0;
   urb_sts_type urb_status;
+#endif
   if(puvc->intf_stream.supported == 1)
   {
     switch(puvc->steam_in_state)
     {
+#ifdef UVC_ISO_IRQ_ENABLE
+      case UVC_STATE_START_IN:
+        puvc->steam_in_state = UVC_STATE_DATA_IN;
+        uvc_iso_start(puhost);
+        break;
+    
+      case UVC_STATE_DATA_IN:
+        /* packets are received and parsed in interrupt context, only the 
+           error recovery that may renegotiate runs here */
+        while((puvc->iso_err_done != puvc->iso_err) && 
+              (puvc->steam_in_state == UVC_STATE_DATA_IN))
+        {
+          puvc->iso_err_done ++;
+          uvc_stream_error(puhost);
+        }
+        break;
+#else
       case UVC_STATE_START_IN:
+        puvc->intf_stream.buf = uvc_stream_rx_buffer(puvc->intf_stream.max_size);
         usbh_isoc_recv(puhost, puvc->intf_stream.channel,
-                            (uint8_t*)tmp_frame_buffer, 
+                            puvc->intf_stream.buf, 
                              puvc->intf_stream.max_size);
         puvc->steam_in_state = UVC_STATE_DATA_IN;
         puvc->intf_stream.timer =  puhost->timer;
@@ -241,184 +511,1014 @@ static usb_sts_type uhost_process_handler(void *uhost)
         {
           puvc->intf_stream.timer =  puhost->timer;
           rxlen = puhost->hch[puvc->intf_stream.channel].trans_count;
-          uvc_stream_data_process((uint16_t)rxlen);
+          uvc_stream_data_process(puvc->intf_stream.buf, (uint16_t)rxlen, puhost->timer);
 //          puvc->steam_in_state = UVC_STATE_START_IN;
+          puvc->intf_stream.buf = uvc_stream_rx_buffer(puvc->intf_stream.max_size);
           usbh_isoc_recv(puhost, puvc->intf_stream.channel,
-                            (uint8_t*)tmp_frame_buffer, 
+                            puvc->intf_stream.buf, 
                              puvc->intf_stream.max_size);
         }
+        else if(urb_status == URB_ERROR)
+        {
+          /* frame overrun or babble halted the channel */
+          uvc_stream_rx_cancel();
+          uvc_stream_error(puhost);
+          if(puvc->steam_in_state == UVC_STATE_DATA_IN)
+          {
+            puvc->intf_stream.buf = uvc_stream_rx_buffer(puvc->intf_stream.max_size);
+            usbh_isoc_recv(puhost, puvc->intf_stream.channel,
+                              puvc->intf_stream.buf, 
+                               puvc->intf_stream.max_size);
+          }
+        }
 //        else if(puhost->timer - puvc->intf_stream.timer >= puvc->intf_stream.poll)
 //        {
 //          puvc->steam_in_state = UVC_STATE_START_IN;
 //        }
       break;
+#endif
       
       default:
         break;
     }
   }
+  
+  /* one step of the queued control requests, the stream keeps running */
+  if(puvc->req_state == UVC_REQ_IDLE)
+  {
+    uvc_cs_request_handle(puhost);
+  }
   return status;
 }
  
+/**
+  * @brief  collect the isochronous in alternate settings of every video
+  *         streaming interface and start with the largest one the host
+  *         can receive
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval status: usb_sts_type status
+  */
 static usb_sts_type uhost_find_video_stream_in(usbh_core_type *puhost)
 {
-  uint8_t intfx = 0, eptidx = 0, idx = 0, alt_settings = 0;
-  uint16_t size1 = 0, size2 = 0;
-  usb_itf_desc_type *usbitf;
+  usb_itf_index_type *pindex = &puhost->dev.cfg_desc.index;
+  usb_itf_alt_type *palt;
+  usb_header_desc_type *pdesc;
+  uint8_t *pbuf;
+  uint16_t ptr, total, wmax, alt_idx;
+  uint8_t alt_num = 0, idx, best = 0xFF;
+  uvc_streaming_in_type *pin;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
   
-  for(intfx = 0; intfx < USBH_MAX_VIDEO_STREAM_IN; intfx ++)
+  memset(puvc->stream_in, 0, sizeof(puvc->stream_in));
+  memset(&puvc->intf_stream, 0, sizeof(puvc->intf_stream));
+  
+  for(alt_idx = 0; (alt_idx < pindex->alt_num) && (alt_num < USBH_MAX_VIDEO_STREAM_IN); alt_idx ++)
   {
-    usbitf = &puhost->dev.cfg_desc.interface[intfx];
-    if((usbitf->interface.bInterfaceClass == USB_CLASS_CODE_VIDEO) &&
-      (usbitf->interface.bInterfaceSubClass == 0x02) )
+    palt = &pindex->alt[alt_idx];
+    if((palt->bInterfaceClass != USB_CLASS_CODE_VIDEO) ||
+       (palt->bInterfaceSubClass != USB_SUBCLASS_VIDEO_STREAMING) ||
+       (palt->bNumEndpoints == 0))
+      continue;
+    
+    /* walk the descriptors of this alternate setting only */
+    pdesc = (usb_header_desc_type *)usbh_get_interface_alt_desc(puhost, alt_idx, &total);
+    ptr = 0;
+    while(alt_num < USBH_MAX_VIDEO_STREAM_IN)
     {
-      if((usbitf->endpoint[0].bEndpointAddress & 0x80) &&
-         (usbitf->endpoint[0].wMaxPacketSize > 0))
+      pdesc = usbh_get_next_header((uint8_t *)pdesc, &ptr);
+      if((ptr + 2 > total) || (pdesc->bLength < 2) || (ptr + pdesc->bLength > total))
+        break;
+      pbuf = (uint8_t *)pdesc;
+      
+      if((pdesc->bDescriptorType == USB_DESCIPTOR_TYPE_ENDPOINT) &&
+         (pbuf[2] & 0x80) && ((pbuf[3] & 0x03) == USB_EPT_DESC_ISO))
       {
-        puvc->stream_in[alt_settings].endp = usbitf->endpoint[0].bEndpointAddress;
-        puvc->stream_in[alt_settings].max_size = usbitf->endpoint[0].wMaxPacketSize;
-        puvc->stream_in[alt_settings].interface = usbitf->interface.bInterfaceNumber;
-        puvc->stream_in[alt_settings].alts = usbitf->interface.bAlternateSetting;
-        puvc->stream_in[alt_settings].poll = usbitf->endpoint[0].bInterval;
-        puvc->stream_in[alt_settings].valid = 1;
-        alt_settings ++;
+        /* wMaxPacketSize bits 12:11 are the additional transactions per microframe */
+        wmax = LE16(&pbuf[4]);
+        pin = &puvc->stream_in[alt_num];
+        pin->endp = pbuf[2];
+        pin->max_size = wmax & 0x7FF;
+        pin->mult = ((wmax >> 11) & 0x03) + 1;
+        pin->bandwidth = pin->max_size * pin->mult;
+        pin->interface = palt->bInterfaceNumber;
+        pin->alts = palt->bAlternateSetting;
+        pin->poll = pbuf[6];
+        /* a full-speed host does one transaction per frame */
+        pin->valid = (pin->max_size > 0) && (pin->mult == 1) && 
+                     (pin->max_size < UVC_RX_FIFO_SIZE);
+        alt_num ++;
       }
     }
   }
   
-  if(alt_settings == 0)
+  for(idx = 0; idx < alt_num; idx ++)
+  {
+    if(puvc->stream_in[idx].valid && 
+       ((best == 0xFF) || (puvc->stream_in[idx].bandwidth > puvc->stream_in[best].bandwidth)))
+    {
+      best = idx;
+    }
+  }
+  
+  if(best == 0xFF)
+  {
     return USB_NOT_SUPPORT;
+  }
+  
+  pin = &puvc->stream_in[best];
+  puvc->intf_stream.endp = pin->endp;
+  puvc->intf_stream.max_size = pin->max_size;
+  puvc->intf_stream.bandwidth = pin->bandwidth;
+  puvc->intf_stream.alts = pin->alts;
+  puvc->intf_stream.interface = pin->interface;
+  puvc->intf_stream.poll = pin->poll;
+  puvc->intf_stream.supported = 1;
+  puvc->max_bandwidth = pin->bandwidth;
+  USBH_DEBUG("%d iso alternate settings, max size %d\r\n", alt_num, pin->max_size);
+  
+  return USB_OK;
+}
+
+/**
+  * @brief  select the smallest alternate setting that carries the payload
+  *         and open the streaming channel for it
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  payload: negotiated dwMaxPayloadTransferSize
+  * @retval status: usb_sts_type status
+  */
+static usb_sts_type uvc_select_alt(usbh_core_type *puhost, uint32_t payload)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_streaming_in_type *pin;
+  uint8_t idx, best = 0xFF;
+  
+  for(idx = 0; idx < USBH_MAX_VIDEO_STREAM_IN; idx ++)
+  {
+    pin = &puvc->stream_in[idx];
+    if((pin->valid == 0) || (pin->bandwidth < payload) || 
+       (pin->bandwidth > puvc->max_bandwidth))
+      continue;
+    if((best == 0xFF) || (pin->bandwidth < puvc->stream_in[best].bandwidth))
+      best = idx;
+  }
+  if(best == 0xFF)
+    return USB_NOT_SUPPORT;
+  
+  pin = &puvc->stream_in[best];
+  if((puvc->intf_stream.channel != 0) && (puvc->intf_stream.endp != pin->endp))
+  {
+    usbh_free_channel(puhost, puvc->intf_stream.channel);
+    puvc->intf_stream.channel = 0;
+  }
+  if(puvc->intf_stream.channel == 0)
+  {
+    puvc->intf_stream.channel = usbh_alloc_channel(puhost, pin->endp);
+  }
+  
+  puvc->intf_stream.endp = pin->endp;
+  puvc->intf_stream.max_size = pin->max_size;
+  puvc->intf_stream.bandwidth = pin->bandwidth;
+  puvc->intf_stream.alts = pin->alts;
+  puvc->intf_stream.interface = pin->interface;
+  puvc->intf_stream.poll = pin->poll;
+  
+  usbh_hc_open(puhost, 
+               puvc->intf_stream.channel,
+               puvc->intf_stream.endp,
+               puhost->dev.address, 
+               EPT_ISO_TYPE,
+               puvc->intf_stream.max_size,
+               puhost->dev.speed);
+  usbh_set_toggle(puhost, puvc->intf_stream.channel, 0);
+  USBH_DEBUG("select alternate setting %d, iso size %d", pin->alts, pin->max_size);
+  return USB_OK;
+}
+
+/**
+  * @brief  stop streaming and run probe/commit again from alternate setting 0
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_stream_restart(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  
+  puvc->steam_in_state = UVC_STATE_IDLE;
+  if(puvc->intf_stream.channel != 0)
+  {
+    usbh_set_hch_callback(puhost, puvc->intf_stream.channel, NULL);
+    usbh_ch_disable(puhost, puvc->intf_stream.channel);
+  }
+  puvc->req_state = UVC_REQ_SET_DEFAULT_IN_INTERFACE;
+  puhost->global_state = USBH_CLASS_REQUEST;
+}
+
+/**
+  * @brief  count a frame overrun or babble on the streaming channel, too many
+  *         in a short time limit the bandwidth below the current alternate
+  *         setting and negotiate again
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_stream_error(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uint16_t lower = 0;
+  uint8_t idx;
+  
+  if(puhost->timer - puvc->intf_stream.err_timer > UVC_ALT_FALLBACK_WINDOW)
+  {
+    puvc->intf_stream.err_cnt = 0;
+    puvc->intf_stream.err_timer = puhost->timer;
+  }
+  if(++ puvc->intf_stream.err_cnt < UVC_ALT_FALLBACK_ERR_NUM)
+    return;
+  puvc->intf_stream.err_cnt = 0;
   
   for(idx = 0; idx < USBH_MAX_VIDEO_STREAM_IN; idx ++)
   {
-    size1 = puvc->stream_in[idx].max_size;
-    if(size1 > size2 && size1 < UVC_RX_FIFO_SIZE)
+    if(puvc->stream_in[idx].valid && 
+       (puvc->stream_in[idx].bandwidth < puvc->intf_stream.bandwidth) &&
+       (puvc->stream_in[idx].bandwidth > lower))
     {
-      size2 = size1;
-      puvc->intf_stream.endp = puvc->stream_in[idx].endp;
-      puvc->intf_stream.max_size = puvc->stream_in[idx].max_size;
-      puvc->intf_stream.alts = puvc->stream_in[idx].alts;
-      puvc->intf_stream.interface = puvc->stream_in[idx].interface;
-      puvc->intf_stream.poll = puvc->stream_in[idx].poll;
-      puvc->intf_stream.supported = 1;
-      eptidx ++;
+      lower = puvc->stream_in[idx].bandwidth;
     }
   }
-  USBH_DEBUG("select iso size %d\r\n", size2);
-  if(eptidx == 0)
+  if(lower == 0)
+    return;
+  
+  USBH_DEBUG("stream errors, limit bandwidth to %d", lower);
+  puvc->max_bandwidth = lower;
+  uvc_stream_restart(puhost);
+}
+
+#ifdef UVC_ISO_IRQ_ENABLE
+/**
+  * @brief  reset the receive descriptors and arm the first isochronous 
+  *         receive, later receives are armed from uvc_iso_complete
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_iso_start(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uint8_t idx;
+  
+  for(idx = 0; idx < UVC_ISO_DESC_NUM; idx ++)
   {
+    puvc->iso_desc[idx].buf = uvc_iso_buffer[idx];
+    puvc->iso_desc[idx].len = 0;
+    puvc->iso_desc[idx].lost = 0;
+    puvc->iso_desc[idx].state = UVC_ISO_FREE;
+  }
+  puvc->iso_armed = 0;
+  puvc->iso_next = 0;
+  puvc->iso_rearm = 0;
+  puvc->iso_err_done = puvc->iso_err;
+  
+  /* packets are received into iso_desc, not through uvc_stream_rx_buffer,
+     the parser still needs the packet size to count short packets */
+  uvc_stream_set_max_packet(puvc->intf_stream.max_size);
+  
+  /* the parser must not preempt the otg interrupt */
+  NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+  usbh_set_hch_callback(puhost, puvc->intf_stream.channel, uvc_iso_complete);
+  uvc_iso_arm(puhost);
+}
+
+/**
+  * @brief  arm the isochronous receive into the current descriptor, the
+  *         channel is left idle while the parser still owns it
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_iso_arm(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_iso_desc_type *desc = &puvc->iso_desc[puvc->iso_armed];
+  
+  if(desc->state == UVC_ISO_DONE)
+  {
+    puvc->iso_rearm = 1;
+    return;
+  }
+  desc->state = UVC_ISO_ARMED;
+  usbh_isoc_recv(puhost, puvc->intf_stream.channel, 
+                 desc->buf, puvc->intf_stream.max_size);
+}
+
+/**
+  * @brief  streaming channel complete callback, runs in the otg interrupt.
+  *         hands the packet to the parser and re-arms the other descriptor
+  * @param  uhost: to the structure of usbh_core_type
+  * @param  chn: channel number
+  * @param  urb_state: URB_DONE or URB_ERROR
+  * @retval none
+  */
+static void uvc_iso_complete(void *uhost, uint8_t chn, urb_sts_type urb_state)
+{
+  usbh_core_type *puhost = (usbh_core_type *)uhost;
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_iso_desc_type *desc = &puvc->iso_desc[puvc->iso_armed];
+  
+  if(puvc->steam_in_state != UVC_STATE_DATA_IN)
+    return;
+  
+  if(urb_state == URB_DONE)
+  {
+    desc->len = puhost->hch[chn].trans_count;
+    desc->timestamp = puhost->timer;
+    desc->state = UVC_ISO_DONE;
+    puvc->iso_armed = (puvc->iso_armed + 1) % UVC_ISO_DESC_NUM;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+  else
+  {
+    /* frame overrun or babble halted the channel, receive again into the
+       same descriptor and let the process handler count the error. the
+       parser hears of the lost packet in order, with the next one */
+    if(desc->lost < 0xFF)
+      desc->lost ++;
+    puvc->iso_err ++;
+  }
+  uvc_iso_arm(puhost);
+}
+#endif
+
+/**
+  * @brief  run the payload parser on the received isochronous packets,
+  *         call from PendSV_Handler when UVC_ISO_IRQ_ENABLE is defined
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+void usbh_uvc_deferred_handler(usbh_core_type *puhost)
+{
+#ifdef UVC_ISO_IRQ_ENABLE
+  usbh_uvc_type *puvc = &usbh_uvc;
+  uvc_iso_desc_type *desc = &puvc->iso_desc[puvc->iso_next];
+  
+  while(desc->state == UVC_ISO_DONE)
+  {
+    for(; desc->lost != 0; desc->lost --)
+    {
+      uvc_stream_rx_cancel();
+    }
+    uvc_stream_data_process(desc->buf, desc->len, desc->timestamp);
+    desc->state = UVC_ISO_FREE;
+    puvc->iso_next = (puvc->iso_next + 1) % UVC_ISO_DESC_NUM;
+    desc = &puvc->iso_desc[puvc->iso_next];
+  }
+  
+  /* the otg interrupt found no free descriptor, the channel is idle */
+  if(puvc->iso_rearm && (puvc->steam_in_state == UVC_STATE_DATA_IN))
+  {
+    puvc->iso_rearm = 0;
+    uvc_iso_arm(puhost);
+  }
+#endif
+}
+
+/**
+  * @brief  look up the camera terminal and processing unit of every control
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_ctrl_setup(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_vc_desc_type *pvc = &puvc->class_desc.cs_desc;
+  const uvc_ctrl_map_type *pmap;
+  uint8_t ctrl, idx, entity, size;
+  const uint8_t *bm;
+  
+  memset(puvc->ctrl_info, 0, sizeof(puvc->ctrl_info));
+  puvc->ctrl_head = 0;
+  puvc->ctrl_tail = 0;
+  puvc->ctrl_busy = 0;
+  puvc->ctrl_read = 0;
+  
+  for(ctrl = 0; ctrl < UVC_CTRL_NUM; ctrl ++)
+  {
+    pmap = &uvc_ctrl_map[ctrl];
+    entity = 0;
+    for(idx = 0; (entity == 0) && (idx < UVC_MAX_NUM_IN_TERMINAL); idx ++)
+    {
+      if(pmap->entity == UVC_VC_INPUT_TERMINAL)
+      {
+        if((idx >= puvc->class_desc.input_terminal) || 
+           (LE16(pvc->input[idx]->wTerminalType) != UVC_ITT_CAMERA))
+          continue;
+        size = pvc->input[idx]->bControlSize;
+        bm = pvc->input[idx]->bmControls;
+        entity = pvc->input[idx]->bTerminalID;
+      }
+      else
+      {
+        if(idx >= puvc->class_desc.processing_unit)
+          continue;
+        size = pvc->processing_unit[idx]->bControlSize;
+        bm = pvc->processing_unit[idx]->bmControls;
+        entity = pvc->processing_unit[idx]->bUnitID;
+      }
+      if((pmap->bit >= size * 8) || ((bm[pmap->bit >> 3] & (1 << (pmap->bit & 7))) == 0))
+        entity = 0;
+    }
+    puvc->ctrl_info[ctrl].entity = entity;
+  }
+  
+#ifdef UVC_CONSTANT_FRAME_RATE
+  uvc_ctrl_push(puhost, UVC_CTRL_AE_PRIORITY, UVC_SET_CUR, 0);
+#endif
+}
+
+/**
+  * @brief  queue the reads of the range and current value of every control
+  *         once after attach
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_ctrl_read_all(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uint8_t ctrl;
+  
+  if(puvc->ctrl_read)
+    return;
+  puvc->ctrl_read = 1;
+  
+  for(ctrl = 0; ctrl < UVC_CTRL_NUM; ctrl ++)
+  {
+    if(uvc_ctrl_map[ctrl].flags & UVC_CTRL_RANGE)
+    {
+      uvc_ctrl_push(puhost, ctrl, UVC_GET_MIN, 0);
+      uvc_ctrl_push(puhost, ctrl, UVC_GET_MAX, 0);
+    }
+    uvc_ctrl_push(puhost, ctrl, UVC_GET_CUR, 0);
+  }
+}
+
+/**
+  * @brief  queue a control request, a set that is still waiting only gets
+  *         its value replaced
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  ctrl: uvc_ctrl_id_type
+  * @param  request: uvc request code
+  * @param  value: value of UVC_SET_CUR
+  * @retval status: USB_OK, USB_NOT_SUPPORT if the device has no such control
+  *         or USB_WAIT if the queue is full
+  */
+static usb_sts_type uvc_ctrl_push(usbh_core_type *puhost, uint8_t ctrl, uint8_t request, int32_t value)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_ctrl_req_type *preq;
+  uint8_t idx, next;
+  
+  if(puvc->ctrl_info[ctrl].entity == 0)
     return USB_NOT_SUPPORT;
+  
+  if(request == UVC_SET_CUR)
+  {
+    /* the head may already be on the pipe */
+    idx = puvc->ctrl_head;
+    if(puvc->ctrl_busy)
+      idx = (idx + 1) & (UVC_CTRL_QUEUE_SIZE - 1);
+    for(; idx != puvc->ctrl_tail; idx = (idx + 1) & (UVC_CTRL_QUEUE_SIZE - 1))
+    {
+      preq = &puvc->ctrl_queue[idx];
+      if((preq->ctrl == ctrl) && (preq->request == UVC_SET_CUR))
+      {
+        preq->value = value;
+        return USB_OK;
+      }
+    }
   }
   
+  next = (puvc->ctrl_tail + 1) & (UVC_CTRL_QUEUE_SIZE - 1);
+  if(next == puvc->ctrl_head)
+    return USB_WAIT;
+  
+  preq = &puvc->ctrl_queue[puvc->ctrl_tail];
+  preq->ctrl = ctrl;
+  preq->request = request;
+  preq->value = value;
+  puvc->ctrl_tail = next;
   return USB_OK;
 }
 
 /**
   * @brief  uvc_cs_request 
-  *         The function is responsible for handling AC Specific requests for a specific feature and channel
-  *         for Video class.
-  * @param  phost: Host handle
-  * @retval USBH Status
+  *         send one camera terminal or processing unit request, the result
+  *         goes to the control state
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  preq: queued request
+  * @retval status: usb_sts_type status, USB_WAIT while it is on the pipe
   */
-static usb_sts_type uvc_cs_request(usbh_core_type *puhost , uint8_t feature, uint8_t channel)
+static usb_sts_type uvc_cs_request(usbh_core_type *puhost, uvc_ctrl_req_type *preq)
 {   
-  usb_sts_type status = USB_WAIT;
-
-  return status; 
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  const uvc_ctrl_map_type *pmap = &uvc_ctrl_map[preq->ctrl];
+  uvc_ctrl_info_type *pinfo = &puvc->ctrl_info[preq->ctrl];
+  usb_sts_type status;
+  int32_t value;
+  
+  if(puvc->ctrl_busy == 0)
+  {
+    puvc->ctrl_buf = (uint32_t)preq->value;
+    puvc->ctrl_busy = 1;
+  }
+  status = uvc_class_request(puhost, preq->request, pmap->selector << 8,
+                             (pinfo->entity << 8) | puvc->class_desc.vc_interface,
+                             (uint8_t *)&puvc->ctrl_buf, pmap->size);
+  if(status == USB_WAIT)
+    return status;
+  puvc->ctrl_busy = 0;
+  
+  if(status != USB_OK)
+  {
+    USBH_DEBUG("control %d request 0x%x failed", preq->ctrl, preq->request);
+    if(preq->request == UVC_SET_CUR)
+      pinfo->valid &= ~UVC_CTRL_VALID_CUR;
+    return status;
+  }
+  
+  /* little endian on the bus and in ctrl_buf */
+  value = (int32_t)puvc->ctrl_buf;
+  if(pmap->size < 4)
+  {
+    value &= (1 << (pmap->size * 8)) - 1;
+    if((pmap->flags & UVC_CTRL_SIGNED) && (value & (1 << (pmap->size * 8 - 1))))
+      value -= 1 << (pmap->size * 8);
+  }
+  
+  switch(preq->request)
+  {
+    case UVC_SET_CUR:
+    case UVC_GET_CUR:
+      pinfo->cur = value;
+      pinfo->valid |= UVC_CTRL_VALID_CUR;
+      break;
+    case UVC_GET_MIN:
+      pinfo->min = value;
+      pinfo->valid |= UVC_CTRL_VALID_MIN;
+      break;
+    case UVC_GET_MAX:
+      pinfo->max = value;
+      pinfo->valid |= UVC_CTRL_VALID_MAX;
+      break;
+    default:
+      break;
+  }
+  return status;
 }
 
 /**
   * @brief  uvc_cs_request_handle 
-  *         The function is responsible for handling VC Specific requests for a all features 
-  *         and associated channels for Video class.
-  * @param  phost: Host handle
-  * @retval USBH Status
+  *         advance the control request queue by one step
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval status: USB_OK when the queue is empty, otherwise USB_WAIT
   */
 static usb_sts_type uvc_cs_request_handle(usbh_core_type *puhost)
 { 
-
-  usb_sts_type status = USB_WAIT;
-  usb_sts_type cs_status = USB_WAIT; 
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
-        
-  cs_status = uvc_cs_request(puhost, 
-                                   puvc->temp_feature, 
-                                   0);
   
-  if(cs_status != USB_WAIT)
-  {        
+  if(puvc->ctrl_head == puvc->ctrl_tail)
+    return USB_OK;
+  
+  /* a failed request is dropped, the device keeps its value */
+  if(uvc_cs_request(puhost, &puvc->ctrl_queue[puvc->ctrl_head]) != USB_WAIT)
+  {
+    puvc->ctrl_head = (puvc->ctrl_head + 1) & (UVC_CTRL_QUEUE_SIZE - 1);
   }
   
-  return status;
+  return (puvc->ctrl_head == puvc->ctrl_tail) ? USB_OK : USB_WAIT;
 }
 
+/**
+  * @brief  start a class specific interface request when the control pipe
+  *         is idle, later calls drive the transfer without blocking
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  request: uvc request code
+  * @param  value: wValue, control selector in the high byte
+  * @param  index: wIndex, entity id in the high byte and interface in the low
+  * @param  data: data stage buffer, kept until the request completes
+  * @param  len: data stage length
+  * @retval status: usb_sts_type status, USB_WAIT while the request is on the
+  *         pipe, USB_NOT_SUPPORT if the device stalled
+  */
+static usb_sts_type uvc_class_request(usbh_core_type *puhost, uint8_t request, uint16_t value,
+                                      uint16_t index, uint8_t *data, uint16_t len)
+{
+  if(puhost->ctrl.state == CONTROL_IDLE)
+  {
+    if(request & 0x80)
+    {
+      puhost->ctrl.setup.bmRequestType = USB_DIR_D2H;
+    }
+    else
+    {
+      puhost->ctrl.setup.bmRequestType = USB_DIR_H2D;
+    }
+    puhost->ctrl.setup.bmRequestType |= USB_REQ_RECIPIENT_INTERFACE | USB_REQ_TYPE_CLASS;
+    puhost->ctrl.setup.bRequest = request;
+    puhost->ctrl.setup.wValue = value;
+    puhost->ctrl.setup.wLength = len;
+    puhost->ctrl.setup.wIndex = index;
+    usbh_ctrl_request(puhost, data, len);
+    return USB_WAIT;
+  }
+  
+  return usbh_ctrl_result_check(puhost, CONTROL_IDLE, ENUM_IDLE);
+}
 
+/**
+  * @brief  send a video streaming interface control request, one step per call
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  request: uvc request code
+  * @param  request_type: control selector in the high byte
+  * @param  params: probe/commit control data
+  * @retval status: usb_sts_type status, USB_WAIT until the request completes,
+  *         USB_NOT_SUPPORT if the device stalled
+  */
+static usb_sts_type uvc_vs_request(usbh_core_type *puhost, uint8_t request,
+                                   uint16_t request_type, uvc_video_info_type *params)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  
+  if((request & 0x80) && (puhost->ctrl.state == CONTROL_IDLE))
+  {
+    memset(params, 0, sizeof(uvc_video_info_type));
+  }
+  return uvc_class_request(puhost, request, request_type, puvc->intf_stream.interface,
+                           (uint8_t *)params, 26);
+}
 
 usb_sts_type uvc_vs_set_cur(usbh_core_type *puhost, uint16_t request_type)
 {
-  uint16_t len = 26;
-	usb_sts_type status = USB_WAIT;
+  return uvc_vs_request(puhost, UVC_SET_CUR, request_type, &video_params);
+}
+
+usb_sts_type uvc_vs_get_cur(usbh_core_type *puhost, uint16_t request_type)
+{
+  return uvc_vs_request(puhost, UVC_GET_CUR, request_type, &video_params);
+}
+
+/**
+  * @brief  select the frame interval for the selected frame and restart the
+  *         probe retry count
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_probe_setup(usbh_core_type *puhost)
+{
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_frame_desc_type *frame;
   
-  if (request_type == (VS_PROBE_CONTROL << 8))
+  frame = uvc_get_frame_descriptor(&puvc->class_desc, uvc_frame_index);
+  puvc->frame_interval = (frame != NULL) ? uvc_frame_interval_select(frame, g_uvc_interval) : 333333;
+  puvc->frame_width = (frame != NULL) ? LE16(frame->wWidth) : 0;
+  puvc->frame_height = (frame != NULL) ? LE16(frame->wHeight) : 0;
+  puvc->interval_min = 0;
+  puvc->interval_max = 0;
+  puvc->probe_retry = 0;
+  puvc->probe_clamped = 0;
+}
+
+/**
+  * @brief  check the probe result returned by the device against the host
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval UVC_PROBE_OK, UVC_PROBE_BANDWIDTH or UVC_PROBE_FRAME_SIZE
+  */
+static uint8_t uvc_probe_validate(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_frame_desc_type *frame;
+  uint32_t payload = video_params.dwMaxPayloadTransferSize;
+  uint32_t frame_size = video_params.dwMaxVideoFrameSize;
+  
+  if((video_params.bFormatIndex != uvc_format_index) ||
+     (video_params.bFrameIndex != uvc_frame_index))
   {
-    memset(&video_params, 0, sizeof(video_params));
-    video_params.bmHint = 1;
-    video_params.bFormatIndex = uvc_format_index;             
-    video_params.bFrameIndex = uvc_frame_index;
-    
-    video_params.dwFrameInterval = 333333;//30 FPS
-    /* ProbeParams.dwFrameInterval = 2000000;//5 FPS */
+    /* the device moved to another frame, take it if it is one we know */
+    frame = uvc_get_frame_descriptor(&puvc->class_desc, video_params.bFrameIndex);
+    if((video_params.bFormatIndex != uvc_format_index) || (frame == NULL))
+    {
+      return UVC_PROBE_FRAME_SIZE;
+    }
+    uvc_frame_index = video_params.bFrameIndex;
+    puvc->frame_width = LE16(frame->wWidth);
+    puvc->frame_height = LE16(frame->wHeight);
   }
   
-  puhost->ctrl.setup.bmRequestType = USB_DIR_H2D | 
-                                     USB_REQ_RECIPIENT_INTERFACE |
-                                     USB_REQ_TYPE_CLASS;
-  puhost->ctrl.setup.bRequest = UVC_SET_CUR;
-  puhost->ctrl.setup.wValue = (uint16_t)request_type;
-  puhost->ctrl.setup.wLength = len;
-  puhost->ctrl.setup.wIndex = puvc->intf_stream.interface;
-  status = usbh_ctrl_request(puhost, (uint8_t *)&video_params, len);
+  if((payload == 0) || (payload > puvc->max_bandwidth))
+  {
+    USBH_DEBUG("payload %d over bandwidth %d", payload, puvc->max_bandwidth);
+    return UVC_PROBE_BANDWIDTH;
+  }
   
-  do
+  /* mjpeg reports a worst case size, compressed frames are checked 
+     against the buffer while streaming */
+  if((g_uvc_format == UVC_FORMAT_YUY2) && (frame_size > UVC_MAX_FRAME_SIZE))
   {
-    status = usbh_ctrl_result_check(puhost, CONTROL_IDLE, ENUM_IDLE);
-  }while(status == USB_WAIT);
+    USBH_DEBUG("frame size %d over buffer %d", frame_size, UVC_MAX_FRAME_SIZE);
+    return UVC_PROBE_FRAME_SIZE;
+  }
+  return UVC_PROBE_OK;
+}
+
+/**
+  * @brief  lower the streaming parameters after a failed probe, first the 
+  *         frame rate for bandwidth, then the frame size
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  reason: uvc_probe_validate result
+  * @retval status: USB_OK to probe again, USB_NOT_SUPPORT if nothing is left
+  */
+static usb_sts_type uvc_probe_step_down(usbh_core_type *puhost, uint8_t reason)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_frame_desc_type *frame;
+  uint32_t interval;
+  uint8_t retry = puvc->probe_retry + 1;
+  
+  if(retry > UVC_PROBE_MAX_RETRY)
+    return USB_NOT_SUPPORT;
+  
+  frame = uvc_get_frame_descriptor(&puvc->class_desc, uvc_frame_index);
+  if((reason == UVC_PROBE_BANDWIDTH) && (frame != NULL))
+  {
+    interval = uvc_frame_interval_next(frame, puvc->frame_interval);
+    if((interval != 0) && ((puvc->interval_max == 0) || (interval <= puvc->interval_max)))
+    {
+      puvc->frame_interval = interval;
+      puvc->probe_retry = retry;
+      return USB_OK;
+    }
+  }
   
+  frame = uvc_get_smaller_frame(&puvc->class_desc, uvc_frame_index);
+  if(frame == NULL)
+    return USB_NOT_SUPPORT;
+  
+  uvc_frame_index = frame->bFrameIndex;
+  uvc_probe_setup(puhost);
+  puvc->probe_retry = retry;
   return USB_OK;
 }
 
-usb_sts_type uvc_vs_get_cur(usbh_core_type *puhost, uint16_t request_type)
+/**
+  * @brief  change the capture format, frame size and rate at runtime. the
+  *         stream is stopped and probe/commit runs again.
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  format: capture format
+  * @param  width: target width, the largest frame inside it is used
+  * @param  height: target height
+  * @param  interval: target frame interval in 100 ns units, 0 for the fastest
+  * @retval status: USB_OK, USB_WAIT if a control transfer is in progress or
+  *         USB_NOT_SUPPORT if the device has no such format
+  */
+usb_sts_type usbh_uvc_set_target(usbh_core_type *puhost, uvc_format_type format,
+                                 uint16_t width, uint16_t height, uint32_t interval)
 {
-	uint16_t len = 26;
-	usb_sts_type status = USB_WAIT;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
-  memset(&video_params, 0, sizeof(video_params));
-
-  puhost->ctrl.setup.bmRequestType = USB_DIR_D2H | 
-                                     USB_REQ_RECIPIENT_INTERFACE |
-                                      USB_REQ_TYPE_CLASS;
-  puhost->ctrl.setup.bRequest = UVC_GET_CUR;
-  puhost->ctrl.setup.wValue = (uint16_t)request_type;
-  puhost->ctrl.setup.wLength = len;
-  puhost->ctrl.setup.wIndex = puvc->intf_stream.interface;
-  status = usbh_ctrl_request(puhost, (uint8_t *)&video_params, len);
-  
-  do
-  {
-    status = usbh_ctrl_result_check(puhost, CONTROL_IDLE, ENUM_IDLE);
-  }while(status == USB_WAIT);
-  
-//  if (status == USB_OK)
-//  {
-//    if (video_params.dwMaxVideoFrameSize > 0)
-//    {
-//      return USB_OK;
-//    }
-//    else
-//      return USB_FAIL;
-//  }
+  uvc_format_type old_format = g_uvc_format;
+  uint32_t old_width = g_uvc_width, old_height = g_uvc_height;
   
-  return status;
+  if(puhost->ctrl.state != CONTROL_IDLE)
+    return USB_WAIT;
+  
+  g_uvc_format = format;
+  g_uvc_width = width;
+  g_uvc_height = height;
+  uvc_parse_format_descriptor(&puvc->class_desc);
+  uvc_parse_frame_descriptor(&puvc->class_desc);
+  if((uvc_format_index == -1) || (uvc_frame_index == -1))
+  {
+    g_uvc_format = old_format;
+    g_uvc_width = old_width;
+    g_uvc_height = old_height;
+    uvc_parse_format_descriptor(&puvc->class_desc);
+    uvc_parse_frame_descriptor(&puvc->class_desc);
+    return USB_NOT_SUPPORT;
+  }
+  g_uvc_interval = interval;
+  
+  if((puhost->global_state == USBH_CLASS) || (puhost->global_state == USBH_CLASS_REQUEST))
+  {
+    uvc_stream_restart(puhost);
+  }
+  return USB_OK;
+}
+
+/**
+  * @brief  queue a new value for a camera terminal or processing unit
+  *         control, it is sent between the streaming requests without
+  *         stopping the stream
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  ctrl: control to set
+  * @param  value: new value, limited to the range read from the device
+  * @retval status: USB_OK, USB_NOT_SUPPORT if the device has no such control
+  *         or USB_WAIT if too many requests are waiting
+  */
+usb_sts_type usbh_uvc_set_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl, int32_t value)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_ctrl_info_type *pinfo;
+  
+  if(ctrl >= UVC_CTRL_NUM)
+    return USB_NOT_SUPPORT;
+  
+  pinfo = &puvc->ctrl_info[ctrl];
+  if((pinfo->valid & UVC_CTRL_VALID_MIN) && (value < pinfo->min))
+    value = pinfo->min;
+  if((pinfo->valid & UVC_CTRL_VALID_MAX) && (value > pinfo->max))
+    value = pinfo->max;
+  
+  return uvc_ctrl_push(puhost, ctrl, UVC_SET_CUR, value);
+}
+
+/**
+  * @brief  queue a read of the current value of a control, for values the
+  *         device changes on its own such as the exposure in auto mode
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  ctrl: control to read
+  * @retval status: USB_OK, USB_NOT_SUPPORT if the device has no such control
+  *         or USB_WAIT if too many requests are waiting
+  */
+usb_sts_type usbh_uvc_read_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl)
+{
+  if(ctrl >= UVC_CTRL_NUM)
+    return USB_NOT_SUPPORT;
+  
+  return uvc_ctrl_push(puhost, ctrl, UVC_GET_CUR, 0);
+}
+
+/**
+  * @brief  get the last value of a control read from or written to the device
+  * @param  puhost: to the structure of usbh_core_type
+  * @param  ctrl: control to get
+  * @param  value: current value
+  * @param  min: minimum value, may be NULL, 0 if the device has no range
+  * @param  max: maximum value, may be NULL, 0 if the device has no range
+  * @retval status: USB_OK, USB_NOT_SUPPORT if the device has no such control
+  *         or USB_WAIT if the value was not read yet
+  */
+usb_sts_type usbh_uvc_get_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl, 
+                                  int32_t *value, int32_t *min, int32_t *max)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_ctrl_info_type *pinfo;
+  
+  if((ctrl >= UVC_CTRL_NUM) || (puvc->ctrl_info[ctrl].entity == 0))
+    return USB_NOT_SUPPORT;
+  
+  pinfo = &puvc->ctrl_info[ctrl];
+  if(min != NULL)
+    *min = pinfo->min;
+  if(max != NULL)
+    *max = pinfo->max;
+  if((pinfo->valid & UVC_CTRL_VALID_CUR) == 0)
+    return USB_WAIT;
+  
+  *value = pinfo->cur;
+  return USB_OK;
+}
+
+#ifdef UVC_DESC_CACHE_NUM
+/**
+  * @brief  checksum of the configuration descriptor
+  * @param  len: bytes in usbh_cfg_buffer
+  * @retval checksum
+  */
+static uint32_t uvc_cache_sum(uint16_t len)
+{
+  uint32_t sum = 0;
+  uint16_t i_index;
+  
+  for(i_index = 0; i_index < len; i_index ++)
+  {
+    sum = sum * 31 + usbh_cfg_buffer[i_index];
+  }
+  return sum;
+}
+
+/**
+  * @brief  find the attached camera in the cache and restore its parsed
+  *         descriptors, and its last commit if the target did not change
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval status: USB_OK if the camera is known, otherwise USB_FAIL
+  */
+static usb_sts_type uvc_cache_load(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  usb_device_desc_type *pdev = &puhost->dev.dev_desc;
+  uvc_cache_type *pcache;
+  uint16_t len = puhost->dev.cfg_desc.cfg.wTotalLength;
+  uint32_t sum;
+  uint8_t idx;
+  
+  if(len > USBH_MAX_CFG_DESC_LEN)
+    len = USBH_MAX_CFG_DESC_LEN;
+  sum = uvc_cache_sum(len);
+  
+  for(idx = 0; idx < UVC_DESC_CACHE_NUM; idx ++)
+  {
+    pcache = &uvc_cache[idx];
+    if(pcache->valid && (pcache->vid == pdev->idVendor) && (pcache->pid == pdev->idProduct) &&
+       (pcache->bcd == pdev->bcdDevice) && (pcache->cfg_len == len) && (pcache->cfg_sum == sum))
+      break;
+  }
+  if(idx == UVC_DESC_CACHE_NUM)
+    return USB_FAIL;
+  
+  puvc->class_desc = pcache->class_desc;
+  memcpy(puvc->stream_in, pcache->stream_in, sizeof(puvc->stream_in));
+  puvc->intf_stream = pcache->intf_stream;
+  puvc->max_bandwidth = pcache->max_bandwidth;
+  puvc->cache_idx = idx;
+  
+  if(pcache->committed && (pcache->format == g_uvc_format) && (pcache->width == g_uvc_width) &&
+     (pcache->height == g_uvc_height) && (pcache->interval == g_uvc_interval))
+  {
+    uvc_format_index = pcache->format_index;
+    uvc_frame_index = pcache->frame_index;
+    puvc->frame_width = pcache->frame_width;
+    puvc->frame_height = pcache->frame_height;
+    puvc->max_bandwidth = pcache->commit_bandwidth;
+    video_params = pcache->commit;
+    puvc->cache_commit = 1;
+  }
+  USBH_DEBUG("cached camera %d%s", idx, puvc->cache_commit ? ", commit" : "");
+  return USB_OK;
+}
+
+/**
+  * @brief  keep the parsed descriptors of the attached camera, a camera 
+  *         with the same key but other descriptors is replaced
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_cache_save_desc(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  usb_device_desc_type *pdev = &puhost->dev.dev_desc;
+  uvc_cache_type *pcache;
+  uint16_t len = puhost->dev.cfg_desc.cfg.wTotalLength;
+  uint8_t idx;
+  
+  if(len > USBH_MAX_CFG_DESC_LEN)
+    len = USBH_MAX_CFG_DESC_LEN;
+  
+  for(idx = 0; idx < UVC_DESC_CACHE_NUM; idx ++)
+  {
+    pcache = &uvc_cache[idx];
+    if(pcache->valid && (pcache->vid == pdev->idVendor) && (pcache->pid == pdev->idProduct) &&
+       (pcache->bcd == pdev->bcdDevice))
+      break;
+  }
+  if(idx == UVC_DESC_CACHE_NUM)
+  {
+    idx = uvc_cache_next;
+    uvc_cache_next = (uvc_cache_next + 1) % UVC_DESC_CACHE_NUM;
+  }
+  
+  pcache = &uvc_cache[idx];
+  pcache->vid = pdev->idVendor;
+  pcache->pid = pdev->idProduct;
+  pcache->bcd = pdev->bcdDevice;
+  pcache->cfg_len = len;
+  pcache->cfg_sum = uvc_cache_sum(len);
+  pcache->class_desc = puvc->class_desc;
+  memcpy(pcache->stream_in, puvc->stream_in, sizeof(pcache->stream_in));
+  pcache->intf_stream = puvc->intf_stream;
+  pcache->max_bandwidth = puvc->max_bandwidth;
+  pcache->committed = 0;
+  pcache->valid = 1;
+  puvc->cache_idx = idx;
+}
+
+/**
+  * @brief  keep the parameters the camera accepted for the current target
+  * @param  puhost: to the structure of usbh_core_type
+  * @retval none
+  */
+static void uvc_cache_save_commit(usbh_core_type *puhost)
+{
+  usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
+  uvc_cache_type *pcache;
+  
+  if(puvc->cache_idx >= UVC_DESC_CACHE_NUM)
+    return;
+  
+  pcache = &uvc_cache[puvc->cache_idx];
+  pcache->format = g_uvc_format;
+  pcache->width = g_uvc_width;
+  pcache->height = g_uvc_height;
+  pcache->interval = g_uvc_interval;
+  pcache->format_index = uvc_format_index;
+  pcache->frame_index = uvc_frame_index;
+  pcache->frame_width = puvc->frame_width;
+  pcache->frame_height = puvc->frame_height;
+  pcache->commit_bandwidth = puvc->max_bandwidth;
+  pcache->commit = video_params;
+  pcache->committed = 1;
 }
+#endif
@@ -30,7 +30,8 @@
 #include "string.h"
 #include "usbh_core.h"
 
-#define USBH_MAX_VIDEO_STREAM_IN          5
+/* streaming interface alternate settings kept for bandwidth selection */
+#define USBH_MAX_VIDEO_STREAM_IN          16
 #define UVC_RX_FIFO_SIZE                  1023
 
 //#define UVC_TARGET_WIDTH                640
@@ -39,15 +40,51 @@
 #define UVC_TARGET_WIDTH                128
 #define UVC_TARGET_HEIGHT               160
    
+/* frame interval in 100 ns units, 0 selects the fastest rate the
+   camera and the bus can sustain */
+#define UVC_TARGET_INTERVAL             0
+
 #define UVC_CAPTURE_MODE                UVC_FORMAT_MJPEG
 //#define UVC_CAPTURE_MODE                UVC_FORMAT_YUY2
    
-// Uncompressed image frame size in byte
-#define UVC_UNCOMP_FRAME_SIZE           (UVC_TARGET_WIDTH * UVC_TARGET_HEIGHT)
-//#define UVC_UNCOMP_FRAME_SIZE           (160 * 120)
+// Uncompressed image frame size in byte, yuy2 takes 2 bytes per pixel
+#define UVC_YUY2_BYTES_PER_PIXEL        2
+#define UVC_UNCOMP_FRAME_SIZE           (UVC_TARGET_WIDTH * UVC_TARGET_HEIGHT * UVC_YUY2_BYTES_PER_PIXEL)
+//#define UVC_UNCOMP_FRAME_SIZE           (160 * 120 * UVC_YUY2_BYTES_PER_PIXEL)
    
 #define UVC_MAX_FRAME_SIZE              UVC_UNCOMP_FRAME_SIZE
 
+#define UVC_HEADER_MAX_SIZE             12
+/* the payload header of a zero-copy packet lands in front of the write
+   position */
+#define UVC_FRAME_HEADROOM              UVC_HEADER_MAX_SIZE
+/* size of each buffer passed to uvc_stream_init */
+#define UVC_FRAME_BUFFER_SIZE           (UVC_FRAME_HEADROOM + UVC_MAX_FRAME_SIZE)
+/* bounce buffer of one isochronous packet, whole words so that every
+   packet is read into a word aligned buffer */
+#define UVC_RX_BUFFER_SIZE              ((UVC_RX_FIFO_SIZE + 3) & ~3)
+
+/* isochronous receive, UVC_ISO_IRQ_ENABLE and UVC_ZERO_COPY_ENABLE are
+   mutually exclusive:
+   - UVC_ISO_IRQ_ENABLE re-arms the receive from the channel complete
+     interrupt and runs the payload parser from PendSV, PendSV_Handler has
+     to call usbh_uvc_deferred_handler. packets alternate between two
+     bounce buffers, the next receive is armed before the length of the
+     last packet is known so it cannot be aimed at the frame buffer.
+   - UVC_ZERO_COPY_ENABLE polls URB_DONE from the class process handler and
+     receives the payloads directly into the frame buffer, the payload
+     header is taken out-of-band.
+   - with neither the process handler polls and every packet is copied
+     from tmp_frame_buffer.
+   the interrupt receive is used unless the build defines one of them */
+#if !defined(UVC_ISO_IRQ_ENABLE) && !defined(UVC_ZERO_COPY_ENABLE)
+#define UVC_ISO_IRQ_ENABLE
+#endif
+#if defined(UVC_ISO_IRQ_ENABLE) && defined(UVC_ZERO_COPY_ENABLE)
+#error "UVC_ISO_IRQ_ENABLE and UVC_ZERO_COPY_ENABLE are mutually exclusive"
+#endif
+#define UVC_ISO_DESC_NUM                2
+
 #define USB_SUBCLASS_VIDEO_CONTROL	                      0x01
 #define USB_SUBCLASS_VIDEO_STREAMING	                    0x02
 #define USB_SUBCLASS_VIDEO_INTERFACE_COLLECTION           0x03
@@ -91,6 +128,8 @@
 #define UVC_GET_RES			    0x84
 #define UVC_SET_MEM			    0x05
 #define UVC_GET_MEM			    0x85
+#define UVC_GET_INFO			    0x86
+#define UVC_GET_DEF			    0x87
 
 #define UVC_GET_STAT			    0xff
 
@@ -102,6 +141,7 @@
 #define UVC_MAX_NUM_OUT_TERMINAL         4
 #define UVC_MAX_NUM_FEATURE_UNIT         2
 #define UVC_MAX_NUM_SELECTOR_UNIT        2
+#define UVC_MAX_NUM_PROCESSING_UNIT      2
 #define UVC_MAX_NUM_IN_HEADER            3
 
 #define UVC_MAX_MJPEG_FORMAT             3
@@ -117,6 +157,48 @@
 #define VS_PROBE_CONTROL                 0x01
 #define VS_COMMIT_CONTROL                0x02
 
+#define UVC_ITT_CAMERA                   0x0201
+
+/* camera terminal control selectors */
+#define CT_AE_MODE_CONTROL               0x02
+#define CT_AE_PRIORITY_CONTROL           0x03
+#define CT_EXPOSURE_TIME_ABSOLUTE_CONTROL 0x04
+#define CT_FOCUS_ABSOLUTE_CONTROL        0x06
+#define CT_FOCUS_AUTO_CONTROL            0x08
+
+/* processing unit control selectors */
+#define PU_BRIGHTNESS_CONTROL            0x02
+#define PU_POWER_LINE_FREQUENCY_CONTROL  0x05
+#define PU_WHITE_BALANCE_TEMPERATURE_CONTROL      0x0A
+#define PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL 0x0B
+
+/* UVC_CTRL_AE_MODE values */
+#define UVC_AE_MODE_MANUAL               0x01
+#define UVC_AE_MODE_AUTO                 0x02
+#define UVC_AE_MODE_SHUTTER_PRIORITY     0x04
+#define UVC_AE_MODE_APERTURE_PRIORITY    0x08
+
+/* pending video control requests, a power of two */
+#define UVC_CTRL_QUEUE_SIZE              32
+
+/* ask the camera to keep the frame rate in low light instead of letting
+   auto exposure stretch the frame interval, comment out to keep the
+   device default */
+#define UVC_CONSTANT_FRAME_RATE
+
+/* cameras whose parsed descriptors and last commit are kept across
+   hot-plug, a known camera is committed without probing again. comment
+   out to parse and probe on every attach */
+#define UVC_DESC_CACHE_NUM               2
+
+/* probe attempts before giving up on the negotiation */
+#define UVC_PROBE_MAX_RETRY              8
+
+/* frame overrun or babble errors within the window (ms) that move the 
+   stream to a lower bandwidth alternate setting */
+#define UVC_ALT_FALLBACK_ERR_NUM         4
+#define UVC_ALT_FALLBACK_WINDOW          1000
+
 /**
   * @brief uvc support format
   */
@@ -165,6 +247,9 @@ typedef enum
   UVC_REQ_GET_CUR,
   UVC_REQ_SET_CUR,
   UVC_REQ_SET_CUR_COM,
+  UVC_REQ_GET_DEF,
+  UVC_REQ_GET_MIN,
+  UVC_REQ_GET_MAX,
 }uvc_req_state_type;
 
 /**
@@ -177,6 +262,23 @@ typedef enum
  UVC_CONTROL_IDLE, 
 }uvc_ctrl_state_type;
 
+/**
+  * @brief camera terminal and processing unit controls
+  */
+typedef enum
+{
+  UVC_CTRL_BRIGHTNESS = 0,
+  UVC_CTRL_AE_MODE,                /* UVC_AE_MODE_xxx */
+  UVC_CTRL_AE_PRIORITY,            /* 0: constant frame rate, 1: the rate may drop */
+  UVC_CTRL_EXPOSURE,               /* exposure time in 100 us units */
+  UVC_CTRL_WHITE_BALANCE_AUTO,
+  UVC_CTRL_WHITE_BALANCE,          /* color temperature in kelvin */
+  UVC_CTRL_POWER_LINE,             /* 0: disabled, 1: 50 Hz, 2: 60 Hz */
+  UVC_CTRL_FOCUS_AUTO,
+  UVC_CTRL_FOCUS,                  /* focus distance in mm */
+  UVC_CTRL_NUM,
+}uvc_ctrl_id_type;
+
 /**
   * @brief states of the uvc streaming
   */
@@ -251,6 +353,21 @@ typedef struct
   uint8_t  bmaControls[UVC_MAX_CONTROLS_NBR][2];                                                                 
 } uvc_feature_desc_type;
 
+/**
+  * @brief processing unit descriptor
+  */
+typedef struct
+{
+  uint8_t  bLength;
+  uint8_t  bDescriptorType;
+  uint8_t  bDescriptorSubtype;
+  uint8_t  bUnitID;
+  uint8_t  bSourceID;
+  uint8_t  wMaxMultiplier[2];
+  uint8_t  bControlSize;
+  uint8_t  bmControls[3];
+} uvc_processing_desc_type;
+
 /**
   * @brief selector descriptor
   */
@@ -317,11 +434,34 @@ typedef struct
   uint8_t  wHeight[2];
   uint8_t  dwMinBitRate[4];
   uint8_t  dwMaxBitRate[4];
+  uint8_t  dwMaxVideoFrameBufferSize[4];
   uint8_t  dwDefaultFrameInterval[4];
   uint8_t  bFrameIntervalType;
   /* dwFrameInterval*N is here */
 } uvc_mjpeg_frame_desc_type;
 
+/**
+  * @brief vs frame descriptor fields shared by mjpeg and uncompressed frames,
+  *        followed by dwMinFrameInterval, dwMaxFrameInterval and
+  *        dwFrameIntervalStep when bFrameIntervalType is 0 or by
+  *        bFrameIntervalType discrete dwFrameInterval values
+  */
+typedef struct 
+{
+  uint8_t  bLength;           
+  uint8_t  bDescriptorType;
+  uint8_t  bDescriptorSubtype;
+  uint8_t  bFrameIndex;
+  uint8_t  bmCapabilities;
+  uint8_t  wWidth[2];
+  uint8_t  wHeight[2];
+  uint8_t  dwMinBitRate[4];
+  uint8_t  dwMaxBitRate[4];
+  uint8_t  dwMaxVideoFrameBufferSize[4];
+  uint8_t  dwDefaultFrameInterval[4];
+  uint8_t  bFrameIntervalType;
+} uvc_frame_desc_type;
+
 /**
   * @brief vs uncompressed format descriptor
   */
@@ -355,6 +495,7 @@ typedef struct
   uint8_t  wHeight[2];
   uint8_t  dwMinBitRate[4];
   uint8_t  dwMaxBitRate[4];
+  uint8_t  dwMaxVideoFrameBufferSize[4];
   uint8_t  dwDefaultFrameInterval[4];
   uint8_t  bFrameIntervalType;
   /* dwFrameInterval*N is here */
@@ -367,7 +508,9 @@ typedef struct
 typedef struct
 {
   uint8_t              endp;
-  uint16_t             max_size;
+  uint16_t             max_size;         /* bytes per transaction */
+  uint16_t             bandwidth;        /* bytes per (micro)frame */
+  uint8_t              mult;             /* transactions per (micro)frame */
   uint8_t              alts;
   uint8_t              interface;
   uint8_t              valid; 
@@ -388,6 +531,9 @@ typedef struct
   uint8_t              channel;  
   uint8_t              poll; 
   uint32_t             timer ; 
+  uint16_t             bandwidth;
+  uint16_t             err_cnt;
+  uint32_t             err_timer;
   
   uint8_t              asociated_as;
   
@@ -400,6 +546,18 @@ typedef struct
   uint32_t             total_length;  
 }uvc_intf_stream_type;
 
+/**
+  * @brief uvc isochronous receive descriptor
+  */
+typedef struct
+{
+  uint8_t              *buf;
+  uint16_t             len;
+  uint32_t             timestamp;
+  uint8_t              lost;        /* packets lost before this one */
+  __IO uint8_t         state;
+}uvc_iso_desc_type;
+
 
 /**
   * @brief class-specific video control interface descriptor
@@ -411,6 +569,7 @@ typedef struct
   uvc_output_desc_type       *output[UVC_MAX_NUM_OUT_TERMINAL];
   uvc_feature_desc_type      *feature_unit[UVC_MAX_NUM_FEATURE_UNIT];
   uvc_selector_desc_type     *selector_unit[UVC_MAX_NUM_SELECTOR_UNIT];
+  uvc_processing_desc_type   *processing_unit[UVC_MAX_NUM_PROCESSING_UNIT];
 }uvc_vc_desc_type;
 
 /**
@@ -422,9 +581,11 @@ typedef struct
   
   uvc_mjpeg_format_desc_type  *mjpeg_format[UVC_MAX_MJPEG_FORMAT];
   uvc_mjpeg_frame_desc_type   *mjpeg_frame[UVC_MAX_MJPEG_FRAME_D];
+  uint8_t                     mjpeg_frame_format[UVC_MAX_MJPEG_FRAME_D];
   
   uvc_uncomp_format_desc_type *uncomp_format[UVC_MAX_UNCOMP_FORMAT];
   uvc_uncomp_frame_desc_type  *uncomp_frame[UVC_MAX_UNCOMP_FRAME_D];
+  uint8_t                     uncomp_frame_format[UVC_MAX_UNCOMP_FRAME_D];
   
 } uvc_vs_desc_type;
 
@@ -441,6 +602,8 @@ typedef struct
   uint16_t input_terminal;
   uint16_t out_terminal;
   uint16_t selector_unit;
+  uint16_t processing_unit;
+  uint8_t  vc_interface;
   
   uint8_t input_header;
   
@@ -472,6 +635,32 @@ typedef __packed struct
 } uvc_video_info_type;
 
 
+/**
+  * @brief uvc control state, the values read from the device
+  */
+typedef struct
+{
+  uint8_t              entity;           /* unit or terminal id, 0 if not supported */
+  uint8_t              valid;            /* UVC_CTRL_VALID_xxx */
+  int32_t              cur;
+  int32_t              min;
+  int32_t              max;
+}uvc_ctrl_info_type;
+
+#define UVC_CTRL_VALID_CUR               0x01
+#define UVC_CTRL_VALID_MIN               0x02
+#define UVC_CTRL_VALID_MAX               0x04
+
+/**
+  * @brief queued video control request
+  */
+typedef struct
+{
+  uint8_t              ctrl;             /* uvc_ctrl_id_type */
+  uint8_t              request;          /* UVC_SET_CUR, UVC_GET_CUR, ... */
+  int32_t              value;
+}uvc_ctrl_req_type;
+
 typedef struct
 {
   uvc_req_state_type                 req_state;  
@@ -483,9 +672,39 @@ typedef struct
   
   uvc_intf_stream_type               intf_stream;//camera;
   uint16_t                           mem[8];  
-  uint8_t                            temp_feature;
    __IO uint16_t                     timer; 
   
+  /* probe and commit negotiation */
+  uint32_t                           frame_interval;
+  uint32_t                           interval_min;
+  uint32_t                           interval_max;
+  uint16_t                           max_bandwidth;
+  uint16_t                           frame_width;
+  uint16_t                           frame_height;
+  uint8_t                            probe_retry;
+  uint8_t                            probe_clamped;
+  
+  /* interrupt driven isochronous receive */
+  uvc_iso_desc_type                  iso_desc[UVC_ISO_DESC_NUM];
+  __IO uint8_t                       iso_armed;    /* descriptor owned by the channel */
+  uint8_t                            iso_next;     /* next descriptor for the parser */
+  __IO uint8_t                       iso_rearm;    /* channel left idle, parser behind */
+  __IO uint16_t                      iso_err;      /* errors seen by the interrupt */
+  uint16_t                           iso_err_done; /* errors handled by the process handler */
+  
+  /* video control requests, sent one at a time between the streaming 
+     requests */
+  uvc_ctrl_info_type                 ctrl_info[UVC_CTRL_NUM];
+  uvc_ctrl_req_type                  ctrl_queue[UVC_CTRL_QUEUE_SIZE];
+  uint8_t                            ctrl_head;
+  uint8_t                            ctrl_tail;
+  uint8_t                            ctrl_busy;    /* queue head on the control pipe */
+  uint8_t                            ctrl_read;    /* values read since attach */
+  uint32_t                           ctrl_buf;     /* control data stage */
+  
+  /* descriptor cache */
+  uint8_t                            cache_idx;    /* entry of this camera, 0xFF if none */
+  uint8_t                            cache_commit; /* committing the cached probe */
 }usbh_uvc_type;
 
 //typedef struct _format_payload_header
@@ -501,5 +720,13 @@ typedef struct
 
 
 extern usbh_class_handler_type uhost_video_class_handler;
+
+usb_sts_type usbh_uvc_set_target(usbh_core_type *puhost, uvc_format_type format,
+                                 uint16_t width, uint16_t height, uint32_t interval);
+void usbh_uvc_deferred_handler(usbh_core_type *puhost);
+usb_sts_type usbh_uvc_set_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl, int32_t value);
+usb_sts_type usbh_uvc_read_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl);
+usb_sts_type usbh_uvc_get_control(usbh_core_type *puhost, uvc_ctrl_id_type ctrl, 
+                                  int32_t *value, int32_t *min, int32_t *max);
 #endif
 
@@ -31,73 +31,51 @@
 #include "stdio.h"
 #include "string.h"
 
-extern uint8_t usbh_cfg_buffer[USB_MAX_DATA_LENGTH]; /*!< usb host cfg buffer */
 int32_t  uvc_format_index = -1;
 int32_t  uvc_frame_index = -1;
 uvc_format_type g_uvc_format = UVC_FORMAT_MJPEG;
 uint32_t g_uvc_width = UVC_TARGET_WIDTH;
 uint32_t g_uvc_height = UVC_TARGET_HEIGHT;
-
-uint8_t uvc_find_Interface_index(usbh_core_type *puhost, uint8_t interface_number, uint8_t alt_settings);
-
-
-uint8_t uvc_find_Interface_index(usbh_core_type *puhost, uint8_t interface_number, uint8_t alt_settings)
-{
-  usb_interface_desc_type    *pif ;
-  uint8_t                     if_ix = 0;
-  
-  while (if_ix < USBH_MAX_INTERFACE)
-  {
-    pif = &(puhost->dev.cfg_desc.interface[if_ix].interface);
-    if((pif->bInterfaceNumber == interface_number) && (pif->bAlternateSetting == alt_settings))
-    {
-      return  if_ix;
-    }
-    if_ix++;
-  }
-  return 0xFF;
-}
+uint32_t g_uvc_interval = UVC_TARGET_INTERVAL;
 
 usb_sts_type uvc_parse_descriptor(usbh_core_type *puhost)
 {
+  usb_itf_index_type *pindex = &puhost->dev.cfg_desc.index;
+  usb_itf_alt_type *palt;
   usb_header_desc_type *pdesc;
-  uint16_t ptr = 0x9;
-  uint8_t itf_index = 0, itf_number = 0, alt_setting;  
+  uint16_t ptr, total, alt_idx;
   usbh_uvc_type *puvc = (usbh_uvc_type *)puhost->class_handler->pdata;
   
-  pdesc   = (usb_header_desc_type *)usbh_cfg_buffer;
-  puvc->class_desc.input_terminal = 0;
-  puvc->class_desc.out_terminal = 0;  
-  puvc->class_desc.alts_num = 0;
+  memset(&puvc->class_desc, 0, sizeof(uvc_class_spec_desc_type));
   
-  while(ptr < puhost->dev.cfg_desc.cfg.wTotalLength)
+  /* class specific descriptors of the video interfaces only, an audio
+     function of the same device has its own */
+  for(alt_idx = 0; alt_idx < pindex->alt_num; alt_idx ++)
   {
-    pdesc = usbh_get_next_header((uint8_t*) pdesc, &ptr);
+    palt = &pindex->alt[alt_idx];
+    if(palt->bInterfaceClass != USB_CLASS_CODE_VIDEO)
+      continue;
+    if(palt->bInterfaceSubClass == USB_SUBCLASS_VIDEO_CONTROL)
+    {
+      /* addressed in wIndex of the unit and terminal requests */
+      puvc->class_desc.vc_interface = palt->bInterfaceNumber;
+    }
     
-    switch (pdesc->bDescriptorType)
-    {  
-      case USB_DESCIPTOR_TYPE_INTERFACE:
-        itf_number = *((uint8_t *)pdesc + 2);
-        alt_setting = *((uint8_t *)pdesc + 3);
-        itf_index = uvc_find_Interface_index(puhost, itf_number, alt_setting);     
-      break;
-
-      case USB_DESC_TYPE_CS_INTERFACE:
-        if(itf_number <= puhost->dev.cfg_desc.cfg.bNumInterfaces)
-        {
-        
-          uvc_parse_cs_descriptors(&puvc->class_desc,
-                           puhost->dev.cfg_desc.interface[itf_index].interface.bInterfaceSubClass, 
-                           (uint8_t *)pdesc);
-        }
+    pdesc = (usb_header_desc_type *)usbh_get_interface_alt_desc(puhost, alt_idx, &total);
+    ptr = 0;
+    while(1)
+    {
+      pdesc = usbh_get_next_header((uint8_t *)pdesc, &ptr);
+      if((ptr + 2 > total) || (pdesc->bLength < 2) || (ptr + pdesc->bLength > total))
         break;
       
-      default:
-        break; 
+      if(pdesc->bDescriptorType == USB_DESC_TYPE_CS_INTERFACE)
+      {
+        uvc_parse_cs_descriptors(&puvc->class_desc, palt->bInterfaceSubClass, (uint8_t *)pdesc);
+      }
     }
   }
   return USB_OK;
- 
 }
 
 usb_sts_type uvc_parse_cs_descriptors(uvc_class_spec_desc_type *class_desc, 
@@ -125,6 +103,13 @@ usb_sts_type uvc_parse_cs_descriptors(uvc_class_spec_desc_type *class_desc,
       case UVC_VC_SELECTOR_UNIT:
         class_desc->cs_desc.selector_unit[class_desc->selector_unit++] = (uvc_selector_desc_type*) pdesc; 
         break;    
+        
+      case UVC_VC_PROCESSING_UNIT:
+        if (class_desc->processing_unit < UVC_MAX_NUM_PROCESSING_UNIT)
+        {
+          class_desc->cs_desc.processing_unit[class_desc->processing_unit++] = (uvc_processing_desc_type*) pdesc;
+        }
+        break;
 
       default: 
         break;
@@ -154,6 +139,12 @@ usb_sts_type uvc_parse_cs_descriptors(uvc_class_spec_desc_type *class_desc,
         if (desc_number < UVC_MAX_MJPEG_FRAME_D)
         {
           class_desc->vs_desc.mjpeg_frame[desc_number] = (uvc_mjpeg_frame_desc_type*) pdesc;    
+          /* frame descriptors follow the format descriptor they belong to */
+          if (class_desc->mjpeg_format != 0)
+          {
+            class_desc->vs_desc.mjpeg_frame_format[desc_number] = 
+              class_desc->vs_desc.mjpeg_format[class_desc->mjpeg_format - 1]->bFormatIndex;
+          }
           USBH_DEBUG("mjpeg frame detected: %d x %d", 
                     LE16(class_desc->vs_desc.mjpeg_frame[desc_number]->wWidth), 
                     LE16(class_desc->vs_desc.mjpeg_frame[desc_number]->wHeight));
@@ -172,9 +163,14 @@ usb_sts_type uvc_parse_cs_descriptors(uvc_class_spec_desc_type *class_desc,
         if (desc_number < UVC_MAX_UNCOMP_FRAME_D)
         {
           class_desc->vs_desc.uncomp_frame[desc_number] = (uvc_uncomp_frame_desc_type*) pdesc;      
+          if (class_desc->uncomp_format != 0)
+          {
+            class_desc->vs_desc.uncomp_frame_format[desc_number] = 
+              class_desc->vs_desc.uncomp_format[class_desc->uncomp_format - 1]->bFormatIndex;
+          }
           USBH_DEBUG("uncompressed frame detected: %d x %d", 
-                    LE16(class_desc->vs_desc.mjpeg_frame[desc_number]->wWidth), 
-                    LE16(class_desc->vs_desc.mjpeg_frame[desc_number]->wHeight));
+                    LE16(class_desc->vs_desc.uncomp_frame[desc_number]->wWidth), 
+                    LE16(class_desc->vs_desc.uncomp_frame[desc_number]->wHeight));
           class_desc->uncomp_frame++;
         }
         break;
@@ -229,35 +225,217 @@ void uvc_parse_format_descriptor(uvc_class_spec_desc_type *class_desc)
   }
 }
 
+/**
+  * @brief  get a frame descriptor of the selected format by list position
+  * @param  class_desc: class-specific descriptors
+  * @param  idx: position in the frame descriptor list
+  * @retval frame descriptor, NULL if it belongs to another format
+  */
+static uvc_frame_desc_type *uvc_frame_at(uvc_class_spec_desc_type *class_desc, uint8_t idx)
+{
+  if (g_uvc_format == UVC_FORMAT_MJPEG)
+  {
+    if ((idx < class_desc->mjpeg_frame) &&
+        (class_desc->vs_desc.mjpeg_frame_format[idx] == uvc_format_index))
+      return (uvc_frame_desc_type *)class_desc->vs_desc.mjpeg_frame[idx];
+  }
+  else if (g_uvc_format == UVC_FORMAT_YUY2)
+  {
+    if ((idx < class_desc->uncomp_frame) &&
+        (class_desc->vs_desc.uncomp_frame_format[idx] == uvc_format_index))
+      return (uvc_frame_desc_type *)class_desc->vs_desc.uncomp_frame[idx];
+  }
+  return NULL;
+}
+
+/**
+  * @brief  get the number of frame descriptors of the selected format type
+  * @param  class_desc: class-specific descriptors
+  * @retval frame descriptor number
+  */
+static uint8_t uvc_frame_num(uvc_class_spec_desc_type *class_desc)
+{
+  if (g_uvc_format == UVC_FORMAT_MJPEG)
+    return class_desc->mjpeg_frame;
+  else if (g_uvc_format == UVC_FORMAT_YUY2)
+    return class_desc->uncomp_frame;
+  return 0;
+}
+
+/**
+  * @brief  get the frame interval at a position of the interval list
+  * @param  frame: frame descriptor
+  * @param  n: interval position
+  * @retval frame interval in 100 ns units
+  */
+static uint32_t uvc_frame_interval_at(uvc_frame_desc_type *frame, uint8_t n)
+{
+  uint8_t *pinterval = (uint8_t *)frame + sizeof(uvc_frame_desc_type) + 4 * n;
+  return LE16(pinterval) | ((uint32_t)LE16(pinterval + 2) << 16);
+}
+
+/**
+  * @brief  select the frame matching g_uvc_width x g_uvc_height, else the
+  *         largest frame inside it, else the smallest frame
+  * @param  class_desc: class-specific descriptors
+  * @retval none
+  */
 void uvc_parse_frame_descriptor(uvc_class_spec_desc_type *class_desc)
 {
-  uvc_mjpeg_frame_desc_type* mjpeg_frame_desc;
-  uvc_uncomp_frame_desc_type* uncomp_frame_desc;
-	uint8_t idx;
+  uvc_frame_desc_type *frame, *best = NULL;
+  uint32_t width, height, area, best_area = 0;
+  uint8_t idx, fit, best_fit = 0;
   uvc_frame_index = -1;
-    
-  if (g_uvc_format == UVC_FORMAT_MJPEG)
+  
+  for (idx = 0; idx < uvc_frame_num(class_desc); idx++)
   {
-    for (idx = 0; idx < class_desc->mjpeg_frame; idx++)
+    frame = uvc_frame_at(class_desc, idx);
+    if (frame == NULL)
+      continue;
+    
+    width = LE16(frame->wWidth);
+    height = LE16(frame->wHeight);
+    if ((width == g_uvc_width) && (height == g_uvc_height))
     {
-      mjpeg_frame_desc = class_desc->vs_desc.mjpeg_frame[idx];
-      if ((LE16(mjpeg_frame_desc->wWidth) == g_uvc_width) && \
-        (LE16(mjpeg_frame_desc->wHeight) == g_uvc_height))
-      {
-        uvc_frame_index = mjpeg_frame_desc->bFrameIndex;
-      }
+      best = frame;
+      break;
+    }
+    
+    fit = (width <= g_uvc_width) && (height <= g_uvc_height);
+    area = width * height;
+    if ((best == NULL) ||
+        (fit && (!best_fit || area > best_area)) ||
+        (!fit && !best_fit && area < best_area))
+    {
+      best = frame;
+      best_fit = fit;
+      best_area = area;
     }
   }
-  else if (g_uvc_format == UVC_FORMAT_YUY2)
+  
+  if (best != NULL)
   {
-    for (idx = 0; idx < class_desc->uncomp_frame; idx++)
+    uvc_frame_index = best->bFrameIndex;
+    USBH_DEBUG("select frame %d: %d x %d", uvc_frame_index, 
+               LE16(best->wWidth), LE16(best->wHeight));
+  }
+}
+
+/**
+  * @brief  get a frame descriptor of the selected format
+  * @param  class_desc: class-specific descriptors
+  * @param  frame_index: bFrameIndex
+  * @retval frame descriptor, NULL if not found
+  */
+uvc_frame_desc_type *uvc_get_frame_descriptor(uvc_class_spec_desc_type *class_desc, uint8_t frame_index)
+{
+  uvc_frame_desc_type *frame;
+  uint8_t idx;
+  
+  for (idx = 0; idx < uvc_frame_num(class_desc); idx++)
+  {
+    frame = uvc_frame_at(class_desc, idx);
+    if ((frame != NULL) && (frame->bFrameIndex == frame_index))
+      return frame;
+  }
+  return NULL;
+}
+
+/**
+  * @brief  get the largest frame of the selected format smaller than a frame
+  * @param  class_desc: class-specific descriptors
+  * @param  frame_index: bFrameIndex of the current frame
+  * @retval frame descriptor, NULL if there is no smaller frame
+  */
+uvc_frame_desc_type *uvc_get_smaller_frame(uvc_class_spec_desc_type *class_desc, uint8_t frame_index)
+{
+  uvc_frame_desc_type *frame, *cur, *best = NULL;
+  uint32_t area, cur_area, best_area = 0;
+  uint8_t idx;
+  
+  cur = uvc_get_frame_descriptor(class_desc, frame_index);
+  if (cur == NULL)
+    return NULL;
+  cur_area = (uint32_t)LE16(cur->wWidth) * LE16(cur->wHeight);
+  
+  for (idx = 0; idx < uvc_frame_num(class_desc); idx++)
+  {
+    frame = uvc_frame_at(class_desc, idx);
+    if (frame == NULL)
+      continue;
+    area = (uint32_t)LE16(frame->wWidth) * LE16(frame->wHeight);
+    if ((area < cur_area) && (area > best_area))
     {
-      uncomp_frame_desc = class_desc->vs_desc.uncomp_frame[idx];
-      if ((LE16(uncomp_frame_desc->wWidth) == g_uvc_width) && \
-        (LE16(uncomp_frame_desc->wHeight) == g_uvc_height))
-      {
-        uvc_frame_index = uncomp_frame_desc->bFrameIndex;
-      }
+      best = frame;
+      best_area = area;
     }
   }
+  return best;
+}
+
+/**
+  * @brief  select the shortest frame interval not below a target
+  * @param  frame: frame descriptor
+  * @param  target: target interval in 100 ns units, 0 for the fastest rate
+  * @retval frame interval, the slowest one if all are below the target
+  */
+uint32_t uvc_frame_interval_select(uvc_frame_desc_type *frame, uint32_t target)
+{
+  uint32_t interval, min, max, step, best = 0, slowest = 0;
+  uint8_t idx;
+  
+  if (frame->bFrameIntervalType == 0)
+  {
+    /* continuous intervals */
+    min = uvc_frame_interval_at(frame, 0);
+    max = uvc_frame_interval_at(frame, 1);
+    step = uvc_frame_interval_at(frame, 2);
+    if (target <= min)
+      return min;
+    if (target >= max)
+      return max;
+    if (step == 0)
+      return target;
+    interval = min + ((target - min + step - 1) / step) * step;
+    return (interval > max) ? max : interval;
+  }
+  
+  for (idx = 0; idx < frame->bFrameIntervalType; idx++)
+  {
+    interval = uvc_frame_interval_at(frame, idx);
+    if (interval > slowest)
+      slowest = interval;
+    if ((interval >= target) && ((best == 0) || (interval < best)))
+      best = interval;
+  }
+  return (best != 0) ? best : slowest;
+}
+
+/**
+  * @brief  get the next longer frame interval
+  * @param  frame: frame descriptor
+  * @param  interval: current interval in 100 ns units
+  * @retval longer frame interval, 0 if there is none
+  */
+uint32_t uvc_frame_interval_next(uvc_frame_desc_type *frame, uint32_t interval)
+{
+  uint32_t next, max, best = 0;
+  uint8_t idx;
+  
+  if (frame->bFrameIntervalType == 0)
+  {
+    /* halve the rate, a step may be a single 100 ns unit */
+    max = uvc_frame_interval_at(frame, 1);
+    if (interval >= max)
+      return 0;
+    return uvc_frame_interval_select(frame, interval * 2);
+  }
+  
+  for (idx = 0; idx < frame->bFrameIntervalType; idx++)
+  {
+    next = uvc_frame_interval_at(frame, idx);
+    if ((next > interval) && ((best == 0) || (next < best)))
+      best = next;
+  }
+  return best;
 }
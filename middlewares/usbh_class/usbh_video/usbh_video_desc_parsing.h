@@ -37,9 +37,17 @@ usb_sts_type uvc_parse_cs_descriptors(uvc_class_spec_desc_type *class_desc,
 void uvc_parse_format_descriptor(uvc_class_spec_desc_type *class_desc);
 void uvc_parse_frame_descriptor(uvc_class_spec_desc_type *class_desc);
 
+uvc_frame_desc_type *uvc_get_frame_descriptor(uvc_class_spec_desc_type *class_desc, uint8_t frame_index);
+uvc_frame_desc_type *uvc_get_smaller_frame(uvc_class_spec_desc_type *class_desc, uint8_t frame_index);
+uint32_t uvc_frame_interval_select(uvc_frame_desc_type *frame, uint32_t target);
+uint32_t uvc_frame_interval_next(uvc_frame_desc_type *frame, uint32_t interval);
+
 extern uvc_format_type g_uvc_format;
-extern int uvc_format_index;
-extern int uvc_frame_index;
+extern uint32_t g_uvc_width;
+extern uint32_t g_uvc_height;
+extern uint32_t g_uvc_interval;
+extern int32_t uvc_format_index;
+extern int32_t uvc_frame_index;
 
 #endif
 
@@ -0,0 +1,415 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_mjpeg.c
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video mjpeg decode
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+
+#include "usbh_video_mjpeg.h"
+
+#define JPEG_MARKER_DHT                 0xC4
+#define JPEG_MARKER_SOS                 0xDA
+
+/**
+  * @brief decode session, the tjpgd device
+  */
+typedef struct
+{
+  const uint8_t *data;
+  uint32_t len;
+  uint32_t pos;                     /* read position in the virtual stream */
+  uint32_t split;                   /* where the default tables are inserted */
+  uint16_t dht_len;                 /* 0 when the frame has its own tables */
+  uint16_t out_width;
+  uvc_mjpeg_output_type output;
+  void *user;
+  lv_area_t strip;
+  uint8_t strip_valid;
+  uint8_t strip_buf;                /* strip buffer being collected */
+  uint32_t strip_cnt;
+}uvc_mjpeg_dev_type;
+
+static uint32_t uvc_mjpeg_pool[UVC_MJPEG_POOL_SIZE / 4];
+/* two strips, one is being filled while the other may still be on its way to the lcd */
+static lv_color_t uvc_mjpeg_strip[2][UVC_MJPEG_STRIP_WIDTH * UVC_MJPEG_STRIP_HEIGHT];
+static uvc_mjpeg_stats_type uvc_mjpeg_stats;
+
+/* mjpeg cameras leave out the huffman tables and expect the decoder to use
+   the example tables of itu-t t.81 annex k.3 */
+static const uint8_t uvc_mjpeg_dht[] =
+{
+  0xFF, JPEG_MARKER_DHT, 0x01, 0xA2,
+  /* luminance dc */
+  0x00,
+  0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0A, 0x0B,
+  /* luminance ac */
+  0x10,
+  0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03,
+  0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D,
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+  0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+  0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16,
+  0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+  0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+  0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+  0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+  0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+  0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+  0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4,
+  0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+  0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA,
+  0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA,
+  /* chrominance dc */
+  0x01,
+  0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0A, 0x0B,
+  /* chrominance ac */
+  0x11,
+  0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04,
+  0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+  0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+  0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+  0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34,
+  0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+  0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38,
+  0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+  0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+  0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96,
+  0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+  0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+  0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+  0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2,
+  0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+  0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9,
+  0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+  0xF9, 0xFA,
+};
+
+/**
+  * @brief  find where the default huffman tables go, in front of the start
+  *         of scan of a frame that carries no dht segment
+  * @param  dev: decode session
+  * @retval none
+  */
+static void uvc_mjpeg_check_dht(uvc_mjpeg_dev_type *dev)
+{
+  const uint8_t *data = dev->data;
+  uint32_t pos = 2;
+
+  dev->split = dev->len;
+  dev->dht_len = 0;
+  if((dev->len < 4) || (data[0] != 0xFF) || (data[1] != 0xD8))
+    return;
+
+  while(pos + 4 <= dev->len)
+  {
+    if(data[pos] != 0xFF)
+      return;
+    if(data[pos + 1] == 0xFF)
+    {
+      /* fill byte */
+      pos ++;
+      continue;
+    }
+    if(data[pos + 1] == JPEG_MARKER_DHT)
+      return;
+    if(data[pos + 1] == JPEG_MARKER_SOS)
+    {
+      dev->split = pos;
+      dev->dht_len = sizeof(uvc_mjpeg_dht);
+      return;
+    }
+    pos += 2 + (((uint32_t)data[pos + 2] << 8) | data[pos + 3]);
+  }
+}
+
+/**
+  * @brief  tjpgd input function, reads the frame with the default huffman
+  *         tables spliced in
+  * @param  jd: tjpgd decompressor
+  * @param  buf: destination, NULL to skip
+  * @param  n: bytes requested
+  * @retval bytes read
+  */
+static size_t uvc_mjpeg_input(JDEC *jd, uint8_t *buf, size_t n)
+{
+  uvc_mjpeg_dev_type *dev = (uvc_mjpeg_dev_type *)jd->device;
+  const uint8_t *src;
+  uint32_t avail;
+  size_t done = 0, chunk;
+
+  while(done < n)
+  {
+    if(dev->pos < dev->split)
+    {
+      src = dev->data + dev->pos;
+      avail = dev->split - dev->pos;
+    }
+    else if(dev->pos < dev->split + dev->dht_len)
+    {
+      src = uvc_mjpeg_dht + (dev->pos - dev->split);
+      avail = dev->split + dev->dht_len - dev->pos;
+    }
+    else if(dev->pos < dev->len + dev->dht_len)
+    {
+      src = dev->data + (dev->pos - dev->dht_len);
+      avail = dev->len + dev->dht_len - dev->pos;
+    }
+    else
+    {
+      break;
+    }
+    chunk = (avail < n - done) ? avail : n - done;
+    if(buf != NULL)
+    {
+      memcpy(buf + done, src, chunk);
+    }
+    dev->pos += chunk;
+    done += chunk;
+  }
+  return done;
+}
+
+/**
+  * @brief  hand the collected strip to the output callback
+  * @param  dev: decode session
+  * @retval 0: aborted by the callback
+  */
+static int uvc_mjpeg_flush(uvc_mjpeg_dev_type *dev)
+{
+  lv_color_t *strip = uvc_mjpeg_strip[dev->strip_buf];
+  uint16_t w, h, row;
+
+  if(dev->strip_valid == 0)
+    return 1;
+  dev->strip_valid = 0;
+  dev->strip_cnt ++;
+
+  /* pack the rows, the strip is collected with a UVC_MJPEG_STRIP_WIDTH stride */
+  w = lv_area_get_width(&dev->strip);
+  h = lv_area_get_height(&dev->strip);
+  if(w != UVC_MJPEG_STRIP_WIDTH)
+  {
+    for(row = 1; row < h; row ++)
+    {
+      memmove(&strip[row * w], &strip[row * UVC_MJPEG_STRIP_WIDTH],
+              w * sizeof(lv_color_t));
+    }
+  }
+  dev->strip_buf ^= 1;
+  return dev->output(&dev->strip, strip, dev->user);
+}
+
+/**
+  * @brief  tjpgd output function, converts one mcu to lv_color_t and
+  *         collects the mcus of a row into a strip
+  * @param  jd: tjpgd decompressor
+  * @param  bitmap: rgb888 mcu
+  * @param  rect: mcu area in the output image
+  * @retval 0: abort the decode
+  */
+static int uvc_mjpeg_output(JDEC *jd, void *bitmap, JRECT *rect)
+{
+  uvc_mjpeg_dev_type *dev = (uvc_mjpeg_dev_type *)jd->device;
+  const uint8_t *src = (const uint8_t *)bitmap;
+  lv_color_t *dst;
+  uint16_t w = rect->right - rect->left + 1;
+  uint16_t h = rect->bottom - rect->top + 1;
+  uint16_t x, y;
+
+  if(dev->strip_valid &&
+     ((rect->top != dev->strip.y1) || (rect->left != dev->strip.x2 + 1) ||
+      (rect->right - dev->strip.x1 + 1 > UVC_MJPEG_STRIP_WIDTH)))
+  {
+    if(uvc_mjpeg_flush(dev) == 0)
+      return 0;
+  }
+  if(dev->strip_valid == 0)
+  {
+    dev->strip.x1 = rect->left;
+    dev->strip.y1 = rect->top;
+    dev->strip.y2 = rect->bottom;
+    dev->strip_valid = 1;
+  }
+  dev->strip.x2 = rect->right;
+
+  for(y = 0; y < h; y ++)
+  {
+    dst = &uvc_mjpeg_strip[dev->strip_buf][y * UVC_MJPEG_STRIP_WIDTH + (rect->left - dev->strip.x1)];
+    for(x = 0; x < w; x ++)
+    {
+      dst[x] = lv_color_make(src[0], src[1], src[2]);
+      src += 3;
+    }
+  }
+
+  /* hand out a finished row without waiting for the next one */
+  if(rect->right + 1 >= dev->out_width)
+    return uvc_mjpeg_flush(dev);
+  return 1;
+}
+
+/**
+  * @brief  pick the smallest reduction that fits the frame into an area
+  * @param  width: frame width
+  * @param  height: frame height
+  * @param  max_width: area width
+  * @param  max_height: area height
+  * @retval scale, UVC_MJPEG_SCALE_8 if nothing fits
+  */
+uvc_mjpeg_scale_type uvc_mjpeg_fit_scale(uint16_t width, uint16_t height,
+                                         uint16_t max_width, uint16_t max_height)
+{
+  uint8_t scale;
+
+  for(scale = UVC_MJPEG_SCALE_1; scale < UVC_MJPEG_SCALE_8; scale ++)
+  {
+    if(((width >> scale) <= max_width) && ((height >> scale) <= max_height))
+      break;
+  }
+  return (uvc_mjpeg_scale_type)scale;
+}
+
+/**
+  * @brief  decode a jpeg image and hand it to the output callback in mcu
+  *         row strips, at most UVC_MJPEG_STRIP_WIDTH pixels wide
+  * @param  data: jpeg data
+  * @param  len: jpeg length
+  * @param  scale: output scale
+  * @param  output: strip output callback
+  * @param  user: passed to the callback
+  * @retval tjpgd result
+  */
+JRESULT uvc_mjpeg_decode(const uint8_t *data, uint32_t len, uvc_mjpeg_scale_type scale,
+                         uvc_mjpeg_output_type output, void *user)
+{
+  uvc_mjpeg_dev_type dev;
+  JDEC jd;
+  JRESULT res;
+  uint32_t start = lv_tick_get(), used;
+
+  memset(&dev, 0, sizeof(dev));
+  dev.data = data;
+  dev.len = len;
+  dev.output = output;
+  dev.user = user;
+  uvc_mjpeg_check_dht(&dev);
+
+  res = jd_prepare(&jd, uvc_mjpeg_input, uvc_mjpeg_pool, sizeof(uvc_mjpeg_pool), &dev);
+  if(res == JDR_OK)
+  {
+    if(scale == UVC_MJPEG_SCALE_FIT)
+    {
+      scale = uvc_mjpeg_fit_scale(jd.width, jd.height,
+                                  UVC_MJPEG_FIT_WIDTH, UVC_MJPEG_FIT_HEIGHT);
+    }
+    if(((jd.msy * 8) >> scale) > UVC_MJPEG_STRIP_HEIGHT)
+    {
+      res = JDR_FMT2;
+    }
+    else
+    {
+      dev.out_width = jd.width >> scale;
+      used = sizeof(uvc_mjpeg_pool) - jd.sz_pool;
+      if(used > uvc_mjpeg_stats.pool_peak)
+        uvc_mjpeg_stats.pool_peak = used;
+      res = jd_decomp(&jd, uvc_mjpeg_output, scale);
+      if((res == JDR_OK) && (uvc_mjpeg_flush(&dev) == 0))
+        res = JDR_INTR;
+    }
+  }
+
+  if(res != JDR_OK)
+  {
+    uvc_mjpeg_stats.error_cnt ++;
+    return res;
+  }
+  uvc_mjpeg_stats.frame_cnt ++;
+  if(dev.dht_len != 0)
+    uvc_mjpeg_stats.dht_insert_cnt ++;
+  uvc_mjpeg_stats.strip_cnt = dev.strip_cnt;
+  uvc_mjpeg_stats.width = jd.width >> scale;
+  uvc_mjpeg_stats.height = jd.height >> scale;
+  uvc_mjpeg_stats.last_time = lv_tick_elaps(start);
+  if(uvc_mjpeg_stats.last_time > uvc_mjpeg_stats.max_time)
+    uvc_mjpeg_stats.max_time = uvc_mjpeg_stats.last_time;
+  return res;
+}
+
+/**
+  * @brief  decode a frame taken with uvc_stream_acquire_filled, truncated
+  *         frames and frames with lost packets are not decoded. the frame
+  *         is not released
+  * @param  frame: filled frame
+  * @param  scale: output scale
+  * @param  output: strip output callback
+  * @param  user: passed to the callback
+  * @retval tjpgd result
+  */
+JRESULT uvc_mjpeg_decode_frame(uvc_frame_type *frame, uvc_mjpeg_scale_type scale,
+                               uvc_mjpeg_output_type output, void *user)
+{
+  if(frame->error & (UVC_FRAME_ERR_TRUNCATED | UVC_FRAME_ERR_LOST))
+  {
+    uvc_mjpeg_stats.error_cnt ++;
+    return JDR_INP;
+  }
+  return uvc_mjpeg_decode(frame->data, frame->len, scale, output, user);
+}
+
+/**
+  * @brief  get the mjpeg decode statistics
+  * @param  stats: copy of the statistics
+  * @retval none
+  */
+void uvc_mjpeg_get_stats(uvc_mjpeg_stats_type *stats)
+{
+  *stats = uvc_mjpeg_stats;
+}
+
+/**
+  * @brief  clear the mjpeg decode statistics
+  * @param  none
+  * @retval none
+  */
+void uvc_mjpeg_reset_stats(void)
+{
+  memset(&uvc_mjpeg_stats, 0, sizeof(uvc_mjpeg_stats));
+}
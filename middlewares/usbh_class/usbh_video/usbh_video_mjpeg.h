@@ -0,0 +1,91 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_mjpeg.h
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video mjpeg decode header file
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBH_VIDEO_MJPEG_H
+#define __USBH_VIDEO_MJPEG_H
+
+#include "lvgl.h"
+#include "tjpgd.h"
+#include "usbh_video_stream_parsing.h"
+
+/* tjpgd work memory, input buffer, huffman and quantizer tables and one mcu */
+#define UVC_MJPEG_POOL_SIZE             4096
+
+/* widest strip handed to the output callback, wider rows are split */
+#define UVC_MJPEG_STRIP_WIDTH           320
+/* tallest mcu, 4:2:0 subsampling */
+#define UVC_MJPEG_STRIP_HEIGHT          16
+
+/* area UVC_MJPEG_SCALE_FIT shrinks the frame into */
+#define UVC_MJPEG_FIT_WIDTH             240
+#define UVC_MJPEG_FIT_HEIGHT            320
+
+/**
+  * @brief mjpeg output scale
+  */
+typedef enum
+{
+  UVC_MJPEG_SCALE_1 = 0,            /*!< full size */
+  UVC_MJPEG_SCALE_2,                /*!< 1/2 */
+  UVC_MJPEG_SCALE_4,                /*!< 1/4 */
+  UVC_MJPEG_SCALE_8,                /*!< 1/8, one pixel per 8x8 block */
+  UVC_MJPEG_SCALE_FIT               /*!< smallest reduction that fits UVC_MJPEG_FIT_x */
+}uvc_mjpeg_scale_type;
+
+/**
+  * @brief strip output callback, pixels are area width x height in
+  *        lv_color_t and stay valid until the next callback returns, so
+  *        they can be sent by dma while the next strip is decoded.
+  *        return 0 to abort
+  */
+typedef int (*uvc_mjpeg_output_type)(const lv_area_t *area, lv_color_t *pixels, void *user);
+
+/**
+  * @brief mjpeg decode statistics
+  */
+typedef struct
+{
+  uint32_t                           frame_cnt;    /*!< decoded frames */
+  uint32_t                           error_cnt;    /*!< frames that failed to decode */
+  uint32_t                           dht_insert_cnt; /*!< frames decoded with the default huffman tables */
+  uint32_t                           strip_cnt;    /*!< strips of the last frame */
+  uint32_t                           last_time;    /*!< decode time of the last frame in ms */
+  uint32_t                           max_time;     /*!< longest decode time in ms */
+  uint32_t                           pool_peak;    /*!< most tjpgd work memory used */
+  uint16_t                           width;        /*!< last output width */
+  uint16_t                           height;       /*!< last output height */
+}uvc_mjpeg_stats_type;
+
+JRESULT uvc_mjpeg_decode(const uint8_t *data, uint32_t len, uvc_mjpeg_scale_type scale,
+                         uvc_mjpeg_output_type output, void *user);
+JRESULT uvc_mjpeg_decode_frame(uvc_frame_type *frame, uvc_mjpeg_scale_type scale,
+                               uvc_mjpeg_output_type output, void *user);
+uvc_mjpeg_scale_type uvc_mjpeg_fit_scale(uint16_t width, uint16_t height,
+                                         uint16_t max_width, uint16_t max_height);
+void uvc_mjpeg_get_stats(uvc_mjpeg_stats_type *stats);
+void uvc_mjpeg_reset_stats(void);
+
+#endif
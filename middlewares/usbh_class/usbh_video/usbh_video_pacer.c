@@ -0,0 +1,232 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_pacer.c
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video frame pacing
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+
+#include "at32f435_437.h"
+#include "usbh_video_pacer.h"
+
+/**
+  * @brief frame pacer state
+  */
+typedef struct
+{
+  usbh_core_type *uhost;
+  uvc_pacer_busy_type busy;
+  uvc_pacer_sync_type sync;
+  uint16_t interval;                /* shortest time between two frames */
+  uint16_t scan_period;
+  uint16_t scan_window;
+  uint32_t last_show;
+  __IO uint32_t te_time;            /* last tearing effect pulse or scan estimate origin */
+  __IO uint32_t te_cnt;
+  uint32_t te_used;                 /* te_cnt the last frame was pushed after */
+  uvc_frame_type *pending;          /* newest frame, waiting for its turn */
+  uvc_frame_type *shown;            /* frame the output is reading */
+  uvc_pacer_stats_type stats;
+}uvc_pacer_type;
+
+static uvc_pacer_type uvc_pacer;
+
+/**
+  * @brief  check if the panel is in a state a frame can be pushed
+  * @param  now: host sof timer
+  * @retval 1: push now
+  */
+static uint8_t uvc_pacer_sync_ready(uint32_t now)
+{
+  switch(uvc_pacer.sync)
+  {
+    case UVC_PACER_SYNC_TE:
+      return (uvc_pacer.te_cnt != uvc_pacer.te_used);
+
+    case UVC_PACER_SYNC_SCAN:
+      return (((now - uvc_pacer.te_time) % uvc_pacer.scan_period) < uvc_pacer.scan_window);
+
+    default:
+      return 1;
+  }
+}
+
+/**
+  * @brief  initialize the frame pacer. frames are taken from the stream ring,
+  *         only the newest one is kept and pushed at most max_fps times a second
+  * @param  uhost: to usb host structure, its sof timer is the time base
+  * @param  max_fps: refresh limit, 0 for no limit
+  * @param  sync: panel synchronization
+  * @param  busy: output busy callback, NULL if the output is done when
+  *         uvc_pacer_done is called
+  * @retval none
+  */
+void uvc_pacer_init(usbh_core_type *uhost, uint16_t max_fps, uvc_pacer_sync_type sync,
+                    uvc_pacer_busy_type busy)
+{
+  memset(&uvc_pacer, 0, sizeof(uvc_pacer));
+  uvc_pacer.uhost = uhost;
+  uvc_pacer.busy = busy;
+  uvc_pacer.sync = sync;
+  uvc_pacer.interval = (max_fps != 0) ? (1000 / max_fps) : 0;
+  uvc_pacer.scan_period = UVC_PACER_SCAN_PERIOD;
+  uvc_pacer.scan_window = UVC_PACER_SCAN_WINDOW;
+  uvc_pacer.te_time = uhost->timer;
+  uvc_pacer.last_show = uhost->timer - uvc_pacer.interval;
+  uvc_pacer_reset_stats();
+}
+
+/**
+  * @brief  set the panel timing estimate of UVC_PACER_SYNC_SCAN
+  * @param  period: panel refresh period in ms
+  * @param  window: time after the vertical blanking a push may start in ms
+  * @retval none
+  */
+void uvc_pacer_set_scan(uint16_t period, uint16_t window)
+{
+  if((period == 0) || (window == 0))
+    return;
+  uvc_pacer.scan_period = period;
+  uvc_pacer.scan_window = (window < period) ? window : period;
+}
+
+/**
+  * @brief  get the frame to push to the panel now. frames older than the
+  *         newest one are released unshown. the frame is owned by the output
+  *         until uvc_pacer_done, a new one is only handed out after that
+  * @param  none
+  * @retval frame, NULL if nothing is due
+  */
+uvc_frame_type *uvc_pacer_next(void)
+{
+  uvc_frame_type *frame;
+  uint32_t now;
+
+  if(uvc_pacer.uhost == NULL)
+    return NULL;
+
+  /* the output is still reading the last frame */
+  if(uvc_pacer.shown != NULL)
+  {
+    if((uvc_pacer.busy == NULL) || uvc_pacer.busy())
+      return NULL;
+    uvc_pacer_done();
+  }
+
+  /* keep the newest frame only */
+  while((frame = uvc_stream_acquire_filled()) != NULL)
+  {
+    if(uvc_pacer.pending != NULL)
+    {
+      uvc_stream_release(uvc_pacer.pending);
+      uvc_pacer.stats.skipped_cnt ++;
+    }
+    uvc_pacer.pending = frame;
+  }
+  if(uvc_pacer.pending == NULL)
+    return NULL;
+
+  now = uvc_pacer.uhost->timer;
+  if(now - uvc_pacer.last_show < uvc_pacer.interval)
+    return NULL;
+  if(uvc_pacer_sync_ready(now) == 0)
+  {
+    uvc_pacer.stats.sync_wait_cnt ++;
+    return NULL;
+  }
+
+  uvc_pacer.last_show = now;
+  uvc_pacer.te_used = uvc_pacer.te_cnt;
+  uvc_pacer.shown = uvc_pacer.pending;
+  uvc_pacer.pending = NULL;
+  return uvc_pacer.shown;
+}
+
+/**
+  * @brief  tell the pacer the output has finished with the frame of
+  *         uvc_pacer_next. waits for the busy callback before the frame
+  *         goes back to the ring, so the receiver never overwrites it early
+  * @param  none
+  * @retval none
+  */
+void uvc_pacer_done(void)
+{
+  uvc_pacer_stats_type *stats = &uvc_pacer.stats;
+  uint32_t latency;
+
+  if(uvc_pacer.shown == NULL)
+    return;
+  if(uvc_pacer.busy != NULL)
+  {
+    while(uvc_pacer.busy())
+    {
+    }
+  }
+
+  latency = uvc_pacer.uhost->timer - uvc_pacer.shown->timestamp;
+  stats->shown_cnt ++;
+  stats->last_latency = latency;
+  stats->latency_sum += latency;
+  if(latency < stats->min_latency)
+    stats->min_latency = latency;
+  if(latency > stats->max_latency)
+    stats->max_latency = latency;
+
+  uvc_stream_release(uvc_pacer.shown);
+  uvc_pacer.shown = NULL;
+}
+
+/**
+  * @brief  tearing effect pulse, call from the interrupt of the pin the
+  *         lcd te output is wired to, see lcd_tearing_effect
+  * @param  none
+  * @retval none
+  */
+void uvc_pacer_te_irq(void)
+{
+  if(uvc_pacer.uhost == NULL)
+    return;
+  uvc_pacer.te_time = uvc_pacer.uhost->timer;
+  uvc_pacer.te_cnt ++;
+}
+
+/**
+  * @brief  copy the frame pacing statistics
+  * @param  stats: statistics output
+  * @retval none
+  */
+void uvc_pacer_get_stats(uvc_pacer_stats_type *stats)
+{
+  if(stats == NULL)
+    return;
+  memcpy(stats, &uvc_pacer.stats, sizeof(uvc_pacer_stats_type));
+}
+
+/**
+  * @brief  clear the frame pacing statistics
+  * @param  none
+  * @retval none
+  */
+void uvc_pacer_reset_stats(void)
+{
+  memset(&uvc_pacer.stats, 0, sizeof(uvc_pacer_stats_type));
+  uvc_pacer.stats.min_latency = 0xFFFFFFFF;
+}
@@ -0,0 +1,76 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_pacer.h
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video frame pacing header file
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBH_VIDEO_PACER_H
+#define __USBH_VIDEO_PACER_H
+
+#include "usbh_video_stream_parsing.h"
+
+/* default scan period and safe window of UVC_PACER_SYNC_SCAN in ms,
+   the ili9341 setup of lcd_init refreshes at about 106 hz */
+#define UVC_PACER_SCAN_PERIOD           9
+#define UVC_PACER_SCAN_WINDOW           2
+
+/**
+  * @brief when a frame may be pushed to the panel
+  */
+typedef enum
+{
+  UVC_PACER_SYNC_NONE = 0,          /*!< as soon as the rate allows */
+  UVC_PACER_SYNC_TE,                /*!< after a tearing effect pulse, see uvc_pacer_te_irq */
+  UVC_PACER_SYNC_SCAN               /*!< in a window after the estimated vertical blanking */
+}uvc_pacer_sync_type;
+
+/**
+  * @brief output busy callback, return nonzero while the output still
+  *        reads the frame handed out by uvc_pacer_next
+  */
+typedef uint8_t (*uvc_pacer_busy_type)(void);
+
+/**
+  * @brief frame pacing statistics, times in ms of the host sof timer
+  */
+typedef struct
+{
+  uint32_t                           shown_cnt;    /*!< frames handed to the output */
+  uint32_t                           skipped_cnt;  /*!< stale frames replaced by a newer one */
+  uint32_t                           sync_wait_cnt;/*!< calls that had a frame but waited for the panel */
+  uint32_t                           last_latency; /*!< end of frame reception to output done */
+  uint32_t                           min_latency;
+  uint32_t                           max_latency;
+  uint32_t                           latency_sum;  /*!< sum over shown_cnt frames */
+}uvc_pacer_stats_type;
+
+void uvc_pacer_init(usbh_core_type *uhost, uint16_t max_fps, uvc_pacer_sync_type sync,
+                    uvc_pacer_busy_type busy);
+void uvc_pacer_set_scan(uint16_t period, uint16_t window);
+uvc_frame_type *uvc_pacer_next(void);
+void uvc_pacer_done(void);
+void uvc_pacer_te_irq(void);
+void uvc_pacer_get_stats(uvc_pacer_stats_type *stats);
+void uvc_pacer_reset_stats(void);
+
+#endif
@@ -34,159 +34,617 @@
 #define UVC_HEADER_BIT_FIELD_POS        1
 #define UVC_HEADER_FID_BIT              (1 << 0)
 #define UVC_HEADER_EOF_BIT              (1 << 1)
-#define UVC_HEADER_SIZE                 12
+#define UVC_HEADER_PTS_BIT              (1 << 2)
+#define UVC_HEADER_SCR_BIT              (1 << 3)
+#define UVC_HEADER_ERR_BIT              (1 << 6)
+#define UVC_HEADER_MIN_SIZE             2
+#define UVC_HEADER_PTS_SIZE             4
+#define UVC_HEADER_SCR_SIZE             6
 
-extern __IO uint8_t tmp_frame_buffer[UVC_RX_FIFO_SIZE];
+#define  LE32(addr)             (((uint32_t)LE16(addr)) | (((uint32_t)LE16(((uint8_t *)(addr)) + 2)) << 16))
+
+/* frame slot ownership, only the owner of a state may leave it except
+   READY which the consumer and a drop-oldest producer compete for */
+#define UVC_SLOT_FREE                   0
+#define UVC_SLOT_WRITING                1
+#define UVC_SLOT_READY                  2
+#define UVC_SLOT_READING                3
+
+extern __IO uint8_t tmp_frame_buffer[UVC_RX_BUFFER_SIZE];
 extern uvc_format_type g_uvc_format;
 
 typedef struct _uvc_data_struct
 {
-  uint32_t packet_cnt;
-  uint32_t data_cnt;
-  uint32_t header_cnt;
+  uvc_stream_stats_type stats;
   uint32_t c_frame_len;
-  uint32_t r_frame_len;
+  uint32_t frame_seq;
+  uint32_t frame_time;
   uint8_t prev_fid;
   uint8_t initialized;
-  uint8_t new_frame;
-  uint8_t switch_ready;
-  uint8_t is_enabled;
   uint8_t is_sof;
   uint8_t is_eof;
-  uint8_t *buffer0;
-  uint8_t *buffer1;
+  
+  /* payload header data of the frame being received */
+  uint8_t frame_err;
+  uint8_t frame_flags;
+  uint16_t frame_packets;
+  uint32_t frame_pts;
+  uint32_t frame_scr_stc;
+  uint16_t frame_scr_sof;
+  uint16_t max_packet;
+  uint32_t frame_size;
+  
+  /* frame ring, the producer always owns use_slot */
+  uint8_t slot_num;
+  uvc_ring_policy_type policy;
+  uvc_frame_type slot[UVC_FRAME_RING_MAX_SLOTS];
+  uvc_frame_type *use_slot;
   uint8_t *use_buffer;
-  uint8_t *filled_buffer;
+  
+  /* zero-copy receive state */
+  uint8_t *rx_buffer;
+  uint8_t header_len;
+  uint8_t stash_len;
+  uint8_t stash[UVC_HEADER_MAX_SIZE];
 }uvc_data_struct;
 
 uvc_data_struct uvc_data;
 
 void video_stream_add_packet_data(uint8_t* buf, uint16_t data_size);
-uint8_t uvc_stream_switch_buffers(void);
+static void uvc_stream_frame_done(uint32_t timestamp);
+static void uvc_stream_frame_reset(void);
+static void uvc_stream_frame_stats(uint32_t timestamp);
 
-void uvc_stream_data_process(uint16_t size)
+/**
+  * @brief  atomically move a frame slot from one state to another
+  * @param  frame: frame slot
+  * @param  from: expected current state
+  * @param  to: new state
+  * @retval 1 if the slot was moved, 0 if it was not in the expected state
+  */
+static uint8_t uvc_slot_claim(uvc_frame_type *frame, uint8_t from, uint8_t to)
 {
-	uint8_t m_fid;
-	uint16_t data_size;
-  
-  /* add packet counter */
-  uvc_data.packet_cnt++;
+  do
+  {
+    if(__LDREXB(&frame->state) != from)
+    {
+      __CLREX();
+      return 0;
+    }
+  }while(__STREXB(to, &frame->state) != 0);
+  __DMB();
+  return 1;
+}
+
+/**
+  * @brief  find the oldest ready frame slot
+  * @param  none
+  * @retval frame slot, NULL if no frame is ready
+  */
+static uvc_frame_type *uvc_slot_oldest_ready(void)
+{
+  uint8_t idx;
+  uvc_frame_type *oldest = NULL;
   
-  if ((size < 2) && (size > UVC_RX_FIFO_SIZE))
-    return;
+  for(idx = 0; idx < uvc_data.slot_num; idx ++)
+  {
+    if((uvc_data.slot[idx].state == UVC_SLOT_READY) &&
+       ((oldest == NULL) || ((int32_t)(uvc_data.slot[idx].seq - oldest->seq) < 0)))
+    {
+      oldest = &uvc_data.slot[idx];
+    }
+  }
+  return oldest;
+}
+
+/**
+  * @brief  get the buffer the next isochronous packet is received into.
+  *         with zero-copy enabled the packet lands in the frame buffer
+  *         with its payload header in front of the write position, the
+  *         frame bytes the header overwrites are saved and restored by
+  *         uvc_stream_data_process. tmp_frame_buffer is used when no frame
+  *         is being captured or the packet may not fit.
+  * @param  max_size: maximum packet size of the streaming endpoint
+  * @retval receive buffer
+  */
+uint8_t *uvc_stream_rx_buffer(uint16_t max_size)
+{
+#ifdef UVC_ZERO_COPY_ENABLE
+  uint8_t *wp;
+  uvc_data.max_packet = max_size;
+  if((uvc_data.initialized == 1) &&
+     (uvc_data.c_frame_len + max_size <= UVC_MAX_FRAME_SIZE))
+  {
+    wp = &uvc_data.use_buffer[uvc_data.c_frame_len];
+    uvc_data.stash_len = uvc_data.header_len;
+    memcpy(uvc_data.stash, wp - uvc_data.stash_len, uvc_data.stash_len);
+    uvc_data.rx_buffer = wp - uvc_data.stash_len;
+    return uvc_data.rx_buffer;
+  }
+#else
+  uvc_data.max_packet = max_size;
+#endif
+  uvc_data.stash_len = 0;
+  uvc_data.rx_buffer = (uint8_t *)tmp_frame_buffer;
+  return uvc_data.rx_buffer;
+}
+
+/**
+  * @brief  drop a receive armed with uvc_stream_rx_buffer that failed, the
+  *         frame the lost packet belonged to is marked or dropped
+  * @param  none
+  * @retval none
+  */
+void uvc_stream_rx_cancel(void)
+{
+  uvc_data.stats.rx_error_cnt++;
+  if (uvc_data.stash_len != 0)
+  {
+    memcpy(uvc_data.rx_buffer, uvc_data.stash, uvc_data.stash_len);
+    uvc_data.stash_len = 0;
+  }
   
-  if ((uvc_data.is_enabled == 0) || (uvc_data.initialized == 0))
+  if (uvc_data.is_eof == 1)
   {
-    uvc_stream_switch_buffers();
+    /* the lost packet may have started the next frame, without the eof
+       that frame is not started and is dropped when it ends */
     uvc_data.is_eof = 0;
-    return;
   }
+  else if (uvc_data.is_sof == 1)
+  {
+    uvc_data.frame_err |= UVC_FRAME_ERR_LOST;
+  }
+}
+
+/**
+  * @brief  set the maximum packet size of the streaming endpoint, when
+  *         packets are not received through uvc_stream_rx_buffer
+  * @param  max_packet: maximum packet size of the streaming endpoint
+  * @retval none
+  */
+void uvc_stream_set_max_packet(uint16_t max_packet)
+{
+  uvc_data.max_packet = max_packet;
+}
+
+/**
+  * @brief  set the size of an uncompressed frame, the committed
+  *         dwMaxVideoFrameSize. a yuy2 frame is complete when it reaches
+  *         this size or at the end of frame bit, whichever comes first.
+  * @param  frame_size: frame size in bytes, 0 or above UVC_MAX_FRAME_SIZE
+  *         for UVC_MAX_FRAME_SIZE
+  * @retval none
+  */
+void uvc_stream_set_frame_size(uint32_t frame_size)
+{
+  if ((frame_size == 0) || (frame_size > UVC_MAX_FRAME_SIZE))
+    frame_size = UVC_MAX_FRAME_SIZE;
+  uvc_data.frame_size = frame_size;
+}
+
+/**
+  * @brief  process one received isochronous packet
+  * @param  buf: packet buffer returned by uvc_stream_rx_buffer
+  * @param  size: received packet length
+  * @param  timestamp: host sof timer when the packet was received
+  * @retval none
+  */
+void uvc_stream_data_process(uint8_t *buf, uint16_t size, uint32_t timestamp)
+{
+  uint8_t m_fid, bfh = 0, hlen, pos;
+  uint8_t flags = 0, err = 0;
+  uint32_t pts = 0, scr_stc = 0;
+  uint16_t scr_sof = 0;
+  uint8_t *payload;
+  uint8_t *wp;
+  uint16_t data_size = 0;
+  
+  /* add packet counter */
+  uvc_data.stats.packet_cnt++;
   
-  if (size <= UVC_HEADER_SIZE)
+  hlen = buf[UVC_HEADER_SIZE_POS];
+  if (size == 0)
   {
-    uvc_data.header_cnt++;
+    uvc_data.stats.zero_len_cnt++;
+    hlen = 0;
   }
-  else if (size > UVC_HEADER_SIZE)
+  else if ((size < UVC_HEADER_MIN_SIZE) || (size > UVC_RX_FIFO_SIZE) ||
+      (hlen < UVC_HEADER_MIN_SIZE) || (hlen > UVC_HEADER_MAX_SIZE) || (hlen > size))
   {
-    uvc_data.data_cnt ++;
-    
-    m_fid = (tmp_frame_buffer[UVC_HEADER_BIT_FIELD_POS] & UVC_HEADER_FID_BIT);
+    uvc_data.stats.invalid_cnt++;
+    hlen = 0;
+  }
+  else
+  {
+    /* parse the header before zero-copy restores the frame bytes it was
+       received over */
+    bfh = buf[UVC_HEADER_BIT_FIELD_POS];
+    data_size = size - hlen;
+    pos = UVC_HEADER_MIN_SIZE;
+    if (bfh & UVC_HEADER_PTS_BIT)
+    {
+      if (pos + UVC_HEADER_PTS_SIZE <= hlen)
+      {
+        pts = LE32(&buf[pos]);
+        flags |= UVC_FRAME_PTS_VALID;
+      }
+      pos += UVC_HEADER_PTS_SIZE;
+    }
+    if ((bfh & UVC_HEADER_SCR_BIT) && (pos + UVC_HEADER_SCR_SIZE <= hlen))
+    {
+      scr_stc = LE32(&buf[pos]);
+      scr_sof = LE16(&buf[pos + 4]) & 0x7FF;
+      flags |= UVC_FRAME_SCR_VALID;
+    }
+    if (bfh & UVC_HEADER_ERR_BIT)
+    {
+      err = UVC_FRAME_ERR_PAYLOAD;
+    }
+  }
+  payload = buf + hlen;
+  
+  if (uvc_data.stash_len != 0)
+  {
+    /* zero-copy packet: move the payload to the write position when the
+       header length changed, then put back the frame bytes the header
+       was received over */
+    wp = buf + uvc_data.stash_len;
+    if ((payload != wp) && (data_size != 0))
+    {
+      memmove(wp, payload, data_size);
+    }
+    memcpy(buf, uvc_data.stash, uvc_data.stash_len);
+    uvc_data.stash_len = 0;
+    payload = wp;
+    if (hlen != 0)
+      uvc_data.header_len = hlen;
+  }
+  
+  if ((hlen == 0) || (uvc_data.initialized == 0))
+    return;
+  
+  if (data_size != 0)
+  {
+    m_fid = (bfh & UVC_HEADER_FID_BIT);
     if ((m_fid != uvc_data.prev_fid) && (uvc_data.is_eof == 1))
     {
-      uvc_data.c_frame_len= 0;
+      uvc_stream_frame_reset();
       uvc_data.is_sof = 1;
     }
     uvc_data.prev_fid = m_fid;
+  }
+  
+  /* the pts is the same in every packet of a frame, the scr is sampled
+     per packet so keep the latest */
+  uvc_data.frame_packets ++;
+  uvc_data.frame_err |= err;
+  if ((flags & UVC_FRAME_PTS_VALID) && !(uvc_data.frame_flags & UVC_FRAME_PTS_VALID))
+  {
+    uvc_data.frame_pts = pts;
+  }
+  if (flags & UVC_FRAME_SCR_VALID)
+  {
+    uvc_data.frame_scr_stc = scr_stc;
+    uvc_data.frame_scr_sof = scr_sof;
+  }
+  uvc_data.frame_flags |= flags;
+  
+  if (data_size == 0)
+  {
+    uvc_data.stats.header_cnt++;
+  }
+  else
+  {
+    uvc_data.stats.data_cnt ++;
+    if (size < uvc_data.max_packet)
+      uvc_data.stats.short_cnt ++;
     
-    data_size = size - UVC_HEADER_SIZE;
-    video_stream_add_packet_data((uint8_t*)&tmp_frame_buffer[UVC_HEADER_SIZE], data_size);
+    video_stream_add_packet_data(payload, data_size);
+  }
+  
+  /* some cameras end the frame with a header only packet */
+  if (bfh & UVC_HEADER_EOF_BIT)
+  {
+    uvc_data.is_eof = 1;
     
-    if (tmp_frame_buffer[UVC_HEADER_BIT_FIELD_POS] & UVC_HEADER_EOF_BIT)
-    {
-      uvc_data.is_eof = 1;
-      
-      if (uvc_data.is_sof == 0)
-      {
-        uvc_data.c_frame_len = 0;
-        return; 
-      }
-      
-      if (g_uvc_format == UVC_FORMAT_MJPEG)
-      {
-        uvc_data.is_enabled = 0;
-        uvc_stream_switch_buffers();
-      }      
-    }
-    else
+    if (uvc_data.is_sof == 0)
     {
-      uvc_data.is_eof = 0;
+      uvc_stream_frame_reset();
+      return; 
     }
     
-    if ((g_uvc_format == UVC_FORMAT_YUY2) && 
-        (uvc_data.c_frame_len >= UVC_UNCOMP_FRAME_SIZE))
+    if ((g_uvc_format == UVC_FORMAT_YUY2) &&
+        (uvc_data.c_frame_len < uvc_data.frame_size))
     {
-      if (uvc_data.is_sof == 0)
-        return;
-      
-      uvc_stream_switch_buffers();
+      /* an uncompressed frame that ends short misses packets */
+      uvc_data.frame_err |= UVC_FRAME_ERR_LOST;
     }
+    uvc_stream_frame_done(timestamp);
+  }
+  else if (data_size == 0)
+  {
+    return;
+  }
+  else if ((g_uvc_format == UVC_FORMAT_YUY2) &&
+           (uvc_data.c_frame_len >= uvc_data.frame_size))
+  {
+    /* cameras that do not set the eof bit, the next fid toggle starts
+       a frame as after an eof */
+    uvc_data.is_eof = 1;
+    if (uvc_data.is_sof == 1)
+      uvc_stream_frame_done(timestamp);
+  }
+  else
+  {
+    uvc_data.is_eof = 0;
   }
 }
 
-uint8_t uvc_stream_switch_buffers(void)
+/**
+  * @brief  clear the data collected for the frame being received
+  * @param  none
+  * @retval none
+  */
+static void uvc_stream_frame_reset(void)
 {
-  if (uvc_data.switch_ready == 1)
+  uvc_data.c_frame_len = 0;
+  uvc_data.frame_err = 0;
+  uvc_data.frame_flags = 0;
+  uvc_data.frame_packets = 0;
+}
+
+/**
+  * @brief  account a completed frame in the stream statistics
+  * @param  timestamp: host sof timer at the end of the frame
+  * @retval none
+  */
+static void uvc_stream_frame_stats(uint32_t timestamp)
+{
+  uint32_t bin;
+  uvc_stream_stats_type *stats = &uvc_data.stats;
+  
+  if (stats->frame_cnt != 0)
   {
-    uvc_data.filled_buffer = uvc_data.use_buffer;
-    if (uvc_data.use_buffer == uvc_data.buffer0)
-      uvc_data.use_buffer = uvc_data.buffer1;
-    else
-      uvc_data.use_buffer = uvc_data.buffer0;
-    
-     uvc_data.new_frame = 1;
-     uvc_data.switch_ready = 0;
-     uvc_data.is_enabled  = 1;
-     uvc_data.is_sof = 0;
-     uvc_data.r_frame_len = uvc_data.c_frame_len;
-     uvc_data.c_frame_len = 0;
-     return 1;
+    stats->last_interval = timestamp - uvc_data.frame_time;
+    bin = stats->last_interval / UVC_STATS_INTERVAL_STEP;
+    if (bin >= UVC_STATS_INTERVAL_BINS)
+      bin = UVC_STATS_INTERVAL_BINS - 1;
+    stats->interval_hist[bin] ++;
   }
-  else
+  uvc_data.frame_time = timestamp;
+  stats->frame_cnt ++;
+  if (uvc_data.frame_err != 0)
+    stats->error_frame_cnt ++;
+  stats->last_packets = uvc_data.frame_packets;
+  if (uvc_data.frame_packets > stats->max_packets)
+    stats->max_packets = uvc_data.frame_packets;
+}
+
+/**
+  * @brief  publish the frame being written and take a slot for the next one,
+  *         called from the producer context only
+  * @param  timestamp: host sof timer at the end of the frame
+  * @retval none
+  */
+static void uvc_stream_frame_done(uint32_t timestamp)
+{
+  uint8_t idx;
+  uvc_frame_type *frame = uvc_data.use_slot;
+  uvc_frame_type *next = NULL;
+  
+  for(idx = 0; idx < uvc_data.slot_num; idx ++)
   {
-    uvc_data.is_enabled  = 0;
+    if(uvc_slot_claim(&uvc_data.slot[idx], UVC_SLOT_FREE, UVC_SLOT_WRITING))
+    {
+      next = &uvc_data.slot[idx];
+      break;
+    }
+  }
+  
+  if((next == NULL) && (uvc_data.policy == UVC_RING_DROP_OLDEST))
+  {
+    /* the consumer may claim the oldest frame while we look for it */
+    while((next = uvc_slot_oldest_ready()) != NULL)
+    {
+      if(uvc_slot_claim(next, UVC_SLOT_READY, UVC_SLOT_WRITING))
+      {
+        uvc_data.stats.dropped_cnt ++;
+        break;
+      }
+    }
+  }
+  
+  uvc_data.is_sof = 0;
+  uvc_stream_frame_stats(timestamp);
+  
+  if(next == NULL)
+  {
+    /* queue full, drop the frame just completed and reuse its slot */
+    uvc_data.stats.dropped_cnt ++;
+    uvc_stream_frame_reset();
+    return;
   }
-  return 0;
+  
+  frame->len = uvc_data.c_frame_len;
+  frame->fid = uvc_data.prev_fid;
+  frame->timestamp = timestamp;
+  frame->pts = uvc_data.frame_pts;
+  frame->scr_stc = uvc_data.frame_scr_stc;
+  frame->scr_sof = uvc_data.frame_scr_sof;
+  frame->packets = uvc_data.frame_packets;
+  frame->flags = uvc_data.frame_flags;
+  frame->error = uvc_data.frame_err;
+  frame->seq = ++ uvc_data.frame_seq;
+  __DMB();
+  frame->state = UVC_SLOT_READY;
+  
+  uvc_data.use_slot = next;
+  uvc_data.use_buffer = next->data;
+  uvc_stream_frame_reset();
 }
 
 void video_stream_add_packet_data(uint8_t* buf, uint16_t size)
 {
-  if ((uvc_data.c_frame_len + size) > UVC_UNCOMP_FRAME_SIZE)
+  uint8_t *wp;
+  if ((uvc_data.c_frame_len + size) > UVC_MAX_FRAME_SIZE)
   {
-    uvc_data.c_frame_len = UVC_UNCOMP_FRAME_SIZE;
+    uvc_data.c_frame_len = UVC_MAX_FRAME_SIZE;
+    uvc_data.frame_err |= UVC_FRAME_ERR_TRUNCATED;
     return;
   }
-  memcpy((void*)&uvc_data.use_buffer[uvc_data.c_frame_len], buf, size);
+  wp = &uvc_data.use_buffer[uvc_data.c_frame_len];
+  /* zero-copy packets are already in place unless the frame restarted */
+  if (buf != wp)
+  {
+    memmove((void*)wp, buf, size);
+  }
   uvc_data.c_frame_len+= size;
 }
 
+/**
+  * @brief  take the oldest completed frame from the ring. the frame stays
+  *         owned by the caller until uvc_stream_release is called.
+  * @param  none
+  * @retval frame, NULL if no frame is ready
+  */
+uvc_frame_type *uvc_stream_acquire_filled(void)
+{
+  uvc_frame_type *frame;
+  
+  if(uvc_data.initialized == 0)
+    return NULL;
+  
+  /* retry if a drop-oldest producer reclaimed the slot in between */
+  while((frame = uvc_slot_oldest_ready()) != NULL)
+  {
+    if(uvc_slot_claim(frame, UVC_SLOT_READY, UVC_SLOT_READING))
+      return frame;
+  }
+  return NULL;
+}
+
+/**
+  * @brief  give a frame from uvc_stream_acquire_filled back to the producer
+  * @param  frame: acquired frame
+  * @retval none
+  */
+void uvc_stream_release(uvc_frame_type *frame)
+{
+  if((frame == NULL) || (frame->state != UVC_SLOT_READING))
+    return;
+  __DMB();
+  frame->state = UVC_SLOT_FREE;
+}
+
+/**
+  * @brief  get the number of completed frames dropped because the ring was full
+  * @param  none
+  * @retval dropped frame count
+  */
+uint32_t uvc_stream_dropped_frames(void)
+{
+  return uvc_data.stats.dropped_cnt;
+}
+
+/**
+  * @brief  copy the stream statistics
+  * @param  stats: statistics output
+  * @retval none
+  */
+void uvc_stream_get_stats(uvc_stream_stats_type *stats)
+{
+  if(stats == NULL)
+    return;
+  memcpy(stats, &uvc_data.stats, sizeof(uvc_stream_stats_type));
+}
+
+/**
+  * @brief  clear the stream statistics
+  * @param  none
+  * @retval none
+  */
+void uvc_stream_reset_stats(void)
+{
+  memset(&uvc_data.stats, 0, sizeof(uvc_stream_stats_type));
+}
+
+/**
+  * @brief  release every frame held by the consumer, kept for the two buffer
+  *         interface
+  * @param  none
+  * @retval none
+  */
 void uvc_stream_buffer_update(void)
 {
-  uvc_data.switch_ready  = 1;
+  uint8_t idx;
+  for(idx = 0; idx < uvc_data.slot_num; idx ++)
+  {
+    uvc_stream_release(&uvc_data.slot[idx]);
+  }
+}
+
+/**
+  * @brief  initialize the stream with a ring of frame buffers
+  * @param  buffers: frame buffers of UVC_FRAME_BUFFER_SIZE bytes each
+  * @param  num: number of buffers, 2 to UVC_FRAME_RING_MAX_SLOTS
+  * @param  policy: what to drop when a frame completes and no slot is free
+  * @retval none
+  */
+void uvc_stream_ring_init(uint8_t **buffers, uint8_t num, uvc_ring_policy_type policy)
+{
+  uint8_t idx;
+  
+  if ((buffers == NULL) || (num < 2) || (num > UVC_FRAME_RING_MAX_SLOTS))
+    return;
+  for(idx = 0; idx < num; idx ++)
+  {
+    if(buffers[idx] == NULL)
+      return;
+  }
+  
+  uvc_data.initialized = 0;
+  memset(uvc_data.slot, 0, sizeof(uvc_data.slot));
+  /* frame data starts after the headroom used by zero-copy receive */
+  for(idx = 0; idx < num; idx ++)
+  {
+    uvc_data.slot[idx].data = buffers[idx] + UVC_FRAME_HEADROOM;
+    uvc_data.slot[idx].state = UVC_SLOT_FREE;
+  }
+  uvc_data.slot_num = num;
+  uvc_data.policy = policy;
+  uvc_data.use_slot = &uvc_data.slot[0];
+  uvc_data.use_slot->state = UVC_SLOT_WRITING;
+  uvc_data.use_buffer = uvc_data.use_slot->data;
+  uvc_data.frame_seq = 0;
+  uvc_stream_frame_reset();
+  uvc_stream_reset_stats();
+  uvc_data.header_len = UVC_HEADER_MAX_SIZE;
+  /* keep a frame size committed before the ring was set up */
+  if (uvc_data.frame_size == 0)
+    uvc_data.frame_size = UVC_MAX_FRAME_SIZE;
+  uvc_data.stash_len = 0;
+  uvc_data.is_sof = 0;
+  uvc_data.is_eof = 1;
+  uvc_data.initialized = 1;
 }
 
+/**
+  * @brief  initialize the stream with two frame buffers, a two slot ring
+  *         that keeps the queued frame when the consumer is late
+  * @param  buffer0: frame buffer of UVC_FRAME_BUFFER_SIZE bytes
+  * @param  buffer1: frame buffer of UVC_FRAME_BUFFER_SIZE bytes
+  * @retval none
+  */
 void uvc_stream_init(uint8_t* buffer0, uint8_t* buffer1)
 {
+  uint8_t *buffers[2];
+  
   if ((buffer0 == NULL) || (buffer1 == NULL))
     return;
   
-  uvc_data.buffer0 = buffer0;
-  uvc_data.buffer1 = buffer1;
-  uvc_data.use_buffer = uvc_data.buffer0;
-  uvc_data.filled_buffer = uvc_data.buffer1;
-  uvc_data.initialized = 1;
-  uvc_data.is_enabled  = 1;
-  uvc_data.switch_ready  = 1;
-  uvc_data.is_eof = 1;
+  buffers[0] = buffer0;
+  buffers[1] = buffer1;
+  uvc_stream_ring_init(buffers, 2, UVC_RING_DROP_NEWEST);
 }
 
 
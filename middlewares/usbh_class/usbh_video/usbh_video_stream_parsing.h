@@ -29,8 +29,84 @@
 
 #include "usbh_video_class.h"
 
-void uvc_stream_data_process(uint16_t size);
+/* maximum number of frame buffers in the stream ring */
+#define UVC_FRAME_RING_MAX_SLOTS        4
+
+/**
+  * @brief frame ring full policy
+  */
+typedef enum
+{
+  UVC_RING_DROP_NEWEST,             /*!< discard the frame just completed */
+  UVC_RING_DROP_OLDEST              /*!< discard the oldest queued frame */
+}uvc_ring_policy_type;
+
+/* uvc_frame_type error bits */
+#define UVC_FRAME_ERR_TRUNCATED         0x01     /*!< frame larger than the buffer */
+#define UVC_FRAME_ERR_PAYLOAD           0x02     /*!< payload header err bit was set */
+#define UVC_FRAME_ERR_LOST              0x04     /*!< a packet of the frame was lost */
+
+/* uvc_frame_type flags bits */
+#define UVC_FRAME_PTS_VALID             0x01
+#define UVC_FRAME_SCR_VALID             0x02
+
+/* inter-frame interval histogram, the last bin counts everything above */
+#define UVC_STATS_INTERVAL_BINS         8
+#define UVC_STATS_INTERVAL_STEP         10       /*!< bin width in ms */
+
+/**
+  * @brief frame ring slot, read only for the consumer between
+  *        uvc_stream_acquire_filled and uvc_stream_release
+  */
+typedef struct
+{
+  uint8_t                            *data;        /*!< frame data */
+  uint32_t                           len;          /*!< frame length in bytes */
+  uint32_t                           seq;          /*!< frame sequence number */
+  uint32_t                           timestamp;    /*!< host sof timer at end of frame */
+  uint32_t                           pts;          /*!< presentation time stamp, device clock */
+  uint32_t                           scr_stc;      /*!< source clock, device clock */
+  uint16_t                           scr_sof;      /*!< usb sof counter sampled with scr_stc */
+  uint16_t                           packets;      /*!< packets that carried the frame */
+  uint8_t                            fid;          /*!< payload header frame id */
+  uint8_t                            flags;        /*!< UVC_FRAME_PTS_VALID, UVC_FRAME_SCR_VALID */
+  uint8_t                            error;        /*!< UVC_FRAME_ERR_x bits */
+  __IO uint8_t                       state;        /*!< slot owner, internal use */
+}uvc_frame_type;
+
+/**
+  * @brief stream statistics
+  */
+typedef struct
+{
+  uint32_t                           packet_cnt;   /*!< all received packets */
+  uint32_t                           data_cnt;     /*!< packets carrying frame data */
+  uint32_t                           header_cnt;   /*!< header only packets */
+  uint32_t                           zero_len_cnt; /*!< zero length packets */
+  uint32_t                           short_cnt;    /*!< data packets below max packet size */
+  uint32_t                           invalid_cnt;  /*!< packets with a malformed header */
+  uint32_t                           rx_error_cnt; /*!< receives lost to overrun or babble */
+  uint32_t                           frame_cnt;    /*!< completed frames */
+  uint32_t                           error_frame_cnt; /*!< completed frames with an error */
+  uint32_t                           dropped_cnt;  /*!< frames dropped by a full ring */
+  uint32_t                           last_packets; /*!< packets of the last frame */
+  uint32_t                           max_packets;  /*!< most packets of one frame */
+  uint32_t                           last_interval;/*!< last inter-frame interval in ms */
+  uint32_t                           interval_hist[UVC_STATS_INTERVAL_BINS];
+}uvc_stream_stats_type;
+
+void uvc_stream_data_process(uint8_t *buf, uint16_t size, uint32_t timestamp);
+uint8_t *uvc_stream_rx_buffer(uint16_t max_size);
+void uvc_stream_rx_cancel(void);
+void uvc_stream_set_max_packet(uint16_t max_packet);
+void uvc_stream_set_frame_size(uint32_t frame_size);
 void uvc_stream_init(uint8_t* buffer0, uint8_t* buffer1);
+void uvc_stream_ring_init(uint8_t **buffers, uint8_t num, uvc_ring_policy_type policy);
+uvc_frame_type *uvc_stream_acquire_filled(void);
+void uvc_stream_release(uvc_frame_type *frame);
+uint32_t uvc_stream_dropped_frames(void);
+void uvc_stream_get_stats(uvc_stream_stats_type *stats);
+void uvc_stream_reset_stats(void);
 void uvc_stream_buffer_update(void);
 
 
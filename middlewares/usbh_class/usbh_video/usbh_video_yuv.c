@@ -0,0 +1,330 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_yuv.c
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video yuy2 conversion
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+
+#include "at32f435_437.h"
+#include "usbh_video_yuv.h"
+
+/* two pixels per instruction with the cortex-m4 simd instructions, the
+   host tests define it to run the simd path on their intrinsics */
+#if !defined(UVC_YUV_SIMD) && defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define UVC_YUV_SIMD
+#endif
+
+/* bt.601 limited range coefficients, 8 bit fraction */
+#define YUV_COEF_Y                      298
+#define YUV_COEF_RV                     409
+#define YUV_COEF_GU                     100
+#define YUV_COEF_GV                     208
+#define YUV_COEF_BU                     516
+
+#define YUV_FIX_ONE                     0x10000
+#define YUV_FIX_HALF                    0x8000
+
+/* scaled luma, (298 * (y - 16) + 128) >> 8, saturated after the chroma is added */
+static int16_t uvc_yuv_luma[256];
+static uint8_t uvc_yuv_luma_ready = 0;
+
+/**
+  * @brief  fill the scaled luma table
+  * @param  none
+  * @retval none
+  */
+static void uvc_yuv_luma_init(void)
+{
+  uint16_t idx;
+
+  for(idx = 0; idx < 256; idx ++)
+  {
+    uvc_yuv_luma[idx] = (int16_t)((YUV_COEF_Y * ((int32_t)idx - 16) + 128) >> 8);
+  }
+  uvc_yuv_luma_ready = 1;
+}
+
+#ifndef UVC_YUV_SIMD
+/**
+  * @brief  convert one pixel to rgb565
+  * @param  y: scaled luma
+  * @param  r: red chroma offset
+  * @param  g: green chroma offset
+  * @param  b: blue chroma offset
+  * @retval rgb565
+  */
+static uint16_t uvc_yuv_rgb565(int32_t y, int32_t r, int32_t g, int32_t b)
+{
+  r += y;
+  g += y;
+  b += y;
+  r = (r < 0) ? 0 : ((r > 255) ? 255 : r);
+  g = (g < 0) ? 0 : ((g > 255) ? 255 : g);
+  b = (b < 0) ? 0 : ((b > 255) ? 255 : b);
+  return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+}
+#endif
+
+/**
+  * @brief  convert two pixels sharing one chroma sample
+  * @param  y0: first luma
+  * @param  y1: second luma
+  * @param  u: cb
+  * @param  v: cr
+  * @retval first pixel in the low half, second in the high half, both in
+  *         lv_color_t byte order
+  */
+static uint32_t uvc_yuv_pack2(uint8_t y0, uint8_t y1, uint8_t u, uint8_t v)
+{
+  int32_t cu = (int32_t)u - 128, cv = (int32_t)v - 128;
+  int32_t r = (YUV_COEF_RV * cv + 128) >> 8;
+  int32_t g = (-YUV_COEF_GU * cu - YUV_COEF_GV * cv + 128) >> 8;
+  int32_t b = (YUV_COEF_BU * cu + 128) >> 8;
+  uint32_t pix;
+#ifdef UVC_YUV_SIMD
+  uint32_t y = (uint16_t)uvc_yuv_luma[y0] | ((uint32_t)(uint16_t)uvc_yuv_luma[y1] << 16);
+  uint32_t pr = __USAT16(__QADD16(y, __PKHBT(r, r, 16)), 8);
+  uint32_t pg = __USAT16(__QADD16(y, __PKHBT(g, g, 16)), 8);
+  uint32_t pb = __USAT16(__QADD16(y, __PKHBT(b, b, 16)), 8);
+
+  pix = ((pr & 0x00F800F8) << 8) | ((pg & 0x00FC00FC) << 3) | ((pb >> 3) & 0x001F001F);
+#if LV_COLOR_16_SWAP
+  pix = __REV16(pix);
+#endif
+#else
+  pix = uvc_yuv_rgb565(uvc_yuv_luma[y0], r, g, b) |
+        ((uint32_t)uvc_yuv_rgb565(uvc_yuv_luma[y1], r, g, b) << 16);
+#if LV_COLOR_16_SWAP
+  pix = ((pix & 0x00FF00FF) << 8) | ((pix >> 8) & 0x00FF00FF);
+#endif
+#endif
+  return pix;
+}
+
+/**
+  * @brief  sample the luma at a source position, 16.16 fixed point
+  * @param  conv: conversion
+  * @param  sx: source x
+  * @param  sy: source y
+  * @param  chroma: set to the yuyv macropixel of the position when not NULL
+  * @retval luma
+  */
+static uint8_t uvc_yuv_sample(uvc_yuv_conv_type *conv, int32_t sx, int32_t sy,
+                              const uint8_t **chroma)
+{
+  uint32_t stride = (uint32_t)conv->src_width * 2;
+  const uint8_t *r0, *r1;
+  int32_t x0, x1, y0, y1, fx, fy, top, bot;
+
+  if(chroma != NULL)
+  {
+    *chroma = conv->src + (sy >> 16) * stride + ((sx >> 16) & ~1) * 2;
+  }
+  if(conv->filter == UVC_YUV_NEAREST)
+  {
+    return conv->src[(sy >> 16) * stride + (sx >> 16) * 2];
+  }
+
+  /* sample centers sit half a pixel into the source grid */
+  sx = (sx > YUV_FIX_HALF) ? sx - YUV_FIX_HALF : 0;
+  sy = (sy > YUV_FIX_HALF) ? sy - YUV_FIX_HALF : 0;
+  x0 = sx >> 16;
+  y0 = sy >> 16;
+  fx = (sx >> 8) & 0xFF;
+  fy = (sy >> 8) & 0xFF;
+  x1 = (x0 + 1 < conv->src_width) ? x0 + 1 : x0;
+  y1 = (y0 + 1 < conv->src_height) ? y0 + 1 : y0;
+  r0 = conv->src + y0 * stride;
+  r1 = conv->src + y1 * stride;
+
+  top = (r0[x0 * 2] << 8) + (r0[x1 * 2] - r0[x0 * 2]) * fx;
+  bot = (r1[x0 * 2] << 8) + (r1[x1 * 2] - r1[x0 * 2]) * fx;
+  return (uint8_t)(((top << 8) + (bot - top) * fy + YUV_FIX_HALF) >> 16);
+}
+
+/**
+  * @brief  convert one output row
+  * @param  conv: conversion
+  * @param  oy: output row
+  * @param  dst: dst_width pixels
+  * @retval none
+  */
+static void uvc_yuv_convert_row(uvc_yuv_conv_type *conv, uint16_t oy, lv_color_t *dst)
+{
+  uint16_t width = conv->dst_width, ox = 0;
+  uint16_t uw, uh;
+  int32_t sx, sy, dsx = 0, dsy = 0;
+  const uint8_t *chroma, *p;
+  uint8_t y0, y1;
+  uint32_t pix;
+
+  /* output width and height before rotation */
+  if((conv->rotate == UVC_YUV_ROTATE_90) || (conv->rotate == UVC_YUV_ROTATE_270))
+  {
+    uw = conv->dst_height;
+    uh = conv->dst_width;
+  }
+  else
+  {
+    uw = conv->dst_width;
+    uh = conv->dst_height;
+  }
+
+  /* source position of the first pixel and the step along the row */
+  switch(conv->rotate)
+  {
+    case UVC_YUV_ROTATE_90:
+      sx = oy;
+      sy = uh - 1;
+      dsy = -conv->step_y;
+      break;
+    case UVC_YUV_ROTATE_180:
+      sx = uw - 1;
+      sy = uh - 1 - oy;
+      dsx = -conv->step_x;
+      break;
+    case UVC_YUV_ROTATE_270:
+      sx = uw - 1 - oy;
+      sy = 0;
+      dsy = conv->step_y;
+      break;
+    default:
+      sx = 0;
+      sy = oy;
+      dsx = conv->step_x;
+      break;
+  }
+  sx = sx * conv->step_x + (conv->step_x >> 1);
+  sy = sy * conv->step_y + (conv->step_y >> 1);
+
+  /* unscaled rows walk the yuyv macropixels directly, 4 pixels a loop */
+  if((conv->rotate == UVC_YUV_ROTATE_0) && (conv->filter == UVC_YUV_NEAREST) &&
+     (conv->step_x == YUV_FIX_ONE))
+  {
+    p = conv->src + (sy >> 16) * (uint32_t)conv->src_width * 2;
+    for(; ox + 4 <= width; ox += 4, p += 8)
+    {
+      pix = uvc_yuv_pack2(p[0], p[2], p[1], p[3]);
+      dst[ox].full = (uint16_t)pix;
+      dst[ox + 1].full = (uint16_t)(pix >> 16);
+      pix = uvc_yuv_pack2(p[4], p[6], p[5], p[7]);
+      dst[ox + 2].full = (uint16_t)pix;
+      dst[ox + 3].full = (uint16_t)(pix >> 16);
+    }
+    sx += ox * conv->step_x;
+  }
+
+  for(; ox + 2 <= width; ox += 2)
+  {
+    y0 = uvc_yuv_sample(conv, sx, sy, &chroma);
+    y1 = uvc_yuv_sample(conv, sx + dsx, sy + dsy, NULL);
+    sx += dsx * 2;
+    sy += dsy * 2;
+    pix = uvc_yuv_pack2(y0, y1, chroma[1], chroma[3]);
+    dst[ox].full = (uint16_t)pix;
+    dst[ox + 1].full = (uint16_t)(pix >> 16);
+  }
+  if(ox < width)
+  {
+    y0 = uvc_yuv_sample(conv, sx, sy, &chroma);
+    pix = uvc_yuv_pack2(y0, y0, chroma[1], chroma[3]);
+    dst[ox].full = (uint16_t)pix;
+  }
+}
+
+/**
+  * @brief  prepare a yuy2 conversion, scaling and rotation are applied in
+  *         the same pass. pixel pairs along an output row share the chroma
+  *         of the first pixel
+  * @param  conv: conversion
+  * @param  src: yuy2 frame
+  * @param  src_width: frame width, even
+  * @param  src_height: frame height
+  * @param  dst_width: output width after rotation
+  * @param  dst_height: output height after rotation
+  * @param  rotate: clockwise rotation
+  * @param  filter: scaling filter
+  * @retval none
+  */
+void uvc_yuv_init(uvc_yuv_conv_type *conv, const uint8_t *src,
+                  uint16_t src_width, uint16_t src_height,
+                  uint16_t dst_width, uint16_t dst_height,
+                  uvc_yuv_rotate_type rotate, uvc_yuv_filter_type filter)
+{
+  uint16_t uw = dst_width, uh = dst_height;
+
+  if(uvc_yuv_luma_ready == 0)
+  {
+    uvc_yuv_luma_init();
+  }
+  if((rotate == UVC_YUV_ROTATE_90) || (rotate == UVC_YUV_ROTATE_270))
+  {
+    uw = dst_height;
+    uh = dst_width;
+  }
+
+  conv->src = src;
+  conv->src_width = src_width;
+  conv->src_height = src_height;
+  conv->dst_width = dst_width;
+  conv->dst_height = (uw && uh) ? dst_height : 0;
+  conv->rotate = rotate;
+  conv->filter = filter;
+  conv->step_x = uw ? (int32_t)(((uint32_t)src_width << 16) / uw) : 0;
+  conv->step_y = uh ? (int32_t)(((uint32_t)src_height << 16) / uh) : 0;
+  conv->row = 0;
+}
+
+/**
+  * @brief  convert the next output rows, for strip wise output to the lcd
+  * @param  conv: conversion
+  * @param  dst: rows x dst_width pixels
+  * @param  rows: most rows to convert
+  * @retval rows converted, 0 when the frame is done
+  */
+uint16_t uvc_yuv_convert_rows(uvc_yuv_conv_type *conv, lv_color_t *dst, uint16_t rows)
+{
+  uint16_t idx;
+
+  if(rows > conv->dst_height - conv->row)
+  {
+    rows = conv->dst_height - conv->row;
+  }
+  for(idx = 0; idx < rows; idx ++)
+  {
+    uvc_yuv_convert_row(conv, conv->row ++, dst);
+    dst += conv->dst_width;
+  }
+  return rows;
+}
+
+/**
+  * @brief  convert the remaining output rows
+  * @param  conv: conversion
+  * @param  dst: dst_width x dst_height pixels
+  * @retval none
+  */
+void uvc_yuv_convert(uvc_yuv_conv_type *conv, lv_color_t *dst)
+{
+  uvc_yuv_convert_rows(conv, dst + conv->row * conv->dst_width,
+                       conv->dst_height - conv->row);
+}
@@ -0,0 +1,78 @@
+/**
+  **************************************************************************
+  * @file     usbh_video_yuv.h
+  * @version  v2.0.9
+  * @date     2022-06-28
+  * @brief    usb host video yuy2 conversion header file
+  **************************************************************************
+  *                       Copyright notice & Disclaimer
+  *
+  * The software Board Support Package (BSP) that is made available to
+  * download from Artery official website is the copyrighted work of Artery.
+  * Artery authorizes customers to use, copy, and distribute the BSP
+  * software and its related documentation for the purpose of design and
+  * development in conjunction with Artery microcontrollers. Use of the
+  * software is governed by this copyright notice and the following disclaimer.
+  *
+  * THIS SOFTWARE IS PROVIDED ON "AS IS" BASIS WITHOUT WARRANTIES,
+  * GUARANTEES OR REPRESENTATIONS OF ANY KIND. ARTERY EXPRESSLY DISCLAIMS,
+  * TO THE FULLEST EXTENT PERMITTED BY LAW, ALL EXPRESS, IMPLIED OR
+  * STATUTORY OR OTHER WARRANTIES, GUARANTEES OR REPRESENTATIONS,
+  * INCLUDING BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.
+  *
+  **************************************************************************
+  */
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBH_VIDEO_YUV_H
+#define __USBH_VIDEO_YUV_H
+
+#include "lvgl.h"
+#include "usbh_video_stream_parsing.h"
+
+/**
+  * @brief output rotation, clockwise
+  */
+typedef enum
+{
+  UVC_YUV_ROTATE_0 = 0,
+  UVC_YUV_ROTATE_90,
+  UVC_YUV_ROTATE_180,
+  UVC_YUV_ROTATE_270
+}uvc_yuv_rotate_type;
+
+/**
+  * @brief scaling filter
+  */
+typedef enum
+{
+  UVC_YUV_NEAREST = 0,              /*!< nearest sample */
+  UVC_YUV_BILINEAR                  /*!< bilinear luma, nearest chroma */
+}uvc_yuv_filter_type;
+
+/**
+  * @brief yuy2 conversion, one pass from the camera frame to the output
+  *        size and orientation. fields are internal after uvc_yuv_init
+  */
+typedef struct
+{
+  const uint8_t                      *src;
+  uint16_t                           src_width;
+  uint16_t                           src_height;
+  uint16_t                           dst_width;    /*!< output width after rotation */
+  uint16_t                           dst_height;   /*!< output height after rotation */
+  uvc_yuv_rotate_type                rotate;
+  uvc_yuv_filter_type                filter;
+  int32_t                            step_x;       /*!< source step per output pixel, 16.16 */
+  int32_t                            step_y;
+  uint16_t                           row;          /*!< next output row */
+}uvc_yuv_conv_type;
+
+void uvc_yuv_init(uvc_yuv_conv_type *conv, const uint8_t *src,
+                  uint16_t src_width, uint16_t src_height,
+                  uint16_t dst_width, uint16_t dst_height,
+                  uvc_yuv_rotate_type rotate, uvc_yuv_filter_type filter);
+uint16_t uvc_yuv_convert_rows(uvc_yuv_conv_type *conv, lv_color_t *dst, uint16_t rows);
+void uvc_yuv_convert(uvc_yuv_conv_type *conv, lv_color_t *dst);
+
+#endif
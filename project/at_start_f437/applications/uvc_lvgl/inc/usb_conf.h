@@ -198,6 +198,34 @@ extern "C" {
 /* usb host vbus power switch */
 #define USBH_5V_POWER_SWITCH
 
+/* usb host rx fifo drained by the edma, comment out to read every
+   received packet by the cpu */
+/* #define USBH_RX_DMA_ENABLE */
+#ifdef USBH_RX_DMA_ENABLE
+#define USBH_RX_DMA_STREAM               EDMA_STREAM2
+#define USBH_RX_DMA_FLAGS                (EDMA_FERR2_FLAG | EDMA_DMERR2_FLAG | EDMA_DTERR2_FLAG | \
+                                          EDMA_HDT2_FLAG | EDMA_FDT2_FLAG)
+#define USBH_RX_DMA_FDT_FLAG             EDMA_FDT2_FLAG
+#define USBH_RX_DMA_IRQ                  EDMA_Stream2_IRQn
+#define USBH_RX_DMA_IRQ_HANDLER          EDMA_Stream2_IRQHandler
+/* shorter packets are read by the cpu */
+#define USBH_RX_DMA_MIN_SIZE             256
+#endif
+
+/* usb host fast attach, the loop handler waits for the port events and
+   usb_get_tick_ms instead of fixed delays, comment out to block in
+   usb_delay_ms while a device attaches. times in ms */
+#define USBH_FAST_ATTACH_ENABLE
+#ifdef USBH_FAST_ATTACH_ENABLE
+#define USBH_ATTACH_DEBOUNCE_TIME        100
+#define USBH_PORT_RESET_TIME             50
+#define USBH_RESET_RECOVERY_TIME         10
+#endif
+
+/* print the duration of every attach phase, from connect to the class
+   running, with USBH_DEBUG. comment in to measure an attach */
+/* #define USBH_ENUM_TIMING_ENABLE */
+
 #endif
 
 /**
@@ -226,6 +254,7 @@ extern "C" {
 
 void usb_delay_ms(uint32_t ms);
 void usb_delay_us(uint32_t us);
+uint32_t usb_get_tick_ms(void);
 /**
   * @}
   */
@@ -24,6 +24,10 @@
 
 /* includes ------------------------------------------------------------------*/
 #include "at32f435_437_int.h"
+#include "usb_core.h"
+#include "usbh_video_class.h"
+
+extern otg_core_type otg_core_struct;
 /** @addtogroup AT32F435_periph_examples
   * @{
   */
@@ -117,6 +121,8 @@ void DebugMon_Handler(void)
   */
 void PendSV_Handler(void)
 {
+  /* isochronous payloads queued by the otg interrupt */
+  usbh_uvc_deferred_handler(&otg_core_struct.host);
 }
 
 /**
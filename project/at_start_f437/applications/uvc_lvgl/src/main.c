@@ -46,8 +46,8 @@ void usb_gpio_config(void);
 void usb_low_power_wakeup_config(void);
 void button_exint_init(void);
 void button_isr(void);
-uint8_t buffer0[UVC_MAX_FRAME_SIZE];
-uint8_t buffer1[UVC_MAX_FRAME_SIZE];
+uint8_t buffer0[UVC_FRAME_BUFFER_SIZE];
+uint8_t buffer1[UVC_FRAME_BUFFER_SIZE];
 
 /**
   * @brief  configure button exint
@@ -173,6 +173,9 @@ void crm_configuration(void)
   crm_periph_clock_enable(LCD_SPI_SCK_GPIO_CLK, TRUE);
   crm_periph_clock_enable(LCD_SPI_MOSI_GPIO_CLK, TRUE);
   crm_periph_clock_enable(LCD_SPI_MISO_GPIO_CLK, TRUE);  
+#ifdef USBH_RX_DMA_ENABLE
+  crm_periph_clock_enable(CRM_EDMA_PERIPH_CLOCK, TRUE);
+#endif
 }
 
 
@@ -188,6 +191,11 @@ void nvic_configuration(void)
 
   /* configure dma1 channel3 for the spi transmit */
   nvic_irq_enable(LCD_SPI_MASTER_Tx_DMA_IRQn, 0, 2);
+
+#ifdef USBH_RX_DMA_ENABLE
+  /* configure the edma stream draining the usb rx fifo */
+  nvic_irq_enable(USBH_RX_DMA_IRQ, 0, 0);
+#endif
 }
 
 
@@ -377,6 +385,18 @@ void OTG_IRQ_HANDLER(void)
   usbh_irq_handler(&otg_core_struct);
 }
 
+#ifdef USBH_RX_DMA_ENABLE
+/**
+  * @brief  this function handles the edma stream draining the usb rx fifo.
+  * @param  none
+  * @retval none
+  */
+void USBH_RX_DMA_IRQ_HANDLER(void)
+{
+  usbh_rx_dma_irq_handler();
+}
+#endif
+
 /**
   * @brief  usb delay millisecond function.
   * @param  ms: number of millisecond delay
@@ -396,4 +416,15 @@ void usb_delay_ms(uint32_t ms)
 void usb_delay_us(uint32_t us)
 {
   delay_us(us);
+}
+
+/**
+  * @brief  usb millisecond tick function.
+  * @param  none
+  * @retval free running millisecond count
+  */
+uint32_t usb_get_tick_ms(void)
+{
+  /* user can define self tick function */
+  return millis();
 }
\ No newline at end of file
@@ -36,6 +36,123 @@ uint16_t back_color = 0xFFFF;
 
 lcd_dev_struct lcddev;
 
+/**
+  * @brief lcd dma window job
+  */
+typedef struct
+{
+  uint16_t xs;
+  uint16_t ys;
+  uint16_t xe;
+  uint16_t ye;
+  const uint16_t *pixels;
+  uint32_t row_beats;       //beats per row, the whole window when contiguous
+  uint16_t rows;
+  uint16_t stride;          //pixels from row to row
+  uint16_t color;           //fill color, pixels points here for a fill
+  uint8_t fill;
+  uint16_t pool_len;        //pool pixels freed with the job
+  lcd_dma_done_type done;
+  void *user;
+} lcd_dma_job_struct;
+
+/**
+  * @brief ili9341 register shadow, commands that would not change
+  *        anything are not sent
+  */
+typedef struct
+{
+  uint16_t xs;
+  uint16_t xe;
+  uint16_t ys;
+  uint16_t ye;
+  uint8_t madctl;
+  uint8_t pixfmt;
+  uint8_t valid;            //LCD_SHADOW_x bits
+} lcd_shadow_struct;
+
+#define LCD_SHADOW_COLUMN                0x01
+#define LCD_SHADOW_ROW                   0x02
+#define LCD_SHADOW_MADCTL                0x04
+#define LCD_SHADOW_PIXFMT                0x08
+
+/**
+  * @brief one pixel wide or one pixel high run of the drawing primitives
+  */
+typedef struct
+{
+  uint16_t xs;
+  uint16_t ys;
+  uint16_t xe;
+  uint16_t ye;
+  uint16_t color;
+  uint8_t valid;
+} lcd_run_struct;
+
+static lcd_dma_job_struct lcd_dma_queue[LCD_DMA_QUEUE_SIZE];
+static uint8_t lcd_dma_head;                //running job
+static uint8_t lcd_dma_tail;
+static volatile uint8_t lcd_dma_count;
+static const uint16_t *lcd_dma_addr;        //next beat
+static uint32_t lcd_dma_left;               //beats left in the row
+static uint16_t lcd_dma_row;
+
+static uint16_t lcd_dma_pool[LCD_DMA_POOL_SIZE];
+static uint16_t lcd_dma_pool_tail;          //next free pixel
+static volatile uint16_t lcd_dma_pool_used; //pixels owned by queued jobs
+static uint16_t lcd_dma_pool_pending;       //allocated, not yet submitted
+
+/* ili9341 registers as last written */
+static lcd_shadow_struct lcd_shadow;
+static lcd_bus_stats_struct lcd_bus_stats;
+
+/**
+  * @brief  send a run to the lcd dma
+  * @param  run: run to send
+  * @retval none
+  */
+static void lcd_run_flush(lcd_run_struct *run)
+{
+  if(run->valid)
+  {
+    lcd_dma_fill(run->xs, run->ys, run->xe, run->ye, run->color, NULL, NULL);
+    run->valid = 0;
+  }
+}
+
+/**
+  * @brief  add a pixel to a run, a pixel that doesn't extend the run
+  *         sends it and starts a new one
+  * @param  run: run to extend
+  * @param  x: x coordinate value
+  * @param  y: y coordinate value
+  * @retval none
+  */
+static void lcd_run_add(lcd_run_struct *run, uint16_t x, uint16_t y)
+{
+  if(run->valid)
+  {
+    if((x >= run->xs) && (x <= run->xe) && (y >= run->ys) && (y <= run->ye))
+    {
+      return;
+    }
+    if((run->ys == run->ye) && (y == run->ys) && ((x + 1 == run->xs) || (x == run->xe + 1)))
+    {
+      if(x < run->xs) run->xs = x; else run->xe = x;
+      return;
+    }
+    if((run->xs == run->xe) && (x == run->xs) && ((y + 1 == run->ys) || (y == run->ye + 1)))
+    {
+      if(y < run->ys) run->ys = y; else run->ye = y;
+      return;
+    }
+    lcd_run_flush(run);
+  }
+  run->xs = run->xe = x;
+  run->ys = run->ye = y;
+  run->valid = 1;
+}
+
 /**
   * @brief  lcd write register
   * @param  regval: register value
@@ -43,9 +160,12 @@ lcd_dev_struct lcddev;
   */
 void lcd_wr_reg(uint8_t regval)
 {
+  /* parameters of the last command may still be shifting out */
+  while(spi_i2s_flag_get(LCD_SPI_SELECTED, SPI_I2S_BF_FLAG) == SET);
   LCD_DC_CLR;//cmd
   lcd_spi1_write(regval);
   LCD_DC_SET;//data
+  lcd_bus_stats.cmd_cnt++;
 }
 
 /**
@@ -56,6 +176,100 @@ void lcd_wr_reg(uint8_t regval)
 void lcd_wr_data(uint8_t data)
 {
   lcd_spi1_write(data);
+  lcd_bus_stats.param_cnt++;
+}
+
+/**
+  * @brief  lcd write a command with two 16-bit parameters. the parameters
+  *         are queued back to back, the next lcd_wr_reg waits for them
+  * @param  regval: register value
+  * @param  p0: first parameter
+  * @param  p1: second parameter
+  * @retval none
+  */
+static void lcd_wr_reg_param2(uint8_t regval, uint16_t p0, uint16_t p1)
+{
+  uint8_t param[4];
+  uint8_t i;
+
+  param[0] = p0 >> 8;
+  param[1] = p0 & 0xff;
+  param[2] = p1 >> 8;
+  param[3] = p1 & 0xff;
+
+  lcd_wr_reg(regval);
+  for(i = 0; i < 4; i++)
+  {
+    while(spi_i2s_flag_get(LCD_SPI_SELECTED, SPI_I2S_TDBE_FLAG) == RESET);
+    spi_i2s_data_transmit(LCD_SPI_SELECTED, param[i]);
+  }
+  lcd_bus_stats.param_cnt += 4;
+}
+
+/**
+  * @brief  forget the register shadow, the next writes are all sent
+  * @param  none
+  * @retval none
+  */
+void lcd_shadow_reset(void)
+{
+  lcd_shadow.valid = 0;
+}
+
+/**
+  * @brief  set the memory access control register
+  * @param  madctl: register value
+  * @retval none
+  */
+void lcd_set_madctl(uint8_t madctl)
+{
+  if((lcd_shadow.valid & LCD_SHADOW_MADCTL) && (lcd_shadow.madctl == madctl))
+  {
+    lcd_bus_stats.skip_cnt++;
+    return;
+  }
+  lcd_wr_reg(0x36);
+  lcd_wr_data(madctl);
+  lcd_shadow.madctl = madctl;
+  lcd_shadow.valid |= LCD_SHADOW_MADCTL;
+}
+
+/**
+  * @brief  set the pixel format register
+  * @param  pixfmt: register value, 0x55 for rgb565
+  * @retval none
+  */
+void lcd_set_pixel_format(uint8_t pixfmt)
+{
+  if((lcd_shadow.valid & LCD_SHADOW_PIXFMT) && (lcd_shadow.pixfmt == pixfmt))
+  {
+    lcd_bus_stats.skip_cnt++;
+    return;
+  }
+  lcd_wr_reg(0x3A);
+  lcd_wr_data(pixfmt);
+  lcd_shadow.pixfmt = pixfmt;
+  lcd_shadow.valid |= LCD_SHADOW_PIXFMT;
+}
+
+/**
+  * @brief  get the command bus statistics
+  * @param  stats: statistics output
+  * @retval none
+  */
+void lcd_get_bus_stats(lcd_bus_stats_struct *stats)
+{
+  *stats = lcd_bus_stats;
+}
+
+/**
+  * @brief  clear the command bus statistics
+  * @param  none
+  * @retval none
+  */
+void lcd_reset_bus_stats(void)
+{
+  memset(&lcd_bus_stats, 0, sizeof(lcd_bus_stats));
 }
 
 /**
@@ -78,8 +292,7 @@ void lcd_wr_data16(uint16_t data)
   */
 void lcd_draw_point(uint16_t x, uint16_t y, uint16_t color)
 {
-  lcd_set_cursor(x, y);
-  lcd_wr_data16(color);
+  lcd_dma_fill(x, y, x, y, color, NULL, NULL);
 }
 
 /**
@@ -91,16 +304,9 @@ void lcd_draw_point(uint16_t x, uint16_t y, uint16_t color)
   */
 void lcd_draw_big_point(uint16_t x, uint16_t y, uint16_t color)
 {
-  uint8_t i;
   if((x>0)&&(y>0)&&(x<LCD_WIDTH)&&(y<LCD_HEIGHT))
   {
-    for(i = 0; i < TOUCH_POINT_SIZE; i++)
-    {
-      lcd_set_cursor(x - 1, y - 1 + i);
-      lcd_wr_data16(color);
-      lcd_wr_data16(color);
-      lcd_wr_data16(color);
-    }
+    lcd_dma_fill(x - 1, y - 1, x + 1, y - 1 + TOUCH_POINT_SIZE - 1, color, NULL, NULL);
   }
 }
 
@@ -118,6 +324,9 @@ void lcd_draw_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t
   uint16_t t;
   int xerr = 0, yerr = 0, delta_x, delta_y, distance;
   int incx, incy, urow, ucol;
+  lcd_run_struct run;
+  run.valid = 0;
+  run.color = color;
   delta_x = x2 - x1;
   delta_y = y2 - y1;
   urow = x1;
@@ -162,7 +371,7 @@ void lcd_draw_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t
 
   for(t = 0; t <= distance + 1; t++ )
   {
-    lcd_draw_point(urow, ucol, color);
+    lcd_run_add(&run, urow, ucol);
     xerr += delta_x ;
     yerr += delta_y ;
 
@@ -178,6 +387,7 @@ void lcd_draw_line(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t
       ucol += incy;
     }
   }
+  lcd_run_flush(&run);
 }
 
 /**
@@ -209,20 +419,27 @@ void lcd_draw_circle(uint16_t x0, uint16_t y0, uint8_t r, uint16_t color)
 {
   int a, b;
   int di;
+  uint8_t i;
+  lcd_run_struct run[8];     //one run per octant
+  for(i = 0; i < 8; i++)
+  {
+    run[i].valid = 0;
+    run[i].color = color;
+  }
   a = 0;
   b = r;
   di = 3 - (r << 1);
 
   while(a <= b)
   {
-    lcd_draw_point(x0 + a, y0 - b, color);        //5
-    lcd_draw_point(x0 + b, y0 - a, color);        //0
-    lcd_draw_point(x0 + b, y0 + a, color);        //4
-    lcd_draw_point(x0 + a, y0 + b, color);        //6
-    lcd_draw_point(x0 - a, y0 + b, color);        //1
-    lcd_draw_point(x0 - b, y0 + a, color);
-    lcd_draw_point(x0 - a, y0 - b, color);        //2
-    lcd_draw_point(x0 - b, y0 - a, color);        //7
+    lcd_run_add(&run[0], x0 + a, y0 - b);        //5
+    lcd_run_add(&run[1], x0 + b, y0 - a);        //0
+    lcd_run_add(&run[2], x0 + b, y0 + a);        //4
+    lcd_run_add(&run[3], x0 + a, y0 + b);        //6
+    lcd_run_add(&run[4], x0 - a, y0 + b);        //1
+    lcd_run_add(&run[5], x0 - b, y0 + a);
+    lcd_run_add(&run[6], x0 - a, y0 - b);        //2
+    lcd_run_add(&run[7], x0 - b, y0 - a);        //7
     a++;
 
     /* draw a circle with bresenham algorithm */
@@ -236,6 +453,10 @@ void lcd_draw_circle(uint16_t x0, uint16_t y0, uint8_t r, uint16_t color)
       b--;
     }
   }
+  for(i = 0; i < 8; i++)
+  {
+    lcd_run_flush(&run[i]);
+  }
 }
 
 /**
@@ -285,10 +506,26 @@ void lcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height, ui
 void lcd_show_char(uint16_t x, uint16_t y, uint8_t num, uint8_t size, uint8_t mode)
 {
   uint8_t temp, t1, t;
-  uint16_t y0 = y;
-  uint8_t csize = (size / 8 + ((size % 8) ? 1 : 0)) * (size / 2);
+  uint8_t col = 0, row = 0;
+  uint8_t width = size / 2;
+  uint8_t csize = (size / 8 + ((size % 8) ? 1 : 0)) * width;
+  uint16_t *pixels = NULL;
+  lcd_run_struct run;
   num = num - ' ';
 
+  if(((size != 12) && (size != 16) && (size != 24)) || (x >= lcddev.width) || (y >= lcddev.height))
+  {
+    return;
+  }
+
+  /* an opaque glyph is one blit, a transparent one a run per column stroke */
+  if(mode == 0)
+  {
+    pixels = lcd_dma_pool_alloc(width * size);
+  }
+  run.valid = 0;
+  run.color = point_color;
+
   for(t = 0; t < csize; t++)
   {
     if(size == 12)
@@ -299,48 +536,47 @@ void lcd_show_char(uint16_t x, uint16_t y, uint8_t num, uint8_t size, uint8_t mo
     {
       temp = asc2_1608[num][t];  //1608 typeface
     }
-    else if(size == 24)
-    {
-      temp = asc2_2412[num][t];  //2412 typeface
-    }
     else
     {
-      return;
+      temp = asc2_2412[num][t];  //2412 typeface
     }
 
     for(t1 = 0; t1 < 8; t1++)
     {
-      if(temp & 0x80)
+      if(mode == 0)
       {
-        lcd_draw_point(x, y, point_color);
+        pixels[row * width + col] = (temp & 0x80) ? point_color : back_color;
       }
-      else if(mode == 0)
+      else if(temp & 0x80)
       {
-        lcd_draw_point(x, y, back_color);
+        if((x + col < lcddev.width) && (y + row < lcddev.height))
+        {
+          lcd_run_add(&run, x + col, y + row);
+        }
       }
 
       temp <<= 1;
-      y++;
+      row++;
 
-      if(y >= lcddev.height)
+      if(row == size)
       {
-        return;
-      }
-
-      if((y - y0) == size)
-      {
-        y = y0;
-        x++;
-
-        if(x >= lcddev.width)
-        {
-          return;
-        }
-
+        row = 0;
+        col++;
         break;
       }
     }
   }
+
+  if(mode == 0)
+  {
+    /* clip to the panel, the rows keep the glyph stride */
+    lcd_dma_submit(x, y, LCD_MIN(x + width, lcddev.width) - 1, LCD_MIN(y + size, lcddev.height) - 1,
+                   pixels, width, NULL, NULL);
+  }
+  else
+  {
+    lcd_run_flush(&run);
+  }
 }
 
 /**
@@ -353,21 +589,372 @@ void lcd_show_char(uint16_t x, uint16_t y, uint8_t num, uint8_t size, uint8_t mo
   */
 void lcd_set_window(unsigned int Xstart, unsigned int Ystart, unsigned int Xend, unsigned int Yend)
 {
-  lcd_wr_reg(lcddev.setxcmd);
-  lcd_wr_data(Xstart >> 8);
-  lcd_wr_data(Xstart & 0xff);
-  lcd_wr_data(Xend >> 8);
-  lcd_wr_data(Xend & 0xff);
+  /* strips of the same width or the same rows only move one address pair */
+  if((lcd_shadow.valid & LCD_SHADOW_COLUMN) && (lcd_shadow.xs == Xstart) && (lcd_shadow.xe == Xend))
+  {
+    lcd_bus_stats.skip_cnt++;
+  }
+  else
+  {
+    lcd_wr_reg_param2(lcddev.setxcmd, Xstart, Xend);
+    lcd_shadow.xs = Xstart;
+    lcd_shadow.xe = Xend;
+    lcd_shadow.valid |= LCD_SHADOW_COLUMN;
+  }
 
-  lcd_wr_reg(lcddev.setycmd);
-  lcd_wr_data(Ystart >> 8);
-  lcd_wr_data(Ystart & 0xff);
-  lcd_wr_data(Yend >> 8);
-  lcd_wr_data(Yend & 0xff);
+  if((lcd_shadow.valid & LCD_SHADOW_ROW) && (lcd_shadow.ys == Ystart) && (lcd_shadow.ye == Yend))
+  {
+    lcd_bus_stats.skip_cnt++;
+  }
+  else
+  {
+    lcd_wr_reg_param2(lcddev.setycmd, Ystart, Yend);
+    lcd_shadow.ys = Ystart;
+    lcd_shadow.ye = Yend;
+    lcd_shadow.valid |= LCD_SHADOW_ROW;
+  }
 
+  /* memory write always restarts at the window origin */
   lcd_wr_reg(lcddev.wramcmd);
 }
 
+/**
+  * @brief  switch the tearing effect output, the te line pulses at the
+  *         start of every vertical blanking period
+  * @param  new_state: TRUE or FALSE
+  * @retval none
+  */
+void lcd_tearing_effect(confirm_state new_state)
+{
+  lcd_dma_wait();
+  if(new_state == TRUE)
+  {
+    lcd_wr_reg(0x35);
+    lcd_wr_data(0x00);
+  }
+  else
+  {
+    lcd_wr_reg(0x34);
+  }
+}
+
+/**
+  * @brief  define the vertical scrolling area, the rows of the fixed top,
+  *         scrolling and fixed bottom areas add up to the panel height
+  * @param  tfa: rows of the top fixed area
+  * @param  vsa: rows of the vertical scrolling area
+  * @param  bfa: rows of the bottom fixed area
+  * @retval none
+  */
+void lcd_scroll_area(uint16_t tfa, uint16_t vsa, uint16_t bfa)
+{
+  lcd_dma_wait();
+  lcd_wr_reg(0x33);
+  lcd_wr_data(tfa >> 8);
+  lcd_wr_data(tfa & 0xff);
+  lcd_wr_data(vsa >> 8);
+  lcd_wr_data(vsa & 0xff);
+  lcd_wr_data(bfa >> 8);
+  lcd_wr_data(bfa & 0xff);
+}
+
+/**
+  * @brief  set the memory row shown at the first row of the scrolling area
+  * @param  vsp: memory row, from tfa to tfa + vsa - 1
+  * @retval none
+  */
+void lcd_scroll_start(uint16_t vsp)
+{
+  lcd_dma_wait();
+  lcd_wr_reg(0x37);
+  lcd_wr_data(vsp >> 8);
+  lcd_wr_data(vsp & 0xff);
+}
+
+/**
+  * @brief  leave the vertical scrolling mode
+  * @param  none
+  * @retval none
+  */
+void lcd_scroll_disable(void)
+{
+  lcd_dma_wait();
+  lcd_wr_reg(0x13);
+}
+
+/**
+  * @brief  change the spi frame size, it may only change while the spi is off
+  * @param  bit_num: SPI_FRAME_8BIT or SPI_FRAME_16BIT
+  * @retval none
+  */
+static void lcd_spi_frame_set(spi_frame_bit_num_type bit_num)
+{
+  while(spi_i2s_flag_get(LCD_SPI_SELECTED, SPI_I2S_BF_FLAG) == SET);
+  spi_enable(LCD_SPI_SELECTED, FALSE);
+  spi_frame_bit_num_set(LCD_SPI_SELECTED, bit_num);
+  spi_enable(LCD_SPI_SELECTED, TRUE);
+}
+
+/**
+  * @brief  send the next chunk of the running job, at most LCD_DMA_MAX_BEATS
+  * @param  none
+  * @retval none
+  */
+static void lcd_dma_chunk(void)
+{
+  uint32_t beats = lcd_dma_left;
+
+  if(beats > LCD_DMA_MAX_BEATS)
+    beats = LCD_DMA_MAX_BEATS;
+  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = FALSE;
+  LCD_SPI_MASTER_Tx_DMA_Channel->dtcnt = beats;
+  LCD_SPI_MASTER_Tx_DMA_Channel->maddr = (uint32_t)lcd_dma_addr;
+  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = TRUE;
+  lcd_dma_left -= beats;
+  if(lcd_dma_queue[lcd_dma_head].fill == 0)
+    lcd_dma_addr += beats;
+}
+
+/**
+  * @brief  open the window of the job at the queue head and start its dma
+  * @param  none
+  * @retval none
+  */
+static void lcd_dma_start(void)
+{
+  lcd_dma_job_struct *job = &lcd_dma_queue[lcd_dma_head];
+
+  /* commands go out in 8-bit frames, pixels in 16-bit frames */
+  lcd_spi_frame_set(SPI_FRAME_8BIT);
+  lcd_set_window(job->xs, job->ys, job->xe, job->ye);
+  LCD_DC_SET;
+  lcd_spi_frame_set(SPI_FRAME_16BIT);
+
+  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.mincm = (job->fill == 0);
+  lcd_dma_addr = job->fill ? &job->color : job->pixels;
+  lcd_dma_left = job->row_beats;
+  lcd_dma_row = 0;
+  lcd_dma_chunk();
+}
+
+/**
+  * @brief  queue a job, waits while the queue is full
+  * @param  job: job to copy into the queue
+  * @retval none
+  */
+static void lcd_dma_queue_job(const lcd_dma_job_struct *job)
+{
+  uint32_t primask;
+  uint8_t start;
+
+  while(lcd_dma_count >= LCD_DMA_QUEUE_SIZE);
+
+  lcd_dma_queue[lcd_dma_tail] = *job;
+  lcd_dma_tail = (lcd_dma_tail + 1) % LCD_DMA_QUEUE_SIZE;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  start = (lcd_dma_count == 0);
+  lcd_dma_count++;
+  __set_PRIMASK(primask);
+
+  if(start)
+    lcd_dma_start();
+}
+
+/**
+  * @brief  send pixels to a panel window without waiting. rows longer than
+  *         the window use a stride, windows over LCD_DMA_MAX_BEATS are chained
+  *         from the dma interrupt. pixels must stay valid until done is called.
+  *         don't call from an interrupt above the lcd dma priority
+  * @param  xs: x direction start
+  * @param  ys: y direction start
+  * @param  xe: x direction end, inclusive
+  * @param  ye: y direction end, inclusive
+  * @param  pixels: rgb565 pixels of the first row
+  * @param  stride: pixels from row to row, 0 for packed rows
+  * @param  done: completion callback, NULL for none
+  * @param  user: callback argument
+  * @retval none
+  */
+void lcd_dma_submit(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye, const uint16_t *pixels,
+                    uint16_t stride, lcd_dma_done_type done, void *user)
+{
+  lcd_dma_job_struct job;
+  uint16_t width = xe - xs + 1;
+
+  /* an empty window would start a dma of zero beats that never completes */
+  if((xe < xs) || (ye < ys))
+  {
+    if(done != NULL)
+      done(user);
+    return;
+  }
+
+  job.xs = xs;
+  job.ys = ys;
+  job.xe = xe;
+  job.ye = ye;
+  job.pixels = pixels;
+  job.fill = 0;
+  job.pool_len = 0;
+  job.done = done;
+  job.user = user;
+  /* pool pixels are given back when the job is done */
+  if((pixels >= lcd_dma_pool) && (pixels < lcd_dma_pool + LCD_DMA_POOL_SIZE))
+  {
+    job.pool_len = lcd_dma_pool_pending;
+    lcd_dma_pool_pending = 0;
+  }
+  if((stride == 0) || (stride == width))
+  {
+    job.row_beats = (uint32_t)width * (ye - ys + 1);
+    job.rows = 1;
+    job.stride = 0;
+  }
+  else
+  {
+    job.row_beats = width;
+    job.rows = ye - ys + 1;
+    job.stride = stride;
+  }
+  lcd_dma_queue_job(&job);
+}
+
+/**
+  * @brief  fill a panel window with one color without waiting
+  * @param  xs: x direction start
+  * @param  ys: y direction start
+  * @param  xe: x direction end, inclusive
+  * @param  ye: y direction end, inclusive
+  * @param  color: rgb565 color
+  * @param  done: completion callback, NULL for none
+  * @param  user: callback argument
+  * @retval none
+  */
+void lcd_dma_fill(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye, uint16_t color,
+                  lcd_dma_done_type done, void *user)
+{
+  lcd_dma_job_struct job;
+
+  if((xe < xs) || (ye < ys))
+  {
+    if(done != NULL)
+      done(user);
+    return;
+  }
+
+  job.xs = xs;
+  job.ys = ys;
+  job.xe = xe;
+  job.ye = ye;
+  job.pixels = NULL;
+  job.row_beats = (uint32_t)(xe - xs + 1) * (ye - ys + 1);
+  job.rows = 1;
+  job.stride = 0;
+  job.color = color;
+  job.fill = 1;
+  job.pool_len = 0;
+  job.done = done;
+  job.user = user;
+  lcd_dma_queue_job(&job);
+}
+
+/**
+  * @brief  get pixels for a blit from the lcd dma pool, waits until enough
+  *         are free. they go back to the pool when the lcd_dma_submit that
+  *         sends them is done, so every allocation has to be submitted
+  * @param  count: number of pixels, at most LCD_DMA_POOL_SIZE
+  * @retval pixels, NULL if count is too big
+  */
+uint16_t *lcd_dma_pool_alloc(uint16_t count)
+{
+  uint16_t waste = 0;
+  uint16_t *pixels;
+  uint32_t primask;
+
+  if((count == 0) || (count > LCD_DMA_POOL_SIZE))
+    return NULL;
+
+  /* the pixels are contiguous, skip the end of the pool if it is too short */
+  if(lcd_dma_pool_tail + count > LCD_DMA_POOL_SIZE)
+    waste = LCD_DMA_POOL_SIZE - lcd_dma_pool_tail;
+  while(lcd_dma_pool_used + waste + count > LCD_DMA_POOL_SIZE);
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  lcd_dma_pool_used += waste + count;
+  __set_PRIMASK(primask);
+
+  if(waste)
+    lcd_dma_pool_tail = 0;
+  pixels = &lcd_dma_pool[lcd_dma_pool_tail];
+  lcd_dma_pool_tail = (lcd_dma_pool_tail + count) % LCD_DMA_POOL_SIZE;
+  lcd_dma_pool_pending += waste + count;
+  return pixels;
+}
+
+/**
+  * @brief  check the lcd dma engine
+  * @param  none
+  * @retval 1: jobs are queued or running
+  */
+uint8_t lcd_dma_busy(void)
+{
+  return (lcd_dma_count != 0);
+}
+
+/**
+  * @brief  wait until all queued jobs are on the panel
+  * @param  none
+  * @retval none
+  */
+void lcd_dma_wait(void)
+{
+  while(lcd_dma_count != 0);
+}
+
+/**
+  * @brief  lcd dma interrupt, continues the row, the next row or the next job
+  * @param  none
+  * @retval none
+  */
+void DMA1_Channel3_IRQHandler(void)
+{
+  lcd_dma_job_struct *job = &lcd_dma_queue[lcd_dma_head];
+  lcd_dma_done_type done;
+  void *user;
+
+  dma_flag_clear(LCD_SPI_MASTER_Tx_DMA_FLAG);
+  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = FALSE;
+
+  if(lcd_dma_left == 0)
+  {
+    lcd_dma_row++;
+    if(lcd_dma_row >= job->rows)
+    {
+      done = job->done;
+      user = job->user;
+
+      /* leave the spi in 8-bit frames for commands and touch */
+      lcd_spi_frame_set(SPI_FRAME_8BIT);
+      LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.mincm = TRUE;
+
+      lcd_dma_pool_used -= job->pool_len;
+      lcd_dma_head = (lcd_dma_head + 1) % LCD_DMA_QUEUE_SIZE;
+      lcd_dma_count--;
+      if(lcd_dma_count != 0)
+        lcd_dma_start();
+      if(done != NULL)
+        done(user);
+      return;
+    }
+    lcd_dma_addr = job->pixels + (uint32_t)lcd_dma_row * job->stride;
+    lcd_dma_left = job->row_beats;
+  }
+  lcd_dma_chunk();
+}
+
 /**
   * @brief  set lcd cursor position
   * @param  sx: x position
@@ -376,6 +963,8 @@ void lcd_set_window(unsigned int Xstart, unsigned int Ystart, unsigned int Xend,
   */
 void lcd_set_cursor(uint16_t Xpos, uint16_t Ypos)
 {
+  /* only the window start is written, the end is unknown afterwards */
+  lcd_shadow.valid &= ~(LCD_SHADOW_COLUMN | LCD_SHADOW_ROW);
   lcd_wr_reg(lcddev.setxcmd);
   lcd_wr_data(Xpos >> 8);
   lcd_wr_data(Xpos & 0xff);
@@ -395,6 +984,7 @@ void lcd_set_cursor(uint16_t Xpos, uint16_t Ypos)
   */
 void lcd_scan_dir(uint8_t dir)
 {
+  lcd_dma_wait();
   switch(dir)
   {
     case 0:
@@ -403,8 +993,7 @@ void lcd_scan_dir(uint8_t dir)
       lcddev.setxcmd = 0x2A;
       lcddev.setycmd = 0x2B;
       lcddev.wramcmd = 0x2C;
-      lcd_wr_reg(0x36);
-      lcd_wr_data(0x08);
+      lcd_set_madctl(0x08);
       break;
     case 1:
       lcddev.width = 320;
@@ -412,8 +1001,7 @@ void lcd_scan_dir(uint8_t dir)
       lcddev.setxcmd = 0x2A;
       lcddev.setycmd = 0x2B;
       lcddev.wramcmd = 0x2C;
-      lcd_wr_reg(0x36);
-      lcd_wr_data(0xA8);
+      lcd_set_madctl(0xA8);
       break;
     case 2:
       lcddev.width = 240;
@@ -421,8 +1009,7 @@ void lcd_scan_dir(uint8_t dir)
       lcddev.setxcmd = 0x2A;
       lcddev.setycmd = 0x2B;
       lcddev.wramcmd = 0x2C;
-      lcd_wr_reg(0x36);
-      lcd_wr_data(0xC8);
+      lcd_set_madctl(0xC8);
       break;
     case 3:
       lcddev.width = 320;
@@ -430,8 +1017,7 @@ void lcd_scan_dir(uint8_t dir)
       lcddev.setxcmd = 0x2A;
       lcddev.setycmd = 0x2B;
       lcddev.wramcmd = 0x2C;
-      lcd_wr_reg(0x36);
-      lcd_wr_data(0x68);
+      lcd_set_madctl(0x68);
       break;
     default:
       break;
@@ -445,6 +1031,7 @@ void lcd_scan_dir(uint8_t dir)
   */
 void ili9341_ivo24_initial(void)
 {
+  lcd_shadow_reset();
   lcd_wr_reg(0x11);  //sleep out 
   delay_ms(120);
   lcd_wr_reg(0xCF);
@@ -480,8 +1067,7 @@ void ili9341_ivo24_initial(void)
   lcd_wr_data(0x3F);
   lcd_wr_reg(0xC7);  //vcm control
   lcd_wr_data(0x92);
-  lcd_wr_reg(0x3A);  //memory access control
-  lcd_wr_data(0x55);
+  lcd_set_pixel_format(0x55);  //pixel format, rgb565
   lcd_wr_reg(0xB1);
   lcd_wr_data(0x00);
   lcd_wr_data(0x12);
@@ -575,33 +1161,7 @@ void lcd_clear(uint16_t color)
     }
   }
 #else   /* use dma */
- 	uint32_t num,num1;
-  lcd_set_window(0, 0, LCD_WIDTH - 1, LCD_HEIGHT - 1);
-  LCD_DC_SET;
-  spi_frame_bit_num_set(LCD_SPI_SELECTED, SPI_FRAME_16BIT);
-  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.mincm = FALSE;
-  num = LCD_WIDTH * LCD_HEIGHT;
-  while(num)
-  {
-    if(num >= 0xFFFE)
-    {
-      num -= 0xFFFE;
-      num1 = 0xFFFE;
-    }
-    else
-    {
-      num1 = num;
-      num = 0;
-    }
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = FALSE;
-    LCD_SPI_MASTER_Tx_DMA_Channel->dtcnt_bit.cnt = num1;
-    LCD_SPI_MASTER_Tx_DMA_Channel->maddr  = (uint32_t)&color;
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = TRUE;
-    while(dma_flag_get(LCD_SPI_MASTER_Tx_DMA_FLAG) != SET);
-    dma_flag_clear(LCD_SPI_MASTER_Tx_DMA_FLAG);
-  }
-  LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.mincm = TRUE;
-  spi_frame_bit_num_set(LCD_SPI_SELECTED, SPI_FRAME_8BIT);
+  lcd_dma_fill(0, 0, LCD_WIDTH - 1, LCD_HEIGHT - 1, color, NULL, NULL);
 #endif  
 }
 
@@ -611,7 +1171,7 @@ void lcd_clear(uint16_t color)
   * @param  sy: y direction start
   * @param  ex: x direction end
   * @param  ey: y direction end
-  * @param  color: fill color point
+  * @param  color: fill color point, read in the background until lcd_dma_wait
   * @retval none
   */
 void lcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint16_t *color)
@@ -628,32 +1188,10 @@ void lcd_fill(uint16_t sx, uint16_t sy, uint16_t ex, uint16_t ey, uint16_t *colo
     }
   } 
 #else   /* use dma */
-	 uint32_t num,num1;
-  lcd_set_window(sx, sy, ex - 1, ey - 1);
-  LCD_DC_SET;
-  num = (ex - sx) * (ey - sy);
-  spi_frame_bit_num_set(LCD_SPI_SELECTED, SPI_FRAME_16BIT);
-  while(num)
-  {
-    if(num >= 0xFFFE)
-    {
-      num -= 0xFFFE;
-      num1 = 0xFFFE;
-    }
-    else
-    {
-      num1 = num;
-      num = 0;
-    }
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = FALSE;
-    LCD_SPI_MASTER_Tx_DMA_Channel->dtcnt_bit.cnt = num1;
-    LCD_SPI_MASTER_Tx_DMA_Channel->maddr  = (uint32_t)color;
-    LCD_SPI_MASTER_Tx_DMA_Channel->ctrl_bit.chen = TRUE;
-    while(dma_flag_get(LCD_SPI_MASTER_Tx_DMA_FLAG) != SET);
-    dma_flag_clear(LCD_SPI_MASTER_Tx_DMA_FLAG);
-    color += num1;
-  }
-  spi_frame_bit_num_set(LCD_SPI_SELECTED, SPI_FRAME_8BIT);
+  /* ex and ey are exclusive, ex - 1 would wrap for an empty area at 0 */
+  if((ex <= sx) || (ey <= sy))
+    return;
+  lcd_dma_submit(sx, sy, ex - 1, ey - 1, color, ex - sx, NULL, NULL);
 #endif
 }
 
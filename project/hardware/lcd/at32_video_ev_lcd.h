@@ -31,6 +31,26 @@
 
 #define TOUCH_POINT_SIZE           	     3
 
+/* largest transfer of the lcd dma in 16-bit beats, bigger windows are chained */
+#define LCD_DMA_MAX_BEATS                0xFFFE
+/* windows queued to the lcd dma engine */
+#define LCD_DMA_QUEUE_SIZE               16
+/* pixels for blits of the drawing primitives, a 24 point glyph takes 288 */
+#define LCD_DMA_POOL_SIZE                1024
+
+#define LCD_MIN(a, b)                    (((a) < (b)) ? (a) : (b))
+
+/* command bus statistics, pixels sent by dma are not counted */
+typedef struct
+{
+  uint32_t cmd_cnt;         //commands sent
+  uint32_t param_cnt;       //parameter bytes sent
+  uint32_t skip_cnt;        //commands skipped by the register shadow
+} lcd_bus_stats_struct;
+
+/* called from the dma interrupt when a window is on the panel */
+typedef void (*lcd_dma_done_type)(void *user);
+
 typedef struct
 {
   uint16_t width;			  //lcd width
@@ -102,6 +122,22 @@ void lcd_draw_circle(uint16_t x0, uint16_t y0, uint8_t r, uint16_t color);
 void lcd_show_string(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t size, char *p);
 void lcd_show_char(uint16_t x, uint16_t y, uint8_t num, uint8_t size, uint8_t mode);
 void lcd_set_window(unsigned int Xstart, unsigned int Ystart, unsigned int Xend, unsigned int Yend);
+void lcd_tearing_effect(confirm_state new_state);
+void lcd_scroll_area(uint16_t tfa, uint16_t vsa, uint16_t bfa);
+void lcd_scroll_start(uint16_t vsp);
+void lcd_scroll_disable(void);
+void lcd_shadow_reset(void);
+void lcd_set_madctl(uint8_t madctl);
+void lcd_set_pixel_format(uint8_t pixfmt);
+void lcd_get_bus_stats(lcd_bus_stats_struct *stats);
+void lcd_reset_bus_stats(void);
+void lcd_dma_submit(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye, const uint16_t *pixels,
+                    uint16_t stride, lcd_dma_done_type done, void *user);
+void lcd_dma_fill(uint16_t xs, uint16_t ys, uint16_t xe, uint16_t ye, uint16_t color,
+                  lcd_dma_done_type done, void *user);
+uint16_t *lcd_dma_pool_alloc(uint16_t count);
+uint8_t lcd_dma_busy(void);
+void lcd_dma_wait(void);
 void lcd_set_cursor(uint16_t Xpos, uint16_t Ypos);
 void lcd_scan_dir(uint8_t dir);
 void ili9341_ivo24_initial(void);
@@ -127,17 +127,9 @@ void lcd_hw_init(void)
 	/* ж */ 
 	dma_interrupt_enable(LCD_SPI_MASTER_Tx_DMA_Channel, DMA_FDT_INT, TRUE);
 	
-	///
-	crm_periph_clock_enable(CRM_TMR2_PERIPH_CLOCK, TRUE);
-	tmr_base_init(TMR2, 0x3F, 0); 
-	tmr_cnt_dir_set(TMR2, TMR_COUNT_UP);
-	/*  TMR2 DMA  */ 
-	tmr_dma_request_enable(TMR2, TMR_OVERFLOW_DMA_REQUEST, TRUE); 
-	
-	///
-	dmamux_enable(DMA1, TRUE);
-	dmamux_init(DMA1MUX_CHANNEL3, DMAMUX_DMAREQ_ID_TMR2_OVERFLOW);
-	tmr_counter_enable(TMR2, TRUE); 
+  /* pace the pixels by the spi transmit request, see lcd_dma_submit */
+  dmamux_enable(LCD_SPI_MASTER_DMA, TRUE);
+  dmamux_init(LCD_SPI_MASTER_Tx_DMAMUX_Channel, DMAMUX_DMAREQ_ID_SPI1_TX);
 }
 
 /**
@@ -97,6 +97,7 @@
 #define LCD_SPI_MASTER_Rx_DMA_INT        DMA1_FDT2_FLAG
 #define LCD_SPI_MASTER_Rx_DMA_FLAG       DMA1_FDT2_FLAG
 #define LCD_SPI_MASTER_Tx_DMA_Channel    DMA1_CHANNEL3
+#define LCD_SPI_MASTER_Tx_DMAMUX_Channel DMA1MUX_CHANNEL3
 #define LCD_SPI_MASTER_Tx_DMA_INT        DMA1_FDT3_FLAG
 #define LCD_SPI_MASTER_Tx_DMA_FLAG       DMA1_FDT3_FLAG
 #define LCD_SPI_MASTER_DR_Base			        (uint32_t)(&(LCD_SPI_SELECTED->dt)); 
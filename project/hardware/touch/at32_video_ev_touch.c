@@ -167,6 +167,8 @@ uint8_t touch_coor_read_twice(uint16_t *x, uint16_t *y)
   */
 uint8_t touch_precise_coor_read(void)
 {
+  /* the spi is shared with the lcd dma */
+  lcd_dma_wait();
   spi_switch(1);
   while(!touch_coor_read_twice(&tp_pixad.x, &tp_pixad.y));
   spi_switch(0);
@@ -198,6 +200,8 @@ void touch_adjust_point_draw(uint16_t x, uint16_t y, uint16_t color)
 uint8_t coor_convert(void)
 {
   uint8_t l = 0;
+  /* the spi is shared with the lcd dma */
+  lcd_dma_wait();
   spi_switch(1);
 
   if(touch_coor_read_twice(&tp_pixad.x, &tp_pixad.y))